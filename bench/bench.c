@@ -0,0 +1,129 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "bench.h"
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+volatile uint64_t bench_sink = 0;
+static uint64_t alloc_count = 0;
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See bench.h for details. */
+uint64_t bench_now_ns( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+
+/* See bench.h for details. */
+uint64_t bench_allocs( void )
+{
+    return alloc_count;
+}
+
+
+/* See bench.h for details. */
+void bench_run( bench_result_t *r, void (*fn)(void *ctx, uint64_t i), void *ctx )
+{
+    uint64_t start, elapsed, allocs, n = 0, batch = 1;
+
+    allocs = alloc_count;
+    start = bench_now_ns();
+    do {
+        uint64_t i;
+
+        for( i = 0; i < batch; i++ ) {
+            fn( ctx, n + i );
+        }
+        n += batch;
+        elapsed = bench_now_ns() - start;
+        if( batch < (1 << 16) ) {
+            batch <<= 1;
+        }
+    } while( elapsed < BENCH_MIN_NS );
+
+    r->iterations = n;
+    r->elapsed_ns = elapsed;
+    r->allocs = alloc_count - allocs;
+    bench_report( r );
+}
+
+
+/* See bench.h for details. */
+void bench_report( const bench_result_t *r )
+{
+    double ns_per_op = (double) r->elapsed_ns / (double) r->iterations;
+    struct rusage ru;
+    long peak_rss_kb = 0;
+
+    if( 0 == getrusage(RUSAGE_SELF, &ru) ) {
+        peak_rss_kb = ru.ru_maxrss;
+    }
+
+    printf( "{\"bench\":\"%s\"", r->bench );
+    if( 0 < r->events ) {
+        printf( ",\"events\":%zu", r->events );
+    }
+    if( 0 < r->macs ) {
+        printf( ",\"macs\":%zu", r->macs );
+    }
+    if( 0 < r->bytes ) {
+        printf( ",\"bytes\":%zu", r->bytes );
+    }
+    printf( ",\"iterations\":%llu,\"ns_per_op\":%.1f,\"allocs_per_op\":%.2f",
+            (unsigned long long) r->iterations, ns_per_op,
+            (double) r->allocs / (double) r->iterations );
+    if( 0 < r->bytes ) {
+        printf( ",\"mb_per_s\":%.1f", (double) r->bytes * 1000.0 / ns_per_op );
+    }
+    printf( ",\"peak_rss_kb\":%ld}\n", peak_rss_kb );
+    fflush( stdout );
+}
+
+
+/* Counting replacements for aker_mem.c. */
+void *aker_malloc( size_t size )
+{
+    alloc_count++;
+    return malloc( size );
+}
+
+void aker_free( void *ptr )
+{
+    free( ptr );
+}
+
+
+/* The daemon gets this from main.c; match its default of no limit. */
+int32_t get_max_mac_limit( void )
+{
+    return INT_MAX;
+}
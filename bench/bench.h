@@ -0,0 +1,78 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define BENCH_MIN_NS    200000000ULL    /* Run each case for at least 0.2s. */
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+typedef struct bench_result {
+    const char *bench;      /* The name of the benchmark. */
+    size_t events;          /* Schedule events, 0 if not relevant. */
+    size_t macs;            /* Schedule MACs, 0 if not relevant. */
+    size_t bytes;           /* Input size for throughput, 0 if not relevant. */
+    uint64_t iterations;    /* The number of operations timed. */
+    uint64_t elapsed_ns;    /* The total time they took. */
+    uint64_t allocs;        /* The aker_malloc() calls they made. */
+} bench_result_t;
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Returns a monotonic timestamp in nanoseconds.
+ */
+uint64_t bench_now_ns( void );
+
+/**
+ *  Returns the number of aker_malloc() calls made so far.
+ */
+uint64_t bench_allocs( void );
+
+/**
+ *  Calls fn in growing batches until at least BENCH_MIN_NS has passed, then
+ *  fills in iterations, elapsed_ns and allocs and reports the result.
+ *
+ *  @param r   the result to fill in; bench, events, macs and bytes are kept
+ *  @param fn  the operation to time, i counts up from 0 across calls
+ *  @param ctx passed through to fn
+ */
+void bench_run( bench_result_t *r, void (*fn)(void *ctx, uint64_t i), void *ctx );
+
+/**
+ *  Prints one result as a single line JSON object, together with the peak
+ *  resident set size of the process so far.
+ *
+ *  @param r the result to print
+ */
+void bench_report( const bench_result_t *r );
+
+/**
+ *  A place to store results so the compiler can't drop the work.
+ */
+extern volatile uint64_t bench_sink;
+
+#endif
@@ -0,0 +1,300 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "bench.h"
+#include "../src/schedule.h"
+#include "../src/schedule_gen.h"
+#include "../src/decode.h"
+#include "../src/time.h"
+#include "../src/aker_md5.h"
+#include "../src/aker_msgpack.h"
+#include "../src/aker_mem.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define LOOKUP_TIMES    1024
+#define BLOCK_MAX       8
+#define ABSOLUTE_GAP    600     /* Average seconds between absolute events. */
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+typedef struct engine_case {
+    uint8_t *data;
+    size_t len;
+    schedule_t *s;
+    time_t times[LOOKUP_TIMES];
+    char *blocked;
+} engine_case_t;
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static const size_t event_counts[] = { 10, 1000, 100000, 1000000 };
+static const size_t mac_counts[] = { 1, 1000, 100000 };
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static void run_case( size_t events, size_t macs );
+static void run_fixed( void );
+static void bench_decode( void *ctx, uint64_t i );
+static void bench_finalize( void *ctx, uint64_t i );
+static void bench_blocked( void *ctx, uint64_t i );
+static void bench_next( void *ctx, uint64_t i );
+static void bench_weekly( void *ctx, uint64_t i );
+static void bench_md5( void *ctx, uint64_t i );
+static void bench_pack_now( void *ctx, uint64_t i );
+static void bench_pack_status( void *ctx, uint64_t i );
+static void __unfinalize( schedule_t *s );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* Usage: bench_engine [max_events [max_macs]] */
+int main( int argc, char **argv )
+{
+    size_t max_events = 1000000;
+    size_t max_macs = 100000;
+    size_t e, m;
+
+    if( 1 < argc ) {
+        max_events = strtoul( argv[1], NULL, 10 );
+    }
+    if( 2 < argc ) {
+        max_macs = strtoul( argv[2], NULL, 10 );
+    }
+
+    set_unix_time_zone( "PST8PDT" );
+    run_fixed();
+
+    for( e = 0; e < sizeof(event_counts) / sizeof(event_counts[0]); e++ ) {
+        for( m = 0; m < sizeof(mac_counts) / sizeof(mac_counts[0]); m++ ) {
+            if( (event_counts[e] <= max_events) && (mac_counts[m] <= max_macs) ) {
+                run_case( event_counts[e], mac_counts[m] );
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Benchmarks that don't depend on the schedule size.
+ */
+static void run_fixed( void )
+{
+    bench_result_t r = { .bench = "convert_unix_time_to_weekly" };
+
+    bench_run( &r, bench_weekly, NULL );
+
+    r.bench = "pack_status_msg";
+    bench_run( &r, bench_pack_status, NULL );
+}
+
+
+/**
+ *  Generates one synthetic schedule and runs every size dependent benchmark
+ *  against it.  Half the events (at most one every other second) are weekly,
+ *  the rest absolute.
+ */
+static void run_case( size_t events, size_t macs )
+{
+    schedule_gen_cfg_t cfg;
+    engine_case_t c;
+    bench_result_t r = { .events = events, .macs = macs };
+    uint64_t state;
+    size_t i;
+
+    memset( &c, 0, sizeof(c) );
+    schedule_gen_defaults( &cfg );
+    cfg.seed = events * 31 + macs;
+    cfg.weekly = events / 2;
+    if( SECONDS_IN_A_WEEK / 2 < cfg.weekly ) {
+        cfg.weekly = SECONDS_IN_A_WEEK / 2;
+    }
+    cfg.absolute = events - cfg.weekly;
+    cfg.macs = macs;
+    cfg.block_max = (macs < BLOCK_MAX) ? macs : BLOCK_MAX;
+    cfg.absolute_span = (time_t) (cfg.absolute * ABSOLUTE_GAP);
+
+    c.len = schedule_gen( &cfg, &c.data );
+    if( (0 == c.len) || (0 != decode_schedule(c.len, c.data, &c.s)) ) {
+        fprintf( stderr, "bench_engine: failed to build %zu/%zu\n", events, macs );
+        goto done;
+    }
+
+    /* Lookups spread from a week before to a week after the absolute range. */
+    state = cfg.seed;
+    for( i = 0; i < LOOKUP_TIMES; i++ ) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        c.times[i] = cfg.absolute_start - SECONDS_IN_A_WEEK +
+                     (time_t) ((state >> 33) % (uint64_t) (cfg.absolute_span + 2 * SECONDS_IN_A_WEEK));
+    }
+    for( i = 0; (i < LOOKUP_TIMES) && (NULL == c.blocked); i++ ) {
+        c.blocked = get_blocked_at_time( c.s, c.times[i] );
+    }
+
+    r.bytes = c.len;
+    r.bench = "decode_schedule";
+    bench_run( &r, bench_decode, &c );
+    r.bench = "compute_byte_stream_md5";
+    bench_run( &r, bench_md5, &c );
+
+    r.bytes = 0;
+    __unfinalize( c.s );
+    r.bench = "finalize_schedule";
+    bench_run( &r, bench_finalize, &c );
+    finalize_schedule( c.s );
+
+    r.bench = "get_blocked_at_time";
+    bench_run( &r, bench_blocked, &c );
+    r.bench = "get_next_unixtime";
+    bench_run( &r, bench_next, &c );
+
+    if( NULL != c.blocked ) {
+        r.bytes = strlen( c.blocked );
+        r.bench = "pack_now_msg";
+        bench_run( &r, bench_pack_now, &c );
+    }
+
+done:
+    if( NULL != c.blocked ) {
+        aker_free( c.blocked );
+    }
+    destroy_schedule( c.s );
+    if( NULL != c.data ) {
+        aker_free( c.data );
+    }
+}
+
+
+/**
+ *  Removes the event finalize_schedule() added, if it added one.
+ */
+static void __unfinalize( schedule_t *s )
+{
+    schedule_event_t *e = s->weekly;
+
+    if( (NULL != e) && (e->time < 0) ) {
+        s->weekly = e->next;
+        aker_free( e );
+    }
+}
+
+
+static void bench_decode( void *ctx, uint64_t i )
+{
+    engine_case_t *c = (engine_case_t*) ctx;
+    schedule_t *s = NULL;
+
+    (void) i;
+    if( 0 == decode_schedule(c->len, c->data, &s) ) {
+        destroy_schedule( s );
+    }
+}
+
+
+static void bench_finalize( void *ctx, uint64_t i )
+{
+    engine_case_t *c = (engine_case_t*) ctx;
+
+    (void) i;
+    finalize_schedule( c->s );
+    __unfinalize( c->s );
+}
+
+
+static void bench_blocked( void *ctx, uint64_t i )
+{
+    engine_case_t *c = (engine_case_t*) ctx;
+    char *macs;
+
+    macs = get_blocked_at_time( c->s, c->times[i % LOOKUP_TIMES] );
+    if( NULL != macs ) {
+        bench_sink += (uint8_t) macs[0];
+        aker_free( macs );
+    }
+}
+
+
+static void bench_next( void *ctx, uint64_t i )
+{
+    engine_case_t *c = (engine_case_t*) ctx;
+
+    bench_sink += (uint64_t) get_next_unixtime( c->s, c->times[i % LOOKUP_TIMES] );
+}
+
+
+static void bench_weekly( void *ctx, uint64_t i )
+{
+    (void) ctx;
+    bench_sink += (uint64_t) convert_unix_time_to_weekly( 1510689448 + (time_t) i * 61 );
+}
+
+
+static void bench_md5( void *ctx, uint64_t i )
+{
+    engine_case_t *c = (engine_case_t*) ctx;
+    unsigned char sig[MD5_SIZE];
+    unsigned char *md5;
+
+    (void) i;
+    md5 = compute_byte_stream_md5( c->data, c->len, sig );
+    if( NULL != md5 ) {
+        bench_sink += md5[0];
+        aker_free( md5 );
+    }
+}
+
+
+static void bench_pack_now( void *ctx, uint64_t i )
+{
+    engine_case_t *c = (engine_case_t*) ctx;
+    void *buf = NULL;
+    size_t len;
+
+    len = pack_now_msg( c->blocked, 1510689448 + (time_t) i, &buf );
+    bench_sink += len;
+    if( NULL != buf ) {
+        aker_free( buf );
+    }
+}
+
+
+static void bench_pack_status( void *ctx, uint64_t i )
+{
+    void *buf = NULL;
+    size_t len;
+
+    (void) ctx; (void) i;
+    len = pack_status_msg( "Request was successful", &buf );
+    bench_sink += len;
+    if( NULL != buf ) {
+        aker_free( buf );
+    }
+}
@@ -0,0 +1,114 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "bench.h"
+#include "../src/aker_integrity.h"
+#include "../src/aker_mem.h"
+#include "../src/crc32c.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define MAX_SIZE    (10 * 1024 * 1024)
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+typedef struct payload {
+    const uint8_t *data;
+    size_t len;
+} payload_t;
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static const size_t sizes[] = { 1024, 4096, 16384, 65536, 262144,
+                                1048576, 4194304, MAX_SIZE };
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static void bench_sig( void *ctx, uint64_t i );
+static void bench_kernel( void *ctx, uint64_t i );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main( void )
+{
+    uint8_t *data;
+    size_t i;
+
+    data = (uint8_t*) aker_malloc( MAX_SIZE );
+    if( NULL == data ) {
+        return 1;
+    }
+    for( i = 0; i < MAX_SIZE; i++ ) {
+        data[i] = (uint8_t) (i * 2654435761u >> 24);
+    }
+
+    for( i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++ ) {
+        payload_t p = { data, sizes[i] };
+        bench_result_t r = { .bytes = sizes[i] };
+
+        /* The full signature path used on every update: checksum plus
+         * formatting into the signature file contents. */
+        integrity_set_mode( "md5" );
+        r.bench = "integrity_md5";
+        bench_run( &r, bench_sig, &p );
+
+        integrity_set_mode( "crc32c" );
+        r.bench = "integrity_crc32c";
+        bench_run( &r, bench_sig, &p );
+
+        /* The bare kernel, so the formatting overhead is visible. */
+        r.bench = "crc32c_kernel";
+        bench_run( &r, bench_kernel, &p );
+    }
+
+    aker_free( data );
+
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+static void bench_sig( void *ctx, uint64_t i )
+{
+    payload_t *p = (payload_t*) ctx;
+    char *sig;
+
+    (void) i;
+    sig = integrity_compute_sig( p->data, p->len );
+    if( NULL != sig ) {
+        bench_sink += (uint8_t) sig[0];
+        aker_free( sig );
+    }
+}
+
+
+static void bench_kernel( void *ctx, uint64_t i )
+{
+    payload_t *p = (payload_t*) ctx;
+
+    (void) i;
+    bench_sink += crc32c( p->data, p->len );
+}
@@ -0,0 +1,299 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "aker_clock.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define NS_PER_SEC      1000000000LL
+#define POLL_NS         10000000LL      /* 10ms */
+#define SLEEP_TIME      5
+#define MAX_WAITING     16      /* Cond/mutex pairs waited on at once. */
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+typedef struct {
+    pthread_cond_t *cond;
+    pthread_mutex_t *mutex;
+    unsigned waits;             /* Threads in aker_clock_wait_until() on it. */
+} waiting_t;
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static pthread_mutex_t clock_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Changed under clock_lock, but read without it by aker_clock_now() so the
+ * real clock (the daemon's) never takes the lock. */
+static bool virtual_clock = false;
+static int64_t virtual_base = 0;    /* Virtual ns at real_base. */
+static int64_t real_base = 0;       /* Real ns when the virtual clock was set. */
+static double virtual_rate = 0.0;
+static waiting_t waiting[MAX_WAITING];
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static int64_t __real_ns( void );
+static int64_t __virtual_ns( int64_t real );
+static int64_t __now_ns( void );
+static int __waiting_add( pthread_cond_t *cond, pthread_mutex_t *mutex );
+static void __wake_waiting( void );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See aker_clock.h for details. */
+int aker_clock_set_virtual( time_t start, double rate )
+{
+    if( rate < 0.0 ) {
+        return -1;
+    }
+
+    pthread_mutex_lock( &clock_lock );
+    real_base = __real_ns();
+    virtual_base = (int64_t) start * NS_PER_SEC;
+    virtual_rate = rate;
+    __atomic_store_n( &virtual_clock, true, __ATOMIC_RELEASE );
+    pthread_mutex_unlock( &clock_lock );
+
+    __wake_waiting();
+
+    return 0;
+}
+
+
+/* See aker_clock.h for details. */
+void aker_clock_set_real( void )
+{
+    pthread_mutex_lock( &clock_lock );
+    __atomic_store_n( &virtual_clock, false, __ATOMIC_RELEASE );
+    pthread_mutex_unlock( &clock_lock );
+
+    __wake_waiting();
+}
+
+
+/* See aker_clock.h for details. */
+bool aker_clock_is_virtual( void )
+{
+    return __atomic_load_n( &virtual_clock, __ATOMIC_ACQUIRE );
+}
+
+
+/* See aker_clock.h for details. */
+int aker_clock_advance( time_t seconds )
+{
+    int rv = -1;
+
+    pthread_mutex_lock( &clock_lock );
+    if( virtual_clock && (0 <= seconds) ) {
+        int64_t real = __real_ns();
+
+        /* Rebase so an accelerated clock keeps running from here. */
+        virtual_base = __virtual_ns( real ) + (int64_t) seconds * NS_PER_SEC;
+        real_base = real;
+        rv = 0;
+    }
+    pthread_mutex_unlock( &clock_lock );
+
+    if( 0 == rv ) {
+        __wake_waiting();
+    }
+
+    return rv;
+}
+
+
+/* See aker_clock.h for details. */
+time_t aker_clock_now( void )
+{
+    int64_t now;
+
+    if( false == __atomic_load_n(&virtual_clock, __ATOMIC_ACQUIRE) ) {
+        return (time_t) (__real_ns() / NS_PER_SEC);
+    }
+
+    /* The base and rate move together, so the virtual clock is read locked. */
+    pthread_mutex_lock( &clock_lock );
+    now = __real_ns();
+    if( virtual_clock ) {
+        now = __virtual_ns( now );
+    }
+    pthread_mutex_unlock( &clock_lock );
+
+    return (time_t) (now / NS_PER_SEC);
+}
+
+
+/* See aker_clock.h for details. */
+int aker_clock_wait_until( pthread_cond_t *cond, pthread_mutex_t *mutex,
+                           time_t until )
+{
+    struct timespec ts;
+    int64_t real, wait = -1;
+    bool reached;
+    int slot, rv;
+
+    pthread_mutex_lock( &clock_lock );
+    if( false == virtual_clock ) {
+        pthread_mutex_unlock( &clock_lock );
+        ts.tv_sec = until;
+        ts.tv_nsec = 0;
+        return pthread_cond_timedwait( cond, mutex, &ts );
+    }
+
+    real = __real_ns();
+    if( (int64_t) until * NS_PER_SEC <= __virtual_ns(real) ) {
+        pthread_mutex_unlock( &clock_lock );
+        return ETIMEDOUT;
+    }
+    if( 0 < virtual_rate ) {
+        wait = (int64_t) ((double) ((int64_t) until * NS_PER_SEC - __virtual_ns(real)) /
+                          virtual_rate) + 1;
+    }
+
+    /* Moving the clock wakes the waits it knows of; any other is polled. */
+    slot = __waiting_add( cond, mutex );
+    if( (slot < 0) && ((wait < 0) || (POLL_NS < wait)) ) {
+        wait = POLL_NS;
+    }
+    pthread_mutex_unlock( &clock_lock );
+
+    /* Never wait again after a timeout here: a signal that raced it would be
+     * lost, so the caller gets to look at what it waits for instead. */
+    if( wait < 0 ) {
+        rv = pthread_cond_wait( cond, mutex );
+    } else {
+        real += wait;
+        ts.tv_sec = (time_t) (real / NS_PER_SEC);
+        ts.tv_nsec = (long) (real % NS_PER_SEC);
+        rv = pthread_cond_timedwait( cond, mutex, &ts );
+    }
+
+    pthread_mutex_lock( &clock_lock );
+    if( 0 <= slot ) {
+        waiting[slot].waits--;
+    }
+    reached = ((int64_t) until * NS_PER_SEC <= __now_ns());
+    pthread_mutex_unlock( &clock_lock );
+
+    if( reached ) {
+        return ETIMEDOUT;
+    }
+
+    return (ETIMEDOUT == rv) ? 0 : rv;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+static int64_t __real_ns( void )
+{
+    struct timespec tm;
+
+    while( 0 != clock_gettime(CLOCK_REALTIME, &tm) ) {
+        sleep( SLEEP_TIME );
+    }
+
+    return (int64_t) tm.tv_sec * NS_PER_SEC + tm.tv_nsec;
+}
+
+
+/**
+ *  The virtual time in ns at a real time.  Needs clock_lock.
+ */
+static int64_t __virtual_ns( int64_t real )
+{
+    return virtual_base + (int64_t) ((double) (real - real_base) * virtual_rate);
+}
+
+
+/**
+ *  The time in ns of the clock in use.  Needs clock_lock.
+ */
+static int64_t __now_ns( void )
+{
+    int64_t now = __real_ns();
+
+    return virtual_clock ? __virtual_ns( now ) : now;
+}
+
+
+/**
+ *  Counts a wait on a cond/mutex pair so moving the clock wakes it.  Needs
+ *  clock_lock.
+ *
+ *  @return the pair's slot, -1 if there is no room
+ */
+static int __waiting_add( pthread_cond_t *cond, pthread_mutex_t *mutex )
+{
+    int i, empty = -1;
+
+    for( i = 0; i < MAX_WAITING; i++ ) {
+        if( (0 < waiting[i].waits) && (cond == waiting[i].cond) &&
+            (mutex == waiting[i].mutex) )
+        {
+            waiting[i].waits++;
+            return i;
+        }
+        if( (0 == waiting[i].waits) && (empty < 0) ) {
+            empty = i;
+        }
+    }
+
+    if( 0 <= empty ) {
+        waiting[empty].cond = cond;
+        waiting[empty].mutex = mutex;
+        waiting[empty].waits = 1;
+    }
+
+    return empty;
+}
+
+
+/**
+ *  Wakes every wait in progress after the clock was moved.  Taking each
+ *  mutex first means a thread that read the old time is inside its wait by
+ *  the time it is signalled.  Must not be called with clock_lock or any of
+ *  the mutexes held.
+ */
+static void __wake_waiting( void )
+{
+    waiting_t pairs[MAX_WAITING];
+    int i, count = 0;
+
+    pthread_mutex_lock( &clock_lock );
+    for( i = 0; i < MAX_WAITING; i++ ) {
+        if( 0 < waiting[i].waits ) {
+            pairs[count++] = waiting[i];
+        }
+    }
+    pthread_mutex_unlock( &clock_lock );
+
+    for( i = 0; i < count; i++ ) {
+        pthread_mutex_lock( pairs[i].mutex );
+        pthread_cond_broadcast( pairs[i].cond );
+        pthread_mutex_unlock( pairs[i].mutex );
+    }
+}
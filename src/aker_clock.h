@@ -0,0 +1,91 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __AKER_CLOCK_H__
+#define __AKER_CLOCK_H__
+
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Switches to a virtual clock.  It starts at start and runs at rate virtual
+ *  seconds per real second; with a rate of 0 it only moves when
+ *  aker_clock_advance() is called.
+ *
+ *  Everything that reads the time through get_unix_time() or waits with
+ *  aker_clock_wait_until() follows the virtual clock, so a week of schedule
+ *  transitions can be replayed in seconds.
+ *
+ *  @param start the virtual unix time to start at
+ *  @param rate  virtual seconds per real second, 0 for manual advance only
+ *
+ *  @return 0 on success, error otherwise
+ */
+int aker_clock_set_virtual( time_t start, double rate );
+
+/**
+ *  Switches back to the real (CLOCK_REALTIME) clock.  This is the default.
+ */
+void aker_clock_set_real( void );
+
+/**
+ *  Returns true if the virtual clock is in use.
+ */
+bool aker_clock_is_virtual( void );
+
+/**
+ *  Moves the virtual clock forward and wakes up any aker_clock_wait_until()
+ *  whose deadline has been reached.
+ *
+ *  @param seconds how far to move the clock forward
+ *
+ *  @return 0 on success, error if the real clock is in use
+ */
+int aker_clock_advance( time_t seconds );
+
+/**
+ *  Returns the current unix time of the clock in use.
+ *
+ *  @note With the real clock this blocks until the system call succeeds.
+ */
+time_t aker_clock_now( void );
+
+/**
+ *  pthread_cond_timedwait() against the clock in use.  The mutex must be
+ *  locked by the caller, as for pthread_cond_timedwait().
+ *
+ *  @note With the virtual clock, aker_clock_set_virtual(), aker_clock_set_real()
+ *        and aker_clock_advance() wake the waits in progress, so they must
+ *        not be called with the mutex held, and the cond and mutex have to
+ *        outlive the wait.  A wait may end early with 0, as a cond wait may;
+ *        the caller looks at what it waits for and waits again.
+ *
+ *  @param cond  the condition to wait on
+ *  @param mutex the locked mutex protecting the condition
+ *  @param until the unix time to wait until
+ *
+ *  @return 0 if signalled or woken early, ETIMEDOUT if the time was reached,
+ *          error otherwise
+ */
+int aker_clock_wait_until( pthread_cond_t *cond, pthread_mutex_t *mutex,
+                           time_t until );
+
+#endif
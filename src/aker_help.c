@@ -40,8 +40,15 @@ void aker_help(char *name, char *opt)
                 
 void print_general_help(char *command)
 {
-    debug_info("Usage:%s %s %s %s %s %s %s %s\n", command,
+    debug_info("Usage:%s %s %s %s %s %s %s %s %s %s %s %s %s %s %s %s %s\n", command,
             "-p <parodus_url>", "-c <client_url>", "-w <firewall_cmd>",
             "-d <data_file>", "-f <md5_sig_file>", "[-m <maximum_allowed_macs>]",
+            "[-b (write-behind persistence)]", "[-i <md5|crc32c>]",
+            "[-s <firewall_state_file>]",
+            "[-e <transition_event_dest>]", "[-n <min_seconds_between_events>]",
+            "[-r <journal_compact_ratio_percent>]",
+            "[-k <memory|store> (compact uploaded schedules)]",
+            "[-T <tenants_file> (lines of <tenant_id> [<firewall_target>])]",
+            "[-j <tenant_worker_threads>]",
             "[-h }, [--h=[<topic>]]");
 }
\ No newline at end of file
@@ -0,0 +1,228 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "aker_integrity.h"
+#include "aker_log.h"
+#include "aker_md5.h"
+#include "aker_mem.h"
+#include "crc32c.h"
+#include "process_data.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define CRC32C_HEX_SIZE 8
+#define SIG_MAX_SIZE    128     /* Far more than any format we write. */
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static int integrity_mode = INTEGRITY_MD5;
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static int __verify_versioned( const uint8_t *data, size_t len, const char *sig );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See aker_integrity.h for details. */
+int integrity_set_mode( const char *name )
+{
+    if( NULL == name ) {
+        return -1;
+    }
+
+    if( 0 == strcmp(name, "md5") ) {
+        integrity_mode = INTEGRITY_MD5;
+    } else if( 0 == strcmp(name, "crc32c") ) {
+        integrity_mode = INTEGRITY_CRC32C;
+    } else {
+        debug_error( "integrity_set_mode() unknown mode '%s'\n", name );
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/* See aker_integrity.h for details. */
+int integrity_get_mode( void )
+{
+    return integrity_mode;
+}
+
+
+/* See aker_integrity.h for details. */
+char* integrity_compute_sig( const uint8_t *data, size_t len )
+{
+    unsigned char md5_sig[MD5_SIZE];
+    char *sig;
+
+    if( INTEGRITY_MD5 == integrity_mode ) {
+        return (char*) compute_byte_stream_md5( (uint8_t*) data, len, md5_sig );
+    }
+
+    sig = (char*) aker_malloc( SIG_MAX_SIZE );
+    if( NULL == sig ) {
+        debug_error( "integrity_compute_sig()->aker_malloc() failed\n" );
+        return NULL;
+    }
+    snprintf( sig, SIG_MAX_SIZE, "%s%d crc32c %08x %zu\n",
+              INTEGRITY_SIG_PREFIX, INTEGRITY_SIG_VERSION,
+              crc32c(data, len), len );
+    debug_info( "CRC32C sig: %s", sig );
+
+    return sig;
+}
+
+
+/* See aker_integrity.h for details. */
+int integrity_verify( const uint8_t *data, size_t len,
+                      const uint8_t *sig, size_t sig_len )
+{
+    char buf[SIG_MAX_SIZE];
+    unsigned char md5_sig[MD5_SIZE];
+    unsigned char *md5_string;
+    int rv;
+
+    if( (NULL == sig) || (0 == sig_len) ) {
+        return -4;
+    }
+
+    if( (sizeof(INTEGRITY_SIG_PREFIX) - 1 <= sig_len) &&
+        (0 == memcmp(sig, INTEGRITY_SIG_PREFIX, sizeof(INTEGRITY_SIG_PREFIX) - 1)) )
+    {
+        if( sizeof(buf) <= sig_len ) {
+            return -4;
+        }
+        memcpy( buf, sig, sig_len );
+        buf[sig_len] = '\0';
+        return __verify_versioned( data, len, buf );
+    }
+
+    /* Anything else is the legacy bare md5 string. */
+    if( sig_len < MD5_SIZE * 2 ) {
+        return -4;
+    }
+
+    md5_string = compute_byte_stream_md5( (uint8_t*) data, len, md5_sig );
+    if( NULL == md5_string ) {
+        return -2;
+    }
+    rv = (0 == memcmp(sig, md5_string, MD5_SIZE * 2)) ? 0 : -2;
+    aker_free( md5_string );
+
+    return rv;
+}
+
+
+/* See aker_integrity.h for details. */
+int verify_integrity_signatures( const char *data_file, const char *sig_file )
+{
+    uint8_t *data = NULL;
+    uint8_t *sig = NULL;
+    size_t len, sig_len;
+    int rv;
+
+    len = read_file_from_disk( data_file, &data );
+    if( 0 == len ) {
+        debug_error( "verify_integrity_signatures() failed to read %s\n", data_file );
+        if( NULL != data ) {
+            aker_free( data );
+        }
+        return -1;
+    }
+
+    sig_len = read_file_from_disk( sig_file, &sig );
+    if( 0 < sig_len ) {
+        rv = integrity_verify( data, len, sig, sig_len );
+        if( 0 == rv ) {
+            debug_info( "verify_integrity_signatures() data and signature verified\n" );
+        } else {
+            debug_error( "verify_integrity_signatures() failed: %d\n", rv );
+        }
+    } else {
+        debug_error( "verify_integrity_signatures() failed to read %s\n", sig_file );
+        rv = -3;
+    }
+
+    if( NULL != sig ) {
+        aker_free( sig );
+    }
+    aker_free( data );
+
+    return rv;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Checks a payload against a null terminated versioned signature.
+ *
+ *  @return 0 if the payload matches, -2 on mismatch, -4 on unknown format
+ */
+static int __verify_versioned( const uint8_t *data, size_t len, const char *sig )
+{
+    unsigned version;
+    char algorithm[16];
+    char digest[MD5_SIZE * 2 + 1];
+    unsigned long long sig_len;
+    int rv = -4;
+
+    if( (4 != sscanf(sig, INTEGRITY_SIG_PREFIX "%u %15s %32s %llu",
+                     &version, algorithm, digest, &sig_len)) ||
+        (INTEGRITY_SIG_VERSION != version) )
+    {
+        debug_error( "integrity: unsupported signature '%s'\n", sig );
+        return rv;
+    }
+
+    /* A length mismatch is the cheap way to catch a truncated file. */
+    if( (unsigned long long) len != sig_len ) {
+        return -2;
+    }
+
+    if( 0 == strcmp(algorithm, "crc32c") ) {
+        char expected[CRC32C_HEX_SIZE + 1];
+
+        snprintf( expected, sizeof(expected), "%08x", crc32c(data, len) );
+        rv = (0 == strcmp(expected, digest)) ? 0 : -2;
+    } else if( 0 == strcmp(algorithm, "md5") ) {
+        unsigned char md5_sig[MD5_SIZE];
+        unsigned char *md5_string;
+
+        md5_string = compute_byte_stream_md5( (uint8_t*) data, len, md5_sig );
+        rv = -2;
+        if( NULL != md5_string ) {
+            if( 0 == strcmp((char*) md5_string, digest) ) {
+                rv = 0;
+            }
+            aker_free( md5_string );
+        }
+    }
+
+    return rv;
+}
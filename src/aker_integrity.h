@@ -0,0 +1,91 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __AKER_INTEGRITY_H__
+#define __AKER_INTEGRITY_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define INTEGRITY_MD5       0   /* Bare 32 character md5, the legacy format */
+#define INTEGRITY_CRC32C    1   /* Versioned sidecar with a CRC-32C */
+
+/* Versioned sidecar: "aker-sig/1 <algorithm> <hex digest> <payload length>\n" */
+#define INTEGRITY_SIG_PREFIX    "aker-sig/"
+#define INTEGRITY_SIG_VERSION   1
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Selects the algorithm used for newly written signature files.  Verifying
+ *  always follows whatever format the signature file is in, so switching
+ *  modes never invalidates a stored schedule.
+ *
+ *  @note Call this before any thread that writes schedules is started.
+ *
+ *  @param name "md5" or "crc32c"
+ *
+ *  @return 0 on success, -1 if the name is not known
+ */
+int integrity_set_mode( const char *name );
+
+/**
+ *  Returns the current mode (INTEGRITY_MD5 or INTEGRITY_CRC32C).
+ */
+int integrity_get_mode( void );
+
+/**
+ *  Computes the signature file contents for a payload in the current mode.
+ *
+ *  @note The returned string needs to be aker_free()-ed by the caller.
+ *
+ *  @param data the payload
+ *  @param len  the length of the payload in bytes
+ *
+ *  @return the null terminated signature, NULL on failure
+ */
+char* integrity_compute_sig( const uint8_t *data, size_t len );
+
+/**
+ *  Checks a payload against signature file contents in any supported format.
+ *
+ *  @param data    the payload
+ *  @param len     the length of the payload in bytes
+ *  @param sig     the signature file contents (need not be null terminated)
+ *  @param sig_len the length of the signature file contents
+ *
+ *  @return 0 if the payload matches, -2 on mismatch, -4 on unknown format
+ */
+int integrity_verify( const uint8_t *data, size_t len,
+                      const uint8_t *sig, size_t sig_len );
+
+/**
+ *  Checks a data file against its signature file.
+ *
+ *  @param data_file the schedule data file
+ *  @param sig_file  the signature file
+ *
+ *  @return 0 if the files match, -1 if the data can't be read, -2 on
+ *          mismatch, -3 if the signature can't be read, -4 on unknown format
+ */
+int verify_integrity_signatures( const char *data_file, const char *sig_file );
+
+#endif
@@ -29,6 +29,7 @@
 #include "process_data.h"
 #include "aker_mem.h"
 
+static const char hex_digits[] = "0123456789abcdef";
 
 unsigned char *compute_file_md5(const char *filename, unsigned char *md5_sig)
 {
@@ -64,7 +65,8 @@ unsigned char * compute_byte_stream_md5(uint8_t *data, size_t size, unsigned cha
     }
 
     for (cnt = 0; cnt < MD5_SIZE; cnt++) {
-        sprintf((char *) &md5_string[cnt * 2], "%02x", md5_sig[cnt]);
+        md5_string[cnt * 2]     = hex_digits[md5_sig[cnt] >> 4];
+        md5_string[cnt * 2 + 1] = hex_digits[md5_sig[cnt] & 0x0f];
     }
     md5_string[MD5_SIZE * 2] = 0;
     debug_info("MD5 sig: %s\n", md5_string);    
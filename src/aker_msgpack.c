@@ -15,6 +15,7 @@
  *
  */
 #include <stddef.h>
+#include <limits.h>
 #include <time.h>
 #include <msgpack.h>
 
@@ -109,6 +110,95 @@ size_t pack_now_msg( const char *active, time_t time, void **binary )
     return len;
 }
 
+/* See aker_msgpack.h for details. */
+size_t pack_device_msg( const char *mac, bool blocked, time_t next_change,
+                        time_t time, void **binary )
+{
+    const char cstr_mac[] = "mac";
+    const char cstr_blocked[] = "blocked";
+    const char cstr_next_change[] = "next_change";
+    const char cstr_time[] = "time";
+    size_t len;
+    msgpack_sbuffer sbuf;
+    msgpack_packer pk;
+
+    msgpack_sbuffer_init(&sbuf);
+    msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+    msgpack_pack_map(&pk, (INT_MAX == next_change) ? 3 : 4);
+
+    pack_msgpack_string(&pk, cstr_mac, strlen(cstr_mac));
+    pack_msgpack_string(&pk, mac, strlen(mac));
+
+    pack_msgpack_string(&pk, cstr_blocked, strlen(cstr_blocked));
+    if( blocked ) {
+        msgpack_pack_true(&pk);
+    } else {
+        msgpack_pack_false(&pk);
+    }
+
+    if( INT_MAX != next_change ) {
+        pack_msgpack_string(&pk, cstr_next_change, strlen(cstr_next_change));
+        msgpack_pack_int32(&pk, next_change);
+    }
+
+    pack_msgpack_string(&pk, cstr_time, strlen(cstr_time));
+    msgpack_pack_int32(&pk, time);
+
+    len = 0;
+    if( sbuf.data ) {
+        *binary = aker_malloc(sizeof(char) * sbuf.size);
+        if( NULL != *binary ) {
+            memcpy(*binary, sbuf.data, sbuf.size);
+            len = sbuf.size;
+        }
+    }
+    msgpack_sbuffer_destroy(&sbuf);
+
+    return len;
+}
+
+/* See aker_msgpack.h for details. */
+size_t pack_event_msg( const char *active, uint64_t seq, time_t time,
+                       void **binary )
+{
+    const char cstr_active[] = "active";
+    const char cstr_seq[] = "seq";
+    const char cstr_time[] = "time";
+    size_t len;
+    size_t active_len = 0;
+    msgpack_sbuffer sbuf;
+    msgpack_packer pk;
+
+    if( active ) {
+        active_len = strlen(active);
+    }
+
+    msgpack_sbuffer_init(&sbuf);
+    msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+    msgpack_pack_map(&pk, 3);
+
+    pack_msgpack_string(&pk, cstr_active, strlen(cstr_active));
+    pack_msgpack_string(&pk, active, active_len);
+
+    pack_msgpack_string(&pk, cstr_seq, strlen(cstr_seq));
+    msgpack_pack_uint64(&pk, seq);
+
+    pack_msgpack_string(&pk, cstr_time, strlen(cstr_time));
+    msgpack_pack_int32(&pk, time);
+
+    len = 0;
+    if( sbuf.data ) {
+        *binary = aker_malloc(sizeof(char) * sbuf.size);
+        if( NULL != *binary ) {
+            memcpy(*binary, sbuf.data, sbuf.size);
+            len = sbuf.size;
+        }
+    }
+    msgpack_sbuffer_destroy(&sbuf);
+
+    return len;
+}
+
 /*----------------------------------------------------------------------------*/
 /*                             Internal functions                             */
 /*----------------------------------------------------------------------------*/
@@ -17,7 +17,10 @@
 #ifndef __AKER_MSGPACK_H__
 #define __AKER_MSGPACK_H__
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <time.h>
 
 /**
  *  Packs string into msgpack 
@@ -37,4 +40,31 @@ size_t pack_status_msg(const char *string, void **binary);
  *  @returns the length of the allocated byte array
  */
 size_t pack_now_msg( const char *active, time_t time, void **binary );
+
+/**
+ *  Packs one device's blocked state into msgpack payload.
+ *
+ *  @param mac         [in]  the device's MAC address
+ *  @param blocked     [in]  whether the device is blocked
+ *  @param next_change [in]  when that next changes, INT_MAX (left out) if never
+ *  @param time        [in]  the time value
+ *  @param binary      [out] the pointer to assign the allocated byte array
+ *
+ *  @returns the length of the allocated byte array
+ */
+size_t pack_device_msg( const char *mac, bool blocked, time_t next_change,
+                        time_t time, void **binary );
+
+/**
+ *  Packs a blocked set transition event into msgpack payload.
+ *
+ *  @param active [in]  the list of blocked devices after the transition
+ *  @param seq    [in]  the transition's sequence number
+ *  @param time   [in]  the time the transition took effect
+ *  @param binary [out] the pointer to assign the allocated byte array
+ *
+ *  @returns the length of the allocated byte array
+ */
+size_t pack_event_msg( const char *active, uint64_t seq, time_t time,
+                       void **binary );
 #endif
@@ -17,8 +17,12 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <getopt.h>
 
+#include "cli_batch.h"
+#include "cli_diff.h"
+#include "cli_stats.h"
 #include "schedule.h"
 #include "process_data.h"
 #include "decode.h"
@@ -56,15 +60,29 @@ size_t get_max_mac_limit(void)
 /* Main function */
 int main( int argc, char **argv)
 {
-    const char *option_string = "f:s:e:h::";
+    const char *option_string = "f:s:e:b:j:r:d:SH:m:h::";
     static const struct option options[] = {
         { "help",  optional_argument, 0, 'h' },
         { "file",  required_argument, 0, 'f' },
         { "start", required_argument, 0, 's' },
         { "end",   required_argument, 0, 'e' },
+        { "batch", required_argument, 0, 'b' },
+        { "jobs",  required_argument, 0, 'j' },
+        { "report", required_argument, 0, 'r' },
+        { "diff",  required_argument, 0, 'd' },
+        { "stats", no_argument,       0, 'S' },
+        { "heatmap", required_argument, 0, 'H' },
+        { "mac",   required_argument, 0, 'm' },
         { 0, 0, 0, 0 }
     };
     const char *filename = NULL;
+    const char *batch = NULL;
+    const char *diff = NULL;
+    const char *heatmap = NULL;
+    const char *mac = NULL;
+    bool stats = false;
+    size_t jobs = 0;
+    bool json = false;
     int start = 0;
     int end = 0;
     int i = 0;
@@ -85,21 +103,85 @@ int main( int argc, char **argv)
             case 'e':
                 end = atoi(optarg);
                 break;
+            case 'd':
+                diff = optarg;
+                break;
+            case 'S':
+                stats = true;
+                break;
+            case 'H':
+                heatmap = optarg;
+                break;
+            case 'm':
+                mac = optarg;
+                break;
+            case 'b':
+                batch = optarg;
+                break;
+            case 'j':
+                jobs = (size_t) strtoul( optarg, NULL, 10 );
+                break;
+            case 'r':
+                if( 0 == strcmp(optarg, "json") ) {
+                    json = true;
+                } else if( 0 != strcmp(optarg, "csv") ) {
+                    fprintf( stderr, "Unknown report format: %s\n", optarg );
+                    return -1;
+                }
+                break;
 
             default:
-                fprintf( stderr, "Usage:\naker-cli -f filename [-s starting_unixtime] [-e ending_unixtime]\n\n" );
+                fprintf( stderr, "Usage:\naker-cli -f filename [-s starting_unixtime] [-e ending_unixtime]\n" );
+                fprintf( stderr, "aker-cli -f filename -S [-H heatmap.csv [-m mac]] [-s starting_unixtime] [-e ending_unixtime]\n" );
+                fprintf( stderr, "aker-cli -d old_filename new_filename [-s starting_unixtime] [-e ending_unixtime]\n" );
+                fprintf( stderr, "aker-cli -b dir|manifest [-j jobs] [-r csv|json] [-s starting_unixtime] [-e ending_unixtime]\n\n" );
                 fprintf( stderr, "    Outputs the schedule according to aker and how it interprets a schedule\n" );
                 fprintf( stderr, "    over a window of time.\n\n" );
+                fprintf( stderr, "    With -S the blocked seconds, block/unblock edges and longest block of\n" );
+                fprintf( stderr, "    each device are printed as csv.  -H also writes a minute resolution\n" );
+                fprintf( stderr, "    weekly heatmap of blocked devices, or of just one device with -m.\n\n" );
+                fprintf( stderr, "    With -d only the intervals where the blocked devices of the two\n" );
+                fprintf( stderr, "    schedules differ are printed, with the devices added and removed.\n\n" );
+                fprintf( stderr, "    With -b every schedule in the directory (or listed one per line in the\n" );
+                fprintf( stderr, "    manifest) is validated in parallel using jobs threads (default: one per\n" );
+                fprintf( stderr, "    core) and a one line summary per file is printed as csv or json.\n\n" );
                 fprintf( stderr, "    If ending_unixtime is 0, process the entire current week.\n" );
                 return -1;
         }
     }
 
+    if( NULL != diff ) {
+        if( optind >= argc ) {
+            fprintf( stderr, "New schedule filename is missing.\n" );
+            return -2;
+        }
+
+        return cli_diff( diff, argv[optind], start, end );
+    }
+
+    if( NULL != batch ) {
+        /* Default to just this week. */
+        if( 0 == end ) {
+            time_t now;
+
+            set_unix_time_zone( "UTC" );
+            now = get_unix_time();
+            start = now - convert_unix_time_to_weekly(now);
+            end = start + 7 * 24 * 3600;
+        }
+
+        return cli_batch( batch, jobs, json, start, end );
+    }
+
     if( NULL == filename ) {
         fprintf( stderr, "Filename is missing.\n" );
         return -2;
     }
 
+    if( stats ) {
+        return cli_stats( filename, start, end, heatmap, mac );
+    }
+
     return process( filename, start, end );
 }
 
@@ -154,7 +236,9 @@ static int process( const char *filename, int start, int end )
             printf( "Weekly (S) | Unixtime     | Date                | Blocked Devices\n" );
             printf( "-----------+--------------+---------------------+-------------------------\n" );
 
-            for( i = start; i < end; i++, offset++ ) {
+            /* Only the transitions can change the output, so jump between
+             * them instead of looking at every second. */
+            for( i = start; i < end; i = get_next_transition(s, i) ) {
                 char *macs;
 
                 macs = get_blocked_at_time( s, i );
@@ -168,7 +252,7 @@ static int process( const char *filename, int start, int end )
                     ts = *localtime(&i);
 
                     printf( " %9.d | %-12.ld | %d-%02d-%02d %02d:%02d:%02d | %s\n",
-                            offset, i,
+                            (int) (offset + (i - start)), i,
                             (ts.tm_year+1900), (ts.tm_mon+1), ts.tm_mday,
                             ts.tm_hour, ts.tm_min, ts.tm_sec, (NULL != macs) ? macs : "" );
 
@@ -0,0 +1,501 @@
+/**
+ * Copyright 2018 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "cli_batch.h"
+#include "schedule.h"
+#include "process_data.h"
+#include "decode.h"
+#include "aker_mem.h"
+#include "schedule_image.h"
+#include "time.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define READ_FAILED     -100
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+typedef struct batch_file {
+    char *path;
+    int status;                 /* decode_schedule_data() result */
+    size_t bytes;
+    size_t weekly;
+    size_t absolute;
+    size_t macs;
+    size_t memory;              /* Bytes allocated for the decoded schedule. */
+    char *time_zone;
+    uint64_t decode_ns;
+    uint64_t eval_ns;
+    size_t transitions;
+    schedule_t *s;              /* Kept from decoding until evaluated. */
+} batch_file_t;
+
+typedef struct batch_pool {
+    pthread_mutex_t lock;
+    batch_file_t **files;
+    size_t count;
+    size_t next;
+    time_t start;
+    time_t end;
+    void (*fn)( struct batch_pool *pool, batch_file_t *f );
+} batch_pool_t;
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static size_t __collect( const char *path, batch_file_t **files );
+static int __add_file( batch_file_t **files, size_t *count, size_t *size,
+                       const char *dir, const char *name );
+static void __run_pool( batch_pool_t *pool, size_t jobs );
+static void *__worker( void *arg );
+static void __decode( batch_pool_t *pool, batch_file_t *f );
+static void __evaluate( batch_pool_t *pool, batch_file_t *f );
+static size_t __count_events( schedule_event_t *e, size_t *memory );
+static uint64_t __now_ns( void );
+static int __compare_paths( const void *a, const void *b );
+static void __report( const batch_file_t *f, bool json, time_t start, time_t end );
+static void __print_json_string( const char *s );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See cli_batch.h for details. */
+int cli_batch( const char *path, size_t jobs, bool json, time_t start, time_t end )
+{
+    batch_file_t *files = NULL;
+    batch_file_t **group;
+    batch_pool_t pool;
+    size_t count, i, j;
+    int rv = 0;
+
+    if( (NULL == path) || (end <= start) ) {
+        return -1;
+    }
+
+    if( 0 == jobs ) {
+        long cores = sysconf( _SC_NPROCESSORS_ONLN );
+
+        jobs = (0 < cores) ? (size_t) cores : 1;
+    }
+
+    count = __collect( path, &files );
+    if( 0 == count ) {
+        fprintf( stderr, "No schedule files found in %s\n", path );
+        return -2;
+    }
+
+    group = (batch_file_t**) aker_malloc( count * sizeof(batch_file_t*) );
+    if( NULL == group ) {
+        rv = -2;
+        goto done;
+    }
+
+    memset( &pool, 0, sizeof(pool) );
+    pthread_mutex_init( &pool.lock, NULL );
+    pool.start = start;
+    pool.end = end;
+
+    /* Decoding doesn't care about the time zone, so do them all at once. */
+    for( i = 0; i < count; i++ ) {
+        group[i] = &files[i];
+    }
+    pool.files = group;
+    pool.count = count;
+    pool.fn = __decode;
+    __run_pool( &pool, jobs );
+
+    /* Evaluate one time zone at a time since TZ is process wide. */
+    pool.fn = __evaluate;
+    for( i = 0; i < count; i++ ) {
+        const char *tz = files[i].time_zone;
+
+        /* Evaluated schedules have already been released. */
+        if( NULL == files[i].s ) {
+            continue;
+        }
+
+        pool.count = 0;
+        for( j = i; j < count; j++ ) {
+            if( (NULL != files[j].s) &&
+                (((NULL == tz) && (NULL == files[j].time_zone)) ||
+                 ((NULL != tz) && (NULL != files[j].time_zone) &&
+                  (0 == strcmp(tz, files[j].time_zone)))) )
+            {
+                group[pool.count++] = &files[j];
+            }
+        }
+
+        set_unix_time_zone( (NULL != tz) ? tz : "UTC" );
+        __run_pool( &pool, jobs );
+    }
+    pthread_mutex_destroy( &pool.lock );
+    aker_free( group );
+
+    if( false == json ) {
+        printf( "file,status,bytes,weekly_events,absolute_events,macs,"
+                "memory_bytes,decode_us,eval_us,transitions,transitions_per_week\n" );
+    }
+    for( i = 0; i < count; i++ ) {
+        __report( &files[i], json, start, end );
+        if( 0 != files[i].status ) {
+            rv = -3;
+        }
+    }
+
+done:
+    for( i = 0; i < count; i++ ) {
+        destroy_schedule( files[i].s );
+        free( files[i].time_zone );
+        aker_free( files[i].path );
+    }
+    aker_free( files );
+
+    return rv;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Builds the list of files from a directory (sorted by name, signature and
+ *  image files skipped) or from a manifest.
+ *
+ *  @return the number of files found
+ */
+static size_t __collect( const char *path, batch_file_t **files )
+{
+    size_t count = 0, size = 0;
+    struct stat st;
+
+    *files = NULL;
+    if( 0 != stat(path, &st) ) {
+        fprintf( stderr, "Can't access %s\n", path );
+        return 0;
+    }
+
+    if( S_ISDIR(st.st_mode) ) {
+        struct dirent *d;
+        DIR *dir;
+
+        dir = opendir( path );
+        if( NULL == dir ) {
+            return 0;
+        }
+        while( NULL != (d = readdir(dir)) ) {
+            const char *ext = strrchr( d->d_name, '.' );
+
+            if( ('.' == d->d_name[0]) ||
+                ((NULL != ext) && ((0 == strcmp(ext, ".md5")) ||
+                                   (0 == strcmp(ext, SCHEDULE_IMAGE_SUFFIX)))) )
+            {
+                continue;
+            }
+            if( 0 != __add_file(files, &count, &size, path, d->d_name) ) {
+                break;
+            }
+        }
+        closedir( dir );
+
+        if( 0 < count ) {
+            qsort( *files, count, sizeof(batch_file_t), __compare_paths );
+        }
+    } else {
+        char *line = NULL;
+        size_t line_size = 0;
+        ssize_t len;
+        FILE *fh;
+
+        fh = fopen( path, "r" );
+        if( NULL == fh ) {
+            return 0;
+        }
+        while( 0 < (len = getline(&line, &line_size, fh)) ) {
+            while( (0 < len) && (('\n' == line[len - 1]) || ('\r' == line[len - 1]) ||
+                                 (' ' == line[len - 1])) )
+            {
+                line[--len] = '\0';
+            }
+            if( (0 == len) || ('#' == line[0]) ) {
+                continue;
+            }
+            if( 0 != __add_file(files, &count, &size, NULL, line) ) {
+                break;
+            }
+        }
+        free( line );
+        fclose( fh );
+    }
+
+    return count;
+}
+
+
+/**
+ *  Appends a file to the list, growing it as needed.
+ *
+ *  @return 0 on success, error otherwise
+ */
+static int __add_file( batch_file_t **files, size_t *count, size_t *size,
+                       const char *dir, const char *name )
+{
+    batch_file_t *f;
+    size_t len;
+
+    if( *count == *size ) {
+        size_t n = (0 < *size) ? (*size * 2) : 64;
+        batch_file_t *tmp;
+
+        tmp = (batch_file_t*) aker_malloc( n * sizeof(batch_file_t) );
+        if( NULL == tmp ) {
+            return -1;
+        }
+        if( 0 < *count ) {
+            memcpy( tmp, *files, *count * sizeof(batch_file_t) );
+        }
+        aker_free( *files );
+        *files = tmp;
+        *size = n;
+    }
+
+    f = &(*files)[*count];
+    memset( f, 0, sizeof(batch_file_t) );
+
+    len = strlen( name ) + 1;
+    if( NULL != dir ) {
+        len += strlen( dir ) + 1;
+    }
+    f->path = (char*) aker_malloc( len );
+    if( NULL == f->path ) {
+        return -1;
+    }
+    if( NULL != dir ) {
+        snprintf( f->path, len, "%s/%s", dir, name );
+    } else {
+        snprintf( f->path, len, "%s", name );
+    }
+    (*count)++;
+
+    return 0;
+}
+
+
+/**
+ *  Runs pool->fn over every file in the pool with up to jobs threads, the
+ *  caller being one of them.
+ */
+static void __run_pool( batch_pool_t *pool, size_t jobs )
+{
+    pthread_t *threads;
+    size_t started = 0, i;
+
+    pool->next = 0;
+    if( pool->count < jobs ) {
+        jobs = pool->count;
+    }
+
+    threads = (pthread_t*) aker_malloc( jobs * sizeof(pthread_t) );
+    for( i = 1; (NULL != threads) && (i < jobs); i++ ) {
+        if( 0 != pthread_create(&threads[started], NULL, __worker, pool) ) {
+            break;
+        }
+        started++;
+    }
+
+    __worker( pool );
+
+    for( i = 0; i < started; i++ ) {
+        pthread_join( threads[i], NULL );
+    }
+    aker_free( threads );
+}
+
+
+static void *__worker( void *arg )
+{
+    batch_pool_t *pool = (batch_pool_t*) arg;
+
+    while( 1 ) {
+        size_t i;
+
+        pthread_mutex_lock( &pool->lock );
+        i = pool->next++;
+        pthread_mutex_unlock( &pool->lock );
+
+        if( pool->count <= i ) {
+            break;
+        }
+        pool->fn( pool, pool->files[i] );
+    }
+
+    return NULL;
+}
+
+
+static void __decode( batch_pool_t *pool, batch_file_t *f )
+{
+    uint8_t *data = NULL;
+    uint64_t t;
+
+    (void) pool;
+
+    f->bytes = read_file_from_disk( f->path, &data );
+    if( 0 == f->bytes ) {
+        f->status = READ_FAILED;
+        return;
+    }
+
+    t = __now_ns();
+    f->status = decode_schedule_data( f->bytes, data, &f->s );
+    f->decode_ns = __now_ns() - t;
+    aker_free( data );
+
+    if( 0 == f->status ) {
+        f->memory = sizeof(schedule_t);
+        f->weekly = __count_events( f->s->weekly, &f->memory );
+        f->absolute = __count_events( f->s->absolute, &f->memory );
+        f->macs = f->s->mac_count;
+        f->memory += f->macs * sizeof(mac_address);
+        if( NULL != f->s->time_zone ) {
+            f->time_zone = strdup( f->s->time_zone );
+            f->memory += strlen( f->s->time_zone ) + 1;
+        }
+    } else {
+        f->s = NULL;
+    }
+}
+
+
+/**
+ *  Walks the window the way aker-cli prints it, counting the changes of the
+ *  blocked list.  The schedule is released afterwards.
+ */
+static void __evaluate( batch_pool_t *pool, batch_file_t *f )
+{
+    char *last = NULL;
+    uint64_t t0;
+    time_t t;
+
+    t0 = __now_ns();
+    for( t = pool->start; t < pool->end; t = get_next_transition(f->s, t) ) {
+        char *macs = get_blocked_at_time( f->s, t );
+
+        if( (t != pool->start) &&
+            (((NULL == macs) != (NULL == last)) ||
+             ((NULL != macs) && (NULL != last) && (0 != strcmp(macs, last)))) )
+        {
+            f->transitions++;
+        }
+        if( NULL != last ) {
+            aker_free( last );
+        }
+        last = macs;
+    }
+    if( NULL != last ) {
+        aker_free( last );
+    }
+    f->eval_ns = __now_ns() - t0;
+
+    destroy_schedule( f->s );
+    f->s = NULL;
+}
+
+
+/**
+ *  Counts the events in a list and adds their allocation sizes to memory.
+ *  The event finalize_schedule() added is not counted as an event.
+ */
+static size_t __count_events( schedule_event_t *e, size_t *memory )
+{
+    size_t count = 0;
+
+    for( ; NULL != e; e = e->next ) {
+        *memory += sizeof(schedule_event_t) + e->block_count * sizeof(uint32_t);
+        if( 0 <= e->time ) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+
+static uint64_t __now_ns( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+
+static int __compare_paths( const void *a, const void *b )
+{
+    return strcmp( ((const batch_file_t*) a)->path, ((const batch_file_t*) b)->path );
+}
+
+
+static void __report( const batch_file_t *f, bool json, time_t start, time_t end )
+{
+    double per_week;
+
+    per_week = (double) f->transitions * SECONDS_IN_A_WEEK / (double) (end - start);
+
+    if( json ) {
+        printf( "{\"file\":" );
+        __print_json_string( f->path );
+        printf( ",\"status\":%d,\"bytes\":%zu,\"weekly_events\":%zu,"
+                "\"absolute_events\":%zu,\"macs\":%zu,\"memory_bytes\":%zu,"
+                "\"decode_us\":%.1f,\"eval_us\":%.1f,\"transitions\":%zu,"
+                "\"transitions_per_week\":%.1f}\n",
+                f->status, f->bytes, f->weekly, f->absolute, f->macs,
+                f->memory, f->decode_ns / 1000.0, f->eval_ns / 1000.0,
+                f->transitions, per_week );
+    } else {
+        printf( "%s,%d,%zu,%zu,%zu,%zu,%zu,%.1f,%.1f,%zu,%.1f\n",
+                f->path, f->status, f->bytes, f->weekly, f->absolute, f->macs,
+                f->memory, f->decode_ns / 1000.0, f->eval_ns / 1000.0,
+                f->transitions, per_week );
+    }
+}
+
+
+static void __print_json_string( const char *s )
+{
+    putchar( '"' );
+    for( ; '\0' != *s; s++ ) {
+        if( ('"' == *s) || ('\\' == *s) ) {
+            printf( "\\%c", *s );
+        } else if( (unsigned char) *s < 0x20 ) {
+            printf( "\\u%04x", (unsigned char) *s );
+        } else {
+            putchar( *s );
+        }
+    }
+    putchar( '"' );
+}
@@ -0,0 +1,47 @@
+/**
+ * Copyright 2018 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __CLI_BATCH_H__
+#define __CLI_BATCH_H__
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Decodes and simulates every schedule file in a directory or listed in a
+ *  manifest (one path per line, '#' starts a comment) across a pool of
+ *  threads, and prints one summary line per file to stdout as CSV or JSON.
+ *
+ *  Decoding runs fully in parallel.  Evaluation depends on the process time
+ *  zone, so files are evaluated one time zone at a time, in parallel within
+ *  each time zone.
+ *
+ *  @param path  the directory or the manifest file
+ *  @param jobs  the number of threads, 0 for one per online core
+ *  @param json  true for JSON lines, false for CSV
+ *  @param start the start of the simulated window (unix time)
+ *  @param end   the end of the simulated window (unix time)
+ *
+ *  @return 0 if every file decoded, -3 if any did not, other errors otherwise
+ */
+int cli_batch( const char *path, size_t jobs, bool json, time_t start, time_t end );
+
+#endif
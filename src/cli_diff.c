@@ -0,0 +1,319 @@
+/**
+ * Copyright 2018 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cli_diff.h"
+#include "schedule.h"
+#include "process_data.h"
+#include "decode.h"
+#include "aker_mem.h"
+#include "time.h"
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+
+/* A blocked list split into sorted MACs. */
+typedef struct mac_set {
+    char *buf;
+    char **mac;
+    size_t count;
+} mac_set_t;
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static const char *current_tz = NULL;
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static schedule_t *__load( const char *filename );
+static void __use_tz( const schedule_t *s );
+static int __to_set( char *macs, mac_set_t *set );
+static void __free_set( mac_set_t *set );
+static char *__difference( const mac_set_t *a, const mac_set_t *b );
+static int __compare_macs( const void *a, const void *b );
+static void __print_interval( time_t from, time_t to, const char *added,
+                              const char *removed );
+static int __same( const char *a, const char *b );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See cli_diff.h for details. */
+int cli_diff( const char *old_file, const char *new_file, time_t start, time_t end )
+{
+    schedule_t *old_s, *new_s;
+    char *added = NULL, *removed = NULL;
+    time_t t, from = 0, differing = 0;
+    size_t intervals = 0;
+    int rv = -1;
+
+    old_s = __load( old_file );
+    new_s = __load( new_file );
+    if( (NULL == old_s) || (NULL == new_s) ) {
+        goto done;
+    }
+
+    /* Default to just this week, as the new schedule sees it. */
+    __use_tz( new_s );
+    if( 0 == end ) {
+        time_t now;
+
+        now = get_unix_time();
+        start = now - convert_unix_time_to_weekly(now);
+        end = start + 7 * 24 * 3600;
+    }
+
+    printf( "Old: %s (Timezone: %s)\n", old_file, old_s->time_zone );
+    printf( "New: %s (Timezone: %s)\n", new_file, new_s->time_zone );
+    printf( "Range from: %ld until: %ld\n", start, end );
+    printf( "\n" );
+    printf( "From         | Until        | Date                | Change\n" );
+    printf( "-------------+--------------+---------------------+-------------------------\n" );
+
+    for( t = start; t < end; ) {
+        mac_set_t old_set, new_set;
+        char *a, *r;
+        time_t next_old, next_new;
+
+        __use_tz( old_s );
+        next_old = get_next_transition( old_s, t );
+        rv = __to_set( get_blocked_at_time(old_s, t), &old_set );
+
+        __use_tz( new_s );
+        next_new = get_next_transition( new_s, t );
+        rv |= __to_set( get_blocked_at_time(new_s, t), &new_set );
+
+        a = __difference( &new_set, &old_set );
+        r = __difference( &old_set, &new_set );
+        __free_set( &old_set );
+        __free_set( &new_set );
+
+        /* Consecutive transitions with the same difference are one interval. */
+        if( (0 == __same(a, added)) || (0 == __same(r, removed)) ) {
+            if( (NULL != added) || (NULL != removed) ) {
+                __print_interval( from, t, added, removed );
+                differing += t - from;
+                intervals++;
+            }
+            free( added );
+            free( removed );
+            added = a;
+            removed = r;
+            from = t;
+        } else {
+            free( a );
+            free( r );
+        }
+
+        if( 0 != rv ) {
+            goto done;
+        }
+
+        t = (next_old < next_new) ? next_old : next_new;
+    }
+
+    if( (NULL != added) || (NULL != removed) ) {
+        __print_interval( from, end, added, removed );
+        differing += end - from;
+        intervals++;
+    }
+
+    printf( "\n%zu differing interval(s), %ld of %ld seconds differ.\n",
+            intervals, differing, end - start );
+    rv = (0 < intervals) ? 1 : 0;
+
+done:
+    free( added );
+    free( removed );
+    destroy_schedule( old_s );
+    destroy_schedule( new_s );
+
+    return rv;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Reads and decodes a schedule file, reporting any failure.
+ *
+ *  @return the schedule or NULL on failure
+ */
+static schedule_t *__load( const char *filename )
+{
+    uint8_t *data = NULL;
+    schedule_t *s = NULL;
+    size_t len;
+
+    len = read_file_from_disk( filename, &data );
+    if( 0 == len ) {
+        fprintf( stderr, "Unable to read %s\n", filename );
+        return NULL;
+    }
+
+    if( 0 != decode_schedule_data(len, data, &s) ) {
+        fprintf( stderr, "Unable to decode %s\n", filename );
+        s = NULL;
+    }
+    aker_free( data );
+
+    return s;
+}
+
+
+/**
+ *  Switches the process time zone to the schedule's, only when it differs
+ *  from the one already in use.
+ */
+static void __use_tz( const schedule_t *s )
+{
+    const char *tz = (NULL != s->time_zone) ? s->time_zone : "UTC";
+
+    if( (NULL == current_tz) || (0 != strcmp(tz, current_tz)) ) {
+        set_unix_time_zone( tz );
+        current_tz = tz;
+    }
+}
+
+
+/**
+ *  Splits a blocked list from get_blocked_at_time() into a sorted set.  The
+ *  list is owned by the set afterwards.
+ *
+ *  @return 0 on success, error otherwise
+ */
+static int __to_set( char *macs, mac_set_t *set )
+{
+    size_t size = 0;
+    char *save = NULL, *p;
+
+    memset( set, 0, sizeof(mac_set_t) );
+    set->buf = macs;
+    if( NULL == macs ) {
+        return 0;
+    }
+
+    for( p = strtok_r(macs, " ", &save); NULL != p; p = strtok_r(NULL, " ", &save) ) {
+        if( set->count == size ) {
+            char **tmp;
+
+            size = (0 < size) ? (size * 2) : 16;
+            tmp = (char**) realloc( set->mac, size * sizeof(char*) );
+            if( NULL == tmp ) {
+                return -1;
+            }
+            set->mac = tmp;
+        }
+        set->mac[set->count++] = p;
+    }
+
+    qsort( set->mac, set->count, sizeof(char*), __compare_macs );
+
+    return 0;
+}
+
+
+static void __free_set( mac_set_t *set )
+{
+    if( NULL != set->buf ) {
+        aker_free( set->buf );
+    }
+    free( set->mac );
+}
+
+
+/**
+ *  Lists the MACs in a that are not in b.
+ *
+ *  @return the space separated list or NULL if there are none
+ */
+static char *__difference( const mac_set_t *a, const mac_set_t *b )
+{
+    char *out = NULL, *tmp;
+    size_t i, j = 0, len = 0;
+
+    for( i = 0; i < a->count; i++ ) {
+        int cmp = 1;
+
+        while( (j < b->count) && (0 < (cmp = strcmp(a->mac[i], b->mac[j]))) ) {
+            j++;
+        }
+        if( (j < b->count) && (0 == cmp) ) {
+            continue;
+        }
+
+        tmp = (char*) realloc( out, len + strlen(a->mac[i]) + 2 );
+        if( NULL == tmp ) {
+            break;
+        }
+        out = tmp;
+        if( 0 < len ) {
+            out[len++] = ' ';
+        }
+        strcpy( &out[len], a->mac[i] );
+        len += strlen( a->mac[i] );
+    }
+
+    return out;
+}
+
+
+static int __compare_macs( const void *a, const void *b )
+{
+    return strcmp( *(char * const *) a, *(char * const *) b );
+}
+
+
+static void __print_interval( time_t from, time_t to, const char *added,
+                              const char *removed )
+{
+    struct tm ts;
+
+    localtime_r( &from, &ts );
+
+    printf( " %-11ld | %-12ld | %d-%02d-%02d %02d:%02d:%02d |",
+            from, to, (ts.tm_year+1900), (ts.tm_mon+1), ts.tm_mday,
+            ts.tm_hour, ts.tm_min, ts.tm_sec );
+    if( NULL != added ) {
+        printf( " added: %s", added );
+    }
+    if( NULL != removed ) {
+        printf( " removed: %s", removed );
+    }
+    printf( "\n" );
+}
+
+
+/**
+ *  @return 1 if both lists are missing or equal, 0 otherwise
+ */
+static int __same( const char *a, const char *b )
+{
+    if( (NULL == a) || (NULL == b) ) {
+        return (a == b) ? 1 : 0;
+    }
+
+    return (0 == strcmp(a, b)) ? 1 : 0;
+}
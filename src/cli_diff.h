@@ -0,0 +1,45 @@
+/**
+ * Copyright 2018 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __CLI_DIFF_H__
+#define __CLI_DIFF_H__
+
+#include <time.h>
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Compares the effective blocked sets of two schedules over a window and
+ *  prints only the intervals where they differ, with the MACs the new
+ *  schedule adds and removes.
+ *
+ *  Both schedules are walked together from transition to transition, so the
+ *  cost depends on the number of transitions and not the length of the
+ *  window.  Each schedule is evaluated in its own time zone.
+ *
+ *  @param old_file the schedule currently in use
+ *  @param new_file the replacement schedule
+ *  @param start    the starting unix time or 0 for current week
+ *  @param end      the ending unix time or 0 for current week
+ *
+ *  @return 0 if the schedules are equivalent over the window, 1 if they
+ *          differ, error otherwise
+ */
+int cli_diff( const char *old_file, const char *new_file, time_t start, time_t end );
+
+#endif
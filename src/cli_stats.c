@@ -0,0 +1,333 @@
+/**
+ * Copyright 2018 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include "cli_stats.h"
+#include "schedule.h"
+#include "process_data.h"
+#include "decode.h"
+#include "aker_mem.h"
+#include "time.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define MINUTES_IN_A_WEEK   (7 * 24 * 60)
+#define NOT_BLOCKED         ((time_t) -1)
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+typedef struct mac_stats {
+    time_t since;               /* When the current block started or
+                                 * NOT_BLOCKED. */
+    time_t total;
+    time_t longest;
+    size_t blocks;
+    size_t unblocks;
+    uint64_t seen;              /* Sweep step the MAC was last seen in. */
+} mac_stats_t;
+
+typedef struct sweep {
+    schedule_t *s;
+    mac_stats_t *stats;
+    uint32_t *blocked;          /* The currently blocked MAC indexes. */
+    uint32_t *next;             /* Scratch space for the next blocked set. */
+    size_t count;
+    uint64_t step;
+    double *device_seconds;     /* Per weekly minute, or NULL. */
+    double *seconds;            /* Per weekly minute, or NULL. */
+    long only;                  /* MAC index the heatmap counts or -1. */
+} sweep_t;
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static void __apply( sweep_t *w, schedule_event_t *e, time_t t );
+static void __close_block( mac_stats_t *m, time_t t );
+static void __add_heat( sweep_t *w, time_t from, time_t to );
+static int __write_heatmap( const char *filename, const sweep_t *w );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See cli_stats.h for details. */
+int cli_stats( const char *filename, time_t start, time_t end,
+               const char *heatmap, const char *mac )
+{
+    uint8_t *data = NULL;
+    sweep_t w;
+    size_t len, i;
+    time_t t;
+    int rv = -1;
+
+    memset( &w, 0, sizeof(w) );
+    w.only = -1;
+
+    len = read_file_from_disk( filename, &data );
+    if( 0 == len ) {
+        fprintf( stderr, "Unable to read %s\n", filename );
+        return -1;
+    }
+    rv = decode_schedule( len, data, &w.s );
+    aker_free( data );
+    if( 0 != rv ) {
+        fprintf( stderr, "Unable to decode %s\n", filename );
+        return -1;
+    }
+    rv = -1;
+
+    /* Default to just this week. */
+    if( 0 == end ) {
+        time_t now;
+
+        now = get_unix_time();
+        start = now - convert_unix_time_to_weekly(now);
+        end = start + 7 * 24 * 3600;
+    }
+
+    if( NULL != mac ) {
+        for( i = 0; i < w.s->mac_count; i++ ) {
+            if( 0 == strcasecmp(mac, w.s->macs[i].mac) ) {
+                w.only = (long) i;
+                break;
+            }
+        }
+        if( w.only < 0 ) {
+            fprintf( stderr, "%s is not in the schedule\n", mac );
+            goto done;
+        }
+    }
+
+    w.stats = (mac_stats_t*) aker_malloc( (w.s->mac_count + 1) * sizeof(mac_stats_t) );
+    w.blocked = (uint32_t*) aker_malloc( (w.s->mac_count + 1) * sizeof(uint32_t) );
+    w.next = (uint32_t*) aker_malloc( (w.s->mac_count + 1) * sizeof(uint32_t) );
+    if( (NULL == w.stats) || (NULL == w.blocked) || (NULL == w.next) ) {
+        goto done;
+    }
+    memset( w.stats, 0, (w.s->mac_count + 1) * sizeof(mac_stats_t) );
+    for( i = 0; i < w.s->mac_count; i++ ) {
+        w.stats[i].since = NOT_BLOCKED;
+    }
+
+    if( NULL != heatmap ) {
+        w.device_seconds = (double*) aker_malloc( MINUTES_IN_A_WEEK * sizeof(double) );
+        w.seconds = (double*) aker_malloc( MINUTES_IN_A_WEEK * sizeof(double) );
+        if( (NULL == w.device_seconds) || (NULL == w.seconds) ) {
+            goto done;
+        }
+        memset( w.device_seconds, 0, MINUTES_IN_A_WEEK * sizeof(double) );
+        memset( w.seconds, 0, MINUTES_IN_A_WEEK * sizeof(double) );
+    }
+
+    for( t = start; t < end; ) {
+        time_t next;
+
+        next = get_next_transition( w.s, t );
+        if( end < next ) {
+            next = end;
+        }
+
+        __apply( &w, get_event_at_time(w.s, t), t );
+        __add_heat( &w, t, next );
+
+        t = next;
+    }
+
+    /* Close the blocks still open at the end of the window. */
+    for( i = 0; i < w.count; i++ ) {
+        __close_block( &w.stats[w.blocked[i]], end );
+    }
+
+    printf( "mac,blocked_seconds,blocked_hours_per_week,blocks,unblocks,longest_block_seconds\n" );
+    for( i = 0; i < w.s->mac_count; i++ ) {
+        mac_stats_t *m = &w.stats[i];
+
+        printf( "%s,%ld,%.2f,%zu,%zu,%ld\n", w.s->macs[i].mac, m->total,
+                (double) m->total / 3600.0 * SECONDS_IN_A_WEEK / (double) (end - start),
+                m->blocks, m->unblocks, m->longest );
+    }
+
+    rv = 0;
+    if( NULL != heatmap ) {
+        rv = __write_heatmap( heatmap, &w );
+    }
+
+done:
+    if( NULL != w.stats ) aker_free( w.stats );
+    if( NULL != w.blocked ) aker_free( w.blocked );
+    if( NULL != w.next ) aker_free( w.next );
+    if( NULL != w.device_seconds ) aker_free( w.device_seconds );
+    if( NULL != w.seconds ) aker_free( w.seconds );
+    destroy_schedule( w.s );
+
+    return rv;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Moves the sweep to the blocked set of event e starting at time t, opening
+ *  and closing blocks for the MACs that changed.
+ *
+ *  Like get_blocked_at_time(), an event with an invalid MAC index blocks
+ *  nothing.
+ */
+static void __apply( sweep_t *w, schedule_event_t *e, time_t t )
+{
+    size_t i, count = 0;
+    uint32_t *tmp;
+
+    w->step++;
+
+    if( NULL != e ) {
+        for( i = 0; i < e->block_count; i++ ) {
+            if( w->s->mac_count <= e->block[i] ) {
+                e = NULL;
+                count = 0;
+                break;
+            }
+        }
+    }
+
+    if( NULL != e ) {
+        for( i = 0; i < e->block_count; i++ ) {
+            mac_stats_t *m = &w->stats[e->block[i]];
+
+            if( m->seen == w->step ) {
+                continue;
+            }
+            m->seen = w->step;
+            w->next[count++] = e->block[i];
+
+            if( NOT_BLOCKED == m->since ) {
+                m->since = t;
+                m->blocks++;
+            }
+        }
+    }
+
+    /* Whatever was blocked but isn't in the new set is now unblocked. */
+    for( i = 0; i < w->count; i++ ) {
+        mac_stats_t *m = &w->stats[w->blocked[i]];
+
+        if( m->seen != w->step ) {
+            __close_block( m, t );
+            m->unblocks++;
+        }
+    }
+
+    tmp = w->blocked;
+    w->blocked = w->next;
+    w->next = tmp;
+    w->count = count;
+}
+
+
+static void __close_block( mac_stats_t *m, time_t t )
+{
+    time_t length = t - m->since;
+
+    m->total += length;
+    if( m->longest < length ) {
+        m->longest = length;
+    }
+    m->since = NOT_BLOCKED;
+}
+
+
+/**
+ *  Spreads the currently blocked devices over the weekly minutes between
+ *  from and to.  The weekly position is looked up once per minute so local
+ *  time jumps are followed.
+ */
+static void __add_heat( sweep_t *w, time_t from, time_t to )
+{
+    double devices;
+
+    if( NULL == w->seconds ) {
+        return;
+    }
+
+    if( 0 <= w->only ) {
+        devices = (NOT_BLOCKED != w->stats[w->only].since) ? 1.0 : 0.0;
+    } else {
+        devices = (double) w->count;
+    }
+
+    while( from < to ) {
+        time_t weekly = convert_unix_time_to_weekly( from );
+        time_t chunk = 60 - (weekly % 60);
+        size_t minute = (size_t) (weekly / 60) % MINUTES_IN_A_WEEK;
+
+        if( to - from < chunk ) {
+            chunk = to - from;
+        }
+        w->seconds[minute] += (double) chunk;
+        w->device_seconds[minute] += devices * (double) chunk;
+        from += chunk;
+    }
+}
+
+
+/**
+ *  Writes the heatmap as CSV, one row per day with a value per minute.
+ *  Minutes the window never covered are left empty.
+ */
+static int __write_heatmap( const char *filename, const sweep_t *w )
+{
+    static const char *days[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+    FILE *fh;
+    int day, minute;
+
+    fh = fopen( filename, "w" );
+    if( NULL == fh ) {
+        fprintf( stderr, "Unable to write %s\n", filename );
+        return -1;
+    }
+
+    fprintf( fh, "day" );
+    for( minute = 0; minute < 24 * 60; minute++ ) {
+        fprintf( fh, ",%02d:%02d", minute / 60, minute % 60 );
+    }
+    fprintf( fh, "\n" );
+
+    for( day = 0; day < 7; day++ ) {
+        fprintf( fh, "%s", days[day] );
+        for( minute = 0; minute < 24 * 60; minute++ ) {
+            size_t i = (size_t) (day * 24 * 60 + minute);
+
+            if( 0.0 < w->seconds[i] ) {
+                fprintf( fh, ",%.3f", w->device_seconds[i] / w->seconds[i] );
+            } else {
+                fprintf( fh, "," );
+            }
+        }
+        fprintf( fh, "\n" );
+    }
+
+    fclose( fh );
+
+    return 0;
+}
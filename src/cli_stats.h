@@ -0,0 +1,49 @@
+/**
+ * Copyright 2018 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __CLI_STATS_H__
+#define __CLI_STATS_H__
+
+#include <time.h>
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Prints per MAC blocked time analytics for a schedule over a window as CSV:
+ *  the total blocked seconds (and hours per week), the number of block and
+ *  unblock edges and the longest continuous block.
+ *
+ *  The window is swept from transition to transition keeping only the set of
+ *  blocked MACs, so the cost depends on the number of transitions and the
+ *  size of their block lists, not on the window length or the MAC count.
+ *
+ *  @param filename the schedule to analyse
+ *  @param start    the starting unix time or 0 for current week
+ *  @param end      the ending unix time or 0 for current week
+ *  @param heatmap  if not NULL, a minute resolution weekly heatmap is written
+ *                  here as CSV: one row per day (Sunday first) and one column
+ *                  per minute holding the average number of blocked devices
+ *  @param mac      if not NULL, the heatmap only counts this MAC (so each
+ *                  value is the fraction of the minute it was blocked)
+ *
+ *  @return 0 on success, error otherwise
+ */
+int cli_stats( const char *filename, time_t start, time_t end,
+               const char *heatmap, const char *mac );
+
+#endif
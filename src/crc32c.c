@@ -0,0 +1,152 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__SSE4_2__) && defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+#include "crc32c.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define CRC32C_POLY 0x82f63b78  /* Castagnoli, bit reflected */
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+#if !(defined(__SSE4_2__) && defined(__x86_64__)) && !defined(__ARM_FEATURE_CRC32)
+#define CRC32C_SOFTWARE
+static pthread_once_t table_once = PTHREAD_ONCE_INIT;
+static uint32_t table[8][256];
+#endif
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+#ifdef CRC32C_SOFTWARE
+static void __build_table( void );
+#endif
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See crc32c.h for details. */
+uint32_t crc32c_update( uint32_t crc, const void *data, size_t len )
+{
+    const uint8_t *p = (const uint8_t*) data;
+
+    crc = ~crc;
+
+#if defined(__SSE4_2__) && defined(__x86_64__)
+    {
+        uint64_t crc64 = crc;
+
+        while( 8 <= len ) {
+            uint64_t word;
+
+            memcpy( &word, p, sizeof(word) );
+            crc64 = _mm_crc32_u64( crc64, word );
+            p += 8;
+            len -= 8;
+        }
+        crc = (uint32_t) crc64;
+    }
+    while( 0 < len-- ) {
+        crc = _mm_crc32_u8( crc, *p++ );
+    }
+#elif defined(__ARM_FEATURE_CRC32)
+    while( 8 <= len ) {
+        uint64_t word;
+
+        memcpy( &word, p, sizeof(word) );
+        crc = __crc32cd( crc, word );
+        p += 8;
+        len -= 8;
+    }
+    while( 0 < len-- ) {
+        crc = __crc32cb( crc, *p++ );
+    }
+#else
+    pthread_once( &table_once, __build_table );
+
+    /* Slice-by-8: fold 8 bytes per step using 8 lookups. */
+    while( 8 <= len ) {
+        uint32_t lo, hi;
+
+        lo = crc ^ ( (uint32_t) p[0]        | ((uint32_t) p[1] << 8) |
+                    ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24) );
+        hi =       ( (uint32_t) p[4]        | ((uint32_t) p[5] << 8) |
+                    ((uint32_t) p[6] << 16) | ((uint32_t) p[7] << 24) );
+
+        crc = table[7][lo & 0xff]         ^ table[6][(lo >> 8) & 0xff] ^
+              table[5][(lo >> 16) & 0xff] ^ table[4][lo >> 24] ^
+              table[3][hi & 0xff]         ^ table[2][(hi >> 8) & 0xff] ^
+              table[1][(hi >> 16) & 0xff] ^ table[0][hi >> 24];
+        p += 8;
+        len -= 8;
+    }
+    while( 0 < len-- ) {
+        crc = table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+#endif
+
+    return ~crc;
+}
+
+
+/* See crc32c.h for details. */
+uint32_t crc32c( const void *data, size_t len )
+{
+    return crc32c_update( 0, data, len );
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+#ifdef CRC32C_SOFTWARE
+/**
+ *  Builds the slice-by-8 lookup tables.  table[0] is the classic bytewise
+ *  table, table[k] advances a byte through k more zero bytes.
+ */
+static void __build_table( void )
+{
+    uint32_t i, j;
+
+    for( i = 0; i < 256; i++ ) {
+        uint32_t crc = i;
+
+        for( j = 0; j < 8; j++ ) {
+            crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY : 0);
+        }
+        table[0][i] = crc;
+    }
+
+    for( i = 0; i < 256; i++ ) {
+        for( j = 1; j < 8; j++ ) {
+            table[j][i] = (table[j - 1][i] >> 8) ^ table[0][table[j - 1][i] & 0xff];
+        }
+    }
+}
+#endif
@@ -0,0 +1,51 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __CRC32C_H__
+#define __CRC32C_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Continues a CRC-32C (Castagnoli) computation over more data.
+ *
+ *  Uses the SSE4.2 or ARMv8 CRC instructions when the compiler targets
+ *  them, a slice-by-8 table driven kernel otherwise.
+ *
+ *  @param crc  the value returned by the previous call, 0 to start
+ *  @param data the bytes to add
+ *  @param len  the number of bytes to add
+ *
+ *  @return the CRC-32C of everything passed in so far
+ */
+uint32_t crc32c_update( uint32_t crc, const void *data, size_t len );
+
+/**
+ *  Computes the CRC-32C (Castagnoli) of a buffer.
+ *
+ *  @param data the bytes to checksum
+ *  @param len  the number of bytes
+ *
+ *  @return the CRC-32C of the buffer
+ */
+uint32_t crc32c( const void *data, size_t len );
+
+#endif
@@ -18,6 +18,7 @@
 #include <msgpack.h>
 
 #include "schedule.h"
+#include "schedule_rules.h"
 #include "decode.h"
 #include "aker_log.h"
 #include "aker_mem.h"
@@ -29,6 +30,10 @@
 #define RELATIVE_TIME_STR "time"
 #define UNIX_TIME_STR     "unix_time"
 #define INDEXES_STR       "indexes"
+#define RULES             "rules"
+#define DAYS_STR          "days"
+#define START_STR         "start"
+#define END_STR           "end"
 /* Currently AKER will not do any validation on time_zone string */
 #define TIME_ZONE         "time_zone" /* REF: https://en.wikipedia.org/wiki/List_of_tz_database_time_zones */
 
@@ -40,6 +45,10 @@ char unpacked_buffer[UNPACKED_BUFFER_SIZE];
 static int decode_schedule_table   (msgpack_object *key, msgpack_object *val, schedule_event_t **t);
 static int decode_macs_table       (msgpack_object *key, msgpack_object *val, schedule_t **t);
 static int decode_string_type      (msgpack_object *key, msgpack_object *val, schedule_t **t);
+static int decode_rules_table      (msgpack_object *key, msgpack_object *val,
+                                    schedule_rule_t **rules, size_t *count);
+
+static int process_rule(msgpack_object *obj, schedule_rule_t *r);
 
 static int process_map(msgpack_object_map *, schedule_event_t **t);
 
@@ -47,12 +56,26 @@ static int process_map(msgpack_object_map *, schedule_event_t **t);
 static bool name_match(msgpack_object *key, const char *name);
 
 int decode_schedule(size_t len, uint8_t * buf, schedule_t **t)
+{
+    int ret_val;
+
+    ret_val = decode_schedule_data(len, buf, t);
+    if ((0 == ret_val) && (NULL != (*t)->time_zone)) {
+        (void ) set_unix_time_zone((*t)->time_zone);
+    }
+
+    return ret_val;
+}
+
+int decode_schedule_data(size_t len, uint8_t * buf, schedule_t **t)
 {
     int ret_val = 0;
     msgpack_unpacked result;
     size_t off = 0;
     msgpack_unpack_return ret;
     schedule_t *s;
+    schedule_rule_t *rules = NULL;
+    size_t rule_count = 0;
 
     if (NULL == t || NULL == buf) {
         return -1;
@@ -110,6 +133,13 @@ int decode_schedule(size_t len, uint8_t * buf, schedule_t **t)
                 else if (0 == strncmp(key->via.str.ptr, TIME_ZONE, key->via.str.size)) {
                     decode_string_type(key, val, &s);
                 }
+                else if (0 == strncmp(key->via.str.ptr, RULES, key->via.str.size)) {
+                    debug_print("Found %s\n", RULES);
+                    if (0 != decode_rules_table(key, val, &rules, &rule_count)) {
+                        debug_error("decode_schedule():decode_rules_table() failed\n");
+                        ret_val = -10;
+                    }
+                }
                 else {
                      debug_error("decode_schedule() can't handle object %d\n", obj.type);
                 }
@@ -118,6 +148,15 @@ int decode_schedule(size_t len, uint8_t * buf, schedule_t **t)
                 val = &p->val;
             }
 
+            /* The rules need the whole MAC table, so they go in last. */
+            if ((0 == ret_val) && (0 != expand_schedule_rules(s, rules, rule_count))) {
+                debug_error("decode_schedule():expand_schedule_rules() failed\n");
+                ret_val = -10;
+            }
+            destroy_schedule_rules(rules, rule_count);
+            rules = NULL;
+            rule_count = 0;
+
             if (0 < finalize_schedule(s)) {
                 debug_error("Unexpected result in finalize_schedule()\n");
                 ret_val = -8;
@@ -165,23 +204,66 @@ int decode_schedule_table (msgpack_object *key, msgpack_object *val, schedule_ev
         int count = val->via.array.size; 
         int i;
         schedule_event_t *temp = NULL;
+        event_array_t events;
+        int rv = 0;
         
         if (count <= 0) {
             return -1;
         }
 
         if (ptr->type == MSGPACK_OBJECT_MAP) {
-            for (i = 0; i < count; i++) {
+            /* Finding each event's place is a binary search, and sorted
+             * schedules are only ever added at the end. */
+            if (0 != event_array_init(&events, t, count)) {
+                return -1;
+            }
+            for (i = 0; (0 == rv) && (i < count); i++) {
                 if (0 == process_map(&ptr->via.map, &temp)) {
-                    insert_event(t, temp);
+                    if ((NULL != temp) && (0 != event_array_insert(&events, temp))) {
+                        aker_free(temp);
+                        rv = -1;
+                    }
                 }
                 ptr++;
            }
+           event_array_destroy(&events);
         }
+        return rv;
     }
     return 0;    
 }
 
+int decode_rules_table (msgpack_object *key, msgpack_object *val,
+                        schedule_rule_t **rules, size_t *count)
+{
+    uint32_t i, size;
+    (void ) key;
+
+    if ((val->type != MSGPACK_OBJECT_ARRAY) || (0 == val->via.array.size)) {
+        debug_error("decode_rules_table(): not a list of rules\n");
+        return -1;
+    }
+
+    destroy_schedule_rules(*rules, *count);
+    *count = 0;
+
+    size = val->via.array.size;
+    *rules = (schedule_rule_t *) aker_malloc(size * sizeof(schedule_rule_t));
+    if (NULL == *rules) {
+        return -2;
+    }
+    memset(*rules, 0, size * sizeof(schedule_rule_t));
+
+    for (i = 0; i < size; i++) {
+        (*count)++;
+        if (0 != process_rule(&val->via.array.ptr[i], &(*rules)[i])) {
+            return -3;
+        }
+    }
+
+    return 0;
+}
+
 int decode_macs_table (msgpack_object *key, msgpack_object *val, schedule_t **t)
 {
     uint32_t i;
@@ -275,13 +357,75 @@ int process_map(msgpack_object_map *map, schedule_event_t **t)
     return ret_val;
 }
 
+int process_rule(msgpack_object *obj, schedule_rule_t *r)
+{
+    msgpack_object_kv *kv;
+    bool have_start = false, have_end = false, have_indexes = false;
+    uint32_t i, j;
+
+    if (obj->type != MSGPACK_OBJECT_MAP) {
+        return -1;
+    }
+
+    /* Without a day mask the range applies every day. */
+    r->days = RULE_ALL_DAYS;
+
+    kv = obj->via.map.ptr;
+    for (i = 0; i < obj->via.map.size; i++, kv++) {
+        msgpack_object *key = &kv->key;
+        msgpack_object *val = &kv->val;
+
+        if (key->type != MSGPACK_OBJECT_STR) {
+            return -1;
+        }
+        if ((val->type == MSGPACK_OBJECT_POSITIVE_INTEGER) && (val->via.u64 <= UINT32_MAX)
+            && name_match(key, DAYS_STR))
+        {
+            r->days = (uint32_t) val->via.u64;
+        } else if ((val->type == MSGPACK_OBJECT_POSITIVE_INTEGER) && (val->via.u64 <= SECONDS_IN_A_DAY)
+                   && name_match(key, START_STR))
+        {
+            r->start = (time_t) val->via.u64;
+            have_start = true;
+        } else if ((val->type == MSGPACK_OBJECT_POSITIVE_INTEGER) && (val->via.u64 <= SECONDS_IN_A_DAY)
+                   && name_match(key, END_STR))
+        {
+            r->end = (time_t) val->via.u64;
+            have_end = true;
+        } else if ((val->type == MSGPACK_OBJECT_ARRAY) && !have_indexes
+                   && name_match(key, INDEXES_STR))
+        {
+            r->block_count = val->via.array.size;
+            if (0 < r->block_count) {
+                r->block = (uint32_t *) aker_malloc(r->block_count * sizeof(uint32_t));
+                if (NULL == r->block) {
+                    return -2;
+                }
+            }
+            for (j = 0; j < r->block_count; j++) {
+                msgpack_object *index = &val->via.array.ptr[j];
+
+                if ((index->type != MSGPACK_OBJECT_POSITIVE_INTEGER) || (UINT32_MAX < index->via.u64)) {
+                    return -1;
+                }
+                r->block[j] = (uint32_t) index->via.u64;
+            }
+            have_indexes = true;
+        } else {
+            debug_error("Unexpected Item in rule\n");
+            return -1;
+        }
+    }
+
+    return (have_start && have_end && have_indexes) ? 0 : -1;
+}
+
 int decode_string_type (msgpack_object *key, msgpack_object *val, schedule_t **t)
 {
     (void ) key;
 
     (*t)->time_zone = strndup(val->via.str.ptr, val->via.str.size);
     debug_info("time_zone:%s\n", (*t)->time_zone);
-    (void ) set_unix_time_zone((*t)->time_zone);
 
     return 0;
 }
@@ -25,7 +25,8 @@
 #include <stdlib.h>
 
 /**
- *  Decodes the MsgPacked structure (bytes) into a new schedule object.
+ *  Decodes the MsgPacked structure (bytes) into a new schedule object and
+ *  makes its time zone the process time zone.
  *
  *  @param len  [in]  the number of bytes to process
  *  @param data [in]  the msgpack bytes to process
@@ -35,5 +36,17 @@
  */
 int decode_schedule(size_t count, uint8_t *bytes, schedule_t **s);
 
+/**
+ *  Same as decode_schedule() but leaves the process time zone alone, so
+ *  several schedules can be decoded at once from different threads.
+ *
+ *  @param len  [in]  the number of bytes to process
+ *  @param data [in]  the msgpack bytes to process
+ *  @param s    [out] the resulting schedule struture, or untouched on error
+ *
+ *  @return 0 on success, error otherwise.
+ */
+int decode_schedule_data(size_t count, uint8_t *bytes, schedule_t **s);
+
 
 #endif
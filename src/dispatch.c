@@ -0,0 +1,564 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dispatch.h"
+#include "wrp_interface.h"
+#include "process_data.h"
+#include "aker_log.h"
+#include "aker_mem.h"
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+typedef struct job {
+    wrp_msg_t *msg;             /* NULL for the idle work. */
+    char *uuid;                 /* The request's, kept past answering it. */
+    char *replaces;             /* See process_wrp_replaces(). */
+    bool write;
+    bool started;
+    bool superseded;
+    struct job *next;           /* In its queue. */
+    struct job *after;          /* The same transaction's next request. */
+    struct job *older;          /* Not answered yet, in the order received. */
+    struct job *newer;
+} job_t;
+
+typedef struct {
+    job_t *head;
+    job_t *tail;
+    pthread_cond_t cond;
+} job_queue_t;
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static job_queue_t reads  = { NULL, NULL, PTHREAD_COND_INITIALIZER };
+static job_queue_t writes = { NULL, NULL, PTHREAD_COND_INITIALIZER };
+static job_t *oldest = NULL;
+static job_t *newest = NULL;
+static size_t writes_pending = 0;   /* Queued, waiting or being run. */
+static size_t pending = 0;          /* The same, but not superseded. */
+static size_t pending_max = DISPATCH_DEFAULT_QUEUE;
+
+static const char *data = NULL;
+static const char *md5 = NULL;
+static dispatch_send_fn send_fn = NULL;
+static void *send_ctx = NULL;
+
+static pthread_t writer;
+static pthread_t *readers = NULL;
+static unsigned reader_total = 0;
+static bool running = false;
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static char* __uuid( const wrp_msg_t *msg );
+static void __free_job( job_t *j );
+static bool __supersede( const job_t *j );
+static void __admit( job_t *j );
+static void __enqueue( job_t *j );
+static void __finish( job_t *j );
+static void __run( const job_t *j );
+static void __answer( wrp_msg_t *msg, int status, const char *text );
+static void __release( wrp_msg_t *msg, wrp_msg_t *response );
+static void __work( job_queue_t *q );
+static void* __reader( void *args );
+static void* __writer( void *args );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See dispatch.h for details. */
+int dispatch_start( const char *data_file, const char *md5_file,
+                    dispatch_send_fn send, void *ctx, unsigned readers_wanted,
+                    size_t queue_max )
+{
+    unsigned i;
+    int rv;
+
+    pthread_mutex_lock( &lock );
+    if( running ) {
+        pthread_mutex_unlock( &lock );
+        return -1;
+    }
+    data = data_file;
+    md5 = md5_file;
+    send_fn = send;
+    send_ctx = ctx;
+    pending_max = (0 == queue_max) ? DISPATCH_DEFAULT_QUEUE : queue_max;
+    pthread_mutex_unlock( &lock );
+
+    if( 0 == readers_wanted ) {
+        readers_wanted = DISPATCH_DEFAULT_READERS;
+    }
+    if( DISPATCH_MAX_READERS < readers_wanted ) {
+        readers_wanted = DISPATCH_MAX_READERS;
+    }
+
+    readers = (pthread_t*) aker_malloc( readers_wanted * sizeof(pthread_t) );
+    if( NULL == readers ) {
+        return ENOMEM;
+    }
+
+    pthread_mutex_lock( &lock );
+    running = true;
+    pthread_mutex_unlock( &lock );
+
+    rv = pthread_create( &writer, NULL, __writer, NULL );
+    if( 0 != rv ) {
+        debug_error("dispatch_start() failed to start the writer: %d\n", rv);
+        pthread_mutex_lock( &lock );
+        running = false;
+        pthread_mutex_unlock( &lock );
+        aker_free( readers );
+        readers = NULL;
+        return rv;
+    }
+
+    for( i = 0; (0 == rv) && (i < readers_wanted); i++ ) {
+        rv = pthread_create( &readers[i], NULL, __reader, NULL );
+        if( 0 == rv ) {
+            reader_total++;
+        }
+    }
+
+    if( 0 != rv ) {
+        debug_error("dispatch_start() failed to start the readers: %d\n", rv);
+        dispatch_stop();
+    }
+
+    return rv;
+}
+
+
+/* See dispatch.h for details. */
+void dispatch_submit( wrp_msg_t *msg )
+{
+    job_t *j;
+
+    if( NULL == msg ) {
+        return;
+    }
+
+    j = (job_t*) aker_malloc( sizeof(job_t) );
+    if( NULL != j ) {
+        memset( j, 0, sizeof(job_t) );
+        j->msg = msg;
+        j->uuid = __uuid( msg );
+        j->write = (WRP_MSG_TYPE__RETREIVE != msg->msg_type);
+        j->replaces = process_wrp_replaces( msg );
+    }
+
+    pthread_mutex_lock( &lock );
+    if( running && (NULL != j) ) {
+        /* Superseding one makes room for this one. */
+        if( __supersede(j) || (pending < pending_max) ) {
+            __admit( j );
+            pthread_mutex_unlock( &lock );
+            return;
+        }
+        pthread_mutex_unlock( &lock );
+
+        debug_info("dispatch: %zu requests pending, turning one away\n", pending_max);
+        __answer( msg, DISPATCH_STATUS_OVERLOADED, "Too many requests" );
+        __free_job( j );
+        return;
+    }
+    pthread_mutex_unlock( &lock );
+
+    /* No threads (or no memory for the job): answer it here. */
+    if( NULL != j ) {
+        __run( j );
+        __free_job( j );
+    } else {
+        job_t local;
+
+        memset( &local, 0, sizeof(job_t) );
+        local.msg = msg;
+        __run( &local );
+    }
+}
+
+
+/* See dispatch.h for details. */
+void dispatch_idle( void )
+{
+    job_t *j;
+
+    pthread_mutex_lock( &lock );
+    if( running && (0 < writes_pending) ) {
+        pthread_mutex_unlock( &lock );
+        return;
+    }
+    pthread_mutex_unlock( &lock );
+
+    j = (job_t*) aker_malloc( sizeof(job_t) );
+    if( NULL == j ) {
+        return;
+    }
+    memset( j, 0, sizeof(job_t) );
+    j->write = true;
+
+    pthread_mutex_lock( &lock );
+    if( running ) {
+        __admit( j );
+        j = NULL;
+    }
+    pthread_mutex_unlock( &lock );
+
+    if( NULL != j ) {
+        __run( j );
+        aker_free( j );
+    }
+}
+
+
+/* See dispatch.h for details. */
+void dispatch_stop( void )
+{
+    bool started;
+    unsigned i;
+
+    pthread_mutex_lock( &lock );
+    started = running;
+    running = false;
+    pthread_cond_broadcast( &reads.cond );
+    pthread_cond_broadcast( &writes.cond );
+    pthread_mutex_unlock( &lock );
+
+    if( started ) {
+        pthread_join( writer, NULL );
+        for( i = 0; i < reader_total; i++ ) {
+            pthread_join( readers[i], NULL );
+        }
+    }
+
+    if( NULL != readers ) {
+        aker_free( readers );
+    }
+    readers = NULL;
+    reader_total = 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Copies the transaction UUID of a request.  The request's own goes into
+ *  the response while it is processed, and the request is freed before the
+ *  job is let go of, so later requests are matched against the copy.
+ *
+ *  @return the copy, NULL if the request has none (or out of memory)
+ */
+static char* __uuid( const wrp_msg_t *msg )
+{
+    char *rv = NULL;
+
+    if( (WRP_MSG_TYPE__CREATE <= msg->msg_type) &&
+        (WRP_MSG_TYPE__DELETE >= msg->msg_type) &&
+        (NULL != msg->u.crud.transaction_uuid) )
+    {
+        size_t len = strlen( msg->u.crud.transaction_uuid ) + 1;
+
+        rv = (char*) aker_malloc( len );
+        if( NULL != rv ) {
+            memcpy( rv, msg->u.crud.transaction_uuid, len );
+        }
+    }
+
+    return rv;
+}
+
+
+/**
+ *  Frees a job, not its request.
+ */
+static void __free_job( job_t *j )
+{
+    if( NULL != j->uuid ) {
+        aker_free( j->uuid );
+    }
+    if( NULL != j->replaces ) {
+        aker_free( j->replaces );
+    }
+    aker_free( j );
+}
+
+
+/**
+ *  Marks the jobs that a new one makes moot: the ones replacing the same
+ *  schedule that haven't been started.  Their payload is dropped right
+ *  away, and they stop counting against the queue limit.  The lock must be
+ *  held.
+ *
+ *  @return true if any job was superseded
+ */
+static bool __supersede( const job_t *j )
+{
+    bool rv = false;
+    job_t *p;
+
+    if( NULL == j->replaces ) {
+        return false;
+    }
+
+    for( p = oldest; NULL != p; p = p->newer ) {
+        if( (NULL != p->replaces) && !p->started && !p->superseded &&
+            (0 == strcmp(j->replaces, p->replaces)) )
+        {
+            debug_info("dispatch: %s update superseded\n", p->replaces);
+            p->superseded = true;
+            /* wrp-c allocated it. */
+            free( p->msg->u.crud.payload );
+            p->msg->u.crud.payload = NULL;
+            p->msg->u.crud.payload_size = 0;
+            pending--;
+            rv = true;
+        }
+    }
+
+    return rv;
+}
+
+
+/**
+ *  Takes in a new job: queued right away, or after the last unanswered
+ *  request of the same transaction.  The lock must be held.
+ */
+static void __admit( job_t *j )
+{
+    job_t *p = NULL;
+
+    if( NULL != j->uuid ) {
+        for( p = newest; NULL != p; p = p->older ) {
+            if( (NULL != p->uuid) && (0 == strcmp(j->uuid, p->uuid)) ) {
+                break;
+            }
+        }
+    }
+
+    j->older = newest;
+    if( NULL == newest ) {
+        oldest = j;
+    } else {
+        newest->newer = j;
+    }
+    newest = j;
+
+    if( j->write ) {
+        writes_pending++;
+    }
+    pending++;
+
+    if( NULL != p ) {
+        p->after = j;
+    } else {
+        __enqueue( j );
+    }
+}
+
+
+/**
+ *  Puts a job at the end of the readers' or the writer's queue.  The lock
+ *  must be held.
+ */
+static void __enqueue( job_t *j )
+{
+    job_queue_t *q = j->write ? &writes : &reads;
+
+    j->next = NULL;
+    if( NULL == q->tail ) {
+        q->head = j;
+    } else {
+        q->tail->next = j;
+    }
+    q->tail = j;
+
+    pthread_cond_signal( &q->cond );
+}
+
+
+/**
+ *  Drops an answered job, letting the next request of its transaction go.
+ *  The lock must be held.
+ */
+static void __finish( job_t *j )
+{
+    if( NULL == j->older ) {
+        oldest = j->newer;
+    } else {
+        j->older->newer = j->newer;
+    }
+    if( NULL == j->newer ) {
+        newest = j->older;
+    } else {
+        j->newer->older = j->older;
+    }
+
+    if( j->write ) {
+        writes_pending--;
+    }
+    if( !j->superseded ) {
+        pending--;
+    }
+
+    if( NULL != j->after ) {
+        __enqueue( j->after );
+    }
+
+    /* The threads stop once everything is answered. */
+    if( !running && (NULL == oldest) ) {
+        pthread_cond_broadcast( &reads.cond );
+        pthread_cond_broadcast( &writes.cond );
+    }
+
+    __free_job( j );
+}
+
+
+/**
+ *  Processes a request and sends the response, or does the idle work.
+ */
+static void __run( const job_t *j )
+{
+    wrp_msg_t response;
+
+    if( NULL == j->msg ) {
+        (void) process_persist_pruned( data, md5, PRUNED_PERSIST_MIN );
+        return;
+    }
+
+    if( j->superseded ) {
+        __answer( j->msg, DISPATCH_STATUS_SUPERSEDED, "Superseded by a newer update" );
+        return;
+    }
+
+    memset( &response, 0, sizeof(wrp_msg_t) );
+    if( 0 == process_wrp(data, md5, j->msg, &response) ) {
+        if( (NULL != send_fn) && (0 != send_fn(send_ctx, &response)) ) {
+            debug_error("dispatch: failed to send a response\n");
+        }
+    }
+    __release( j->msg, &response );
+}
+
+
+/**
+ *  Answers a request without processing it.
+ */
+static void __answer( wrp_msg_t *msg, int status, const char *text )
+{
+    wrp_msg_t response;
+
+    memset( &response, 0, sizeof(wrp_msg_t) );
+    if( 0 == process_wrp_reject(msg, status, text, &response) ) {
+        if( (NULL != send_fn) && (0 != send_fn(send_ctx, &response)) ) {
+            debug_error("dispatch: failed to send a response\n");
+        }
+    }
+    __release( msg, &response );
+}
+
+
+/**
+ *  Frees a request and its response once sent.  Answering moves the
+ *  request's transaction UUID, source, destination and path into the
+ *  response; they go back to the request so wrp_free_struct() frees them.
+ */
+static void __release( wrp_msg_t *msg, wrp_msg_t *response )
+{
+    if( (WRP_MSG_TYPE__CREATE <= response->msg_type) &&
+        (WRP_MSG_TYPE__DELETE >= response->msg_type) )
+    {
+        struct wrp_crud_msg *in = &(msg->u.crud);
+        struct wrp_crud_msg *out = &(response->u.crud);
+
+        if( NULL == in->transaction_uuid ) {
+            in->transaction_uuid = out->transaction_uuid;
+            out->transaction_uuid = NULL;
+        }
+        if( NULL == in->source ) {
+            in->source = out->dest;
+            out->dest = NULL;
+        }
+        if( NULL == in->dest ) {
+            in->dest = out->source;
+            out->source = NULL;
+        }
+        if( NULL == in->path ) {
+            in->path = out->path;
+            out->path = NULL;
+        }
+    }
+    cleanup_wrp( response );
+    wrp_free_struct( msg );
+}
+
+
+/**
+ *  Runs the jobs of a queue until stopped and everything is answered.
+ */
+static void __work( job_queue_t *q )
+{
+    pthread_mutex_lock( &lock );
+    while( running || (NULL != oldest) ) {
+        job_t *j = q->head;
+
+        if( NULL == j ) {
+            pthread_cond_wait( &q->cond, &lock );
+            continue;
+        }
+
+        q->head = j->next;
+        if( NULL == q->head ) {
+            q->tail = NULL;
+        }
+        j->started = true;
+        pthread_mutex_unlock( &lock );
+
+        __run( j );
+
+        pthread_mutex_lock( &lock );
+        __finish( j );
+    }
+    pthread_mutex_unlock( &lock );
+}
+
+
+static void* __reader( void *args )
+{
+    (void) args;
+    __work( &reads );
+    return NULL;
+}
+
+
+static void* __writer( void *args )
+{
+    (void) args;
+    __work( &writes );
+    return NULL;
+}
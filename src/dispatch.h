@@ -0,0 +1,118 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __DISPATCH_H__
+#define __DISPATCH_H__
+
+#include <stddef.h>
+#include <wrp-c.h>
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define DISPATCH_DEFAULT_READERS    2
+#define DISPATCH_MAX_READERS        16
+#define DISPATCH_DEFAULT_QUEUE      64
+
+/* Not 409, which already means a CREATE of a schedule that is present or a
+ * patch that doesn't fit. */
+#define DISPATCH_STATUS_SUPERSEDED  410
+#define DISPATCH_STATUS_OVERLOADED  503
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Sends one response upstream.
+ *
+ *  @note The message and its contents belong to the caller.
+ *
+ *  @param ctx the context given to dispatch_start()
+ *  @param msg the response to send
+ *
+ *  @return 0 on success, error otherwise
+ */
+typedef int (*dispatch_send_fn)( void *ctx, wrp_msg_t *msg );
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+
+/*
+ *  Requests are taken off the main loop by a small pool of threads:
+ *
+ *  - RETRIEVEs go to the readers and run side by side, against whatever is
+ *    in force when they run, so a large upload doesn't hold them up.
+ *  - Everything else goes to a single writer, one at a time in the order
+ *    received.
+ *  - A request with the same transaction UUID as one that is still being
+ *    worked on waits for it, so the responses to a transaction go out in
+ *    the order its requests came in.
+ *  - An UPDATE that replaces a whole schedule (see process_wrp_replaces())
+ *    supersedes the ones for the same endpoint that haven't been started:
+ *    they are answered with DISPATCH_STATUS_SUPERSEDED without being
+ *    applied, so only the latest one is decoded, stored and swapped in.
+ *  - At most queue_max requests are waiting or being worked on, not
+ *    counting superseded ones.  Past that a request is answered with
+ *    DISPATCH_STATUS_OVERLOADED right away, unless it supersedes one.
+ *
+ *  Until dispatch_start() succeeds, requests are handled in the caller.
+ */
+
+/**
+ *  Starts the writer and the readers.
+ *
+ *  @param data_file the data file name
+ *  @param md5_file  the signature file name
+ *  @param send      the function that sends a response
+ *  @param ctx       passed to send as is
+ *  @param readers   the number of reader threads, 0 for
+ *                   DISPATCH_DEFAULT_READERS
+ *  @param queue_max the most requests waiting or being worked on, 0 for
+ *                   DISPATCH_DEFAULT_QUEUE
+ *
+ *  @return 0 on success, error otherwise (requests are then handled in the
+ *          caller)
+ */
+int dispatch_start( const char *data_file, const char *md5_file,
+                    dispatch_send_fn send, void *ctx, unsigned readers,
+                    size_t queue_max );
+
+/**
+ *  Hands a request over, answering it once it has been processed.
+ *
+ *  @param msg the request; it is freed with wrp_free_struct() when done
+ */
+void dispatch_submit( wrp_msg_t *msg );
+
+/**
+ *  Called when no request came in for a while: stores what the scheduler
+ *  pruned (see process_persist_pruned()) on the writer, unless it has
+ *  something queued.
+ */
+void dispatch_idle( void );
+
+/**
+ *  Answers everything handed over so far and stops the threads.
+ *
+ *  @note The daemon calls this on SIGINT/SIGTERM once it stops receiving,
+ *        before stopping the journal and persistence, so every request it
+ *        took is answered and handed to them first.
+ */
+void dispatch_stop( void );
+
+#endif
@@ -0,0 +1,146 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <string.h>
+#include <msgpack.h>
+
+#include "encode.h"
+#include "aker_log.h"
+#include "aker_mem.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+/* The same names decode.c looks for. */
+#define WEEKLY_SCHEDULE   "weekly"
+#define MACS              "macs"
+#define ABSOLUTE_SCHEDULE "absolute"
+#define RELATIVE_TIME_STR "time"
+#define UNIX_TIME_STR     "unix_time"
+#define INDEXES_STR       "indexes"
+#define TIME_ZONE         "time_zone"
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static void __pack_string( msgpack_packer *pk, const char *s );
+static void __pack_events( msgpack_packer *pk, schedule_event_t *head,
+                           const char *time_key );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See encode.h for details. */
+size_t encode_schedule( schedule_t *s, uint8_t **data )
+{
+    msgpack_sbuffer sbuf;
+    msgpack_packer pk;
+    size_t i, len = 0;
+
+    if( (NULL == s) || (NULL == data) ) {
+        return 0;
+    }
+
+    msgpack_sbuffer_init( &sbuf );
+    msgpack_packer_init( &pk, &sbuf, msgpack_sbuffer_write );
+    msgpack_pack_map( &pk, 1 + ((NULL != s->time_zone) ? 1 : 0) +
+                           ((NULL != s->weekly) ? 1 : 0) +
+                           ((NULL != s->absolute) ? 1 : 0) );
+
+    if( NULL != s->time_zone ) {
+        __pack_string( &pk, TIME_ZONE );
+        __pack_string( &pk, s->time_zone );
+    }
+
+    __pack_string( &pk, MACS );
+    msgpack_pack_array( &pk, s->mac_count );
+    for( i = 0; i < s->mac_count; i++ ) {
+        __pack_string( &pk, s->macs[i].mac );
+    }
+
+    if( NULL != s->weekly ) {
+        __pack_string( &pk, WEEKLY_SCHEDULE );
+        __pack_events( &pk, s->weekly, RELATIVE_TIME_STR );
+    }
+
+    if( NULL != s->absolute ) {
+        __pack_string( &pk, ABSOLUTE_SCHEDULE );
+        __pack_events( &pk, s->absolute, UNIX_TIME_STR );
+    }
+
+    if( NULL != sbuf.data ) {
+        *data = (uint8_t*) aker_malloc( sbuf.size );
+        if( NULL != *data ) {
+            memcpy( *data, sbuf.data, sbuf.size );
+            len = sbuf.size;
+        } else {
+            debug_error( "encode_schedule() failed to allocate %zu bytes\n", sbuf.size );
+        }
+    }
+    msgpack_sbuffer_destroy( &sbuf );
+
+    return len;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+static void __pack_string( msgpack_packer *pk, const char *s )
+{
+    size_t len = strlen( s );
+
+    msgpack_pack_str( pk, len );
+    msgpack_pack_str_body( pk, s, len );
+}
+
+
+/**
+ *  Packs a list of events as an array of { time_key: time, "indexes": [] }
+ *  maps, leaving out events before the start of the week.
+ */
+static void __pack_events( msgpack_packer *pk, schedule_event_t *head,
+                           const char *time_key )
+{
+    schedule_event_t *p;
+    size_t count = 0;
+
+    for( p = head; NULL != p; p = p->next ) {
+        if( 0 <= p->time ) {
+            count++;
+        }
+    }
+
+    msgpack_pack_array( pk, count );
+    for( p = head; NULL != p; p = p->next ) {
+        size_t i;
+
+        if( p->time < 0 ) {
+            continue;
+        }
+
+        msgpack_pack_map( pk, 2 );
+        __pack_string( pk, time_key );
+        msgpack_pack_int64( pk, (int64_t) p->time );
+
+        __pack_string( pk, INDEXES_STR );
+        msgpack_pack_array( pk, p->block_count );
+        for( i = 0; i < p->block_count; i++ ) {
+            msgpack_pack_uint32( pk, p->block[i] );
+        }
+    }
+}
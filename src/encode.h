@@ -0,0 +1,40 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __ENCODE_H__
+#define __ENCODE_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "schedule.h"
+
+/**
+ *  Encodes a schedule into the msgpack format decode_schedule() accepts, so
+ *  decoding the result gives back the same schedule.
+ *
+ *  @note The copy of last week's final event that finalize_schedule() adds
+ *        is left out, as it was never part of the uploaded schedule.
+ *  @note The returned buffer needs to be aker_free()-ed by the caller.
+ *
+ *  @param s    [in]  the schedule to encode
+ *  @param data [out] the msgpack bytes
+ *
+ *  @return the length of the msgpack bytes, 0 on error
+ */
+size_t encode_schedule( schedule_t *s, uint8_t **data );
+
+#endif
@@ -0,0 +1,201 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "firewall_state.h"
+#include "aker_log.h"
+#include "aker_mem.h"
+#include "persist.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define STATE_HEADER    "aker-fw/1"
+#define BOOT_ID_FILE    "/proc/sys/kernel/random/boot_id"
+#define BOOT_ID_SIZE    40
+#define NO_BOOT_ID      "-"
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static void __get_boot_id( char id[BOOT_ID_SIZE] );
+static char* __field( char *line, const char *name );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See firewall_state.h for details. */
+int firewall_state_save( const char *filename, const char *blocked,
+                         time_t applied )
+{
+    char boot_id[BOOT_ID_SIZE];
+    char *buf;
+    size_t size;
+    int len, rv;
+
+    if( NULL == filename ) {
+        return -1;
+    }
+    if( NULL == blocked ) {
+        blocked = "";
+    }
+
+    __get_boot_id( boot_id );
+
+    size = sizeof(STATE_HEADER) + BOOT_ID_SIZE + strlen(blocked) + 64;
+    buf = (char*) aker_malloc( size );
+    if( NULL == buf ) {
+        debug_error( "firewall_state_save() failed to allocate %zu bytes\n", size );
+        return -1;
+    }
+
+    len = snprintf( buf, size, STATE_HEADER "\nboot_id %s\napplied %lld\nblocked %s\n",
+                    boot_id, (long long) applied, blocked );
+    rv = persist_write_file( filename, buf, (size_t) len );
+    aker_free( buf );
+
+    return rv;
+}
+
+
+/* See firewall_state.h for details. */
+int firewall_state_load( const char *filename, char **blocked,
+                         time_t *applied )
+{
+    char boot_id[BOOT_ID_SIZE];
+    char *lines[4] = { NULL, NULL, NULL, NULL };
+    char *value;
+    size_t n = 0;
+    FILE *fh;
+    int i, rv = 0;
+
+    *blocked = NULL;
+    if( NULL == filename ) {
+        return -1;
+    }
+
+    fh = fopen( filename, "r" );
+    if( NULL == fh ) {
+        return -1;
+    }
+
+    for( i = 0; i < 4; i++ ) {
+        ssize_t len;
+
+        n = 0;
+        len = getline( &lines[i], &n, fh );
+        if( len <= 0 ) {
+            rv = -3;
+            break;
+        }
+        if( '\n' == lines[i][len - 1] ) {
+            lines[i][len - 1] = '\0';
+        }
+    }
+    fclose( fh );
+
+    if( (0 == rv) && (0 != strcmp(lines[0], STATE_HEADER)) ) {
+        rv = -3;
+    }
+
+    if( 0 == rv ) {
+        value = __field( lines[1], "boot_id" );
+        __get_boot_id( boot_id );
+        if( NULL == value ) {
+            rv = -3;
+        } else if( 0 != strcmp(value, boot_id) ) {
+            rv = -2;
+        }
+    }
+
+    if( 0 == rv ) {
+        value = __field( lines[2], "applied" );
+        if( NULL == value ) {
+            rv = -3;
+        } else if( NULL != applied ) {
+            *applied = (time_t) strtoll( value, NULL, 10 );
+        }
+    }
+
+    if( 0 == rv ) {
+        value = __field( lines[3], "blocked" );
+        if( NULL == value ) {
+            rv = -3;
+        } else if( '\0' != *value ) {
+            size_t len = strlen( value );
+
+            *blocked = (char*) aker_malloc( len + 1 );
+            if( NULL == *blocked ) {
+                rv = -3;
+            } else {
+                memcpy( *blocked, value, len + 1 );
+            }
+        }
+    }
+
+    /* getline() allocates with malloc(). */
+    for( i = 0; i < 4; i++ ) {
+        free( lines[i] );
+    }
+
+    return rv;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Reads the kernel's id for this boot, or NO_BOOT_ID where there isn't one.
+ */
+static void __get_boot_id( char id[BOOT_ID_SIZE] )
+{
+    FILE *fh;
+
+    strcpy( id, NO_BOOT_ID );
+    fh = fopen( BOOT_ID_FILE, "r" );
+    if( NULL != fh ) {
+        if( NULL != fgets(id, BOOT_ID_SIZE, fh) ) {
+            id[strcspn(id, "\n")] = '\0';
+        }
+        fclose( fh );
+        if( '\0' == id[0] ) {
+            strcpy( id, NO_BOOT_ID );
+        }
+    }
+}
+
+
+/**
+ *  Returns the value of a "name value" line, NULL if the name doesn't match.
+ */
+static char* __field( char *line, const char *name )
+{
+    size_t len = strlen( name );
+
+    if( (0 == strncmp(line, name, len)) && (' ' == line[len]) ) {
+        return &line[len + 1];
+    }
+
+    return NULL;
+}
@@ -0,0 +1,55 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __FIREWALL_STATE_H__
+#define __FIREWALL_STATE_H__
+
+#include <time.h>
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Records the blocked set that was just handed to the firewall command,
+ *  tagged with the current boot so a reboot (which drops the firewall rules)
+ *  invalidates it.
+ *
+ *  @param filename the state file to write
+ *  @param blocked  the space separated MAC list applied, NULL if none
+ *  @param applied  when it was applied
+ *
+ *  @return 0 on success, error otherwise
+ */
+int firewall_state_save( const char *filename, const char *blocked,
+                         time_t applied );
+
+/**
+ *  Reads back the blocked set the firewall is enforcing right now.
+ *
+ *  @note The returned string needs to be aker_free()-ed by the caller.
+ *
+ *  @param filename the state file to read
+ *  @param blocked  [out] the MAC list, NULL if nothing is blocked
+ *  @param applied  [out] when it was applied, ignored if NULL
+ *
+ *  @return 0 if the state is valid for this boot, -1 if there is no state,
+ *          -2 if it was saved during a different boot, -3 if it is malformed
+ */
+int firewall_state_load( const char *filename, char **blocked,
+                         time_t *applied );
+
+#endif
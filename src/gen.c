@@ -0,0 +1,230 @@
+/**
+ * Copyright 2018 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "schedule_gen.h"
+#include "aker_integrity.h"
+#include "aker_mem.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static void usage( void );
+static int write_output( const char *filename, const void *data, size_t len );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+size_t get_max_mac_limit(void)
+{
+    return 128;
+}
+
+/* Main function */
+int main( int argc, char **argv)
+{
+    const char *option_string = "o:s:i:S:w:a:m:b:v:z:t:p:d0h::";
+    static const struct option options[] = {
+        { "help",      optional_argument, 0, 'h' },
+        { "output",    required_argument, 0, 'o' },
+        { "sig",       required_argument, 0, 's' },
+        { "integrity", required_argument, 0, 'i' },
+        { "seed",      required_argument, 0, 'S' },
+        { "weekly",    required_argument, 0, 'w' },
+        { "absolute",  required_argument, 0, 'a' },
+        { "macs",      required_argument, 0, 'm' },
+        { "blocks",    required_argument, 0, 'b' },
+        { "overlap",   required_argument, 0, 'v' },
+        { "time-zone", required_argument, 0, 'z' },
+        { "start",     required_argument, 0, 't' },
+        { "span",      required_argument, 0, 'p' },
+        { "dst",       no_argument,       0, 'd' },
+        { "time-zero", no_argument,       0, '0' },
+        { 0, 0, 0, 0 }
+    };
+    schedule_gen_cfg_t cfg;
+    const char *output = NULL;
+    const char *sig_file = NULL;
+    uint8_t *data = NULL;
+    size_t len;
+    int i = 0;
+    int item = 0;
+    int rv = 0;
+
+    extern int cimplog_debug_level;
+
+    cimplog_debug_level = -1;
+
+    schedule_gen_defaults( &cfg );
+
+    while( -1 != (item = getopt_long(argc, argv, option_string, options, &i)) ) {
+        switch( item ) {
+            case 'o':
+                output = optarg;
+                break;
+            case 's':
+                sig_file = optarg;
+                break;
+            case 'i':
+                if( 0 != integrity_set_mode(optarg) ) {
+                    fprintf( stderr, "Unknown integrity mode: %s\n", optarg );
+                    return -3;
+                }
+                break;
+            case 'S':
+                cfg.seed = strtoull( optarg, NULL, 0 );
+                break;
+            case 'w':
+                cfg.weekly = strtoul( optarg, NULL, 0 );
+                break;
+            case 'a':
+                cfg.absolute = strtoul( optarg, NULL, 0 );
+                break;
+            case 'm':
+                cfg.macs = strtoul( optarg, NULL, 0 );
+                break;
+            case 'b':
+                cfg.block_max = strtoul( optarg, NULL, 0 );
+                break;
+            case 'v':
+                cfg.overlap = (unsigned) strtoul( optarg, NULL, 0 );
+                break;
+            case 'z':
+                cfg.time_zone = (0 == strcmp(optarg, "none")) ? NULL : optarg;
+                break;
+            case 't':
+                cfg.absolute_start = (time_t) strtoll( optarg, NULL, 0 );
+                break;
+            case 'p':
+                cfg.absolute_span = (time_t) strtoll( optarg, NULL, 0 );
+                break;
+            case 'd':
+                cfg.dst_edges = true;
+                break;
+            case '0':
+                cfg.time_zero = true;
+                break;
+
+            default:
+                usage();
+                return -1;
+        }
+    }
+
+    if( (100 < cfg.overlap) || (cfg.absolute_span <= 0) ) {
+        usage();
+        return -1;
+    }
+
+    len = schedule_gen( &cfg, &data );
+    if( 0 == len ) {
+        fprintf( stderr, "Failed to generate the schedule.\n" );
+        return -2;
+    }
+
+    rv = write_output( output, data, len );
+
+    if( (0 == rv) && (NULL != sig_file) ) {
+        char *sig;
+
+        sig = integrity_compute_sig( data, len );
+        if( NULL != sig ) {
+            rv = write_output( sig_file, sig, strlen(sig) );
+            aker_free( sig );
+        } else {
+            rv = -2;
+        }
+    }
+
+    aker_free( data );
+
+    return rv;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+static void usage( void )
+{
+    fprintf( stderr, "Usage:\naker-gen [-o file] [-s sig_file] [-i md5|crc32c] [-S seed]\n"
+                     "         [-w weekly] [-a absolute] [-m macs] [-b blocks] [-v overlap]\n"
+                     "         [-z time_zone|none] [-t start] [-p span] [-d] [-0]\n\n" );
+    fprintf( stderr, "    Generates a synthetic msgpack schedule for load and scale testing.\n" );
+    fprintf( stderr, "    The same options and seed always give the same bytes.\n\n" );
+    fprintf( stderr, "    -o  output file, stdout if missing\n" );
+    fprintf( stderr, "    -s  also write the signature file aker checks at startup\n" );
+    fprintf( stderr, "    -w  number of weekly events\n" );
+    fprintf( stderr, "    -a  number of absolute events, spread over [start, start + span)\n" );
+    fprintf( stderr, "    -m  number of MACs\n" );
+    fprintf( stderr, "    -b  most MACs blocked by one event\n" );
+    fprintf( stderr, "    -v  percent chance a blocked MAC repeats one from the previous event\n" );
+    fprintf( stderr, "    -d  add events on both sides of every DST change\n" );
+    fprintf( stderr, "    -0  add a weekly event at time 0\n" );
+}
+
+
+/**
+ *  Writes the bytes to a file, or to stdout if filename is NULL or "-".
+ *
+ *  @return 0 on success, error otherwise
+ */
+static int write_output( const char *filename, const void *data, size_t len )
+{
+    FILE *fh = stdout;
+    int rv = 0;
+
+    if( (NULL != filename) && (0 != strcmp(filename, "-")) ) {
+        fh = fopen( filename, "wb" );
+        if( NULL == fh ) {
+            fprintf( stderr, "Unable to open %s\n", filename );
+            return -4;
+        }
+    }
+
+    if( len != fwrite(data, 1, len, fh) ) {
+        fprintf( stderr, "Unable to write %zu bytes\n", len );
+        rv = -4;
+    }
+
+    if( stdout != fh ) {
+        fclose( fh );
+    } else {
+        fflush( fh );
+    }
+
+    return rv;
+}
@@ -0,0 +1,600 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "journal.h"
+#include "aker_log.h"
+#include "aker_mem.h"
+#include "crc32c.h"
+#include "persist.h"
+#include "schedule_patch.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define JOURNAL_MAGIC   0x4c4a4b41  /* "AKJL", also catches a byte order swap */
+#define JOURNAL_VERSION 1
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+
+/* The file is a journal_header_t followed by records, each a
+ * record_header_t and then the msgpack patch bytes. */
+typedef struct journal_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t base_crc;          /* CRC-32C of the base's signature file. */
+    uint32_t reserved;
+} journal_header_t;
+
+typedef struct record_header {
+    uint32_t len;               /* The number of patch bytes that follow. */
+    uint32_t crc;               /* CRC-32C of the patch bytes. */
+} record_header_t;
+
+/* A whole schedule waiting to become the new base. */
+typedef struct compaction {
+    char *data_file;
+    char *md5_file;
+    uint8_t *payload;
+    size_t len;
+    char *sig;
+} compaction_t;
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static pthread_mutex_t journal_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t journal_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t journal_thread_id;
+
+static bool background = false;
+static bool keep_going = false;
+static unsigned compact_ratio = DEFAULT_COMPACT_RATIO;
+
+static bool have_base = false;      /* The base files are known to be good. */
+static uint32_t base_crc = 0;
+static size_t journal_size = 0;     /* 0 while there is no journal file. */
+static size_t record_count = 0;
+static compaction_t *queued = NULL;
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static void *journal_thread( void *args );
+static void __compact( void );
+static int __append( const char *name, const uint8_t *patch, size_t len );
+static void __drop( const char *data_file );
+static compaction_t* __create_compaction( const char *data_file,
+                                          const char *md5_file,
+                                          const uint8_t *payload, size_t len,
+                                          const char *sig );
+static void __destroy_compaction( compaction_t *c );
+static size_t __read_file( const char *name, uint8_t **data );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See journal.h for details. */
+int journal_start( unsigned ratio, pthread_t *thread )
+{
+    int rv;
+
+    pthread_mutex_lock( &journal_lock );
+    compact_ratio = (0 < ratio) ? ratio : DEFAULT_COMPACT_RATIO;
+    keep_going = true;
+    rv = pthread_create( &journal_thread_id, NULL, journal_thread, NULL );
+    if( 0 == rv ) {
+        background = true;
+        if( NULL != thread ) {
+            *thread = journal_thread_id;
+        }
+    } else {
+        keep_going = false;
+    }
+    pthread_mutex_unlock( &journal_lock );
+
+    return rv;
+}
+
+
+/* See journal.h for details. */
+void journal_stop( void )
+{
+    bool running;
+
+    pthread_mutex_lock( &journal_lock );
+    running = background;
+    keep_going = false;
+    pthread_cond_broadcast( &journal_cond );
+    pthread_mutex_unlock( &journal_lock );
+
+    if( running ) {
+        pthread_join( journal_thread_id, NULL );
+
+        pthread_mutex_lock( &journal_lock );
+        background = false;
+        pthread_mutex_unlock( &journal_lock );
+    }
+}
+
+
+/* See journal.h for details. */
+int journal_append( const char *data_file, const char *md5_file,
+                    const uint8_t *patch, size_t patch_len,
+                    const uint8_t *schedule, size_t schedule_len,
+                    const char *sig )
+{
+    char *name;
+    int rv = 0;
+
+    if( (NULL == data_file) || (NULL == md5_file) ||
+        (NULL == patch) || (0 == patch_len) || (UINT32_MAX < patch_len) ||
+        (NULL == schedule) || (0 == schedule_len) || (NULL == sig) )
+    {
+        return -1;
+    }
+
+    name = journal_name( data_file );
+    if( NULL == name ) {
+        return -3;
+    }
+
+    pthread_mutex_lock( &journal_lock );
+    if( !have_base ) {
+        debug_error( "journal_append() no base to journal against\n" );
+        rv = -2;
+    } else if( 0 != __append(name, patch, patch_len) ) {
+        debug_error( "journal_append() failed to write %s\n", name );
+        rv = -3;
+    } else if( (uint64_t) journal_size * 100 > (uint64_t) schedule_len * compact_ratio ) {
+        compaction_t *c;
+
+        /* A newer schedule supersedes one that is still waiting. */
+        c = __create_compaction( data_file, md5_file, schedule, schedule_len, sig );
+        if( NULL != c ) {
+            __destroy_compaction( queued );
+            queued = c;
+            if( background ) {
+                pthread_cond_signal( &journal_cond );
+            } else {
+                __compact();
+            }
+        }
+    }
+    pthread_mutex_unlock( &journal_lock );
+
+    aker_free( name );
+
+    return rv;
+}
+
+
+/* See journal.h for details. */
+int journal_write_base( const char *data_file, const char *md5_file,
+                        const uint8_t *payload, size_t len, const char *sig )
+{
+    int rv;
+
+    pthread_mutex_lock( &journal_lock );
+    __destroy_compaction( queued );
+    queued = NULL;
+
+    rv = persist_schedule( data_file, md5_file, payload, len, sig );
+    if( NULL != data_file ) {
+        __drop( data_file );
+    }
+    have_base = (0 == rv);
+    base_crc = (0 == rv) ? crc32c( sig, strlen(sig) ) : 0;
+    pthread_mutex_unlock( &journal_lock );
+
+    return rv;
+}
+
+
+/* See journal.h for details. */
+int journal_remove_base( const char *data_file, const char *md5_file )
+{
+    int rv;
+
+    pthread_mutex_lock( &journal_lock );
+    __destroy_compaction( queued );
+    queued = NULL;
+
+    rv = persist_remove( data_file, md5_file );
+    if( NULL != data_file ) {
+        __drop( data_file );
+    }
+    have_base = false;
+    pthread_mutex_unlock( &journal_lock );
+
+    return rv;
+}
+
+
+/* See journal.h for details. */
+int journal_replay( const char *data_file, const uint8_t *sig, size_t sig_len,
+                    schedule_t **s )
+{
+    const schedule_patch_t **patches = NULL;
+    const journal_header_t *h;
+    uint8_t *data = NULL;
+    char *name;
+    size_t len, off, count = 0, i;
+    int rv = 0;
+
+    if( (NULL == data_file) || (NULL == s) || (NULL == *s) ) {
+        return -1;
+    }
+
+    name = journal_name( data_file );
+    if( NULL == name ) {
+        return -1;
+    }
+
+    pthread_mutex_lock( &journal_lock );
+    have_base = (NULL != sig);
+    base_crc = (NULL != sig) ? crc32c( sig, sig_len ) : 0;
+    journal_size = 0;
+    record_count = 0;
+
+    len = __read_file( name, &data );
+    if( 0 == len ) {
+        goto done;
+    }
+
+    h = (const journal_header_t*) data;
+    if( (NULL == sig) || (len < sizeof(journal_header_t)) ||
+        (JOURNAL_MAGIC != h->magic) || (JOURNAL_VERSION != h->version) ||
+        (base_crc != h->base_crc) )
+    {
+        debug_info( "journal_replay() %s does not belong to the base\n", name );
+        (void) remove( name );
+        goto done;
+    }
+
+    /* Find where the intact records end. */
+    off = sizeof(journal_header_t);
+    while( sizeof(record_header_t) <= len - off ) {
+        record_header_t r;
+
+        memcpy( &r, &data[off], sizeof(r) );
+        if( (r.len > len - off - sizeof(r)) ||
+            (r.crc != crc32c(&data[off + sizeof(r)], r.len)) )
+        {
+            break;
+        }
+        off += sizeof(r) + r.len;
+        count++;
+    }
+
+    if( off < len ) {
+        /* A power cut during an append; that patch was never acknowledged. */
+        debug_error( "journal_replay() cutting %zu torn bytes off %s\n", len - off, name );
+        if( 0 != truncate(name, (off_t) off) ) {
+            debug_error( "journal_replay() failed to truncate %s\n", name );
+        }
+    }
+    journal_size = off;
+
+    if( 0 == count ) {
+        goto done;
+    }
+
+    patches = (const schedule_patch_t**) aker_malloc( count * sizeof(schedule_patch_t*) );
+    if( NULL == patches ) {
+        rv = -2;
+        goto done;
+    }
+    memset( patches, 0, count * sizeof(schedule_patch_t*) );
+
+    off = sizeof(journal_header_t);
+    for( i = 0; (0 == rv) && (i < count); i++ ) {
+        record_header_t r;
+
+        memcpy( &r, &data[off], sizeof(r) );
+        if( 0 != decode_schedule_patch(r.len, &data[off + sizeof(r)],
+                                       (schedule_patch_t**) &patches[i]) )
+        {
+            rv = -3;
+        }
+        off += sizeof(r) + r.len;
+    }
+
+    if( 0 == rv ) {
+        schedule_t *c = copy_schedule( *s );
+
+        if( NULL == c ) {
+            rv = -2;
+        } else if( 0 != apply_schedule_patches(c, patches, count) ) {
+            destroy_schedule( c );
+            rv = -3;
+        } else {
+            destroy_schedule( *s );
+            *s = c;
+            record_count = count;
+            rv = (int) count;
+        }
+    }
+
+    if( rv < 0 ) {
+        debug_error( "journal_replay() failed to replay %s: %d\n", name, rv );
+        (void) remove( name );
+        journal_size = 0;
+    }
+
+done:
+    pthread_mutex_unlock( &journal_lock );
+
+    if( NULL != patches ) {
+        for( i = 0; i < count; i++ ) {
+            destroy_schedule_patch( (schedule_patch_t*) patches[i] );
+        }
+        aker_free( patches );
+    }
+    if( NULL != data ) {
+        aker_free( data );
+    }
+    aker_free( name );
+
+    return rv;
+}
+
+
+/* See journal.h for details. */
+size_t journal_get_record_count( void )
+{
+    size_t count;
+
+    pthread_mutex_lock( &journal_lock );
+    count = record_count;
+    pthread_mutex_unlock( &journal_lock );
+
+    return count;
+}
+
+
+/* See journal.h for details. */
+char* journal_name( const char *data_file )
+{
+    char *name = NULL;
+
+    if( NULL != data_file ) {
+        size_t len = strlen( data_file );
+
+        name = (char*) aker_malloc( len + sizeof(JOURNAL_SUFFIX) );
+        if( NULL != name ) {
+            memcpy( name, data_file, len );
+            memcpy( &name[len], JOURNAL_SUFFIX, sizeof(JOURNAL_SUFFIX) );
+        }
+    }
+
+    return name;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Compaction thread.  Folds the journal into a new base whenever one is
+ *  queued, until told to stop.
+ */
+static void *journal_thread( void *args )
+{
+    (void) args;
+
+    pthread_mutex_lock( &journal_lock );
+    while( true ) {
+        while( (NULL == queued) && keep_going ) {
+            pthread_cond_wait( &journal_cond, &journal_lock );
+        }
+        if( NULL == queued ) {
+            break;
+        }
+        __compact();
+    }
+    pthread_mutex_unlock( &journal_lock );
+
+    return NULL;
+}
+
+
+/**
+ *  Writes the queued schedule as the new base and drops the journal it
+ *  replaces.  Called with journal_lock held, so no record can be appended
+ *  in between and the queued schedule covers every record.
+ *
+ *  @note With write-behind persistence the base is only queued here, so
+ *        the journal's records are lost if power fails before it lands,
+ *        the same as for any acknowledged write-behind UPDATE.
+ */
+static void __compact( void )
+{
+    compaction_t *c = queued;
+
+    queued = NULL;
+    if( 0 == persist_schedule(c->data_file, c->md5_file, c->payload, c->len, c->sig) ) {
+        debug_info( "journal: %zu records (%zu bytes) folded into a %zu byte base\n",
+                    record_count, journal_size, c->len );
+        __drop( c->data_file );
+        have_base = true;
+        base_crc = crc32c( c->sig, strlen(c->sig) );
+    } else {
+        /* The journal still matches whichever base is on disk. */
+        debug_error( "journal: compaction failed, keeping the journal\n" );
+    }
+    __destroy_compaction( c );
+}
+
+
+/**
+ *  Appends one record, starting the file with a header if there is none,
+ *  and syncs it.  On failure the file is cut back to what it was.
+ *
+ *  @return 0 on success, error otherwise
+ */
+static int __append( const char *name, const uint8_t *patch, size_t len )
+{
+    journal_header_t h;
+    record_header_t r;
+    size_t size = journal_size;
+    FILE *fh;
+    int rv = -1;
+
+    fh = fopen( name, (0 == size) ? "wb" : "ab" );
+    if( NULL == fh ) {
+        return -1;
+    }
+
+    if( 0 == size ) {
+        memset( &h, 0, sizeof(h) );
+        h.magic = JOURNAL_MAGIC;
+        h.version = JOURNAL_VERSION;
+        h.base_crc = base_crc;
+        if( 1 == fwrite(&h, sizeof(h), 1, fh) ) {
+            size += sizeof(h);
+        }
+    }
+
+    r.len = (uint32_t) len;
+    r.crc = crc32c( patch, len );
+    if( (0 < size) &&
+        (1 == fwrite(&r, sizeof(r), 1, fh)) &&
+        (len == fwrite(patch, sizeof(uint8_t), len, fh)) &&
+        (0 == fflush(fh)) && (0 == fsync(fileno(fh))) )
+    {
+        rv = 0;
+    }
+    fclose( fh );
+
+    if( 0 == rv ) {
+        journal_size = size + sizeof(r) + len;
+        record_count++;
+    } else if( 0 == journal_size ) {
+        (void) remove( name );
+    } else {
+        (void) truncate( name, (off_t) journal_size );
+    }
+
+    return rv;
+}
+
+
+/**
+ *  Removes the journal file of a data file.  Called with journal_lock held.
+ */
+static void __drop( const char *data_file )
+{
+    char *name = journal_name( data_file );
+
+    if( NULL != name ) {
+        (void) remove( name );
+        aker_free( name );
+    }
+    journal_size = 0;
+    record_count = 0;
+}
+
+
+static compaction_t* __create_compaction( const char *data_file,
+                                          const char *md5_file,
+                                          const uint8_t *payload, size_t len,
+                                          const char *sig )
+{
+    compaction_t *c;
+
+    c = (compaction_t*) aker_malloc( sizeof(compaction_t) );
+    if( NULL == c ) {
+        return NULL;
+    }
+    memset( c, 0, sizeof(compaction_t) );
+
+    c->data_file = strdup( data_file );
+    c->md5_file = strdup( md5_file );
+    c->sig = strdup( sig );
+    c->payload = (uint8_t*) aker_malloc( len );
+    if( (NULL == c->data_file) || (NULL == c->md5_file) ||
+        (NULL == c->sig) || (NULL == c->payload) )
+    {
+        debug_error( "journal: failed to allocate a compaction\n" );
+        __destroy_compaction( c );
+        return NULL;
+    }
+    memcpy( c->payload, payload, len );
+    c->len = len;
+
+    return c;
+}
+
+
+static void __destroy_compaction( compaction_t *c )
+{
+    if( NULL != c ) {
+        if( NULL != c->payload ) {
+            aker_free( c->payload );
+        }
+        /* The strings come from strdup() so they go back to free(). */
+        free( c->data_file );
+        free( c->md5_file );
+        free( c->sig );
+        aker_free( c );
+    }
+}
+
+
+/**
+ *  Reads a whole file.
+ *
+ *  @return the number of bytes read, 0 if there is no such file or on error
+ */
+static size_t __read_file( const char *name, uint8_t **data )
+{
+    FILE *fh;
+    long size;
+    size_t len = 0;
+
+    fh = fopen( name, "rb" );
+    if( NULL == fh ) {
+        return 0;
+    }
+
+    if( (0 == fseek(fh, 0, SEEK_END)) && (0 < (size = ftell(fh))) &&
+        (0 == fseek(fh, 0, SEEK_SET)) )
+    {
+        *data = (uint8_t*) aker_malloc( (size_t) size );
+        if( NULL != *data ) {
+            len = fread( *data, 1, (size_t) size, fh );
+            if( len != (size_t) size ) {
+                aker_free( *data );
+                *data = NULL;
+                len = 0;
+            }
+        }
+    }
+    fclose( fh );
+
+    return len;
+}
@@ -0,0 +1,141 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __JOURNAL_H__
+#define __JOURNAL_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "schedule.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define JOURNAL_SUFFIX          ".journal"
+#define DEFAULT_COMPACT_RATIO   100
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+
+/*
+ *  The schedule is stored as a base snapshot (the data and signature files
+ *  written by persist_schedule()) plus <data_file>.journal, an append-only
+ *  log of the patches applied since.  The journal names the base it belongs
+ *  to by the CRC-32C of the base's signature file, and each record carries
+ *  the CRC-32C of its patch, so a torn final append is cut off at startup
+ *  and a journal left over from an older base is ignored.
+ *
+ *  Every base write goes through this module so a compaction can never
+ *  overwrite a newer schedule.
+ */
+
+/**
+ *  Starts the compaction thread.  Until this is called a compaction runs in
+ *  the journal_append() call that triggers it.
+ *
+ *  @param ratio  compact once the journal is larger than this percentage of
+ *                the encoded schedule, 0 for DEFAULT_COMPACT_RATIO
+ *  @param thread if not NULL the thread id is returned here, ignored otherwise
+ *
+ *  @return the result of thread creation
+ */
+int journal_start( unsigned ratio, pthread_t *thread );
+
+/**
+ *  Runs any queued compaction and stops the compaction thread.
+ *
+ *  @note The daemon calls this on SIGINT/SIGTERM once the requests are
+ *        answered.  A compaction writes the new base through persist, so
+ *        this goes before persist_stop().
+ */
+void journal_stop( void );
+
+/**
+ *  Appends a patch to the journal and syncs it.  If the journal has grown
+ *  past the ratio, a copy of the whole schedule is queued as the next base.
+ *
+ *  @param data_file    the base data file
+ *  @param md5_file     the base signature file
+ *  @param patch        the msgpack patch, as received
+ *  @param patch_len    the length of the patch
+ *  @param schedule     the whole schedule after the patch, msgpack encoded
+ *  @param schedule_len the length of the encoded schedule
+ *  @param sig          the signature of the encoded schedule
+ *
+ *  @return 0 on success, -1 on invalid arguments, -2 if there is no base to
+ *          journal against, -3 if the record was not written
+ */
+int journal_append( const char *data_file, const char *md5_file,
+                    const uint8_t *patch, size_t patch_len,
+                    const uint8_t *schedule, size_t schedule_len,
+                    const char *sig );
+
+/**
+ *  Replaces the base with a whole schedule (see persist_schedule()) and
+ *  drops the journal.  A queued compaction is cancelled.
+ *
+ *  @return the result of persist_schedule()
+ */
+int journal_write_base( const char *data_file, const char *md5_file,
+                        const uint8_t *payload, size_t len, const char *sig );
+
+/**
+ *  Removes the base (see persist_remove()) and the journal.  A queued
+ *  compaction is cancelled.
+ *
+ *  @return the result of persist_remove()
+ */
+int journal_remove_base( const char *data_file, const char *md5_file );
+
+/**
+ *  Replays the journal of a base at startup.  The records are checked, a
+ *  torn final record is cut off, and the patches are applied to a copy of
+ *  the base in one pass.  A journal that belongs to a different base, or
+ *  that can't be applied, is removed.
+ *
+ *  @param data_file the base data file
+ *  @param sig       the base's signature file contents, NULL if the base
+ *                   is missing or didn't verify
+ *  @param sig_len   the length of the signature file contents
+ *  @param s         [in/out] the base schedule, replaced by the patched one
+ *                   if there were records to replay
+ *
+ *  @return the number of patches replayed, < 0 on error (s is untouched)
+ */
+int journal_replay( const char *data_file, const uint8_t *sig, size_t sig_len,
+                    schedule_t **s );
+
+/**
+ *  Returns the number of journal records not yet folded into the base, i.e.
+ *  non zero if the base files are older than the running schedule.
+ */
+size_t journal_get_record_count( void );
+
+/**
+ *  Makes the journal file name used for a schedule data file.
+ *
+ *  @note The returned string needs to be aker_free()-ed by the caller.
+ *
+ *  @param data_file the msgpack schedule data file
+ *
+ *  @return the journal file name, NULL on failure
+ */
+char* journal_name( const char *data_file );
+
+#endif
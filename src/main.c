@@ -26,17 +26,27 @@
 
 #include "aker_log.h"
 #include "schedule.h"
+#include "schedule_image.h"
+#include "decode.h"
 #include "wrp_interface.h"
 #include "scheduler.h"
 #include "process_data.h"
-#include "aker_md5.h"
+#include "aker_integrity.h"
 #include "aker_mem.h"
 #include "aker_help.h"
+#include "persist.h"
+#include "notify.h"
+#include "journal.h"
+#include "encode.h"
+#include "time.h"
+#include "tenant.h"
+#include "dispatch.h"
 
 /*----------------------------------------------------------------------------*/
 /*                                   Macros                                   */
 /*----------------------------------------------------------------------------*/
 #define LIBPD_CLOSED_MSG_RECEIVED 2
+#define DEFAULT_EVENT_INTERVAL    1
 
 /*----------------------------------------------------------------------------*/
 /*                               Data Structures                              */
@@ -48,6 +58,10 @@
 /*----------------------------------------------------------------------------*/
 size_t max_macs = INT_MAX;
 
+/* Set by SIGINT/SIGTERM: main_loop() returns and what was accepted is
+ * written out before exiting. */
+static volatile sig_atomic_t shutting_down = 0;
+
 
 /*----------------------------------------------------------------------------*/
 /*                            Global Variables                                */
@@ -59,14 +73,17 @@ size_t max_macs = INT_MAX;
 /*----------------------------------------------------------------------------*/
 static void sig_handler(int sig);
 static void import_existing_schedule( const char *data_file, const char *md5_file );
+static void replay_journal( const char *data_file, const uint8_t *sig,
+                            size_t sig_len, schedule_t **s );
 static int main_loop(libpd_cfg_t *cfg, char *data_file, char *md5_file );
+static int send_msg( void *ctx, wrp_msg_t *msg );
 
 /*----------------------------------------------------------------------------*/
 /*                             External Functions                             */
 /*----------------------------------------------------------------------------*/
 int main( int argc, char **argv)
 {
-    const char *option_string = "p:c:w:d:f:m:h::";
+    const char *option_string = "p:c:w:d:f:m:i:s:e:n:r:k:T:j:bh::";
     static const struct option options[] = {
         { "help",         optional_argument, 0, 'h' },
         { "parodus-url",  required_argument, 0, 'p' },
@@ -75,6 +92,15 @@ int main( int argc, char **argv)
         { "data-file",    required_argument, 0, 'd' },
         { "md5-file",     required_argument, 0, 'f' },
         { "max-macs",     required_argument, 0, 'm' },
+        { "write-behind", no_argument,       0, 'b' },
+        { "integrity",    required_argument, 0, 'i' },
+        { "state-file",   required_argument, 0, 's' },
+        { "event-dest",   required_argument, 0, 'e' },
+        { "event-interval", required_argument, 0, 'n' },
+        { "compact-ratio", required_argument, 0, 'r' },
+        { "compact",      required_argument, 0, 'k' },
+        { "tenants",      required_argument, 0, 'T' },
+        { "tenant-workers", required_argument, 0, 'j' },
         { 0, 0, 0, 0 }
     };
 
@@ -88,9 +114,16 @@ int main( int argc, char **argv)
     char *firewall_cmd = NULL;
     char *data_file = NULL;
     char *md5_file = NULL;
+    char *state_file = NULL;
+    char *event_dest = NULL;
+    char *tenants_file = NULL;
+    unsigned tenant_workers = TENANT_DEFAULT_WORKERS;
+    time_t event_interval = DEFAULT_EVENT_INTERVAL;
+    int compact_ratio = DEFAULT_COMPACT_RATIO;
     int item = 0;
     int opt_index = 0;
     int rv = 0;
+    bool write_behind = false;
     pthread_t thread_id;
 
     signal(SIGTERM, sig_handler);
@@ -123,9 +156,46 @@ int main( int argc, char **argv)
             case 'f':
                 md5_file = strdup(optarg);
                 break;
+            case 's':
+                state_file = strdup(optarg);
+                break;
+            case 'e':
+                event_dest = strdup(optarg);
+                break;
+            case 'n':
+                event_interval = atoi(optarg);
+                break;
+            case 'r':
+                compact_ratio = atoi(optarg);
+                break;
+            case 'k':
+                if( 0 == strcmp(optarg, "memory") ) {
+                    process_set_compaction( PROCESS_COMPACT_MEMORY );
+                } else if( 0 == strcmp(optarg, "store") ) {
+                    process_set_compaction( PROCESS_COMPACT_STORE );
+                } else {
+                    printf("%s Unknown compaction %s (memory|store)\n", argv[0], optarg);
+                    rv = -8;
+                }
+                break;
+            case 'T':
+                tenants_file = strdup(optarg);
+                break;
+            case 'j':
+                tenant_workers = (unsigned) atoi(optarg);
+                break;
             case 'm':
                 max_macs = atoi(optarg);
                 break;
+            case 'b':
+                write_behind = true;
+                break;
+            case 'i':
+                if( 0 != integrity_set_mode(optarg) ) {
+                    printf("%s Unknown integrity mode %s (md5|crc32c)\n", argv[0], optarg);
+                    rv = -8;
+                }
+                break;
             case 'h':
                 aker_help(argv[0], optarg);
                 break;
@@ -157,11 +227,46 @@ int main( int argc, char **argv)
         (NULL != data_file) &&
         (NULL != md5_file) )
     {
+        if( write_behind ) {
+            if( 0 != persist_start(NULL) ) {
+                debug_error("%s write-behind thread failed, writing synchronously\n", argv[0]);
+            }
+        }
+
+        if( (compact_ratio <= 0) || (0 != journal_start(compact_ratio, NULL)) ) {
+            debug_error("%s journal compaction runs in the patch request\n", argv[0]);
+        }
+
+        if( NULL != event_dest ) {
+            if( 0 != notify_init(cfg.service_name, event_dest, event_interval) ) {
+                debug_error("%s transition events disabled\n", argv[0]);
+            }
+        }
+
+        scheduler_set_state_file( state_file );
         scheduler_start( &thread_id, firewall_cmd );
 
         import_existing_schedule( data_file, md5_file );
+        process_import_named( data_file, md5_file );
+        scheduler_import_done();
+
+        if( NULL != tenants_file ) {
+            if( (0 <= tenant_load(tenants_file)) &&
+                (0 == tenant_start(firewall_cmd, tenant_workers)) )
+            {
+                process_import_tenants( data_file, md5_file );
+            } else {
+                debug_error("%s multi-tenant mode disabled\n", argv[0]);
+                tenant_stop();
+            }
+        }
         
         main_loop(&cfg, data_file, md5_file);
+        tenant_stop();
+
+        /* A compaction writes through persist, so the journal goes first. */
+        journal_stop();
+        persist_stop();
         rv = 0;
     } else {
         if ((NULL == cfg.parodus_url)) {
@@ -190,6 +295,9 @@ int main( int argc, char **argv)
         debug_error("%s  program terminating\n", argv[0]);
     }
 
+    if( NULL != tenants_file )      aker_free( tenants_file );
+    if( NULL != event_dest )        aker_free( event_dest );
+    if( NULL != state_file )        aker_free( state_file );
     if( NULL != md5_file )          aker_free( md5_file );
     if( NULL != data_file )         aker_free( data_file );
     if( NULL != firewall_cmd )      aker_free( firewall_cmd );
@@ -204,12 +312,13 @@ int main( int argc, char **argv)
 /*----------------------------------------------------------------------------*/
 static void sig_handler(int sig)
 {
-    if( sig == SIGINT ) {
-        debug_info("SIGINT received! Program Terminating!\n");
-        exit(0);
-    } else if ( sig == SIGTERM ) {
-        debug_info("SIGTERM received! Program Terminating!\n");
-        exit(0);
+    if( (sig == SIGINT) || (sig == SIGTERM) ) {
+        /* A second one doesn't wait for the files. */
+        if( shutting_down ) {
+            exit(0);
+        }
+        debug_info("%s received! Program Terminating!\n", (sig == SIGINT) ? "SIGINT" : "SIGTERM");
+        shutting_down = 1;
     } else if( sig == SIGUSR1 ) {
         signal(SIGUSR1, sig_handler); /* reset it to this function */
         debug_info("SIGUSR1 received!\n");
@@ -233,18 +342,96 @@ static void sig_handler(int sig)
 
 static void import_existing_schedule( const char *data_file, const char *md5_file )
 {
-    size_t len;
+    size_t len, sig_len;
     uint8_t *data = NULL;
-
-    if (0 != verify_md5_signatures(data_file, md5_file)) {
-        debug_error("import_existing_schedule() data or md5 corruption\n");
+    uint8_t *sig = NULL;
+    schedule_t *s = NULL;
+    char *image_file;
+
+    image_file = schedule_image_name( data_file );
+    sig_len = read_file_from_disk( md5_file, &sig );
+
+    /* An image compiled from exactly this data skips the msgpack decode. */
+    if( (0 < sig_len) && (0 == schedule_image_load(image_file, sig, sig_len, &s)) ) {
+        debug_info("import_existing_schedule() loaded %s\n", image_file);
+        replay_journal( data_file, sig, sig_len, &s );
+        scheduler_set_schedule( s );
+        goto done;
     }
 
+    /* Read the data once and check that same buffer against the signature. */
     len = read_file_from_disk( data_file, &data );
     if( 0 < len ) {
-        process_schedule_data( len, data );
+        int verified;
+
+        verified = integrity_verify(data, len, sig, sig_len);
+        if (0 != verified) {
+            debug_error("import_existing_schedule() data or signature corruption\n");
+        }
+
+        if( 0 == decode_schedule(len, data, &s) ) {
+            print_schedule( s );
+            /* Only cache what matched its signature, for the next start. */
+            if( (0 == verified) && (NULL != image_file) ) {
+                (void) schedule_image_write( image_file, s, sig, sig_len );
+            }
+            /* A journal is only trusted on top of the base it was made for. */
+            if( 0 == verified ) {
+                replay_journal( data_file, sig, sig_len, &s );
+            } else {
+                replay_journal( data_file, NULL, 0, &s );
+            }
+            scheduler_set_schedule( s );
+        } else {
+            debug_error("import_existing_schedule() failed to decode %s\n", data_file);
+        }
+    }
+
+done:
+    if( NULL != data ) {
+        aker_free( data );
+    }
+    if( NULL != sig ) {
+        aker_free( sig );
+    }
+    if( NULL != image_file ) {
+        aker_free( image_file );
+    }
+}
+
+
+/**
+ *  Applies the patches journaled since the base was written and sets the
+ *  schedule's tag: the base's signature, or after patches the signature of
+ *  the patched schedule, as when the last patch was applied.
+ */
+static void replay_journal( const char *data_file, const uint8_t *sig,
+                            size_t sig_len, schedule_t **s )
+{
+    uint8_t *data = NULL;
+    char *tag = NULL;
+    size_t len;
+
+    if( journal_replay(data_file, sig, sig_len, s) <= 0 ) {
+        if( NULL != sig ) {
+            process_set_schedule_etag( sig, sig_len );
+        }
+        return;
+    }
+
+    if( NULL != (*s)->time_zone ) {
+        (void) set_unix_time_zone( (*s)->time_zone );
+    }
+
+    len = encode_schedule( *s, &data );
+    if( 0 < len ) {
+        tag = integrity_compute_sig( data, len );
         aker_free( data );
     }
+    if( NULL != tag ) {
+        process_set_schedule_etag( (const uint8_t*) tag, strlen(tag) );
+        aker_free( tag );
+    }
 }
 
 
@@ -274,24 +461,33 @@ static int main_loop(libpd_cfg_t *cfg, char *data_file, char *md5_file )
             break;
         }
         libparodus_shutdown(&hpd_instance);
+        if( shutting_down ) {
+            return 0;
+        }
+    }
+
+    /* Does nothing unless transition events were enabled. */
+    (void) notify_start( send_msg, hpd_instance, NULL );
+
+    /* Without the threads, requests are answered in this one. */
+    rv = dispatch_start( data_file, md5_file, send_msg, hpd_instance,
+                         DISPATCH_DEFAULT_READERS, DISPATCH_DEFAULT_QUEUE );
+    if( 0 != rv ) {
+        debug_error("Failed to start the request threads: %d\n", rv);
     }
 
     debug_print("starting the main loop...\n");
-    while( true ) {
+    while( !shutting_down ) {
         rv = libparodus_receive(hpd_instance, &wrp_msg, 2000);
 
         if( 0 == rv ) {
-            wrp_msg_t response;
-
             debug_print("Got something from parodus.\n");
-            memset(&response, 0, sizeof(wrp_msg_t));
-            rv = process_wrp(data_file, md5_file, wrp_msg, &response);
-            if( 0 == rv ) {
-                libparodus_send(hpd_instance, &response);
-            }
-            cleanup_wrp(&response);
+            dispatch_submit( wrp_msg );
+            wrp_msg = NULL;
         } else if( 1 == rv || LIBPD_CLOSED_MSG_RECEIVED == rv ) {
             debug_print("Timed out or message closed.\n");
+            /* Nothing to serve: store what the scheduler pruned, if enough. */
+            dispatch_idle();
             continue;
         } else {
             debug_info("Libparodus failed to receive message: '%s'\n",libparodus_strerror(rv));
@@ -303,12 +499,29 @@ static int main_loop(libpd_cfg_t *cfg, char *data_file, char *md5_file )
         }
     }
 
+    /* Answer what was handed over, then stop using libparodus. */
+    dispatch_stop();
+    notify_stop();
     (void ) libparodus_shutdown(&hpd_instance);
     debug_print("End of parodus_upstream\n");
     return 0;
 }
 
 
+/**
+ *  Sends a message through libparodus.
+ *
+ *  @param ctx the libparodus instance
+ *  @param msg the response or event to send
+ *
+ *  @return the libparodus result
+ */
+static int send_msg( void *ctx, wrp_msg_t *msg )
+{
+    return libparodus_send( (libpd_instance_t) ctx, msg );
+}
+
+
 int32_t get_max_mac_limit(void)
 {
     return max_macs;
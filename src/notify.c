@@ -0,0 +1,344 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "notify.h"
+#include "aker_clock.h"
+#include "aker_log.h"
+#include "aker_mem.h"
+#include "aker_msgpack.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+typedef struct notify_state {
+    uint64_t seq;
+    time_t when;
+    char *blocked;                  /* May be NULL and valid. */
+} notify_state_t;
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static pthread_mutex_t notify_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t notify_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t notify_thread_id;
+
+static bool enabled = false;
+static bool running = false;
+static bool keep_going = false;
+
+static char *event_source = NULL;
+static char *event_dest = NULL;
+static time_t interval = 0;
+static notify_send_fn send_fn = NULL;
+static void *send_ctx = NULL;
+
+static bool has_pending = false;
+static notify_state_t pending;      /* Recorded, not sent yet. */
+
+static uint64_t sequence = 0;
+static uint64_t sent_sequence = 0;
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static void *notify_thread( void *args );
+static void __send( notify_send_fn send, void *ctx, notify_state_t *state );
+static void __clear( void );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See notify.h for details. */
+int notify_init( const char *source, const char *dest, time_t min_interval )
+{
+    char *s, *d;
+
+    if( (NULL == source) || (NULL == dest) || (min_interval < 0) ) {
+        return -1;
+    }
+
+    s = strdup( source );
+    d = strdup( dest );
+    if( (NULL == s) || (NULL == d) ) {
+        debug_error( "notify_init() failed to allocate the event addresses\n" );
+        if( NULL != s ) aker_free( s );
+        if( NULL != d ) aker_free( d );
+        return -1;
+    }
+
+    pthread_mutex_lock( &notify_lock );
+    if( running ) {
+        pthread_mutex_unlock( &notify_lock );
+        aker_free( s );
+        aker_free( d );
+        return -1;
+    }
+    if( NULL != event_source ) aker_free( event_source );
+    if( NULL != event_dest )   aker_free( event_dest );
+    event_source = s;
+    event_dest = d;
+    interval = min_interval;
+    enabled = true;
+    pthread_mutex_unlock( &notify_lock );
+
+    return 0;
+}
+
+
+/* See notify.h for details. */
+int notify_start( notify_send_fn send, void *ctx, pthread_t *thread )
+{
+    int rv = -1;
+
+    pthread_mutex_lock( &notify_lock );
+    if( enabled && !running && (NULL != send) ) {
+        send_fn = send;
+        send_ctx = ctx;
+        keep_going = true;
+        rv = pthread_create( &notify_thread_id, NULL, notify_thread, NULL );
+        if( 0 == rv ) {
+            running = true;
+            if( NULL != thread ) {
+                *thread = notify_thread_id;
+            }
+        } else {
+            keep_going = false;
+        }
+    }
+    pthread_mutex_unlock( &notify_lock );
+
+    return rv;
+}
+
+
+/* See notify.h for details. */
+void notify_stop( void )
+{
+    bool was_running;
+
+    pthread_mutex_lock( &notify_lock );
+    was_running = running;
+    keep_going = false;
+    pthread_cond_broadcast( &notify_cond );
+    pthread_mutex_unlock( &notify_lock );
+
+    if( was_running ) {
+        pthread_join( notify_thread_id, NULL );
+    }
+
+    pthread_mutex_lock( &notify_lock );
+    running = false;
+    enabled = false;
+    __clear();
+    if( NULL != event_source ) aker_free( event_source );
+    if( NULL != event_dest )   aker_free( event_dest );
+    event_source = NULL;
+    event_dest = NULL;
+    pthread_mutex_unlock( &notify_lock );
+}
+
+
+/* See notify.h for details. */
+void notify_transition( const char *blocked, uint64_t seq, time_t when )
+{
+    char *copy = NULL;
+
+    if( NULL != blocked ) {
+        copy = strdup( blocked );
+        if( NULL == copy ) {
+            /* Leaves the gap in the sequence for upstream to notice. */
+            debug_error( "notify_transition() failed to copy the blocked set\n" );
+        }
+    }
+
+    pthread_mutex_lock( &notify_lock );
+    if( enabled ) {
+        sequence = seq;
+        if( (NULL == blocked) || (NULL != copy) ) {
+            __clear();
+            pending.seq = seq;
+            pending.when = when;
+            pending.blocked = copy;
+            copy = NULL;
+            has_pending = true;
+            pthread_cond_broadcast( &notify_cond );
+        }
+    }
+    pthread_mutex_unlock( &notify_lock );
+
+    if( NULL != copy ) {
+        aker_free( copy );
+    }
+}
+
+
+/* See notify.h for details. */
+uint64_t notify_get_sequence( void )
+{
+    uint64_t rv;
+
+    pthread_mutex_lock( &notify_lock );
+    rv = sequence;
+    pthread_mutex_unlock( &notify_lock );
+
+    return rv;
+}
+
+
+/* See notify.h for details. */
+uint64_t notify_get_sent_sequence( void )
+{
+    uint64_t rv;
+
+    pthread_mutex_lock( &notify_lock );
+    rv = sent_sequence;
+    pthread_mutex_unlock( &notify_lock );
+
+    return rv;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Sends the newest recorded state, at most one event per interval.
+ *  Whatever is recorded while waiting replaces the pending state.
+ */
+static void *notify_thread( void *args )
+{
+    bool sent_any = false;
+    time_t last_sent = 0;
+
+    (void) args;
+
+    pthread_mutex_lock( &notify_lock );
+    while( keep_going ) {
+        notify_send_fn send;
+        notify_state_t state;
+        void *ctx;
+
+        if( !has_pending ) {
+            pthread_cond_wait( &notify_cond, &notify_lock );
+            continue;
+        }
+
+        if( sent_any && (aker_clock_now() < last_sent + interval) ) {
+            int rv;
+
+            rv = aker_clock_wait_until( &notify_cond, &notify_lock,
+                                        last_sent + interval );
+            if( (0 != rv) && (ETIMEDOUT != rv) ) {
+                debug_error( "notify_thread() wait error: %d(%s)\n", rv, strerror(rv) );
+            }
+            continue;
+        }
+
+        state = pending;
+        pending.blocked = NULL;
+        has_pending = false;
+        send = send_fn;
+        ctx = send_ctx;
+        pthread_mutex_unlock( &notify_lock );
+
+        __send( send, ctx, &state );
+        if( NULL != state.blocked ) {
+            aker_free( state.blocked );
+        }
+
+        pthread_mutex_lock( &notify_lock );
+        sent_any = true;
+        last_sent = aker_clock_now();
+        sent_sequence = state.seq;
+    }
+    pthread_mutex_unlock( &notify_lock );
+
+    return NULL;
+}
+
+
+/**
+ *  Packs and sends one state as a WRP event.
+ *
+ *  @note A failed send is only logged; the next event carries the whole
+ *        blocked set, so nothing needs to be resent.
+ *
+ *  @param send  the function that sends the event
+ *  @param ctx   passed to send as is
+ *  @param state the state to send
+ */
+static void __send( notify_send_fn send, void *ctx, notify_state_t *state )
+{
+    wrp_msg_t msg;
+    void *payload = NULL;
+    size_t len;
+    int rv;
+
+    len = pack_event_msg( state->blocked, state->seq, state->when, &payload );
+    if( 0 == len ) {
+        debug_error( "notify: failed to pack event %llu\n",
+                     (unsigned long long) state->seq );
+        return;
+    }
+
+    memset( &msg, 0, sizeof(wrp_msg_t) );
+    msg.msg_type = WRP_MSG_TYPE__EVENT;
+    msg.u.event.content_type = "application/msgpack";
+    msg.u.event.source = event_source;
+    msg.u.event.dest = event_dest;
+    msg.u.event.payload = payload;
+    msg.u.event.payload_size = len;
+
+    rv = send( ctx, &msg );
+    if( 0 != rv ) {
+        debug_error( "notify: failed to send event %llu: %d\n",
+                     (unsigned long long) state->seq, rv );
+    } else {
+        debug_info( "notify: sent event %llu\n", (unsigned long long) state->seq );
+    }
+
+    aker_free( payload );
+}
+
+
+/**
+ *  Drops the pending state.
+ *
+ *  @note The lock must be held.
+ */
+static void __clear( void )
+{
+    if( NULL != pending.blocked ) {
+        aker_free( pending.blocked );
+        pending.blocked = NULL;
+    }
+    has_pending = false;
+}
@@ -0,0 +1,102 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __NOTIFY_H__
+#define __NOTIFY_H__
+
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <wrp-c.h>
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Sends one event upstream.
+ *
+ *  @note The message and its contents belong to the caller.
+ *
+ *  @param ctx the context given to notify_start()
+ *  @param msg the event to send
+ *
+ *  @return 0 on success, error otherwise
+ */
+typedef int (*notify_send_fn)( void *ctx, wrp_msg_t *msg );
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Enables transition events.  From here on every notify_transition() is
+ *  recorded, so the state at start up is not lost while upstream is still
+ *  being connected; nothing is sent until notify_start().
+ *
+ *  @param source       the event source
+ *  @param dest         the event destination, e.g. "event:aker/transition"
+ *  @param min_interval the least number of seconds between two events
+ *
+ *  @return 0 on success, error otherwise (also if the thread is running)
+ */
+int notify_init( const char *source, const char *dest, time_t min_interval );
+
+/**
+ *  Starts the thread that sends the events.
+ *
+ *  @param send   the function that sends an event
+ *  @param ctx    passed to send as is
+ *  @param thread if not NULL the thread id is returned here, ignored otherwise
+ *
+ *  @return 0 on success, -1 if notify_init() wasn't called, error from
+ *          thread creation otherwise
+ */
+int notify_start( notify_send_fn send, void *ctx, pthread_t *thread );
+
+/**
+ *  Stops the sending thread and disables the events.  Anything not sent yet
+ *  is dropped.
+ *
+ *  @note The daemon calls this on SIGINT/SIGTERM, after the requests are
+ *        answered and before libparodus is shut down, so no event is sent
+ *        through a closed instance.
+ */
+void notify_stop( void );
+
+/**
+ *  Records that the blocked set changed.  A state that has not been sent yet
+ *  is replaced by the newer one, so upstream sees a gap in the sequence
+ *  numbers when transitions were coalesced.  Does nothing unless
+ *  notify_init() was called.
+ *
+ *  @param blocked the new blocked set (may be NULL and valid)
+ *  @param seq     the transition's sequence number, one more than the last
+ *  @param when    the time the transition took effect
+ */
+void notify_transition( const char *blocked, uint64_t seq, time_t when );
+
+/**
+ *  Returns the sequence number of the newest recorded transition, 0 if none.
+ */
+uint64_t notify_get_sequence( void );
+
+/**
+ *  Returns the sequence number of the newest event that was sent, 0 if none.
+ */
+uint64_t notify_get_sent_sequence( void );
+
+#endif
@@ -0,0 +1,540 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "persist.h"
+#include "aker_log.h"
+#include "aker_mem.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define TEMP_SUFFIX ".tmp"
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+typedef struct persist_request {
+    int op;                         /* PERSIST_OP_WRITE or PERSIST_OP_REMOVE */
+    uint64_t version;               /* The applied version this represents. */
+    char *filename;
+    char *md5_file;
+    uint8_t *payload;
+    size_t len;
+    char *sig;                      /* The signature file contents. */
+    size_t sig_len;
+} persist_request_t;
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static pthread_mutex_t persist_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t persist_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t persist_thread_id;
+
+static bool write_behind = false;
+static bool keep_going = false;
+
+static persist_request_t *pending = NULL;   /* Accepted, not started yet. */
+static persist_request_t *inflight = NULL;  /* Being written right now. */
+
+static uint64_t applied_version = 0;
+static uint64_t persisted_version = 0;
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static void *persist_thread( void *args );
+static int __submit( persist_request_t *r );
+static int __execute( persist_request_t *r, bool durable );
+static int __write_file( const char *filename, const void *data, size_t len,
+                         bool durable );
+static int __sync_dir( const char *filename );
+static persist_request_t* __create_request( int op, const char *filename,
+                                            const char *md5_file );
+static void __destroy_request( persist_request_t *r );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See persist.h for details. */
+int persist_start( pthread_t *thread )
+{
+    int rv;
+
+    pthread_mutex_lock( &persist_lock );
+    keep_going = true;
+    rv = pthread_create( &persist_thread_id, NULL, persist_thread, NULL );
+    if( 0 == rv ) {
+        write_behind = true;
+        if( NULL != thread ) {
+            *thread = persist_thread_id;
+        }
+    } else {
+        keep_going = false;
+    }
+    pthread_mutex_unlock( &persist_lock );
+
+    return rv;
+}
+
+
+/* See persist.h for details. */
+void persist_stop( void )
+{
+    bool running;
+
+    pthread_mutex_lock( &persist_lock );
+    running = write_behind;
+    keep_going = false;
+    pthread_cond_broadcast( &persist_cond );
+    pthread_mutex_unlock( &persist_lock );
+
+    if( running ) {
+        pthread_join( persist_thread_id, NULL );
+
+        pthread_mutex_lock( &persist_lock );
+        write_behind = false;
+        pthread_mutex_unlock( &persist_lock );
+    }
+}
+
+
+/* See persist.h for details. */
+int persist_schedule( const char *filename, const char *md5_file,
+                      const uint8_t *payload, size_t len,
+                      const char *sig )
+{
+    persist_request_t *r;
+
+    if( (NULL == filename) || (NULL == md5_file) ||
+        (NULL == payload) || (0 == len) || (NULL == sig) )
+    {
+        return -1;
+    }
+
+    r = __create_request( PERSIST_OP_WRITE, filename, md5_file );
+    if( NULL == r ) {
+        return -1;
+    }
+
+    r->payload = (uint8_t*) aker_malloc( len );
+    if( NULL == r->payload ) {
+        debug_error( "persist_schedule() failed to allocate the payload copy\n" );
+        __destroy_request( r );
+        return -1;
+    }
+    memcpy( r->payload, payload, len );
+    r->len = len;
+
+    r->sig_len = strlen( sig );
+    r->sig = (char*) aker_malloc( r->sig_len + 1 );
+    if( NULL == r->sig ) {
+        debug_error( "persist_schedule() failed to allocate the signature copy\n" );
+        __destroy_request( r );
+        return -1;
+    }
+    memcpy( r->sig, sig, r->sig_len + 1 );
+
+    return __submit( r );
+}
+
+
+/* See persist.h for details. */
+int persist_remove( const char *filename, const char *md5_file )
+{
+    persist_request_t *r;
+
+    r = __create_request( PERSIST_OP_REMOVE, filename, md5_file );
+    if( NULL == r ) {
+        return -1;
+    }
+
+    return __submit( r );
+}
+
+
+/* See persist.h for details. */
+int persist_write_file( const char *filename, const void *data, size_t len )
+{
+    if( (NULL == filename) || ((NULL == data) && (0 < len)) ) {
+        return -1;
+    }
+
+    return __write_file( filename, data, len, true );
+}
+
+
+/* See persist.h for details. */
+int persist_get_pending_op( void )
+{
+    int op = PERSIST_OP_NONE;
+
+    pthread_mutex_lock( &persist_lock );
+    if( NULL != pending ) {
+        op = pending->op;
+    } else if( NULL != inflight ) {
+        op = inflight->op;
+    }
+    pthread_mutex_unlock( &persist_lock );
+
+    return op;
+}
+
+
+/* See persist.h for details. */
+size_t persist_get_pending_payload( uint8_t **data )
+{
+    persist_request_t *newest;
+    size_t len = 0;
+
+    pthread_mutex_lock( &persist_lock );
+    newest = (NULL != pending) ? pending : inflight;
+    if( (NULL != newest) && (PERSIST_OP_WRITE == newest->op) ) {
+        *data = (uint8_t*) aker_malloc( newest->len );
+        if( NULL != *data ) {
+            memcpy( *data, newest->payload, newest->len );
+            len = newest->len;
+        }
+    }
+    pthread_mutex_unlock( &persist_lock );
+
+    return len;
+}
+
+
+/* See persist.h for details. */
+uint64_t get_applied_version( void )
+{
+    uint64_t v;
+
+    pthread_mutex_lock( &persist_lock );
+    v = applied_version;
+    pthread_mutex_unlock( &persist_lock );
+
+    return v;
+}
+
+
+/* See persist.h for details. */
+uint64_t get_persisted_version( void )
+{
+    uint64_t v;
+
+    pthread_mutex_lock( &persist_lock );
+    v = persisted_version;
+    pthread_mutex_unlock( &persist_lock );
+
+    return v;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Write-behind thread.  Drains the single pending slot until told to stop.
+ */
+static void *persist_thread( void *args )
+{
+    (void) args;
+
+    while( true ) {
+        persist_request_t *r;
+        int rv;
+
+        pthread_mutex_lock( &persist_lock );
+        while( (NULL == pending) && keep_going ) {
+            pthread_cond_wait( &persist_cond, &persist_lock );
+        }
+        if( NULL == pending ) {
+            pthread_mutex_unlock( &persist_lock );
+            break;
+        }
+        inflight = pending;
+        pending = NULL;
+        pthread_mutex_unlock( &persist_lock );
+
+        rv = __execute( inflight, true );
+
+        pthread_mutex_lock( &persist_lock );
+        if( 0 == rv ) {
+            persisted_version = inflight->version;
+        }
+        r = inflight;
+        inflight = NULL;
+        pthread_mutex_unlock( &persist_lock );
+
+        debug_info( "persist_thread() version %llu %s\n",
+                    (unsigned long long) r->version,
+                    (0 == rv) ? "persisted" : "failed" );
+        __destroy_request( r );
+    }
+
+    return NULL;
+}
+
+
+/**
+ *  Assigns the next version to the request and either executes it right
+ *  away or hands it to the write-behind thread, superseding whatever
+ *  request is still waiting there.
+ *
+ *  @param r the request to submit (ownership is taken)
+ *
+ *  @return 0 on success (or when queued), error otherwise
+ */
+static int __submit( persist_request_t *r )
+{
+    persist_request_t *superseded = NULL;
+    int rv = 0;
+
+    pthread_mutex_lock( &persist_lock );
+    r->version = ++applied_version;
+
+    if( write_behind ) {
+        superseded = pending;
+        pending = r;
+        r = NULL;
+        pthread_cond_signal( &persist_cond );
+    }
+    pthread_mutex_unlock( &persist_lock );
+
+    if( NULL != superseded ) {
+        debug_info( "persist: version %llu superseded before being written\n",
+                    (unsigned long long) superseded->version );
+        __destroy_request( superseded );
+    }
+
+    if( NULL != r ) {
+        rv = __execute( r, false );
+        if( 0 == rv ) {
+            pthread_mutex_lock( &persist_lock );
+            if( persisted_version < r->version ) {
+                persisted_version = r->version;
+            }
+            pthread_mutex_unlock( &persist_lock );
+        }
+        __destroy_request( r );
+    }
+
+    return rv;
+}
+
+
+/**
+ *  Performs the request against the filesystem.
+ *
+ *  @param r       the request to perform
+ *  @param durable if true sync each file to storage and replace it atomically
+ *
+ *  @return 0 on success, error otherwise
+ */
+static int __execute( persist_request_t *r, bool durable )
+{
+    int rv = 0;
+
+    if( PERSIST_OP_REMOVE == r->op ) {
+        /* We don't care if these have errors, just try to delete the files. */
+        if( NULL != r->filename ) {
+            (void) remove( r->filename );
+        }
+        if( NULL != r->md5_file ) {
+            (void) remove( r->md5_file );
+        }
+    } else {
+        debug_print( "payload_size = %zu\n", r->len );
+        if( 0 != __write_file(r->filename, r->payload, r->len, durable) ) {
+            debug_error( "Create/Update - failed to write %s\n", r->filename );
+            rv = -1;
+        }
+        if( 0 != __write_file(r->md5_file, r->sig, r->sig_len, durable) ) {
+            debug_error( "Create/Update - failed to write %s\n", r->md5_file );
+            rv = -1;
+        }
+    }
+
+    return rv;
+}
+
+
+/**
+ *  Writes a buffer out to a file.  The data goes to a temporary file that
+ *  is renamed over the original, so a reader opening the file sees either
+ *  the old or the new contents, never a partial write.
+ *
+ *  @param filename the file to write
+ *  @param data     the bytes to write
+ *  @param len      the number of bytes to write
+ *  @param durable  if true the temporary file is synced before the rename
+ *                  and the rename is synced, so a power cut leaves either
+ *                  the old or the new file
+ *
+ *  @return 0 on success, error otherwise
+ */
+static int __write_file( const char *filename, const void *data, size_t len,
+                         bool durable )
+{
+    size_t name_len = strlen( filename );
+    char *tmp;
+    FILE *fh;
+    int rv = -1;
+
+    tmp = (char*) aker_malloc( name_len + sizeof(TEMP_SUFFIX) );
+    if( NULL == tmp ) {
+        return -1;
+    }
+    memcpy( tmp, filename, name_len );
+    memcpy( &tmp[name_len], TEMP_SUFFIX, sizeof(TEMP_SUFFIX) );
+
+    fh = fopen( tmp, "wb" );
+    if( NULL != fh ) {
+        if( len == fwrite(data, sizeof(uint8_t), len, fh) ) {
+            rv = 0;
+        }
+        if( durable && (0 == rv) ) {
+            if( (0 != fflush(fh)) || (0 != fsync(fileno(fh))) ) {
+                rv = -1;
+            }
+        }
+        if( 0 != fclose(fh) ) {
+            rv = -1;
+        }
+    } else {
+        debug_error( "Create/Update - failed on fopen(%s, \"wb\")\n", tmp );
+    }
+
+    if( (0 == rv) && (0 != rename(tmp, filename)) ) {
+        rv = -1;
+    }
+    if( 0 != rv ) {
+        (void) remove( tmp );
+    } else if( durable ) {
+        rv = __sync_dir( filename );
+    }
+    aker_free( tmp );
+
+    return rv;
+}
+
+
+/**
+ *  Syncs the directory a file is in, so a rename into it is on storage.
+ *
+ *  @param filename the file whose directory to sync
+ *
+ *  @return 0 on success, error otherwise
+ */
+static int __sync_dir( const char *filename )
+{
+    const char *slash = strrchr( filename, '/' );
+    char *dir = NULL;
+    int fd;
+    int rv = 0;
+
+    if( NULL == slash ) {
+        fd = open( ".", O_RDONLY );
+    } else {
+        size_t len = (slash == filename) ? 1 : (size_t) (slash - filename);
+
+        dir = (char*) aker_malloc( len + 1 );
+        if( NULL == dir ) {
+            return -1;
+        }
+        memcpy( dir, filename, len );
+        dir[len] = '\0';
+        fd = open( dir, O_RDONLY );
+    }
+
+    if( fd < 0 ) {
+        rv = -1;
+    } else {
+        /* Some file systems can't sync a directory, and don't need to. */
+        if( (0 != fsync(fd)) && (EINVAL != errno) ) {
+            rv = -1;
+        }
+        close( fd );
+    }
+
+    if( 0 != rv ) {
+        debug_error( "Create/Update - failed to sync the directory of %s\n", filename );
+    }
+    if( NULL != dir ) {
+        aker_free( dir );
+    }
+
+    return rv;
+}
+
+
+/**
+ *  Allocates a request and copies the file names into it.
+ */
+static persist_request_t* __create_request( int op, const char *filename,
+                                            const char *md5_file )
+{
+    persist_request_t *r;
+
+    r = (persist_request_t*) aker_malloc( sizeof(persist_request_t) );
+    if( NULL != r ) {
+        memset( r, 0, sizeof(persist_request_t) );
+        r->op = op;
+        if( NULL != filename ) {
+            r->filename = strdup( filename );
+        }
+        if( NULL != md5_file ) {
+            r->md5_file = strdup( md5_file );
+        }
+        if( ((NULL != filename) && (NULL == r->filename)) ||
+            ((NULL != md5_file) && (NULL == r->md5_file)) )
+        {
+            __destroy_request( r );
+            r = NULL;
+        }
+    }
+
+    return r;
+}
+
+
+/**
+ *  Frees a request and everything it owns.
+ */
+static void __destroy_request( persist_request_t *r )
+{
+    if( NULL != r ) {
+        if( NULL != r->payload ) {
+            aker_free( r->payload );
+        }
+        if( NULL != r->sig ) {
+            aker_free( r->sig );
+        }
+        /* The names come from strdup() so they go back to free(). */
+        free( r->filename );
+        free( r->md5_file );
+        aker_free( r );
+    }
+}
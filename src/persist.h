@@ -0,0 +1,128 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __PERSIST_H__
+#define __PERSIST_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define PERSIST_OP_NONE     0
+#define PERSIST_OP_WRITE    1
+#define PERSIST_OP_REMOVE   2
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Starts the write-behind persistence thread.  Until this is called every
+ *  persist_*() request is written to disk synchronously by the caller.
+ *
+ *  @param thread if not NULL the thread id is returned here, ignored otherwise
+ *
+ *  @return the result of thread creation
+ */
+int persist_start( pthread_t *thread );
+
+/**
+ *  Writes out any queued request and stops the write-behind thread.  Later
+ *  requests are written synchronously again.
+ *
+ *  @note The daemon calls this on SIGINT/SIGTERM, after the request threads
+ *        and the journal are stopped, so an acknowledged update is on disk
+ *        before it exits.
+ */
+void persist_stop( void );
+
+/**
+ *  Persists the schedule payload and its signature.
+ *
+ *  In write-behind mode the data is copied and queued; a newer request
+ *  supersedes a queued one that has not been written yet.
+ *
+ *  @param filename the data file to write
+ *  @param md5_file the signature file to write
+ *  @param payload  the schedule msgpack data
+ *  @param len      the length of the payload in bytes
+ *  @param sig      the null terminated signature file contents, as made by
+ *                  integrity_compute_sig()
+ *
+ *  @return 0 on success (or when queued), error otherwise
+ */
+int persist_schedule( const char *filename, const char *md5_file,
+                      const uint8_t *payload, size_t len,
+                      const char *sig );
+
+/**
+ *  Removes the persisted schedule files.
+ *
+ *  @note In write-behind mode the removal is queued like any other request
+ *        so it can't be overtaken by an older write.
+ *
+ *  @param filename the data file to remove
+ *  @param md5_file the md5 file to remove
+ *
+ *  @return 0 on success (or when queued), error otherwise
+ */
+int persist_remove( const char *filename, const char *md5_file );
+
+/**
+ *  Writes a whole file durably: the data goes to a temporary file that is
+ *  synced and then renamed over the original.  Always synchronous.
+ *
+ *  @param filename the file to write
+ *  @param data     the bytes to write
+ *  @param len      the number of bytes to write
+ *
+ *  @return 0 on success, error otherwise
+ */
+int persist_write_file( const char *filename, const void *data, size_t len );
+
+/**
+ *  Returns the operation (PERSIST_OP_*) of the newest request that has been
+ *  accepted but is not on disk yet, or PERSIST_OP_NONE if disk is current.
+ */
+int persist_get_pending_op( void );
+
+/**
+ *  Gets a copy of the newest schedule payload that is not on disk yet.
+ *
+ *  @note The returned buffer needs to be aker_free()-ed by the caller.
+ *
+ *  @param data where to put the copy of the payload
+ *
+ *  @return the size of the payload, 0 if there is nothing pending
+ */
+size_t persist_get_pending_payload( uint8_t **data );
+
+/**
+ *  Returns the version of the newest request accepted for persistence.  The
+ *  version increases by one with every persist_schedule()/persist_remove().
+ */
+uint64_t get_applied_version( void );
+
+/**
+ *  Returns the version of the newest request known to be on disk.  Durability
+ *  has caught up when this matches get_applied_version().
+ */
+uint64_t get_persisted_version( void );
+
+#endif
@@ -20,34 +20,76 @@
 #include <pthread.h>
 #include <errno.h>
 #include <unistd.h>
+#include <ctype.h>
+#include <inttypes.h>
+#include <dirent.h>
 
 #include "aker_log.h"
 #include "process_data.h"
 #include "scheduler.h"
-#include "aker_md5.h"
+#include "aker_integrity.h"
 #include "aker_msgpack.h"
 #include "time.h"
 #include "aker_mem.h"
+#include "persist.h"
+#include "journal.h"
+#include "schedule_image.h"
+#include "schedule_patch.h"
+#include "encode.h"
+#include "decode.h"
+#include "schedule_compact.h"
+#include "tenant.h"
 
 /*----------------------------------------------------------------------------*/
 /*                                   Macros                                   */
 /*----------------------------------------------------------------------------*/
-/* None */
+#define NOW_ETAG_SIZE   48
 
 /*----------------------------------------------------------------------------*/
 /*                                   Variables                                */
 /*----------------------------------------------------------------------------*/
-/* None */
+static pthread_mutex_t etag_lock = PTHREAD_MUTEX_INITIALIZER;
+static char *schedule_etag = NULL;      /* The served schedule's signature. */
+static int compaction = PROCESS_COMPACT_NONE;
 
 /*----------------------------------------------------------------------------*/
 /*                               Data Structures                              */
 /*----------------------------------------------------------------------------*/
-/* None */
+
+/* Schedules kept next to the main one: where they are stored and how they
+ * are put in force. */
+typedef struct stored_kind {
+    const char *infix;
+    const char *what;                   /* For the logs. */
+    int (*set)( const char *name, schedule_t *s );
+} stored_kind_t;
+
+static const stored_kind_t named_kind  = { NAMED_SCHEDULE_INFIX, "Named schedule",
+                                           scheduler_set_named_schedule };
+static const stored_kind_t tenant_kind = { TENANT_SCHEDULE_INFIX, "Tenant",
+                                           tenant_set_schedule };
 
 /*----------------------------------------------------------------------------*/
 /*                             Function Prototypes                            */
 /*----------------------------------------------------------------------------*/
-/* None */
+static int __decode_compacted( void *payload, size_t payload_size,
+                               schedule_t **s, uint8_t **data, size_t *len );
+static char* __stored_file( const stored_kind_t *kind, const char *file,
+                            const char *name );
+static int __stored_create_ok( const stored_kind_t *kind, const char *filename,
+                               const char *name );
+static int __stored_update( const stored_kind_t *kind, const char *filename,
+                            const char *md5, const char *name,
+                            void *payload, size_t payload_size );
+static size_t __stored_retrieve( const stored_kind_t *kind, const char *filename,
+                                 const char *name, uint8_t **data );
+static int __stored_delete( const stored_kind_t *kind, const char *filename,
+                            const char *md5, const char *name );
+static int __stored_import( const stored_kind_t *kind, const char *filename,
+                            const char *md5 );
+static int __import_one( const stored_kind_t *kind, const char *filename,
+                         const char *md5, const char *name );
+static bool __same_etag( const char *etag, const char *base );
 
 /*----------------------------------------------------------------------------*/
 /*                             External Functions                             */
@@ -56,7 +98,17 @@
 /* See process_data.h for details. */
 int process_is_create_ok( const char *filename )
 {
-    if( (NULL != filename) && (0 == access(filename, F_OK)) ) {
+    int op;
+
+    /* A write-behind request that hasn't reached the disk yet is the truth. */
+    op = persist_get_pending_op();
+    if( PERSIST_OP_WRITE == op ) {
+        return -1;
+    }
+
+    if( (PERSIST_OP_REMOVE != op) &&
+        (NULL != filename) && (0 == access(filename, F_OK)) )
+    {
         return -1;
     }
 
@@ -68,58 +120,58 @@ int process_update( const char *filename, const char *md5,
                         void *payload, size_t payload_size )
 {
     int rv;
-    unsigned char result[MD5_SIZE];
-    unsigned char *md5_string = NULL;
+    char *sig = NULL;
+    schedule_t *s = NULL;
+    uint8_t *data = NULL;
+    size_t len = 0;
     time_t process_time;
 
     process_time = get_unix_time();
     rv = 0;
 
-    md5_string = compute_byte_stream_md5(payload, payload_size, result);
-    if( (NULL != md5_string) && (0 < payload_size) ) {
-        if( 0 == process_schedule_data(payload_size, payload) ) {
-            FILE *fh = NULL;
-
-            fh = fopen(filename, "wb");
-            if( fh ) {
-                debug_print("payload_size = %d\n", payload_size);
-                if( payload_size == fwrite(payload, sizeof(uint8_t), payload_size, fh) ) {
-                    rv += 1;
-                } else {
-                    debug_error("Create/Update - failed to write %s\n", md5);
-                }
-                fclose(fh);
-            } else {
-                debug_error("Create/Update - failed on fopen(%s, \"wb\"\n", filename);
-            }
+    if( (PROCESS_COMPACT_NONE != compaction) && (0 < payload_size) ) {
+        if( 0 != __decode_compacted(payload, payload_size, &s,
+                                    ((PROCESS_COMPACT_STORE == compaction) ? &data : NULL),
+                                    &len) )
+        {
+            debug_error("Create/Update - process data failed\n");
+            return -2;
+        }
+        if( NULL != data ) {
+            payload = data;
+            payload_size = len;
+        }
+    }
 
-            fh = fopen(md5, "wb");
-            if (fh) {
-                if( 0 < fwrite(md5_string, sizeof(uint8_t), MD5_SIZE * 2, fh) ) {
-                    rv += 2;
-                } else {
-                    debug_error("Create/Update - failed to write %s\n", md5);
-                }
-                fclose(fh);
+    sig = integrity_compute_sig(payload, payload_size);
+    if( (NULL != sig) && (0 < payload_size) ) {
+        if( (NULL != s) || (0 == process_schedule_data(payload_size, payload)) ) {
+            if( NULL != s ) {
+                scheduler_set_schedule( s );
+                s = NULL;
             }
-
-            /* If we wrote both files successfully, rv is 3 - then it's a success. */
-            if( 3 == rv ) {
-                rv = 0;
-            } else {
+            rv = journal_write_base(filename, md5, payload, payload_size, sig);
+            if( 0 != rv ) {
                 rv = -1;
             }
+            /* Unknown what RETRIEVE serves after a failure, so no tag then. */
+            process_set_schedule_etag( (const uint8_t*) sig,
+                                       ((0 == rv) ? strlen(sig) : 0) );
         } else {
             debug_error("Create/Update - process data failed\n");
             rv = -2;
         }
     } else {
-        debug_error("Create/Update - compute_byte_stream_md5() failed\n");
+        debug_error("Create/Update - integrity_compute_sig() failed\n");
         rv = -3;
     }
 
-    if( NULL != md5_string ) {
-        aker_free(md5_string);
+    destroy_schedule( s );
+    if( NULL != data ) {
+        aker_free( data );
+    }
+    if( NULL != sig ) {
+        aker_free(sig);
     }
 
     process_time = get_unix_time() - process_time;
@@ -130,6 +182,88 @@ int process_update( const char *filename, const char *md5,
 }
 
 
+/* See process_data.h for details. */
+int process_patch( const char *filename, const char *md5,
+                   void *payload, size_t payload_size )
+{
+    schedule_patch_t *patch = NULL;
+    schedule_t *s = NULL;
+    char *etag = NULL;
+    char *sig = NULL;
+    uint8_t *data = NULL;
+    size_t len;
+    int rv;
+
+    /* A patch is made against what RETRIEVE served, which isn't what runs. */
+    if( PROCESS_COMPACT_MEMORY == compaction ) {
+        debug_error("Patch - not supported with in memory compaction\n");
+        return -7;
+    }
+
+    rv = decode_schedule_patch(payload_size, payload, &patch);
+    if( 0 != rv ) {
+        debug_error("Patch - invalid patch: %d\n", rv);
+        return (-3 == rv) ? -5 : -1;
+    }
+
+    /* Copy on write: the scheduler keeps using the current schedule until
+     * the patched copy replaces it. */
+    etag = process_get_schedule_etag();
+    s = scheduler_copy_schedule();
+    if( NULL == s ) {
+        rv = -2;
+        goto done;
+    }
+
+    if( (NULL == etag) || !__same_etag(etag, patch->base) ) {
+        debug_info("Patch - base '%s' is not the current schedule '%s'\n",
+                   patch->base, (NULL != etag) ? etag : "");
+        rv = -3;
+        goto done;
+    }
+
+    rv = apply_schedule_patch(s, patch);
+    if( 0 != rv ) {
+        rv = (-3 == rv) ? -5 : -4;
+        goto done;
+    }
+
+    /* What is stored has to be a whole schedule, as RETRIEVE returns it. */
+    len = encode_schedule(s, &data);
+    if( 0 < len ) {
+        sig = integrity_compute_sig(data, len);
+    }
+    if( NULL == sig ) {
+        debug_error("Patch - failed to encode the patched schedule\n");
+        rv = -5;
+        goto done;
+    }
+
+    if( NULL != s->time_zone ) {
+        (void) set_unix_time_zone(s->time_zone);
+    }
+    scheduler_set_schedule(s);
+    s = NULL;
+
+    /* Only the patch is written; the whole schedule is handed over in case
+     * the journal is due to be folded into a new base. */
+    rv = journal_append(filename, md5, payload, payload_size, data, len, sig);
+    if( 0 != rv ) {
+        rv = -6;
+    }
+    process_set_schedule_etag((const uint8_t*) sig, ((0 == rv) ? strlen(sig) : 0));
+
+done:
+    if( NULL != s )     destroy_schedule(s);
+    if( NULL != data )  aker_free(data);
+    if( NULL != sig )   aker_free(sig);
+    if( NULL != etag )  aker_free(etag);
+    destroy_schedule_patch(patch);
+
+    return rv;
+}
+
+
 /* See process_data.h for details. */
 size_t process_retrieve_now( uint8_t **data )
 {
@@ -150,6 +284,148 @@ size_t process_retrieve_now( uint8_t **data )
 }
 
 
+/* See process_data.h for details. */
+size_t process_retrieve_device( const char *mac, uint8_t **data )
+{
+    time_t current, next_change;
+    bool blocked;
+
+    current = get_unix_time();
+    if( 0 != get_current_device_status(mac, current, &blocked, &next_change) ) {
+        return 0;
+    }
+
+    return pack_device_msg( mac, blocked, next_change, current, (void**) data );
+}
+
+
+/* See process_data.h for details. */
+size_t process_retrieve_schedule( const char *filename, uint8_t **data )
+{
+    size_t len;
+
+    /* Patched since the base was written, so only memory is current. */
+    if( 0 < journal_get_record_count() ) {
+        schedule_t *s = scheduler_copy_schedule();
+
+        len = 0;
+        if( NULL != s ) {
+            len = encode_schedule(s, data);
+            destroy_schedule(s);
+        }
+        return len;
+    }
+
+    /* Serve what was acknowledged, even if it is still on its way to disk. */
+    switch( persist_get_pending_op() ) {
+        case PERSIST_OP_WRITE:
+            len = persist_get_pending_payload(data);
+            if( 0 < len ) {
+                return len;
+            }
+            break;
+        case PERSIST_OP_REMOVE:
+            return 0;
+        default:
+            break;
+    }
+
+    return read_file_from_disk(filename, data);
+}
+
+
+/* See process_data.h for details. */
+void process_set_compaction( int mode )
+{
+    compaction = mode;
+}
+
+
+/* See process_data.h for details. */
+void process_set_schedule_etag( const uint8_t *sig, size_t len )
+{
+    char *etag = NULL;
+
+    /* The signature file ends with a newline in the versioned format. */
+    while( (NULL != sig) && (0 < len) && isspace(sig[len - 1]) ) {
+        len--;
+    }
+
+    /* "aker-sig/1 <algorithm> <hex digest> <payload length>": the tag is the
+     * digest, so it fits in a quoted ETag. */
+    if( (NULL != sig) && (strlen(INTEGRITY_SIG_PREFIX) < len) &&
+        (0 == memcmp(INTEGRITY_SIG_PREFIX, sig, strlen(INTEGRITY_SIG_PREFIX))) )
+    {
+        const uint8_t *end = sig + len;
+        const uint8_t *p = sig;
+        int field;
+
+        /* Skip the version and the algorithm. */
+        for( field = 0; field < 2; field++ ) {
+            while( (p < end) && !isspace(*p) ) {
+                p++;
+            }
+            while( (p < end) && isspace(*p) ) {
+                p++;
+            }
+        }
+        sig = p;
+        while( (p < end) && !isspace(*p) ) {
+            p++;
+        }
+        len = (size_t) (p - sig);
+    }
+
+    if( (NULL != sig) && (0 < len) ) {
+        etag = (char*) aker_malloc( len + 1 );
+        if( NULL != etag ) {
+            memcpy( etag, sig, len );
+            etag[len] = '\0';
+        }
+    }
+
+    pthread_mutex_lock( &etag_lock );
+    if( NULL != schedule_etag ) {
+        aker_free( schedule_etag );
+    }
+    schedule_etag = etag;
+    pthread_mutex_unlock( &etag_lock );
+}
+
+
+/* See process_data.h for details. */
+char* process_get_schedule_etag( void )
+{
+    char *etag = NULL;
+
+    pthread_mutex_lock( &etag_lock );
+    if( NULL != schedule_etag ) {
+        etag = strdup( schedule_etag );
+    }
+    pthread_mutex_unlock( &etag_lock );
+
+    return etag;
+}
+
+
+/* See process_data.h for details. */
+char* process_get_now_etag( void )
+{
+    char buf[NOW_ETAG_SIZE];
+    time_t start_time = 0;
+    uint64_t seq;
+
+    seq = get_current_transition_seq( &start_time );
+    if( 0 == seq ) {
+        return NULL;
+    }
+
+    snprintf( buf, sizeof(buf), "%ld-%" PRIu64, (long) start_time, seq );
+
+    return strdup( buf );
+}
+
+
 /* See process_data.h for details. */
 size_t read_file_from_disk( const char *filename, uint8_t **data )
 {
@@ -200,18 +476,480 @@ int process_delete( const char *filename, const char *md5_file )
 
     rv = process_schedule_data(0, NULL);
 
-    /* We don't care if these have errors, just try to delete the files. */
-    if( NULL != filename ) {
-        (void) remove(filename);
+    /* We don't care if the removal has errors, just try to delete the files. */
+    (void) journal_remove_base(filename, md5_file);
+    process_set_schedule_etag(NULL, 0);
+
+    return rv;
+}
+
+/* See process_data.h for details. */
+int process_persist_pruned( const char *filename, const char *md5_file,
+                            size_t min_pruned )
+{
+    schedule_t *s;
+    uint8_t *sig = NULL;
+    char *image_file = NULL;
+    size_t sig_len;
+    int rv = 0;
+
+    s = scheduler_copy_pruned_schedule( min_pruned );
+    if( NULL == s ) {
+        return 0;
     }
-    if( NULL != md5_file ) {
-        (void) remove(md5_file);
+
+    /* The image the journal's patches are replayed on at startup is left as
+     * it was when they were accepted; a queued write means the signature
+     * file is about to change. */
+    if( (0 < journal_get_record_count()) ||
+        (PERSIST_OP_NONE != persist_get_pending_op()) )
+    {
+        goto done;
     }
 
+    sig_len = read_file_from_disk( md5_file, &sig );
+    if( 0 == sig_len ) {
+        goto done;
+    }
+
+    rv = -1;
+    image_file = schedule_image_name( filename );
+    if( (NULL != image_file) && (0 == finalize_schedule(s)) ) {
+        rv = -2;
+        if( 0 == schedule_image_write(image_file, s, sig, sig_len) ) {
+            rv = 1;
+        }
+    }
+    debug_info("Pruned schedule image stored: %d\n", rv);
+
+done:
+    if( NULL != image_file ) {
+        aker_free( image_file );
+    }
+    if( NULL != sig ) {
+        aker_free( sig );
+    }
+    destroy_schedule( s );
+
     return rv;
 }
 
+/* See process_data.h for details. */
+bool process_is_named_ok( const char *name )
+{
+    size_t i;
+
+    if( (NULL == name) || (0 == strcmp("patch", name)) ) {
+        return false;
+    }
+
+    for( i = 0; '\0' != name[i]; i++ ) {
+        if( (NAMED_SCHEDULE_MAX <= i) ||
+            (!isalnum((unsigned char) name[i]) && ('-' != name[i]) && ('_' != name[i])) )
+        {
+            return false;
+        }
+    }
+
+    return (0 < i);
+}
+
+
+/* See process_data.h for details. */
+char* process_named_file( const char *file, const char *name )
+{
+    return __stored_file( &named_kind, file, name );
+}
+
+
+/* See process_data.h for details. */
+int process_is_named_create_ok( const char *filename, const char *name )
+{
+    return __stored_create_ok( &named_kind, filename, name );
+}
+
+
+/* See process_data.h for details. */
+int process_named_update( const char *filename, const char *md5,
+                          const char *name, void *payload, size_t payload_size )
+{
+    return __stored_update( &named_kind, filename, md5, name, payload, payload_size );
+}
+
+
+/* See process_data.h for details. */
+size_t process_retrieve_named( const char *filename, const char *name,
+                               uint8_t **data )
+{
+    return __stored_retrieve( &named_kind, filename, name, data );
+}
+
+
+/* See process_data.h for details. */
+int process_named_delete( const char *filename, const char *md5,
+                          const char *name )
+{
+    return __stored_delete( &named_kind, filename, md5, name );
+}
+
+
+/* See process_data.h for details. */
+int process_import_named( const char *filename, const char *md5 )
+{
+    return __stored_import( &named_kind, filename, md5 );
+}
+
+
+/* See process_data.h for details. */
+int process_is_tenant_create_ok( const char *filename, const char *id )
+{
+    return __stored_create_ok( &tenant_kind, filename, id );
+}
+
+
+/* See process_data.h for details. */
+int process_tenant_update( const char *filename, const char *md5,
+                           const char *id, void *payload, size_t payload_size )
+{
+    return __stored_update( &tenant_kind, filename, md5, id, payload, payload_size );
+}
+
+
+/* See process_data.h for details. */
+size_t process_retrieve_tenant( const char *filename, const char *id,
+                                uint8_t **data )
+{
+    return __stored_retrieve( &tenant_kind, filename, id, data );
+}
+
+
+/* See process_data.h for details. */
+int process_tenant_delete( const char *filename, const char *md5,
+                           const char *id )
+{
+    return __stored_delete( &tenant_kind, filename, md5, id );
+}
+
+
+/* See process_data.h for details. */
+int process_import_tenants( const char *filename, const char *md5 )
+{
+    return __stored_import( &tenant_kind, filename, md5 );
+}
+
 /*----------------------------------------------------------------------------*/
 /*                             Internal functions                             */
 /*----------------------------------------------------------------------------*/
-/* None */
+
+/**
+ *  Decodes and compacts an uploaded schedule.
+ *
+ *  @param payload      the uploaded msgpack schedule
+ *  @param payload_size the length of the upload
+ *  @param s            [out] the compacted schedule
+ *  @param data         [out] the compacted schedule encoded again, NULL if
+ *                      it isn't needed
+ *  @param len          [out] the length of data
+ *
+ *  @return 0 on success, error otherwise
+ */
+static int __decode_compacted( void *payload, size_t payload_size,
+                               schedule_t **s, uint8_t **data, size_t *len )
+{
+    schedule_counts_t before, after;
+    schedule_t *tmp = NULL;
+
+    if( 0 != decode_schedule(payload_size, payload, &tmp) ) {
+        destroy_schedule( tmp );
+        return -1;
+    }
+
+    if( 0 != compact_schedule(tmp, get_unix_time(), &before, &after) ) {
+        destroy_schedule( tmp );
+        return -2;
+    }
+    debug_info("Compacted schedule: weekly %zu -> %zu, absolute %zu -> %zu, "
+               "macs %zu -> %zu, blocks %zu -> %zu\n",
+               before.weekly, after.weekly, before.absolute, after.absolute,
+               before.macs, after.macs, before.blocks, after.blocks);
+
+    if( NULL != data ) {
+        *len = encode_schedule( tmp, data );
+        if( 0 == *len ) {
+            destroy_schedule( tmp );
+            return -3;
+        }
+    }
+
+    *s = tmp;
+    return 0;
+}
+
+
+
+/**
+ *  Makes the name of the file a schedule other than the main one is stored
+ *  in: <file><infix><name>.
+ *
+ *  @return the file name, NULL if the name is not valid or on memory errors
+ */
+static char* __stored_file( const stored_kind_t *kind, const char *file,
+                            const char *name )
+{
+    char *stored;
+    size_t len;
+
+    if( (NULL == file) || !process_is_named_ok(name) ) {
+        return NULL;
+    }
+
+    len = strlen(file) + strlen(kind->infix) + strlen(name) + 1;
+    stored = (char*) aker_malloc( len );
+    if( NULL != stored ) {
+        snprintf( stored, len, "%s%s%s", file, kind->infix, name );
+    }
+
+    return stored;
+}
+
+
+/**
+ *  See process_is_named_create_ok().
+ */
+static int __stored_create_ok( const stored_kind_t *kind, const char *filename,
+                               const char *name )
+{
+    char *data_file;
+    int rv = 0;
+
+    data_file = __stored_file( kind, filename, name );
+    if( NULL == data_file ) {
+        return -2;
+    }
+    if( 0 == access(data_file, F_OK) ) {
+        rv = -1;
+    }
+    aker_free( data_file );
+
+    return rv;
+}
+
+
+/**
+ *  See process_named_update().
+ */
+static int __stored_update( const stored_kind_t *kind, const char *filename,
+                            const char *md5, const char *name,
+                            void *payload, size_t payload_size )
+{
+    char *data_file, *sig_file, *sig = NULL;
+    schedule_t *s = NULL;
+    int rv = 0;
+
+    data_file = __stored_file( kind, filename, name );
+    sig_file = __stored_file( kind, md5, name );
+    if( (NULL == data_file) || (NULL == sig_file) ) {
+        rv = -1;
+        goto done;
+    }
+
+    /* The process time zone stays the main schedule's. */
+    if( (0 == payload_size) || (0 != decode_schedule_data(payload_size, payload, &s)) ) {
+        debug_error("%s %s - process data failed\n", kind->what, name);
+        rv = -2;
+        goto done;
+    }
+
+    sig = integrity_compute_sig( payload, payload_size );
+    if( NULL == sig ) {
+        rv = -3;
+        goto done;
+    }
+
+    rv = kind->set( name, s );
+    s = NULL;
+    if( 0 != rv ) {
+        rv = -3;
+        goto done;
+    }
+
+    /* Written directly: the write-behind queue only holds the main one. */
+    if( (0 != persist_write_file(data_file, payload, payload_size)) ||
+        (0 != persist_write_file(sig_file, sig, strlen(sig))) )
+    {
+        debug_error("%s %s - failed to store\n", kind->what, name);
+        rv = -4;
+    }
+
+done:
+    destroy_schedule( s );
+    if( NULL != sig )       aker_free( sig );
+    if( NULL != sig_file )  aker_free( sig_file );
+    if( NULL != data_file ) aker_free( data_file );
+
+    return rv;
+}
+
+
+/**
+ *  See process_retrieve_named().
+ */
+static size_t __stored_retrieve( const stored_kind_t *kind, const char *filename,
+                                 const char *name, uint8_t **data )
+{
+    char *data_file;
+    size_t len = 0;
+
+    data_file = __stored_file( kind, filename, name );
+    if( NULL != data_file ) {
+        if( 0 == access(data_file, F_OK) ) {
+            len = read_file_from_disk( data_file, data );
+        }
+        aker_free( data_file );
+    }
+
+    return len;
+}
+
+
+/**
+ *  See process_named_delete().
+ */
+static int __stored_delete( const stored_kind_t *kind, const char *filename,
+                            const char *md5, const char *name )
+{
+    char *data_file, *sig_file;
+    int rv = -1;
+
+    data_file = __stored_file( kind, filename, name );
+    sig_file = __stored_file( kind, md5, name );
+    if( (NULL != data_file) && (NULL != sig_file) ) {
+        rv = (0 == access(data_file, F_OK)) ? 0 : -2;
+
+        (void) kind->set( name, NULL );
+        (void) remove( data_file );
+        (void) remove( sig_file );
+    }
+
+    if( NULL != sig_file )  aker_free( sig_file );
+    if( NULL != data_file ) aker_free( data_file );
+
+    return rv;
+}
+
+
+/**
+ *  See process_import_named().
+ */
+static int __stored_import( const stored_kind_t *kind, const char *filename,
+                            const char *md5 )
+{
+    char *dir, *prefix;
+    const char *base;
+    size_t prefix_len;
+    struct dirent *e;
+    DIR *d;
+    int count = 0;
+
+    if( (NULL == filename) || (NULL == md5) ) {
+        return 0;
+    }
+
+    dir = strdup( filename );
+    if( NULL == dir ) {
+        return 0;
+    }
+    base = strrchr( filename, '/' );
+    if( NULL == base ) {
+        strcpy( dir, "." );
+        base = filename;
+    } else {
+        dir[(base == filename) ? 1 : (size_t) (base - filename)] = '\0';
+        base++;
+    }
+
+    prefix_len = strlen(base) + strlen(kind->infix);
+    prefix = (char*) aker_malloc( prefix_len + 1 );
+    d = opendir( dir );
+    if( (NULL != prefix) && (NULL != d) ) {
+        snprintf( prefix, prefix_len + 1, "%s%s", base, kind->infix );
+
+        while( NULL != (e = readdir(d)) ) {
+            /* Temporary files and the like are not valid names. */
+            if( (0 == strncmp(e->d_name, prefix, prefix_len)) &&
+                process_is_named_ok(&e->d_name[prefix_len]) &&
+                (0 == __import_one(kind, filename, md5, &e->d_name[prefix_len])) )
+            {
+                count++;
+            }
+        }
+    }
+
+    if( NULL != d )      closedir( d );
+    if( NULL != prefix ) aker_free( prefix );
+    aker_free( dir );
+
+    debug_info("%s - imported %d schedules\n", kind->what, count);
+
+    return count;
+}
+
+
+/**
+ *  Loads one stored schedule, if it matches its signature.
+ *
+ *  @return 0 on success, error otherwise
+ */
+static int __import_one( const stored_kind_t *kind, const char *filename,
+                         const char *md5, const char *name )
+{
+    char *data_file, *sig_file;
+    uint8_t *data = NULL, *sig = NULL;
+    size_t len = 0, sig_len = 0;
+    schedule_t *s = NULL;
+    int rv = -1;
+
+    data_file = __stored_file( kind, filename, name );
+    sig_file = __stored_file( kind, md5, name );
+    if( (NULL != data_file) && (NULL != sig_file) ) {
+        len = read_file_from_disk( data_file, &data );
+        sig_len = read_file_from_disk( sig_file, &sig );
+    }
+
+    if( (0 < len) && (0 == integrity_verify(data, len, sig, sig_len)) &&
+        (0 == decode_schedule_data(len, data, &s)) )
+    {
+        rv = kind->set( name, s );
+    } else {
+        debug_error("%s %s - data or signature corruption\n", kind->what, name);
+        destroy_schedule( s );
+    }
+
+    if( NULL != data )      aker_free( data );
+    if( NULL != sig )       aker_free( sig );
+    if( NULL != sig_file )  aker_free( sig_file );
+    if( NULL != data_file ) aker_free( data_file );
+
+    return rv;
+}
+
+
+/**
+ *  Compares a patch's base with the current tag.  The base may be quoted,
+ *  as the ETag header is.
+ *
+ *  @param etag the current tag
+ *  @param base the patch's base
+ *
+ *  @return true if the patch was made against the current schedule
+ */
+static bool __same_etag( const char *etag, const char *base )
+{
+    size_t len = strlen( base );
+
+    if( (2 <= len) && ('"' == base[0]) && ('"' == base[len - 1]) ) {
+        return (len - 2 == strlen(etag)) && (0 == strncmp(etag, &base[1], len - 2));
+    }
+
+    return (0 == strcmp(etag, base));
+}
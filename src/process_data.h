@@ -21,13 +21,20 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 
 /*----------------------------------------------------------------------------*/
 /*                                   Macros                                   */
 /*----------------------------------------------------------------------------*/
-/* None */
+#define PROCESS_COMPACT_NONE    0   /* Use uploads as they are. */
+#define PROCESS_COMPACT_MEMORY  1   /* Compact the running schedule. */
+#define PROCESS_COMPACT_STORE   2   /* Also store the compacted schedule. */
+#define PRUNED_PERSIST_MIN      16  /* Expired events worth a rewrite. */
+#define NAMED_SCHEDULE_INFIX    ".named."
+#define NAMED_SCHEDULE_MAX      32  /* The longest schedule name. */
+#define TENANT_SCHEDULE_INFIX   ".tenant."
 
 /*----------------------------------------------------------------------------*/
 /*                               Data Structures                              */
@@ -51,7 +58,7 @@ int process_is_create_ok( const char *filename );
  * @brief Processes wrp CRUD message for Update.
  *
  * @param filename     to write data payload into
- * @param md5_file     to write the MD5 checksum into
+ * @param md5_file     to write the integrity signature into
  * @param payload      the data to consume
  * @param payload_size the length of the data in bytes
  *
@@ -60,6 +67,24 @@ int process_is_create_ok( const char *filename );
 int process_update( const char *filename, const char *md5_file,
                     void *payload, size_t payload_size );
 
+/**
+ * @brief Processes wrp CRUD message for a schedule patch: the operations
+ *        are applied to a copy of the current schedule, which then replaces
+ *        it, and the patch is appended to the journal, see journal.h.
+ * @param filename     the base data file the journal belongs to
+ * @param md5_file     the base signature file
+ * @param payload      the msgpack patch, see schedule_patch.h
+ * @param payload_size the length of the patch in bytes
+ * @return 0 if successful, -1 if the patch is malformed, -2 if there is no
+ *         schedule, -3 if the patch's base is not the current schedule's
+ *         tag, -4 if an operation does not fit the schedule, -5 on memory
+ *         errors, -6 if the patched schedule is in use but was not stored,
+ *         -7 if uploads are only compacted in memory (see
+ *         process_set_compaction())
+ */
+int process_patch( const char *filename, const char *md5_file,
+                   void *payload, size_t payload_size );
+
 /**
  * @brief Returns list of the currently blocked MAC IDs through the wrp CRUD message.
  * 
@@ -71,6 +96,67 @@ int process_update( const char *filename, const char *md5_file,
  */
 size_t process_retrieve_now( uint8_t **data );
 
+/**
+ * @brief Returns one device's blocked state through the wrp CRUD message.
+ *
+ * @note return data buffer needs to be free()-ed by caller.
+ *
+ * @param mac  the device's MAC address
+ * @param data where to put the msgpack payload
+ *
+ * @return size of data retrieved, 0 if there is no schedule or the device
+ *         is not in it
+ */
+size_t process_retrieve_device( const char *mac, uint8_t **data );
+
+/**
+ * @brief Returns the current schedule payload for a CRUD retrieve.
+ *
+ * @note Serves a payload that is still queued for write-behind persistence
+ *       before falling back to the data file.  The returned buffer needs to
+ *       be free()-ed by the caller.
+ *
+ * @param filename the data file to read
+ * @param data     pointer to be allocated
+ *
+ * @return size of the payload, 0 if there is no schedule
+ */
+size_t process_retrieve_schedule( const char *filename, uint8_t **data );
+
+/**
+ * @brief Sets what process_update() does with compact_schedule().  When the
+ *        compacted schedule is stored, it is also what RETRIEVE serves and
+ *        what the ETag is computed over.  When it is only run, RETRIEVE
+ *        serves the upload, whose MAC indexes the running schedule doesn't
+ *        share, so process_patch() refuses patches.
+ * @param mode one of PROCESS_COMPACT_*
+ */
+void process_set_compaction( int mode );
+
+/**
+ * @brief Sets the tag of the schedule RETRIEVE serves: the hex digest of
+ *        its signature file, in either format.
+ * @param sig the signature file contents, NULL if there is no schedule or
+ *            the tag is unknown
+ * @param len the length of the signature file contents
+ */
+void process_set_schedule_etag( const uint8_t *sig, size_t len );
+
+/**
+ * @brief Returns the tag of the schedule RETRIEVE serves.
+ * @note The returned string needs to be free()-ed by the caller.
+ * @return the tag, NULL if it is not known
+ */
+char* process_get_schedule_etag( void );
+
+/**
+ * @brief Returns the tag of the blocked set the "now" RETRIEVE serves: the
+ *        scheduler's start time and transition sequence number.
+ * @note The returned string needs to be free()-ed by the caller.
+ * @return the tag, NULL before the scheduler's first pass
+ */
+char* process_get_now_etag( void );
+
 /**
  * @brief reads the file.
  * 
@@ -93,6 +179,143 @@ size_t read_file_from_disk( const char *filename, uint8_t **data );
  */
 int process_delete( const char *filename, const char *md5_file );
 
+/**
+ * @brief Stores the running schedule as the compiled image of the stored
+ *        one (see schedule_image.h) once the scheduler has dropped at least
+ *        min_pruned expired absolute events from it (see
+ *        scheduler_copy_pruned_schedule()), so a restart loads it without
+ *        them.  The stored schedule, its signature and so the ETag stay as
+ *        uploaded.  Nothing is stored while the journal has patches or a
+ *        write is queued.
+ *
+ * @note Meant to be called when no request is being served, from the
+ *       thread that serves them.
+ *
+ * @param filename   the data file
+ * @param md5_file   the signature file
+ * @param min_pruned the number of dropped events that makes a rewrite worth it
+ *
+ * @return 1 if the schedule was stored, 0 if there was nothing to store,
+ *         < 0 on error
+ */
+int process_persist_pruned( const char *filename, const char *md5_file,
+                            size_t min_pruned );
+
+/**
+ * @brief Makes the name of a file a named schedule is stored in:
+ *        <file>.named.<name>, for both the data and the signature file.
+ * @note The returned string needs to be aker_free()-ed by the caller.
+ * @param file the main schedule's data or signature file
+ * @param name the schedule name, see process_is_named_ok()
+ * @return the file name, NULL if the name is not valid or on memory errors
+ */
+char* process_named_file( const char *file, const char *name );
+
+/**
+ * @brief Checks a schedule name: 1 to NAMED_SCHEDULE_MAX letters, digits,
+ *        '-' or '_', and not "patch".
+ * @param name the schedule name
+ * @return true if the name is valid
+ */
+bool process_is_named_ok( const char *name );
+
+/**
+ * @brief Returns if it is ok to create a named schedule.
+ * @param filename the main schedule's data file
+ * @param name     the schedule name
+ * @return 0 if ok, -1 if it exists, -2 if the name is not valid
+ */
+int process_is_named_create_ok( const char *filename, const char *name );
+
+/**
+ * @brief Processes wrp CRUD message for Create/Update of a named schedule.
+ *        It is decoded, stored and put in force next to the main schedule
+ *        on its own; the others are not touched.
+ * @param filename     the main schedule's data file
+ * @param md5_file     the main schedule's signature file
+ * @param name         the schedule name
+ * @param payload      the msgpack schedule
+ * @param payload_size the length of the schedule in bytes
+ * @return 0 if successful, -1 if the name is not valid, -2 if the schedule
+ *         does not decode, -3 if the signature failed or the schedule
+ *         could not be put in force, -4 if the schedule is in use but was
+ *         not stored
+ */
+int process_named_update( const char *filename, const char *md5_file,
+                          const char *name, void *payload, size_t payload_size );
+
+/**
+ * @brief Returns a named schedule's payload for a CRUD retrieve.
+ * @note The returned buffer needs to be free()-ed by the caller.
+ * @param filename the main schedule's data file
+ * @param name     the schedule name
+ * @param data     pointer to be allocated
+ * @return size of the payload, 0 if there is no such schedule
+ */
+size_t process_retrieve_named( const char *filename, const char *name,
+                               uint8_t **data );
+
+/**
+ * @brief Takes a named schedule out of force and deletes its files.
+ * @param filename the main schedule's data file
+ * @param md5_file the main schedule's signature file
+ * @param name     the schedule name
+ * @return 0 if successful, -1 if the name is not valid, -2 if there is no
+ *         such schedule
+ */
+int process_named_delete( const char *filename, const char *md5_file,
+                          const char *name );
+
+/**
+ * @brief Loads the stored named schedules at startup.  Ones whose data does
+ *        not match the signature are left out.
+ * @param filename the main schedule's data file
+ * @param md5_file the main schedule's signature file
+ * @return the number of schedules loaded
+ */
+int process_import_named( const char *filename, const char *md5_file );
+
+/*
+ *  Tenant schedules (see tenant.h) are kept the same way as named schedules,
+ *  in <data_file>.tenant.<id> and <md5_file>.tenant.<id>, and the tenant ID
+ *  follows the same rules as a schedule name.  They are only put in force
+ *  for tenants in the tenants file.
+ */
+
+/**
+ * @brief Returns if it is ok to create a tenant's schedule.
+ * @return see process_is_named_create_ok()
+ */
+int process_is_tenant_create_ok( const char *filename, const char *id );
+
+/**
+ * @brief Processes wrp CRUD message for Create/Update of a tenant's schedule.
+ * @return see process_named_update(), -3 also for an unknown tenant
+ */
+int process_tenant_update( const char *filename, const char *md5_file,
+                           const char *id, void *payload, size_t payload_size );
+
+/**
+ * @brief Returns a tenant's schedule payload for a CRUD retrieve.
+ * @note The returned buffer needs to be free()-ed by the caller.
+ * @return see process_retrieve_named()
+ */
+size_t process_retrieve_tenant( const char *filename, const char *id,
+                                uint8_t **data );
+
+/**
+ * @brief Takes a tenant's schedule out of force and deletes its files.
+ * @return see process_named_delete()
+ */
+int process_tenant_delete( const char *filename, const char *md5_file,
+                           const char *id );
+
+/**
+ * @brief Loads the stored tenant schedules at startup.
+ * @return the number of schedules loaded
+ */
+int process_import_tenants( const char *filename, const char *md5_file );
+
 #ifdef __cplusplus
 }
 #endif
@@ -16,6 +16,7 @@
  */
 #include <stdbool.h>
 #include <string.h>
+#include <strings.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -50,6 +51,24 @@
 /*----------------------------------------------------------------------------*/
 char* __convert_event_to_string( schedule_t *s, schedule_event_t *e );
 int __validate_mac( const char *mac, size_t len );
+static bool __weekly_in_step( time_t from, time_t from_weekly, time_t t );
+static time_t __stop_at_jump( time_t from, time_t from_weekly, time_t next );
+static void __free_index( schedule_index_t *x );
+static int __grow_array( event_array_t *a );
+static void __move_gap( event_array_t *a, size_t pos );
+static int __index_events( schedule_t *s, schedule_event_t *head,
+                           schedule_event_t ***events, size_t *count,
+                           size_t **start, uint32_t **by_mac );
+static uint32_t __hash_mac( const char *mac );
+static size_t __upper_bound( schedule_event_t **e, size_t first, size_t count,
+                             time_t t );
+static schedule_event_t* __lookup( schedule_t *s, time_t unixtime,
+                                   bool *absolute, size_t *pos );
+static size_t __lower_bound( const uint32_t *list, size_t count, size_t pos );
+static bool __in_list( const uint32_t *list, size_t count, size_t pos );
+static bool __device_blocked( schedule_t *s, uint32_t mac, time_t unixtime );
+static time_t __next_candidate( schedule_t *s, uint32_t mac, time_t unixtime );
+static time_t __next_weekly( time_t unixtime, time_t weekly, time_t position );
 
 
 
@@ -131,8 +150,10 @@ void insert_event(schedule_event_t **head, schedule_event_t *e )
         cur = cur->next;
     }
 
+    /* An event at the same time as the head goes in front of it, like it
+     * does anywhere else in the list. */
     e->next = cur;
-    if( (NULL == prev) || (e->time < prev->time) ) {
+    if( (NULL == prev) || (prev == cur) ) {
         *head = e;
     } else {
         prev->next = e;
@@ -140,6 +161,165 @@ void insert_event(schedule_event_t **head, schedule_event_t *e )
 }
 
 
+/* See schedule.h for details. */
+int event_array_init( event_array_t *a, schedule_event_t **head, size_t reserve )
+{
+    schedule_event_t *p;
+    size_t count = 0;
+
+    if( (NULL == a) || (NULL == head) ) {
+        return -1;
+    }
+
+    for( p = *head; NULL != p; p = p->next ) {
+        count++;
+    }
+
+    memset( a, 0, sizeof(event_array_t) );
+    a->head = head;
+    a->capacity = count + reserve;
+    if( 0 < a->capacity ) {
+        a->slot = (schedule_event_t**) aker_malloc( a->capacity * sizeof(schedule_event_t*) );
+        if( NULL == a->slot ) {
+            return -1;
+        }
+    }
+
+    /* The gap starts at the end, where sorted input is added. */
+    for( p = *head; NULL != p; p = p->next ) {
+        a->slot[a->gap++] = p;
+    }
+    a->gap_size = reserve;
+
+    return 0;
+}
+
+
+/* See schedule.h for details. */
+void event_array_destroy( event_array_t *a )
+{
+    if( NULL != a ) {
+        if( NULL != a->slot ) {
+            aker_free( a->slot );
+        }
+        memset( a, 0, sizeof(event_array_t) );
+    }
+}
+
+
+/* See schedule.h for details. */
+size_t event_array_count( const event_array_t *a )
+{
+    return a->capacity - a->gap_size;
+}
+
+
+/* See schedule.h for details. */
+schedule_event_t* event_array_get( const event_array_t *a, size_t i )
+{
+    if( event_array_count(a) <= i ) {
+        return NULL;
+    }
+
+    return a->slot[(i < a->gap) ? i : (i + a->gap_size)];
+}
+
+
+/* See schedule.h for details. */
+size_t event_array_lower_bound( const event_array_t *a, time_t t )
+{
+    size_t lo = 0, hi = event_array_count( a );
+
+    while( lo < hi ) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if( event_array_get(a, mid)->time < t ) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+
+/* See schedule.h for details. */
+size_t event_array_upper_bound( const event_array_t *a, time_t t )
+{
+    size_t lo = 0, hi = event_array_count( a );
+
+    while( lo < hi ) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if( event_array_get(a, mid)->time <= t ) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+
+/* See schedule.h for details. */
+int event_array_insert( event_array_t *a, schedule_event_t *e )
+{
+    schedule_event_t *prev;
+    size_t pos;
+
+    if( (NULL == a) || (NULL == e) ) {
+        return -1;
+    }
+
+    if( (0 == a->gap_size) && (0 != __grow_array(a)) ) {
+        return -1;
+    }
+
+    pos = event_array_lower_bound( a, e->time );
+    prev = (0 < pos) ? event_array_get( a, pos - 1 ) : NULL;
+
+    e->next = event_array_get( a, pos );
+    if( NULL == prev ) {
+        *a->head = e;
+    } else {
+        prev->next = e;
+    }
+
+    __move_gap( a, pos );
+    a->slot[a->gap++] = e;
+    a->gap_size--;
+
+    return 0;
+}
+
+
+/* See schedule.h for details. */
+schedule_event_t* event_array_remove( event_array_t *a, size_t i )
+{
+    schedule_event_t *e, *prev;
+
+    if( (NULL == a) || (NULL == (e = event_array_get(a, i))) ) {
+        return NULL;
+    }
+
+    prev = (0 < i) ? event_array_get( a, i - 1 ) : NULL;
+    if( NULL == prev ) {
+        *a->head = e->next;
+    } else {
+        prev->next = e->next;
+    }
+    e->next = NULL;
+
+    __move_gap( a, i + 1 );
+    a->gap--;
+    a->gap_size++;
+
+    return e;
+}
+
+
 /* See schedule.h for details. */
 int finalize_schedule( schedule_t *s )
 {
@@ -166,11 +346,77 @@ int finalize_schedule( schedule_t *s )
                 }
             }
         }
+
+        if( 0 == rv ) {
+            rv = build_schedule_index( s );
+        }
     }
 
     return rv;
 }
 
+/* See schedule.h for details. */
+schedule_t* copy_schedule( schedule_t *s )
+{
+    schedule_t *c;
+    schedule_event_t *p, **tail;
+
+    if( NULL == s ) {
+        return NULL;
+    }
+
+    c = create_schedule();
+    if( NULL == c ) {
+        return NULL;
+    }
+
+    if( NULL != s->time_zone ) {
+        c->time_zone = strdup( s->time_zone );
+        if( NULL == c->time_zone ) {
+            goto error;
+        }
+    }
+
+    if( 0 < s->mac_count ) {
+        if( 0 != create_mac_table(c, s->mac_count) ) {
+            goto error;
+        }
+        memcpy( c->macs, s->macs, s->mac_count * sizeof(mac_address) );
+    }
+
+    /* The lists are already sorted, so append instead of inserting. */
+    tail = &c->absolute;
+    for( p = s->absolute; NULL != p; p = p->next ) {
+        *tail = copy_schedule_event( p );
+        if( NULL == *tail ) {
+            goto error;
+        }
+        (*tail)->time = p->time;
+        tail = &(*tail)->next;
+    }
+
+    /* Leave out the copy of last week's final event finalize_schedule()
+     * put in front; it is the only one before the start of the week. */
+    tail = &c->weekly;
+    for( p = s->weekly; NULL != p; p = p->next ) {
+        if( p->time < 0 ) {
+            continue;
+        }
+        *tail = copy_schedule_event( p );
+        if( NULL == *tail ) {
+            goto error;
+        }
+        (*tail)->time = p->time;
+        tail = &(*tail)->next;
+    }
+
+    return c;
+
+error:
+    destroy_schedule( c );
+    return NULL;
+}
+
 /* See schedule.h for details. */
 void destroy_schedule( schedule_t *s )
 {
@@ -197,18 +443,27 @@ void destroy_schedule( schedule_t *s )
             aker_free( s->time_zone);
         }
 
+        __free_index( s->index );
+
         aker_free( s );
     }
 }
 
 
 /* See schedule.h for details. */
-char* get_blocked_at_time( schedule_t *s, time_t unixtime )
+schedule_event_t* get_event_at_time( schedule_t *s, time_t unixtime )
 {
     schedule_event_t *abs_prev, *abs_cur, *w_prev, *w_cur;
-    char *rv;
+    schedule_event_t *rv;
     time_t weekly, last_abs;
 
+    if( (NULL != s) && (NULL != s->index) ) {
+        bool absolute;
+        size_t pos;
+
+        return __lookup( s, unixtime, &absolute, &pos );
+    }
+
     weekly = convert_unix_time_to_weekly( unixtime );
 
     rv = NULL;
@@ -232,7 +487,7 @@ char* get_blocked_at_time( schedule_t *s, time_t unixtime )
         if( NULL != abs_prev ) {
             if( (NULL != abs_cur) && (abs_prev->time <= unixtime) ) {
                 /* In the absolute schedule */
-                rv = __convert_event_to_string( s, abs_prev );
+                rv = abs_prev;
                 goto done;
             }
 
@@ -258,19 +513,30 @@ char* get_blocked_at_time( schedule_t *s, time_t unixtime )
          * as it's in the past.  Otherwise use the weekly schedule. */
         if( NULL != w_prev) {
             if( (w_prev->time < last_abs) && (last_abs <= weekly) ) {
-                rv = __convert_event_to_string( s, abs_prev );
+                rv = abs_prev;
             } else {
-                rv = __convert_event_to_string( s, w_prev );
+                rv = w_prev;
             }
         } else {
             if( (NULL != abs_prev) && (abs_prev->time <= unixtime) ) {
-                rv = __convert_event_to_string( s, abs_prev );
+                rv = abs_prev;
             }
         }
     }
 
 done:
-    debug_info( "Time: %ld (%ld) -> '%s'\n", unixtime, weekly, rv );
+    return rv;
+}
+
+
+/* See schedule.h for details. */
+char* get_blocked_at_time( schedule_t *s, time_t unixtime )
+{
+    char *rv;
+
+    rv = __convert_event_to_string( s, get_event_at_time(s, unixtime) );
+    debug_info( "Time: %ld -> '%s'\n", unixtime, rv );
+
     return rv;
 }
 
@@ -320,11 +586,22 @@ time_t get_next_unixtime(schedule_t *s, time_t unixtime)
         time_t weekly;
 
         /* Check absolute schedule first */
-        for( p = s->absolute; NULL != p; p = p->next ) {
-            if( (p->time > unixtime) && (p->time < next_unixtime) ) {
-                next_unixtime = p->time;
+        if( NULL != s->index ) {
+            schedule_index_t *x = s->index;
+            size_t n = __upper_bound( x->absolute, x->absolute_first,
+                                      x->absolute_count, unixtime );
+
+            if( n < x->absolute_count ) {
+                next_unixtime = x->absolute[n]->time;
                 goto done;
             }
+        } else {
+            for( p = s->absolute; NULL != p; p = p->next ) {
+                if( (p->time > unixtime) && (p->time < next_unixtime) ) {
+                    next_unixtime = p->time;
+                    goto done;
+                }
+            }
         }
 
         /* Check the relative schedule next */
@@ -357,10 +634,699 @@ done:
 }
 
 
+/* See schedule.h for details. */
+time_t get_next_transition( schedule_t *s, time_t unixtime )
+{
+    schedule_event_t *p, *abs_prev;
+    time_t next = INT_MAX;
+    time_t weekly, boundary;
+
+    if( NULL == s ) {
+        return INT_MAX;
+    }
+
+    /* The next absolute event, and the one get_blocked_at_time() compares
+     * against the weekly schedule: the last one started or else the first. */
+    abs_prev = s->absolute;
+    if( NULL != s->index ) {
+        schedule_index_t *x = s->index;
+        size_t n = __upper_bound( x->absolute, x->absolute_first,
+                                  x->absolute_count, unixtime );
+
+        if( n < x->absolute_count ) {
+            next = x->absolute[n]->time;
+        }
+        if( x->absolute_first < n ) {
+            abs_prev = x->absolute[n - 1];
+        }
+    } else {
+        for( p = s->absolute; NULL != p; p = p->next ) {
+            if( p->time > unixtime ) {
+                next = p->time;
+                break;
+            }
+            abs_prev = p;
+        }
+    }
+
+    if( NULL == s->weekly ) {
+        return next;
+    }
+
+    /* The next weekly boundary: an event, the weekly position of that
+     * absolute event, or the wrap around to Sunday midnight. */
+    weekly = convert_unix_time_to_weekly( unixtime );
+    boundary = SECONDS_IN_A_WEEK;
+    if( NULL != s->index ) {
+        schedule_index_t *x = s->index;
+        size_t n = __upper_bound( x->weekly, 0, x->weekly_count, weekly );
+
+        if( n < x->weekly_count ) {
+            boundary = x->weekly[n]->time;
+        }
+    } else {
+        for( p = s->weekly; NULL != p; p = p->next ) {
+            if( p->time > weekly ) {
+                boundary = p->time;
+                break;
+            }
+        }
+    }
+    if( NULL != abs_prev ) {
+        time_t last_abs = convert_unix_time_to_weekly( abs_prev->time );
+
+        if( (weekly < last_abs) && (last_abs < boundary) ) {
+            boundary = last_abs;
+        }
+    }
+
+    if( unixtime + (boundary - weekly) < next ) {
+        next = unixtime + (boundary - weekly);
+    }
+
+    /* If local time jumps before then, stop at the jump and look again. */
+    return __stop_at_jump( unixtime, weekly, next );
+}
+
+
+/* See schedule.h for details. */
+int build_schedule_index( schedule_t *s )
+{
+    schedule_index_t *x;
+    size_t i;
+
+    if( NULL == s ) {
+        return -1;
+    }
+
+    __free_index( s->index );
+    s->index = NULL;
+
+    x = (schedule_index_t*) aker_malloc( sizeof(schedule_index_t) );
+    if( NULL == x ) {
+        return -1;
+    }
+    memset( x, 0, sizeof(schedule_index_t) );
+
+    if( (0 != __index_events(s, s->weekly, &x->weekly, &x->weekly_count,
+                             &x->weekly_start, &x->weekly_by_mac)) ||
+        (0 != __index_events(s, s->absolute, &x->absolute, &x->absolute_count,
+                             &x->absolute_start, &x->absolute_by_mac)) )
+    {
+        __free_index( x );
+        return -1;
+    }
+
+    /* At most half full so probes stay short. */
+    x->hash_size = 1;
+    while( x->hash_size < 2 * s->mac_count ) {
+        x->hash_size <<= 1;
+    }
+    x->hash = (uint32_t*) aker_malloc( x->hash_size * sizeof(uint32_t) );
+    if( NULL == x->hash ) {
+        __free_index( x );
+        return -1;
+    }
+    memset( x->hash, 0, x->hash_size * sizeof(uint32_t) );
+
+    for( i = 0; i < s->mac_count; i++ ) {
+        size_t h = __hash_mac( s->macs[i].mac ) & (x->hash_size - 1);
+
+        /* Keep the first of any duplicates, like a linear search would. */
+        while( 0 != x->hash[h] ) {
+            if( 0 == strncasecmp(s->macs[x->hash[h] - 1].mac, s->macs[i].mac,
+                                 MAC_ADDRESS_SIZE) ) {
+                break;
+            }
+            h = (h + 1) & (x->hash_size - 1);
+        }
+        if( 0 == x->hash[h] ) {
+            x->hash[h] = (uint32_t) i + 1;
+        }
+    }
+
+    s->index = x;
+
+    return 0;
+}
+
+
+/* See schedule.h for details. */
+int prune_absolute_events( schedule_t *s, time_t now )
+{
+    schedule_index_t *x;
+    int count = 0;
+
+    if( NULL == s ) {
+        return 0;
+    }
+
+    /* The index lists the events in the same order, so the ones dropped
+     * are the ones at its start. */
+    x = s->index;
+    while( (NULL != s->absolute) && (NULL != s->absolute->next) &&
+           (s->absolute->next->time <= now) )
+    {
+        schedule_event_t *e = s->absolute;
+
+        s->absolute = e->next;
+        aker_free( e );
+        if( NULL != x ) {
+            x->absolute[x->absolute_first++] = NULL;
+        }
+        count++;
+    }
+
+    return count;
+}
+
+
+/* See schedule.h for details. */
+int find_mac_index( schedule_t *s, const char *mac, uint32_t *index )
+{
+    schedule_index_t *x;
+    size_t h;
+
+    if( (NULL == s) || (NULL == s->index) || (NULL == mac) || (NULL == index) ) {
+        return -1;
+    }
+
+    x = s->index;
+    h = __hash_mac( mac ) & (x->hash_size - 1);
+    while( 0 != x->hash[h] ) {
+        if( 0 == strncasecmp(s->macs[x->hash[h] - 1].mac, mac, MAC_ADDRESS_SIZE) ) {
+            *index = x->hash[h] - 1;
+            return 0;
+        }
+        h = (h + 1) & (x->hash_size - 1);
+    }
+
+    return -1;
+}
+
+
+/* See schedule.h for details. */
+int get_device_status( schedule_t *s, const char *mac, time_t unixtime,
+                       bool *blocked, time_t *next_change )
+{
+    time_t t, horizon;
+    uint32_t m;
+    bool now;
+
+    if( (NULL == s) || (NULL == s->index) || (NULL == mac) ||
+        (NULL == blocked) || (NULL == next_change) )
+    {
+        return -1;
+    }
+
+    if( 0 != find_mac_index(s, mac, &m) ) {
+        return -2;
+    }
+
+    now = __device_blocked( s, m, unixtime );
+    *blocked = now;
+
+    /* Once the absolute schedule is over every week looks the same, so a
+     * change that hasn't happened two weeks after that never will. */
+    horizon = unixtime;
+    if( (s->index->absolute_first < s->index->absolute_count) &&
+        (horizon < s->index->absolute[s->index->absolute_count - 1]->time) )
+    {
+        horizon = s->index->absolute[s->index->absolute_count - 1]->time;
+    }
+    horizon += 2 * SECONDS_IN_A_WEEK;
+
+    *next_change = INT_MAX;
+    for( t = unixtime; t < horizon; ) {
+        /* Any transition can unblock, but only the events blocking this
+         * device can block it. */
+        t = now ? get_next_transition( s, t ) : __next_candidate( s, m, t );
+        if( (t < horizon) && (now != __device_blocked(s, m, t)) ) {
+            *next_change = t;
+            break;
+        }
+    }
+
+    return 0;
+}
+
+
 /*----------------------------------------------------------------------------*/
 /*                             Internal functions                             */
 /*----------------------------------------------------------------------------*/
 
+/**
+ *  Checks that weekly time has moved in step with unix time from one time
+ *  to a later one, i.e. there was no local time jump in between.
+ *
+ *  @param from        the starting unix time
+ *  @param from_weekly the weekly time at from
+ *  @param t           the later unix time
+ *
+ *  @return true if weekly time kept pace, false otherwise
+ */
+static bool __weekly_in_step( time_t from, time_t from_weekly, time_t t )
+{
+    return ((from_weekly + (t - from)) % SECONDS_IN_A_WEEK) ==
+           convert_unix_time_to_weekly( t );
+}
+
+
+/**
+ *  Moves next back to the first local time jump after from, if there is one.
+ *
+ *  @param from        the starting unix time
+ *  @param from_weekly the weekly time at from
+ *  @param next        the later unix time
+ *
+ *  @return next, or the first second with a jump before it
+ */
+static time_t __stop_at_jump( time_t from, time_t from_weekly, time_t next )
+{
+    if( (INT_MAX != next) && !__weekly_in_step(from, from_weekly, next) ) {
+        time_t lo = from, hi = next;
+
+        while( 1 < hi - lo ) {
+            time_t mid = lo + (hi - lo) / 2;
+
+            if( __weekly_in_step(from, from_weekly, mid) ) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        next = hi;
+    }
+
+    return next;
+}
+
+
+/**
+ *  Grows an event array to a bit over twice its size, keeping the gap where
+ *  it is.
+ *
+ *  @return 0 on success, -1 on memory errors
+ */
+static int __grow_array( event_array_t *a )
+{
+    schedule_event_t **slot;
+    size_t extra = a->capacity + 16;
+    size_t after = a->capacity - a->gap - a->gap_size;
+
+    slot = (schedule_event_t**) aker_malloc( (a->capacity + extra) * sizeof(schedule_event_t*) );
+    if( NULL == slot ) {
+        return -1;
+    }
+
+    if( NULL != a->slot ) {
+        memcpy( slot, a->slot, a->gap * sizeof(schedule_event_t*) );
+        memcpy( &slot[a->gap + a->gap_size + extra], &a->slot[a->gap + a->gap_size],
+                after * sizeof(schedule_event_t*) );
+        aker_free( a->slot );
+    }
+
+    a->slot = slot;
+    a->capacity += extra;
+    a->gap_size += extra;
+
+    return 0;
+}
+
+
+/**
+ *  Moves the gap of an event array so that pos events are in front of it.
+ */
+static void __move_gap( event_array_t *a, size_t pos )
+{
+    if( pos < a->gap ) {
+        memmove( &a->slot[pos + a->gap_size], &a->slot[pos],
+                 (a->gap - pos) * sizeof(schedule_event_t*) );
+    } else if( a->gap < pos ) {
+        memmove( &a->slot[a->gap], &a->slot[a->gap + a->gap_size],
+                 (pos - a->gap) * sizeof(schedule_event_t*) );
+    }
+    a->gap = pos;
+}
+
+
+static void __free_index( schedule_index_t *x )
+{
+    if( NULL != x ) {
+        aker_free( x->weekly );
+        aker_free( x->absolute );
+        aker_free( x->hash );
+        aker_free( x->weekly_start );
+        aker_free( x->weekly_by_mac );
+        aker_free( x->absolute_start );
+        aker_free( x->absolute_by_mac );
+        aker_free( x );
+    }
+}
+
+
+/**
+ *  Builds the time ordered array of a list of events and, per MAC, the
+ *  ascending positions of the events blocking it.
+ *
+ *  @return 0 on success, error otherwise
+ */
+static int __index_events( schedule_t *s, schedule_event_t *head,
+                           schedule_event_t ***events, size_t *count,
+                           size_t **start, uint32_t **by_mac )
+{
+    schedule_event_t *e;
+    size_t n = 0, i, j, total;
+    uint32_t *last;
+
+    for( e = head; NULL != e; e = e->next ) {
+        n++;
+    }
+
+    *count = n;
+    *events = (schedule_event_t**) aker_malloc( (n + 1) * sizeof(schedule_event_t*) );
+    *start = (size_t*) aker_malloc( (s->mac_count + 1) * sizeof(size_t) );
+    last = (uint32_t*) aker_malloc( (s->mac_count + 1) * sizeof(uint32_t) );
+    if( (NULL == *events) || (NULL == *start) || (NULL == last) ) {
+        aker_free( last );
+        return -1;
+    }
+    memset( *start, 0, (s->mac_count + 1) * sizeof(size_t) );
+
+    /* Count the events blocking each MAC, once per event, skipping events
+     * that block nothing because of an invalid index. */
+    for( i = 0, e = head; NULL != e; e = e->next, i++ ) {
+        (*events)[i] = e;
+        for( j = 0; j < e->block_count; j++ ) {
+            if( s->mac_count <= e->block[j] ) {
+                break;
+            }
+        }
+        if( j < e->block_count ) {
+            continue;
+        }
+        for( j = 0; j < e->block_count; j++ ) {
+            (*start)[e->block[j] + 1]++;
+        }
+    }
+
+    /* Duplicates were counted too, so this is an upper bound until the
+     * offsets are compacted below. */
+    for( i = 0; i < s->mac_count; i++ ) {
+        (*start)[i + 1] += (*start)[i];
+    }
+    total = (*start)[s->mac_count];
+
+    *by_mac = (uint32_t*) aker_malloc( (total + 1) * sizeof(uint32_t) );
+    if( NULL == *by_mac ) {
+        aker_free( last );
+        return -1;
+    }
+
+    /* last[] holds where the next position of each MAC goes, and the
+     * position just written lets duplicates within an event be skipped. */
+    for( i = 0; i < s->mac_count; i++ ) {
+        last[i] = (uint32_t) (*start)[i];
+    }
+    for( i = 0; i < n; i++ ) {
+        e = (*events)[i];
+        for( j = 0; j < e->block_count; j++ ) {
+            if( s->mac_count <= e->block[j] ) {
+                break;
+            }
+        }
+        if( j < e->block_count ) {
+            continue;
+        }
+        for( j = 0; j < e->block_count; j++ ) {
+            uint32_t m = e->block[j];
+
+            if( (last[m] > (*start)[m]) && ((*by_mac)[last[m] - 1] == i) ) {
+                continue;
+            }
+            (*by_mac)[last[m]++] = (uint32_t) i;
+        }
+    }
+
+    /* Close the gaps the duplicates left. */
+    total = 0;
+    for( i = 0; i < s->mac_count; i++ ) {
+        size_t from = (*start)[i];
+        size_t len = last[i] - from;
+
+        memmove( &(*by_mac)[total], &(*by_mac)[from], len * sizeof(uint32_t) );
+        (*start)[i] = total;
+        total += len;
+    }
+    (*start)[s->mac_count] = total;
+
+    aker_free( last );
+
+    return 0;
+}
+
+
+/**
+ *  FNV-1a of a MAC address, ignoring case.
+ */
+static uint32_t __hash_mac( const char *mac )
+{
+    uint32_t h = 2166136261u;
+    size_t i;
+
+    for( i = 0; (i < MAC_ADDRESS_SIZE - 1) && ('\0' != mac[i]); i++ ) {
+        h ^= (uint32_t) tolower( (unsigned char) mac[i] );
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+
+/**
+ *  @return the position after the last of the events from first on with a
+ *          time at or before t, first if there is none
+ */
+static size_t __upper_bound( schedule_event_t **e, size_t first, size_t count,
+                             time_t t )
+{
+    size_t lo = first, hi = count;
+
+    while( lo < hi ) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if( e[mid]->time <= t ) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+
+/**
+ *  The indexed version of get_event_at_time(), which also says which list
+ *  the event is from and where.  The rules are the same as the list walk.
+ */
+static schedule_event_t* __lookup( schedule_t *s, time_t unixtime,
+                                   bool *absolute, size_t *pos )
+{
+    schedule_index_t *x = s->index;
+    schedule_event_t *abs_prev = NULL;
+    size_t abs_pos = 0;
+    time_t weekly, last_abs;
+
+    weekly = convert_unix_time_to_weekly( unixtime );
+
+    *absolute = true;
+    last_abs = weekly + 1;
+    if( x->absolute_first < x->absolute_count ) {
+        size_t n = __upper_bound( x->absolute, x->absolute_first,
+                                  x->absolute_count, unixtime );
+
+        abs_pos = (x->absolute_first < n) ? (n - 1) : x->absolute_first;
+        abs_prev = x->absolute[abs_pos];
+        *pos = abs_pos;
+
+        /* In the absolute schedule */
+        if( (abs_pos + 1 < x->absolute_count) && (abs_prev->time <= unixtime) ) {
+            return abs_prev;
+        }
+
+        last_abs = convert_unix_time_to_weekly( abs_prev->time );
+    }
+
+    if( 0 < x->weekly_count ) {
+        size_t n = __upper_bound( x->weekly, 0, x->weekly_count, weekly );
+        size_t w_pos = (0 < n) ? (n - 1) : 0;
+
+        /* If the abs time event is the most recent, use it as long
+         * as it's in the past.  Otherwise use the weekly schedule. */
+        if( (x->weekly[w_pos]->time < last_abs) && (last_abs <= weekly) ) {
+            return abs_prev;
+        }
+        *absolute = false;
+        *pos = w_pos;
+        return x->weekly[w_pos];
+    }
+
+    if( (NULL != abs_prev) && (abs_prev->time <= unixtime) ) {
+        return abs_prev;
+    }
+
+    return NULL;
+}
+
+
+/**
+ *  @return the number of positions in the ascending list before pos
+ */
+static size_t __lower_bound( const uint32_t *list, size_t count, size_t pos )
+{
+    size_t lo = 0, hi = count;
+
+    while( lo < hi ) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if( list[mid] < pos ) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+
+/**
+ *  @return true if pos is in the ascending list, false otherwise
+ */
+static bool __in_list( const uint32_t *list, size_t count, size_t pos )
+{
+    size_t lo = __lower_bound( list, count, pos );
+
+    return (lo < count) && (list[lo] == pos);
+}
+
+
+/**
+ *  @return true if the event in effect at unixtime blocks the MAC
+ */
+static bool __device_blocked( schedule_t *s, uint32_t mac, time_t unixtime )
+{
+    schedule_index_t *x = s->index;
+    schedule_event_t *e;
+    bool absolute;
+    size_t pos;
+
+    e = __lookup( s, unixtime, &absolute, &pos );
+    if( NULL == e ) {
+        return false;
+    }
+
+    if( absolute ) {
+        return __in_list( &x->absolute_by_mac[x->absolute_start[mac]],
+                          x->absolute_start[mac + 1] - x->absolute_start[mac], pos );
+    }
+
+    return __in_list( &x->weekly_by_mac[x->weekly_start[mac]],
+                      x->weekly_start[mac + 1] - x->weekly_start[mac], pos );
+}
+
+
+/**
+ *  Finds the earliest time after unixtime at which an event blocking the MAC
+ *  can come into effect: one of its absolute events starts, one of its weekly
+ *  events (or the weekly position of the absolute event compared against
+ *  them) comes around, the week wraps or local time jumps.
+ */
+static time_t __next_candidate( schedule_t *s, uint32_t mac, time_t unixtime )
+{
+    schedule_index_t *x = s->index;
+    const uint32_t *list;
+    size_t count, lo, hi;
+    time_t weekly, next;
+
+    weekly = convert_unix_time_to_weekly( unixtime );
+    next = unixtime + (SECONDS_IN_A_WEEK - weekly);
+
+    /* The first of its absolute events after unixtime, past the pruned
+     * ones. */
+    list = &x->absolute_by_mac[x->absolute_start[mac]];
+    count = x->absolute_start[mac + 1] - x->absolute_start[mac];
+    lo = __lower_bound( list, count, x->absolute_first );
+    hi = count;
+    while( lo < hi ) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if( x->absolute[list[mid]]->time <= unixtime ) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if( (lo < count) && (x->absolute[list[lo]]->time < next) ) {
+        next = x->absolute[list[lo]]->time;
+    }
+
+    /* The weekly position of the absolute event get_event_at_time() would
+     * compare against, if it blocks the MAC. */
+    if( x->absolute_first < x->absolute_count ) {
+        size_t n = __upper_bound( x->absolute, x->absolute_first,
+                                  x->absolute_count, unixtime );
+        size_t pos = (x->absolute_first < n) ? (n - 1) : x->absolute_first;
+
+        if( __in_list(list, count, pos) ) {
+            time_t t = __next_weekly( unixtime, weekly,
+                                      convert_unix_time_to_weekly(x->absolute[pos]->time) );
+            if( t < next ) {
+                next = t;
+            }
+        }
+    }
+
+    /* The next of its weekly events to come around this week. */
+    list = &x->weekly_by_mac[x->weekly_start[mac]];
+    count = x->weekly_start[mac + 1] - x->weekly_start[mac];
+    lo = 0;
+    hi = count;
+    while( lo < hi ) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if( x->weekly[list[mid]]->time <= weekly ) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if( lo < count ) {
+        time_t t = __next_weekly( unixtime, weekly, x->weekly[list[lo]]->time );
+
+        if( t < next ) {
+            next = t;
+        }
+    }
+
+    return __stop_at_jump( unixtime, weekly, next );
+}
+
+
+/**
+ *  @return the unix time the weekly position next comes around after
+ *          unixtime, assuming no local time jumps
+ */
+static time_t __next_weekly( time_t unixtime, time_t weekly, time_t position )
+{
+    if( position > weekly ) {
+        return unixtime + (position - weekly);
+    }
+
+    return unixtime + (SECONDS_IN_A_WEEK - weekly) + position;
+}
+
 
 /**
  *  Convert a block pointing to a list of macs in a schedule into a string
@@ -17,6 +17,7 @@
 #ifndef __SCHEDULE_H__
 #define __SCHEDULE_H__
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <time.h>
 #include <pthread.h>
@@ -46,6 +47,27 @@ typedef struct mac_address_t {
 } mac_address;
 
 
+typedef struct schedule_index {
+    schedule_event_t **weekly;      /* The weekly events in time order. */
+    size_t weekly_count;
+    schedule_event_t **absolute;    /* The absolute events in time order. */
+    size_t absolute_count;
+    size_t absolute_first;          /* The first of them not pruned since;
+                                     * the ones before it are gone. */
+
+    uint32_t *hash;                 /* Open addressed MAC table index + 1,
+                                     * 0 is an empty slot. */
+    size_t hash_size;               /* Always a power of 2. */
+
+    size_t *weekly_start;           /* Per MAC offsets into weekly_by_mac,
+                                     * mac_count + 1 of them. */
+    uint32_t *weekly_by_mac;        /* Ascending weekly[] positions of the
+                                     * events blocking each MAC. */
+    size_t *absolute_start;         /* Same as above, for absolute[]. */
+    uint32_t *absolute_by_mac;
+} schedule_index_t;
+
+
 typedef struct schedule {
     char             *time_zone;    /*                                  */
     
@@ -57,8 +79,25 @@ typedef struct schedule {
 
     size_t mac_count;               /* The count of the macs. */
     mac_address *macs;              /* The shared list of mac addresses to block. */
+
+    schedule_index_t *index;        /* Lookup tables built from the lists
+                                     * above, or NULL. */
 } schedule_t;
 
+
+/* An ordered array over one of the event lists, for building and editing
+ * large lists: finding a position is a binary search, and the free slots
+ * are kept together as a gap that is moved to where an event goes in or
+ * comes out, so runs of nearby changes move few entries. */
+typedef struct event_array {
+    schedule_event_t **head;        /* The list kept linked in this order. */
+    schedule_event_t **slot;        /* capacity entries, gap_size of them
+                                     * free starting at gap. */
+    size_t capacity;
+    size_t gap;                     /* The number of events before the gap. */
+    size_t gap_size;
+} event_array_t;
+
 /*----------------------------------------------------------------------------*/
 /*                            File Scoped Variables                           */
 /*----------------------------------------------------------------------------*/
@@ -106,13 +145,154 @@ void insert_event(schedule_event_t **head, schedule_event_t *e );
 
 
 /**
- *  Performs the tasks needed to make the scheduler's job a bit easier.
+ *  Builds an event array over a (sorted) list.
+ *
+ *  @param a       the array to set up
+ *  @param head    the list head; the array keeps it linked as it changes
+ *  @param reserve room to make for this many inserts up front
+ *
+ *  @return 0 on success, -1 on error
+ */
+int event_array_init( event_array_t *a, schedule_event_t **head, size_t reserve );
+
+
+/**
+ *  Frees the array, leaving the list and its events alone.
+ */
+void event_array_destroy( event_array_t *a );
+
+
+/**
+ *  Returns the number of events in the array.
+ */
+size_t event_array_count( const event_array_t *a );
+
+
+/**
+ *  Returns the i-th event in time order, NULL if there is no such event.
+ */
+schedule_event_t* event_array_get( const event_array_t *a, size_t i );
+
+
+/**
+ *  Returns the position of the first event at or after t, or the count if
+ *  there is none.
+ */
+size_t event_array_lower_bound( const event_array_t *a, time_t t );
+
+
+/**
+ *  Returns the position of the first event after t, or the count if there is
+ *  none.  The event before it is the last one at or before t.
+ */
+size_t event_array_upper_bound( const event_array_t *a, time_t t );
+
+
+/**
+ *  Adds an event in time order, in front of any events at the same time
+ *  (as insert_event() does), and links it into the list.
+ *
+ *  @return 0 on success, -1 on error (e is not added)
+ */
+int event_array_insert( event_array_t *a, schedule_event_t *e );
+
+
+/**
+ *  Takes the i-th event out of the array and unlinks it from the list.
+ *
+ *  @return the event, which the caller now owns, NULL if there is none
+ */
+schedule_event_t* event_array_remove( event_array_t *a, size_t i );
+
+
+/**
+ *  Performs the tasks needed to make the scheduler's job a bit easier,
+ *  including building the schedule's index.
  *
  *  @param s the schedule to finalize
  */
 int finalize_schedule( schedule_t *s );
 
 
+/**
+ *  (Re)builds the index of a schedule: the events in time order, a hash of
+ *  the MAC table, and for each MAC the events blocking it.  Lookups use the
+ *  index when there is one and walk the lists otherwise.
+ *
+ *  @note The index must be rebuilt after the event lists or MAC table
+ *        change.  Events with an invalid MAC index block nothing, so they
+ *        are not indexed under any MAC.
+ *
+ *  @param s the schedule to index
+ *
+ *  @return 0 on success, error otherwise (the schedule is left without one)
+ */
+int build_schedule_index( schedule_t *s );
+
+
+/**
+ *  Drops the absolute events that no lookup at or after now can land on:
+ *  all of them before the last one at or before now.  That one stays, as it
+ *  is in effect (or, past the end of the absolute schedule, still compared
+ *  against the weekly one).  An indexed schedule keeps its index, which just
+ *  starts further into its absolute events.
+ *
+ *  @param s   the schedule to prune
+ *  @param now the earliest time the schedule will be looked at from now on
+ *
+ *  @return the number of events dropped
+ */
+int prune_absolute_events( schedule_t *s, time_t now );
+
+
+/**
+ *  Finds a MAC address in the schedule's MAC table using the index.
+ *
+ *  @param s     the indexed schedule
+ *  @param mac   the MAC address ("11:22:33:44:55:66", any case)
+ *  @param index where to put the MAC table index
+ *
+ *  @return 0 if found, error otherwise
+ */
+int find_mac_index( schedule_t *s, const char *mac, uint32_t *index );
+
+
+/**
+ *  Gets whether one device is blocked at a time and when that next changes,
+ *  without building the blocked list.
+ *
+ *  The blocked state costs O(log n).  Finding the next change jumps between
+ *  the events that block the device while it is unblocked, and steps through
+ *  transitions while it is blocked.
+ *
+ *  @param s           the indexed schedule
+ *  @param mac         the MAC address ("11:22:33:44:55:66", any case)
+ *  @param unixtime    the time to look at
+ *  @param blocked     where to put whether the device is blocked
+ *  @param next_change where to put the time the state next changes, INT_MAX
+ *                     if it never does
+ *
+ *  @return 0 on success, -1 on invalid arguments or no index, -2 if the MAC
+ *          is not in the schedule
+ */
+int get_device_status( schedule_t *s, const char *mac, time_t unixtime,
+                       bool *blocked, time_t *next_change );
+
+
+/**
+ *  Makes a deep copy of a schedule that can be altered without touching the
+ *  original, as it was before finalize_schedule(): without the index and
+ *  without the copy of last week's final event.
+ *
+ *  @note Call finalize_schedule() on the copy once it has been altered.
+ *
+ *  @param s the schedule to copy
+ *
+ *  @return NULL on error, valid pointer to a schedule_t otherwise
+ */
+schedule_t* copy_schedule( schedule_t *s );
+
+
 /**
  *  Destroys the schedule passed in.
  *
@@ -132,6 +312,21 @@ void destroy_schedule( schedule_t *s );
 char* get_blocked_at_time( schedule_t *s, time_t unixtime );
 
 
+/**
+ *  Gets the event whose block list applies at this time, which is what
+ *  get_blocked_at_time() turns into a string.
+ *
+ *  @note The event belongs to the schedule; its block indexes are not
+ *        validated against the mac table.
+ *
+ *  @param s        the schedule to apply
+ *  @param unixtime the unixtime representation
+ *
+ *  @return the event in effect or NULL if nothing is blocked
+ */
+schedule_event_t* get_event_at_time( schedule_t *s, time_t unixtime );
+
+
 /**
  *  Creates the schedule's table of mac addresses.
  *
@@ -184,4 +379,23 @@ void print_schedule( schedule_t *s );
  */
 time_t get_next_unixtime(schedule_t *s, time_t unixtime);
 
+/**
+ *  Finds the next time after unixtime at which get_blocked_at_time() may
+ *  return something different.  No change is ever skipped, but the blocked
+ *  list is not guaranteed to differ at the returned time (for example at the
+ *  weekly wrap around), so callers compare the results.
+ *
+ *  Unlike get_next_unixtime() this accounts for weekly events before the
+ *  absolute schedule starts and for local time jumps (DST changes).
+ *
+ *  @note Two local time jumps that cancel each other out within one step
+ *        are not detected.
+ *
+ *  @param s        the schedule
+ *  @param unixtime the time to start from
+ *
+ *  @return the unix time of the next possible change, INT_MAX if none
+ */
+time_t get_next_transition( schedule_t *s, time_t unixtime );
+
 #endif
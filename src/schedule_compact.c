@@ -0,0 +1,407 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "schedule_compact.h"
+#include "aker_log.h"
+#include "aker_mem.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define UNUSED_MAC  UINT32_MAX
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+typedef struct {
+    const char *mac;
+    uint32_t index;
+} mac_entry_t;
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static void __count_list( schedule_event_t *head, size_t *events, size_t *blocks );
+static void __drop_invalid( schedule_event_t *head, size_t mac_count );
+static int __map_duplicates( schedule_t *s, uint32_t *map );
+static int __compare_mac( const void *a, const void *b );
+static void __remap_list( schedule_event_t *head, const uint32_t *map );
+static int __compare_index( const void *a, const void *b );
+static bool __same_blocks( const schedule_event_t *a, const schedule_event_t *b );
+static void __remove_next( schedule_event_t **link );
+static void __drop_hidden( schedule_event_t **head, time_t keep_head_after );
+static void __merge_absolute( schedule_t *s );
+static void __merge_weekly( schedule_t *s );
+static void __mark_used( schedule_event_t *head, uint32_t *map );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See schedule_compact.h for details. */
+void count_schedule( schedule_t *s, schedule_counts_t *c )
+{
+    if( NULL != c ) {
+        memset( c, 0, sizeof(schedule_counts_t) );
+
+        if( NULL != s ) {
+            __count_list( s->weekly, &c->weekly, &c->blocks );
+            __count_list( s->absolute, &c->absolute, &c->blocks );
+            c->macs = s->mac_count;
+        }
+    }
+}
+
+
+/* See schedule_compact.h for details. */
+int compact_schedule( schedule_t *s, time_t now,
+                      schedule_counts_t *before, schedule_counts_t *after )
+{
+    uint32_t *map;
+    size_t i, used;
+
+    if( (NULL == s) || ((0 < s->mac_count) && (NULL == s->macs)) ) {
+        return -1;
+    }
+
+    map = NULL;
+    if( 0 < s->mac_count ) {
+        map = (uint32_t*) aker_malloc( s->mac_count * sizeof(uint32_t) );
+        if( NULL == map ) {
+            return -2;
+        }
+    }
+
+    /* Point every MAC at the first entry with the same address. */
+    if( 0 != __map_duplicates(s, map) ) {
+        aker_free( map );
+        return -2;
+    }
+
+    count_schedule( s, before );
+
+    __drop_invalid( s->weekly, s->mac_count );
+    __drop_invalid( s->absolute, s->mac_count );
+
+    /* The copy of last week's final event goes, finalize_schedule() puts
+     * it back at the end. */
+    while( (NULL != s->weekly) && (s->weekly->time < 0) ) {
+        __remove_next( &s->weekly );
+    }
+
+    __remap_list( s->weekly, map );
+    __remap_list( s->absolute, map );
+
+    if( 0 < now ) {
+        (void) prune_absolute_events( s, now );
+    }
+    __drop_hidden( &s->weekly, 0 );
+    __drop_hidden( &s->absolute, (0 < now) ? now : 0 );
+    __merge_absolute( s );
+    __merge_weekly( s );
+
+    /* Renumber the MACs still blocked, keeping their order so the sorted
+     * indexes stay sorted. */
+    for( i = 0; i < s->mac_count; i++ ) {
+        map[i] = UNUSED_MAC;
+    }
+    __mark_used( s->weekly, map );
+    __mark_used( s->absolute, map );
+    used = 0;
+    for( i = 0; i < s->mac_count; i++ ) {
+        if( UNUSED_MAC != map[i] ) {
+            used++;
+        }
+    }
+    if( (0 == used) && (0 < s->mac_count) ) {
+        /* Nothing blocks anything: keep one MAC for decode_schedule(). */
+        map[0] = 0;
+    }
+    used = 0;
+    for( i = 0; i < s->mac_count; i++ ) {
+        if( UNUSED_MAC != map[i] ) {
+            if( used != i ) {
+                memcpy( &s->macs[used], &s->macs[i], sizeof(mac_address) );
+            }
+            map[i] = (uint32_t) used++;
+        }
+    }
+    if( 0 < s->mac_count ) {
+        s->mac_count = used;
+        __remap_list( s->weekly, map );
+        __remap_list( s->absolute, map );
+    }
+
+    aker_free( map );
+
+    if( 0 != finalize_schedule(s) ) {
+        return -3;
+    }
+
+    count_schedule( s, after );
+
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Counts the events of a list (not the negative time copy) and adds their
+ *  block entries to blocks.
+ */
+static void __count_list( schedule_event_t *head, size_t *events, size_t *blocks )
+{
+    for( ; NULL != head; head = head->next ) {
+        if( 0 <= head->time ) {
+            (*events)++;
+            *blocks += head->block_count;
+        }
+    }
+}
+
+
+/**
+ *  Empties the events of a list that have an index outside the MAC table.
+ *  The decoder accepts them, and lookups treat such an event as blocking
+ *  nothing, not even its valid indexes.
+ */
+static void __drop_invalid( schedule_event_t *head, size_t mac_count )
+{
+    size_t i;
+
+    for( ; NULL != head; head = head->next ) {
+        for( i = 0; i < head->block_count; i++ ) {
+            if( mac_count <= head->block[i] ) {
+                head->block_count = 0;
+                break;
+            }
+        }
+    }
+}
+
+
+/**
+ *  Maps every MAC to the first entry of the table with the same address,
+ *  sorting the table's addresses rather than comparing every pair.
+ *
+ *  @return 0 on success, -1 if out of memory
+ */
+static int __map_duplicates( schedule_t *s, uint32_t *map )
+{
+    mac_entry_t *sorted;
+    size_t i, first;
+
+    if( 0 == s->mac_count ) {
+        return 0;
+    }
+
+    sorted = (mac_entry_t*) aker_malloc( s->mac_count * sizeof(mac_entry_t) );
+    if( NULL == sorted ) {
+        return -1;
+    }
+    for( i = 0; i < s->mac_count; i++ ) {
+        sorted[i].mac = s->macs[i].mac;
+        sorted[i].index = (uint32_t) i;
+    }
+    qsort( sorted, s->mac_count, sizeof(mac_entry_t), __compare_mac );
+
+    /* Equal addresses are next to each other, the first entry leading. */
+    first = 0;
+    for( i = 0; i < s->mac_count; i++ ) {
+        if( 0 != strcasecmp(sorted[first].mac, sorted[i].mac) ) {
+            first = i;
+        }
+        map[sorted[i].index] = sorted[first].index;
+    }
+
+    aker_free( sorted );
+
+    return 0;
+}
+
+
+/**
+ *  qsort() comparison for MAC table entries: by address, then by index.
+ */
+static int __compare_mac( const void *a, const void *b )
+{
+    const mac_entry_t *x = (const mac_entry_t*) a;
+    const mac_entry_t *y = (const mac_entry_t*) b;
+    int rv;
+
+    rv = strcasecmp( x->mac, y->mac );
+    if( 0 == rv ) {
+        rv = (x->index < y->index) ? -1 : 1;
+    }
+
+    return rv;
+}
+
+
+/**
+ *  Maps the indexes of every event in a list, then sorts them and drops the
+ *  duplicates.
+ */
+static void __remap_list( schedule_event_t *head, const uint32_t *map )
+{
+    size_t i, n;
+
+    for( ; NULL != head; head = head->next ) {
+        if( 0 == head->block_count ) {
+            continue;
+        }
+
+        for( i = 0; i < head->block_count; i++ ) {
+            head->block[i] = map[head->block[i]];
+        }
+        qsort( head->block, head->block_count, sizeof(uint32_t), __compare_index );
+
+        n = 1;
+        for( i = 1; i < head->block_count; i++ ) {
+            if( head->block[i] != head->block[n - 1] ) {
+                head->block[n++] = head->block[i];
+            }
+        }
+        head->block_count = n;
+    }
+}
+
+
+/**
+ *  qsort() comparison for block indexes.
+ */
+static int __compare_index( const void *a, const void *b )
+{
+    uint32_t x = *((const uint32_t*) a);
+    uint32_t y = *((const uint32_t*) b);
+
+    return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+
+/**
+ *  Compares the (sorted) block sets of two events.
+ */
+static bool __same_blocks( const schedule_event_t *a, const schedule_event_t *b )
+{
+    return (a->block_count == b->block_count) &&
+           (0 == memcmp(a->block, b->block, a->block_count * sizeof(uint32_t)));
+}
+
+
+/**
+ *  Unlinks and frees the event link points at.
+ */
+static void __remove_next( schedule_event_t **link )
+{
+    schedule_event_t *e = *link;
+
+    *link = e->next;
+    aker_free( e );
+}
+
+
+/**
+ *  Drops events followed by one at the same time; a lookup always lands on
+ *  the last of them.  Before the first absolute event its block set is still
+ *  used, so a first event after keep_head_after is kept.
+ */
+static void __drop_hidden( schedule_event_t **head, time_t keep_head_after )
+{
+    schedule_event_t **link = head;
+
+    while( (NULL != *link) && (NULL != (*link)->next) ) {
+        if( ((*link)->time == (*link)->next->time) &&
+            ((link != head) || ((*link)->time <= keep_head_after)) )
+        {
+            __remove_next( link );
+        } else {
+            link = &(*link)->next;
+        }
+    }
+}
+
+
+/**
+ *  Drops absolute events that block the same set as the one before them.
+ *  The first and the last events are never dropped: they start and end the
+ *  window the absolute schedule applies in.
+ */
+static void __merge_absolute( schedule_t *s )
+{
+    schedule_event_t *p = s->absolute;
+
+    while( (NULL != p) && (NULL != p->next) && (NULL != p->next->next) ) {
+        if( __same_blocks(p, p->next) ) {
+            __remove_next( &p->next );
+        } else {
+            p = p->next;
+        }
+    }
+}
+
+
+/**
+ *  Drops weekly events that block the same set as the one before them, the
+ *  week wrapping around to the first event.  Past the last absolute event
+ *  the weekly position of that event is compared against the weekly events,
+ *  so this is only done once there are no absolute events.
+ */
+static void __merge_weekly( schedule_t *s )
+{
+    schedule_event_t *p, *last;
+
+    if( (NULL != s->absolute) || (NULL == s->weekly) ) {
+        return;
+    }
+
+    p = s->weekly;
+    while( NULL != p->next ) {
+        if( __same_blocks(p, p->next) ) {
+            __remove_next( &p->next );
+        } else {
+            p = p->next;
+        }
+    }
+    last = p;
+
+    if( (last != s->weekly) && __same_blocks(last, s->weekly) ) {
+        __remove_next( &s->weekly );
+    }
+}
+
+
+/**
+ *  Marks the MACs blocked by a list in map (any value but UNUSED_MAC).
+ */
+static void __mark_used( schedule_event_t *head, uint32_t *map )
+{
+    size_t i;
+
+    for( ; NULL != head; head = head->next ) {
+        for( i = 0; i < head->block_count; i++ ) {
+            map[head->block[i]] = 0;
+        }
+    }
+}
@@ -0,0 +1,78 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __SCHEDULE_COMPACT_H__
+#define __SCHEDULE_COMPACT_H__
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "schedule.h"
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+
+typedef struct schedule_counts {
+    size_t weekly;                  /* Weekly events, not counting the copy
+                                     * finalize_schedule() adds. */
+    size_t absolute;                /* Absolute events. */
+    size_t macs;                    /* MAC table entries. */
+    size_t blocks;                  /* Block entries over all the events. */
+} schedule_counts_t;
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Fills in the counts of a schedule.
+ *
+ *  @param s the schedule to count
+ *  @param c [out] the counts, all 0 if s is NULL
+ */
+void count_schedule( schedule_t *s, schedule_counts_t *c );
+
+/**
+ *  Removes what an uploaded schedule can carry that never changes which
+ *  devices are blocked at or after now, then finalizes it again:
+ *
+ *   - duplicate indexes in an event, and duplicate MACs in the table
+ *   - the indexes of an event with one past the end of the MAC table, as
+ *     such an event blocks nothing
+ *   - absolute events before the last one at or before now
+ *   - events hidden by a later event at the same time
+ *   - events that block the same set as the event before them (weekly ones
+ *     only if no absolute events are left, as their weekly positions depend
+ *     on the time zone)
+ *   - MACs no event blocks, with the indexes renumbered
+ *
+ *  The block indexes of each event are left sorted.  At least one weekly
+ *  event, the last absolute event and one MAC are always kept, so the result
+ *  still encodes to a schedule decode_schedule() accepts.
+ *
+ *  @param s      the schedule, finalized or not
+ *  @param now    the current unix time, 0 to keep all the absolute events
+ *  @param before [out] the counts before, ignored if NULL
+ *  @param after  [out] the counts after, ignored if NULL
+ *
+ *  @return 0 on success, -1 on invalid input, -2 if out of memory (s is
+ *          untouched for both), -3 if finalize_schedule() failed
+ */
+int compact_schedule( schedule_t *s, time_t now,
+                      schedule_counts_t *before, schedule_counts_t *after );
+
+#endif
@@ -0,0 +1,349 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <msgpack.h>
+
+#include "schedule_gen.h"
+#include "schedule.h"
+#include "aker_mem.h"
+#include "time.h"
+#include "aker_log.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define DST_CHANGES_MAX     64
+#define DST_SCAN_STEP       3600
+#define DST_SCAN_DEFAULT    (366 * 24 * 3600)
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static uint64_t __next( uint64_t *state );
+static void __pack_string( msgpack_packer *pk, const char *s );
+static int __pack_events( msgpack_packer *pk, const schedule_gen_cfg_t *cfg,
+                          uint64_t *state, const char *time_key,
+                          size_t count, time_t start, time_t span,
+                          const time_t *extra, size_t extra_count );
+static size_t __find_dst_changes( const char *time_zone, time_t start,
+                                  time_t span, time_t *changes );
+static int __compare_times( const void *a, const void *b );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See schedule_gen.h for details. */
+void schedule_gen_defaults( schedule_gen_cfg_t *cfg )
+{
+    memset( cfg, 0, sizeof(schedule_gen_cfg_t) );
+    cfg->seed = 1;
+    cfg->weekly = 10;
+    cfg->absolute = 2;
+    cfg->macs = 4;
+    cfg->block_max = 2;
+    cfg->absolute_start = 1510689448;
+    cfg->absolute_span = SECONDS_IN_A_WEEK;
+    cfg->time_zone = "PST8PDT";
+}
+
+
+/* See schedule_gen.h for details. */
+size_t schedule_gen( const schedule_gen_cfg_t *cfg, uint8_t **data )
+{
+    msgpack_sbuffer sbuf;
+    msgpack_packer pk;
+    time_t changes[DST_CHANGES_MAX];
+    time_t weekly_extra[DST_CHANGES_MAX * 3 + 1];
+    time_t absolute_extra[DST_CHANGES_MAX * 3];
+    size_t change_count = 0, weekly_count = 0, absolute_count = 0;
+    uint64_t state;
+    size_t i, len = 0;
+    int rv = 0;
+
+    if( (NULL == cfg) || (NULL == data) || (0 == cfg->macs) ||
+        ((0 == cfg->weekly) && (0 == cfg->absolute)) )
+    {
+        return 0;
+    }
+
+    if( cfg->time_zero ) {
+        weekly_extra[weekly_count++] = 0;
+    }
+
+    if( cfg->dst_edges && (NULL != cfg->time_zone) ) {
+        time_t span = (0 < cfg->absolute) ? cfg->absolute_span : DST_SCAN_DEFAULT;
+
+        change_count = __find_dst_changes( cfg->time_zone, cfg->absolute_start,
+                                           span, changes );
+    }
+
+    /* The last second before, the first second after and, in local time,
+     * the second that was skipped or repeated. */
+    for( i = 0; i < change_count; i++ ) {
+        time_t before = convert_unix_time_to_weekly( changes[i] - 1 );
+
+        weekly_extra[weekly_count++] = before;
+        weekly_extra[weekly_count++] = (before + 1) % SECONDS_IN_A_WEEK;
+        weekly_extra[weekly_count++] = convert_unix_time_to_weekly( changes[i] );
+
+        if( 0 < cfg->absolute ) {
+            absolute_extra[absolute_count++] = changes[i] - 1;
+            absolute_extra[absolute_count++] = changes[i];
+            absolute_extra[absolute_count++] = changes[i] + 1;
+        }
+    }
+
+    /* xorshift64* needs a non-zero state. */
+    state = cfg->seed ^ 0x9e3779b97f4a7c15ULL;
+    if( 0 == state ) {
+        state = 1;
+    }
+
+    msgpack_sbuffer_init( &sbuf );
+    msgpack_packer_init( &pk, &sbuf, msgpack_sbuffer_write );
+    msgpack_pack_map( &pk, 1 + ((NULL != cfg->time_zone) ? 1 : 0) +
+                           ((0 < cfg->weekly) ? 1 : 0) +
+                           ((0 < cfg->absolute) ? 1 : 0) );
+
+    if( NULL != cfg->time_zone ) {
+        __pack_string( &pk, "time_zone" );
+        __pack_string( &pk, cfg->time_zone );
+    }
+
+    __pack_string( &pk, "macs" );
+    msgpack_pack_array( &pk, cfg->macs );
+    for( i = 0; i < cfg->macs; i++ ) {
+        char mac[MAC_ADDRESS_SIZE];
+
+        /* Locally administered, unique per index. */
+        snprintf( mac, sizeof(mac), "02:%02x:%02x:%02x:%02x:%02x",
+                  (unsigned) (cfg->seed & 0xff),
+                  (unsigned) ((i >> 24) & 0xff), (unsigned) ((i >> 16) & 0xff),
+                  (unsigned) ((i >> 8) & 0xff), (unsigned) (i & 0xff) );
+        __pack_string( &pk, mac );
+    }
+
+    if( 0 < cfg->weekly ) {
+        __pack_string( &pk, "weekly" );
+        rv |= __pack_events( &pk, cfg, &state, "time", cfg->weekly,
+                             0, SECONDS_IN_A_WEEK, weekly_extra, weekly_count );
+    }
+
+    if( 0 < cfg->absolute ) {
+        __pack_string( &pk, "absolute" );
+        rv |= __pack_events( &pk, cfg, &state, "unix_time", cfg->absolute,
+                             cfg->absolute_start, cfg->absolute_span,
+                             absolute_extra, absolute_count );
+    }
+
+    if( (0 == rv) && (NULL != sbuf.data) ) {
+        *data = (uint8_t*) aker_malloc( sbuf.size );
+        if( NULL != *data ) {
+            memcpy( *data, sbuf.data, sbuf.size );
+            len = sbuf.size;
+        }
+    }
+    msgpack_sbuffer_destroy( &sbuf );
+
+    return len;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  xorshift64*: small, fast and identical on every platform.
+ */
+static uint64_t __next( uint64_t *state )
+{
+    uint64_t x = *state;
+
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+
+    return x * 0x2545f4914f6cdd1dULL;
+}
+
+
+static void __pack_string( msgpack_packer *pk, const char *s )
+{
+    size_t len = strlen( s );
+
+    msgpack_pack_str( pk, len );
+    msgpack_pack_str_body( pk, s, len );
+}
+
+
+/**
+ *  Packs an array of events spread evenly over [start, start + span) with a
+ *  random offset inside each slot, so times are sorted and distinct as long
+ *  as there are no more events than seconds.  The extra times are merged in.
+ *
+ *  @return 0 on success, error otherwise
+ */
+static int __pack_events( msgpack_packer *pk, const schedule_gen_cfg_t *cfg,
+                          uint64_t *state, const char *time_key,
+                          size_t count, time_t start, time_t span,
+                          const time_t *extra, size_t extra_count )
+{
+    uint64_t slot = (uint64_t) span / count;
+    uint32_t *prev, *cur;
+    size_t prev_count = 0;
+    time_t *times;
+    size_t i, j, n;
+
+    times = (time_t*) aker_malloc( (count + extra_count) * sizeof(time_t) );
+    prev = (uint32_t*) aker_malloc( (cfg->block_max + 1) * 2 * sizeof(uint32_t) );
+    if( (NULL == times) || (NULL == prev) ) {
+        aker_free( times );
+        aker_free( prev );
+        msgpack_pack_array( pk, 0 );
+        return -1;
+    }
+    cur = &prev[cfg->block_max + 1];
+
+    for( i = 0; i < count; i++ ) {
+        uint64_t t = (uint64_t) i * (uint64_t) span / count;
+
+        if( 1 < slot ) {
+            t += __next( state ) % slot;
+        }
+        times[i] = start + (time_t) t;
+    }
+
+    n = count;
+    if( 0 < extra_count ) {
+        memcpy( &times[count], extra, extra_count * sizeof(time_t) );
+        qsort( times, count + extra_count, sizeof(time_t), __compare_times );
+
+        for( i = 1, n = 1; i < count + extra_count; i++ ) {
+            if( times[i] != times[n - 1] ) {
+                times[n++] = times[i];
+            }
+        }
+    }
+
+    msgpack_pack_array( pk, n );
+    for( i = 0; i < n; i++ ) {
+        size_t blocks = 0;
+
+        if( 0 < cfg->block_max ) {
+            blocks = __next( state ) % (cfg->block_max + 1);
+        }
+
+        for( j = 0; j < blocks; j++ ) {
+            if( (0 < prev_count) && (0 < cfg->overlap) &&
+                ((__next(state) % 100) < cfg->overlap) )
+            {
+                cur[j] = prev[__next(state) % prev_count];
+            } else {
+                cur[j] = (uint32_t) (__next(state) % cfg->macs);
+            }
+        }
+
+        msgpack_pack_map( pk, 2 );
+        __pack_string( pk, time_key );
+        msgpack_pack_int64( pk, (int64_t) times[i] );
+
+        __pack_string( pk, "indexes" );
+        msgpack_pack_array( pk, blocks );
+        for( j = 0; j < blocks; j++ ) {
+            msgpack_pack_uint32( pk, cur[j] );
+        }
+
+        if( 0 < blocks ) {
+            memcpy( prev, cur, blocks * sizeof(uint32_t) );
+            prev_count = blocks;
+        }
+    }
+
+    aker_free( times );
+    aker_free( prev );
+
+    return 0;
+}
+
+
+/**
+ *  Finds the seconds in [start, start + span) at which the time zone moves
+ *  into or out of daylight saving time.
+ *
+ *  @param time_zone the POSIX time zone to look at
+ *  @param start     where to start looking
+ *  @param span      how long to look for
+ *  @param changes   [out] the first second of each change (DST_CHANGES_MAX)
+ *
+ *  @return the number of changes found
+ */
+static size_t __find_dst_changes( const char *time_zone, time_t start,
+                                  time_t span, time_t *changes )
+{
+    struct tm ts;
+    time_t t, end = start + span;
+    size_t count = 0;
+    int dst;
+
+    set_unix_time_zone( time_zone );
+
+    localtime_r( &start, &ts );
+    dst = ts.tm_isdst;
+
+    for( t = start + DST_SCAN_STEP; (t < end) && (count < DST_CHANGES_MAX);
+         t += DST_SCAN_STEP )
+    {
+        localtime_r( &t, &ts );
+        if( ts.tm_isdst != dst ) {
+            time_t lo = t - DST_SCAN_STEP, hi = t;
+
+            /* lo is on the old side, hi on the new side. */
+            while( 1 < hi - lo ) {
+                time_t mid = lo + (hi - lo) / 2;
+
+                localtime_r( &mid, &ts );
+                if( ts.tm_isdst == dst ) {
+                    lo = mid;
+                } else {
+                    hi = mid;
+                }
+            }
+
+            changes[count++] = hi;
+            localtime_r( &hi, &ts );
+            dst = ts.tm_isdst;
+        }
+    }
+
+    debug_info( "Found %zu DST changes in %s\n", count, time_zone );
+
+    return count;
+}
+
+
+static int __compare_times( const void *a, const void *b )
+{
+    time_t x = *(const time_t*) a;
+    time_t y = *(const time_t*) b;
+
+    return (x > y) - (x < y);
+}
@@ -0,0 +1,76 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __SCHEDULE_GEN_H__
+#define __SCHEDULE_GEN_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+typedef struct schedule_gen_cfg {
+    uint64_t    seed;           /* The same seed always makes the same bytes. */
+    size_t      weekly;         /* Number of weekly events. */
+    size_t      absolute;       /* Number of absolute events. */
+    size_t      macs;           /* Size of the MAC table. */
+    size_t      block_max;      /* Most MACs one event blocks (density). */
+    unsigned    overlap;        /* Percent chance a blocked MAC is one the
+                                 * previous event blocked too. */
+    time_t      absolute_start; /* Time of the first absolute event. */
+    time_t      absolute_span;  /* Absolute events are spread over this. */
+    const char  *time_zone;     /* Left out of the schedule if NULL. */
+    bool        dst_edges;      /* Add events around every DST change. */
+    bool        time_zero;      /* Add a weekly event at time 0. */
+} schedule_gen_cfg_t;
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Fills in a small but valid configuration.
+ *
+ *  @param cfg the configuration to initialize
+ */
+void schedule_gen_defaults( schedule_gen_cfg_t *cfg );
+
+/**
+ *  Generates a msgpack schedule in the format decode_schedule() accepts.
+ *  Events are emitted in time order with distinct times whenever the count
+ *  fits in the week (or the absolute span).
+ *
+ *  The edge case events (dst_edges, time_zero) are added on top of the
+ *  requested counts; duplicate times are dropped.  DST changes are looked for
+ *  in the absolute span, or in the year after absolute_start if there are no
+ *  absolute events.
+ *
+ *  @note With dst_edges the process time zone is set to cfg->time_zone, the
+ *        same as decode_schedule() does.
+ *
+ *  @note The returned buffer needs to be aker_free()-ed by the caller.
+ *
+ *  @param cfg  the shape of the schedule
+ *  @param data [out] the msgpack bytes
+ *
+ *  @return the length of the msgpack bytes, 0 on error
+ */
+size_t schedule_gen( const schedule_gen_cfg_t *cfg, uint8_t **data );
+
+#endif
@@ -0,0 +1,373 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "schedule_image.h"
+#include "aker_log.h"
+#include "aker_mem.h"
+#include "crc32c.h"
+#include "persist.h"
+#include "time.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define IMAGE_MAGIC     0x4d494b41  /* "AKIM", also catches a byte order swap */
+#define IMAGE_VERSION   1
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+
+/* The body follows the header in this order:
+ *   image_event_t weekly[weekly_count]
+ *   image_event_t absolute[absolute_count]
+ *   uint32_t      blocks[block_total]
+ *   mac_address   macs[mac_count]
+ *   char          time_zone[tz_len]        (not null terminated) */
+typedef struct image_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t body_crc;          /* CRC-32C of everything after the header. */
+    uint32_t source_crc;        /* CRC-32C of the source signature file. */
+    uint64_t body_size;
+    uint32_t mac_count;
+    uint32_t weekly_count;
+    uint32_t absolute_count;
+    uint32_t block_total;
+    uint32_t tz_len;
+    uint32_t reserved;
+} image_header_t;
+
+typedef struct image_event {
+    int64_t  time;
+    uint32_t block_start;       /* Index into the blocks array. */
+    uint32_t block_count;
+} image_event_t;
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static uint32_t __count_events( const schedule_event_t *e, uint32_t *blocks );
+static uint8_t* __write_events( uint8_t *p, const schedule_event_t *e,
+                                uint32_t *block_start );
+static uint8_t* __write_blocks( uint8_t *p, const schedule_event_t *e );
+static int __read_events( const image_event_t *ie, uint32_t count,
+                          const uint32_t *blocks, uint32_t block_total,
+                          schedule_event_t **head );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See schedule_image.h for details. */
+int schedule_image_write( const char *filename, const schedule_t *s,
+                          const uint8_t *source, size_t source_len )
+{
+    image_header_t h;
+    uint8_t *buf, *p;
+    uint32_t block_start = 0;
+    size_t size;
+    int rv;
+
+    if( (NULL == filename) || (NULL == s) || (NULL == source) ) {
+        return -1;
+    }
+
+    memset( &h, 0, sizeof(h) );
+    h.magic = IMAGE_MAGIC;
+    h.version = IMAGE_VERSION;
+    h.source_crc = crc32c( source, source_len );
+    h.mac_count = (uint32_t) s->mac_count;
+    h.weekly_count = __count_events( s->weekly, &h.block_total );
+    h.absolute_count = __count_events( s->absolute, &h.block_total );
+    if( NULL != s->time_zone ) {
+        h.tz_len = (uint32_t) strlen( s->time_zone );
+    }
+
+    h.body_size = (uint64_t) (h.weekly_count + h.absolute_count) * sizeof(image_event_t)
+                + (uint64_t) h.block_total * sizeof(uint32_t)
+                + (uint64_t) h.mac_count * sizeof(mac_address)
+                + h.tz_len;
+    size = sizeof(h) + (size_t) h.body_size;
+
+    buf = (uint8_t*) aker_malloc( size );
+    if( NULL == buf ) {
+        debug_error( "schedule_image_write() failed to allocate %zu bytes\n", size );
+        return -1;
+    }
+
+    p = &buf[sizeof(h)];
+    p = __write_events( p, s->weekly, &block_start );
+    p = __write_events( p, s->absolute, &block_start );
+    p = __write_blocks( p, s->weekly );
+    p = __write_blocks( p, s->absolute );
+    if( 0 < h.mac_count ) {
+        memcpy( p, s->macs, h.mac_count * sizeof(mac_address) );
+        p += h.mac_count * sizeof(mac_address);
+    }
+    if( 0 < h.tz_len ) {
+        memcpy( p, s->time_zone, h.tz_len );
+    }
+
+    h.body_crc = crc32c( &buf[sizeof(h)], (size_t) h.body_size );
+    memcpy( buf, &h, sizeof(h) );
+
+    rv = persist_write_file( filename, buf, size );
+    if( 0 != rv ) {
+        debug_error( "schedule_image_write() failed to write %s\n", filename );
+    }
+    aker_free( buf );
+
+    return rv;
+}
+
+
+/* See schedule_image.h for details. */
+int schedule_image_load( const char *filename, const uint8_t *source,
+                         size_t source_len, schedule_t **s )
+{
+    const image_header_t *h;
+    const uint8_t *body;
+    const image_event_t *weekly, *absolute;
+    const uint32_t *blocks;
+    const mac_address *macs;
+    schedule_t *n = NULL;
+    struct stat st;
+    void *map;
+    uint64_t expected;
+    int fd, rv = 0;
+
+    if( (NULL == filename) || (NULL == source) || (NULL == s) ) {
+        return -1;
+    }
+
+    fd = open( filename, O_RDONLY );
+    if( fd < 0 ) {
+        return -1;
+    }
+    if( (0 != fstat(fd, &st)) || (st.st_size < (off_t) sizeof(image_header_t)) ) {
+        close( fd );
+        return -1;
+    }
+    map = mmap( NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if( MAP_FAILED == map ) {
+        return -1;
+    }
+
+    h = (const image_header_t*) map;
+    body = (const uint8_t*) map + sizeof(image_header_t);
+
+    if( (IMAGE_MAGIC != h->magic) || (IMAGE_VERSION != h->version) ) {
+        rv = -2;
+        goto done;
+    }
+    if( crc32c(source, source_len) != h->source_crc ) {
+        rv = -3;
+        goto done;
+    }
+
+    expected = (uint64_t) ((uint64_t) h->weekly_count + h->absolute_count) * sizeof(image_event_t)
+             + (uint64_t) h->block_total * sizeof(uint32_t)
+             + (uint64_t) h->mac_count * sizeof(mac_address)
+             + h->tz_len;
+    if( (expected != h->body_size) ||
+        ((uint64_t) st.st_size != sizeof(image_header_t) + h->body_size) ||
+        (crc32c(body, (size_t) h->body_size) != h->body_crc) )
+    {
+        rv = -4;
+        goto done;
+    }
+
+    weekly = (const image_event_t*) body;
+    absolute = &weekly[h->weekly_count];
+    blocks = (const uint32_t*) &absolute[h->absolute_count];
+    macs = (const mac_address*) &blocks[h->block_total];
+
+    n = create_schedule();
+    if( NULL == n ) {
+        rv = -5;
+        goto done;
+    }
+
+    if( 0 < h->mac_count ) {
+        if( 0 != create_mac_table(n, h->mac_count) ) {
+            rv = -5;
+            goto done;
+        }
+        memcpy( n->macs, macs, h->mac_count * sizeof(mac_address) );
+    }
+
+    if( 0 < h->tz_len ) {
+        n->time_zone = strndup( (const char*) &macs[h->mac_count], h->tz_len );
+        if( NULL == n->time_zone ) {
+            rv = -5;
+            goto done;
+        }
+    }
+
+    rv = __read_events( weekly, h->weekly_count, blocks, h->block_total, &n->weekly );
+    if( 0 == rv ) {
+        rv = __read_events( absolute, h->absolute_count, blocks, h->block_total,
+                            &n->absolute );
+    }
+    if( (0 == rv) && (0 != build_schedule_index(n)) ) {
+        rv = -5;
+    }
+
+done:
+    munmap( map, (size_t) st.st_size );
+
+    if( 0 == rv ) {
+        if( NULL != n->time_zone ) {
+            (void) set_unix_time_zone( n->time_zone );
+        }
+        *s = n;
+    } else {
+        debug_info( "schedule_image_load() %s not used: %d\n", filename, rv );
+        destroy_schedule( n );
+    }
+
+    return rv;
+}
+
+
+/* See schedule_image.h for details. */
+char* schedule_image_name( const char *data_file )
+{
+    char *name = NULL;
+
+    if( NULL != data_file ) {
+        size_t len = strlen( data_file );
+
+        name = (char*) aker_malloc( len + sizeof(SCHEDULE_IMAGE_SUFFIX) );
+        if( NULL != name ) {
+            memcpy( name, data_file, len );
+            memcpy( &name[len], SCHEDULE_IMAGE_SUFFIX, sizeof(SCHEDULE_IMAGE_SUFFIX) );
+        }
+    }
+
+    return name;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Counts the events in a list and adds their blocks to the running total.
+ */
+static uint32_t __count_events( const schedule_event_t *e, uint32_t *blocks )
+{
+    uint32_t count = 0;
+
+    for( ; NULL != e; e = e->next ) {
+        *blocks += (uint32_t) e->block_count;
+        count++;
+    }
+
+    return count;
+}
+
+
+/**
+ *  Writes the fixed size event records for a list.
+ */
+static uint8_t* __write_events( uint8_t *p, const schedule_event_t *e,
+                                uint32_t *block_start )
+{
+    for( ; NULL != e; e = e->next ) {
+        image_event_t ie;
+
+        ie.time = (int64_t) e->time;
+        ie.block_start = *block_start;
+        ie.block_count = (uint32_t) e->block_count;
+        memcpy( p, &ie, sizeof(ie) );
+        p += sizeof(ie);
+        *block_start += ie.block_count;
+    }
+
+    return p;
+}
+
+
+/**
+ *  Writes the block indexes of every event in a list back to back.
+ */
+static uint8_t* __write_blocks( uint8_t *p, const schedule_event_t *e )
+{
+    for( ; NULL != e; e = e->next ) {
+        size_t len = e->block_count * sizeof(uint32_t);
+
+        if( 0 < len ) {
+            memcpy( p, e->block, len );
+            p += len;
+        }
+    }
+
+    return p;
+}
+
+
+/**
+ *  Rebuilds a sorted list from image records.  The records are already in
+ *  list order so each one is appended at the tail.
+ *
+ *  @return 0 on success, -4 if a record is out of bounds, -5 on allocation
+ *          failure
+ */
+static int __read_events( const image_event_t *ie, uint32_t count,
+                          const uint32_t *blocks, uint32_t block_total,
+                          schedule_event_t **head )
+{
+    schedule_event_t **tail = head;
+    uint32_t i;
+
+    for( i = 0; i < count; i++ ) {
+        schedule_event_t *e;
+
+        if( ((uint64_t) ie[i].block_start + ie[i].block_count > block_total) ||
+            ((0 < i) && (ie[i].time < ie[i - 1].time)) )
+        {
+            return -4;
+        }
+
+        e = create_schedule_event( ie[i].block_count );
+        if( NULL == e ) {
+            return -5;
+        }
+        e->time = (time_t) ie[i].time;
+        if( 0 < ie[i].block_count ) {
+            memcpy( e->block, &blocks[ie[i].block_start],
+                    ie[i].block_count * sizeof(uint32_t) );
+        }
+
+        *tail = e;
+        tail = &e->next;
+    }
+
+    return 0;
+}
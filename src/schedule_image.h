@@ -0,0 +1,78 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __SCHEDULE_IMAGE_H__
+#define __SCHEDULE_IMAGE_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "schedule.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define SCHEDULE_IMAGE_SUFFIX   ".img"
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Writes a compiled (already finalized) schedule out as a flat binary image
+ *  that can be loaded without decoding the msgpack source again.
+ *
+ *  The image is position independent (offsets only, no pointers) and carries
+ *  a version, a CRC-32C of its contents and the CRC-32C of the signature file
+ *  of the msgpack data it was compiled from.
+ *
+ *  @param filename   the image file to write
+ *  @param s          the schedule to write
+ *  @param source     the signature file contents of the msgpack source
+ *  @param source_len the length of the signature file contents
+ *
+ *  @return 0 on success, error otherwise
+ */
+int schedule_image_write( const char *filename, const schedule_t *s,
+                          const uint8_t *source, size_t source_len );
+
+/**
+ *  Maps an image file and rebuilds the schedule from it.
+ *
+ *  @param filename   the image file to load
+ *  @param source     the signature file contents of the current msgpack data
+ *  @param source_len the length of the signature file contents
+ *  @param s          [out] the schedule, untouched on error
+ *
+ *  @return 0 on success, -1 if the image can't be read, -2 if it is from a
+ *          different version, -3 if it is stale, -4 if it is corrupt,
+ *          -5 on allocation failure
+ */
+int schedule_image_load( const char *filename, const uint8_t *source,
+                         size_t source_len, schedule_t **s );
+
+/**
+ *  Makes the image file name used for a schedule data file.
+ *
+ *  @note The returned string needs to be aker_free()-ed by the caller.
+ *
+ *  @param data_file the msgpack schedule data file
+ *
+ *  @return the image file name, NULL on failure
+ */
+char* schedule_image_name( const char *data_file );
+
+#endif
@@ -0,0 +1,488 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "schedule_merge.h"
+#include "aker_log.h"
+#include "aker_mem.h"
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+
+/* One MAC address of the union, as it is being built. */
+typedef struct merge_mac {
+    const char *mac;
+    size_t order;
+} merge_mac_t;
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static int __find( const schedule_merge_t *m, const char *name, bool *found );
+static int __grow( schedule_merge_t *m );
+static void __evaluate( merge_source_t *src, time_t now );
+static void __sift_down( schedule_merge_t *m, size_t i );
+static char* __union( const schedule_merge_t *m );
+static int __compare_mac( const void *a, const void *b );
+static int __compare_order( const void *a, const void *b );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See schedule_merge.h for details. */
+void schedule_merge_init( schedule_merge_t *m )
+{
+    memset( m, 0, sizeof(schedule_merge_t) );
+}
+
+
+/* See schedule_merge.h for details. */
+void schedule_merge_destroy( schedule_merge_t *m )
+{
+    size_t i;
+
+    for( i = 0; i < m->count; i++ ) {
+        destroy_schedule( m->src[i].s );
+        if( NULL != m->src[i].name )    aker_free( m->src[i].name );
+        if( NULL != m->src[i].blocked ) aker_free( m->src[i].blocked );
+    }
+    if( NULL != m->src )  aker_free( m->src );
+    if( NULL != m->heap ) aker_free( m->heap );
+
+    schedule_merge_init( m );
+}
+
+
+/* See schedule_merge.h for details. */
+int schedule_merge_swap( schedule_merge_t *m, const char *name,
+                         schedule_t *s, schedule_t **old )
+{
+    merge_source_t *src;
+    bool found;
+    int i;
+
+    *old = NULL;
+    i = __find( m, name, &found );
+
+    if( found ) {
+        src = &m->src[i];
+        *old = src->s;
+        if( NULL != s ) {
+            src->s = s;
+            src->stale = true;
+        } else {
+            if( NULL != src->name )    aker_free( src->name );
+            if( NULL != src->blocked ) aker_free( src->blocked );
+            memmove( src, src + 1, (m->count - i - 1) * sizeof(merge_source_t) );
+            m->count--;
+        }
+    } else if( NULL != s ) {
+        char *copy = NULL;
+
+        if( NULL != name ) {
+            copy = strdup( name );
+            if( NULL == copy ) {
+                return -2;
+            }
+        }
+        if( (m->count == m->capacity) && (0 != __grow(m)) ) {
+            if( NULL != copy ) aker_free( copy );
+            return -2;
+        }
+
+        src = &m->src[i];
+        memmove( src + 1, src, (m->count - i) * sizeof(merge_source_t) );
+        memset( src, 0, sizeof(merge_source_t) );
+        src->name = copy;
+        src->s = s;
+        src->stale = true;
+        m->count++;
+    }
+
+    /* The weekly times of every schedule depend on the main one's zone. */
+    if( (NULL == name) && (NULL != s) ) {
+        size_t j;
+
+        for( j = 0; j < m->count; j++ ) {
+            m->src[j].stale = true;
+        }
+    }
+    m->dirty = true;
+
+    return 0;
+}
+
+
+/* See schedule_merge.h for details. */
+schedule_t* schedule_merge_get( const schedule_merge_t *m, const char *name )
+{
+    bool found;
+    int i;
+
+    i = __find( m, name, &found );
+
+    return found ? m->src[i].s : NULL;
+}
+
+
+/* See schedule_merge.h for details. */
+char* schedule_merge_blocked( schedule_merge_t *m, time_t now )
+{
+    size_t i;
+
+    if( now < m->evaluated ) {
+        for( i = 0; i < m->count; i++ ) {
+            m->src[i].stale = true;
+        }
+        m->dirty = true;
+    }
+    m->evaluated = now;
+
+    if( m->dirty ) {
+        for( i = 0; i < m->count; i++ ) {
+            if( m->src[i].stale ) {
+                __evaluate( &m->src[i], now );
+            }
+            m->heap[i] = i;
+        }
+        for( i = m->count / 2; 0 < i; i-- ) {
+            __sift_down( m, i - 1 );
+        }
+        m->dirty = false;
+    }
+
+    /* Only the sources with a transition due are looked at again. */
+    while( (0 < m->count) && (m->src[m->heap[0]].next <= now) ) {
+        __evaluate( &m->src[m->heap[0]], now );
+        __sift_down( m, 0 );
+    }
+
+    return __union( m );
+}
+
+
+/* See schedule_merge.h for details. */
+time_t schedule_merge_next( const schedule_merge_t *m )
+{
+    if( m->dirty ) {
+        return 0;
+    }
+    if( 0 == m->count ) {
+        return INT_MAX;
+    }
+
+    return m->src[m->heap[0]].next;
+}
+
+
+/* See schedule_merge.h for details. */
+int schedule_merge_device_status( const schedule_merge_t *m, const char *mac,
+                                  time_t unixtime, bool *blocked,
+                                  time_t *next_change )
+{
+    bool found = false, indexed = false, state = false;
+    time_t t = unixtime;
+    int step;
+
+    for( step = 0; step < MERGE_MAX_STEPS; step++ ) {
+        time_t next = INT_MAX;
+        bool any = false;
+        size_t i;
+
+        for( i = 0; i < m->count; i++ ) {
+            time_t n;
+            bool b;
+            int rv;
+
+            rv = get_device_status( m->src[i].s, mac, t, &b, &n );
+            if( -1 != rv ) {
+                indexed = true;
+            }
+            if( 0 == rv ) {
+                found = true;
+                any = any || b;
+                if( n < next ) {
+                    next = n;
+                }
+            }
+        }
+
+        if( 0 == step ) {
+            if( !found ) {
+                return indexed ? -2 : -1;
+            }
+            state = any;
+            *blocked = any;
+        } else if( any != state ) {
+            *next_change = t;
+            return 0;
+        }
+
+        if( INT_MAX == next ) {
+            *next_change = INT_MAX;
+            return 0;
+        }
+        t = next;
+    }
+
+    /* Still no change: the caller has to ask again by then. */
+    *next_change = t;
+
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Binary searches the sources for a name, the main schedule sorting first.
+ *
+ *  @return the position of the source, or where it would go if not found
+ */
+static int __find( const schedule_merge_t *m, const char *name, bool *found )
+{
+    int lo = 0, hi = (int) m->count;
+
+    *found = false;
+    while( lo < hi ) {
+        int mid = lo + (hi - lo) / 2;
+        const char *n = m->src[mid].name;
+        int cmp;
+
+        if( NULL == n ) {
+            cmp = (NULL == name) ? 0 : -1;
+        } else {
+            cmp = (NULL == name) ? 1 : strcmp( n, name );
+        }
+
+        if( 0 == cmp ) {
+            *found = true;
+            return mid;
+        }
+        if( cmp < 0 ) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+
+/**
+ *  Doubles the room for sources.
+ *
+ *  @return 0 on success, -1 on memory errors
+ */
+static int __grow( schedule_merge_t *m )
+{
+    size_t capacity = (0 < m->capacity) ? (2 * m->capacity) : 4;
+    merge_source_t *src;
+    size_t *heap;
+
+    src = (merge_source_t*) aker_malloc( capacity * sizeof(merge_source_t) );
+    heap = (size_t*) aker_malloc( capacity * sizeof(size_t) );
+    if( (NULL == src) || (NULL == heap) ) {
+        if( NULL != src )  aker_free( src );
+        if( NULL != heap ) aker_free( heap );
+        return -1;
+    }
+
+    if( 0 < m->count ) {
+        memcpy( src, m->src, m->count * sizeof(merge_source_t) );
+    }
+    if( NULL != m->src )  aker_free( m->src );
+    if( NULL != m->heap ) aker_free( m->heap );
+
+    m->src = src;
+    m->heap = heap;
+    m->capacity = capacity;
+
+    return 0;
+}
+
+
+/**
+ *  Looks up one source's blocked set and its next transition.
+ */
+static void __evaluate( merge_source_t *src, time_t now )
+{
+    if( NULL != src->blocked ) {
+        aker_free( src->blocked );
+    }
+    src->blocked = get_blocked_at_time( src->s, now );
+    src->next = get_next_transition( src->s, now );
+    src->stale = false;
+}
+
+
+/**
+ *  Moves a heap entry down until neither child transitions before it.
+ */
+static void __sift_down( schedule_merge_t *m, size_t i )
+{
+    for( ;; ) {
+        size_t l = 2 * i + 1, r = l + 1, min = i, tmp;
+
+        if( (l < m->count) && (m->src[m->heap[l]].next < m->src[m->heap[min]].next) ) {
+            min = l;
+        }
+        if( (r < m->count) && (m->src[m->heap[r]].next < m->src[m->heap[min]].next) ) {
+            min = r;
+        }
+        if( min == i ) {
+            return;
+        }
+
+        tmp = m->heap[i];
+        m->heap[i] = m->heap[min];
+        m->heap[min] = tmp;
+        i = min;
+    }
+}
+
+
+/**
+ *  Joins the sources' blocked sets, leaving out MAC addresses already in an
+ *  earlier one.
+ *
+ *  @return the union, NULL if nothing is blocked or on memory errors
+ */
+static char* __union( const schedule_merge_t *m )
+{
+    merge_mac_t *macs = NULL;
+    char *buf = NULL, *out = NULL, *p;
+    size_t i, k, n = 0, len = 0, sets = 0, max = 0;
+
+    for( i = 0; i < m->count; i++ ) {
+        if( NULL != m->src[i].blocked ) {
+            const char *c;
+
+            len += strlen( m->src[i].blocked ) + 1;
+            for( c = m->src[i].blocked; '\0' != *c; c++ ) {
+                max += (' ' == *c) ? 1 : 0;
+            }
+            max++;
+            sets++;
+        }
+    }
+
+    if( 0 == sets ) {
+        return NULL;
+    }
+
+    /* A single set is already the answer. */
+    if( 1 == sets ) {
+        for( i = 0; NULL == m->src[i].blocked; i++ ) {
+            ;
+        }
+        return strdup( m->src[i].blocked );
+    }
+
+    buf = (char*) aker_malloc( len );
+    out = (char*) aker_malloc( len );
+    macs = (merge_mac_t*) aker_malloc( max * sizeof(merge_mac_t) );
+    if( (NULL == buf) || (NULL == out) || (NULL == macs) ) {
+        debug_error( "schedule_merge_blocked() out of memory\n" );
+        if( NULL != out ) aker_free( out );
+        out = NULL;
+        goto done;
+    }
+
+    p = buf;
+    for( i = 0; i < m->count; i++ ) {
+        char *save = NULL, *mac;
+
+        if( NULL == m->src[i].blocked ) {
+            continue;
+        }
+        strcpy( p, m->src[i].blocked );
+        for( mac = strtok_r(p, " ", &save); NULL != mac; mac = strtok_r(NULL, " ", &save) ) {
+            macs[n].mac = mac;
+            macs[n].order = n;
+            n++;
+        }
+        p += strlen( m->src[i].blocked ) + 1;
+    }
+
+    /* Equal addresses end up next to each other, the first one first. */
+    qsort( macs, n, sizeof(merge_mac_t), __compare_mac );
+    for( i = 1, k = 0; i < n; i++ ) {
+        if( 0 == strcasecmp(macs[k].mac, macs[i].mac) ) {
+            macs[i].mac = NULL;
+        } else {
+            k = i;
+        }
+    }
+    qsort( macs, n, sizeof(merge_mac_t), __compare_order );
+
+    p = out;
+    for( i = 0; i < n; i++ ) {
+        if( NULL != macs[i].mac ) {
+            if( p != out ) {
+                *p++ = ' ';
+            }
+            strcpy( p, macs[i].mac );
+            p += strlen( macs[i].mac );
+        }
+    }
+    *p = '\0';
+
+done:
+    if( NULL != buf )  aker_free( buf );
+    if( NULL != macs ) aker_free( macs );
+
+    return out;
+}
+
+
+/**
+ *  Orders MAC addresses ignoring case, then by where they came in.
+ */
+static int __compare_mac( const void *a, const void *b )
+{
+    const merge_mac_t *x = (const merge_mac_t*) a;
+    const merge_mac_t *y = (const merge_mac_t*) b;
+    int cmp = strcasecmp( x->mac, y->mac );
+
+    if( 0 != cmp ) {
+        return cmp;
+    }
+
+    return (x->order < y->order) ? -1 : 1;
+}
+
+
+/**
+ *  Orders MAC addresses by where they came in.
+ */
+static int __compare_order( const void *a, const void *b )
+{
+    const merge_mac_t *x = (const merge_mac_t*) a;
+    const merge_mac_t *y = (const merge_mac_t*) b;
+
+    return (x->order > y->order) - (x->order < y->order);
+}
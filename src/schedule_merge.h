@@ -0,0 +1,135 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __SCHEDULE_MERGE_H__
+#define __SCHEDULE_MERGE_H__
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "schedule.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define MERGE_MAX_STEPS     1024    /* Transitions a device status merge
+                                     * looks through for a change. */
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+
+typedef struct merge_source {
+    char *name;                     /* NULL for the main schedule. */
+    schedule_t *s;
+    char *blocked;                  /* Its blocked set when last looked at. */
+    time_t next;                    /* Its next transition after that,
+                                     * INT_MAX if none. */
+    bool stale;                     /* blocked and next need looking up. */
+} merge_source_t;
+
+/* Several schedules in force at once, the blocked set being the union of
+ * theirs.  Each source's set only changes at its own transitions, so the
+ * sources are kept in a min-heap on their next transition and only the ones
+ * due (or replaced) are looked at again: the transition streams are merged
+ * k ways. */
+typedef struct schedule_merge {
+    merge_source_t *src;            /* The main schedule first, then by name. */
+    size_t count;
+    size_t capacity;
+    size_t *heap;                   /* src[] positions, a min-heap on next. */
+    bool dirty;                     /* A source was added, removed or
+                                     * replaced since the heap was built. */
+    time_t evaluated;               /* The last time looked at. */
+} schedule_merge_t;
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Sets up an empty merge.
+ */
+void schedule_merge_init( schedule_merge_t *m );
+
+/**
+ *  Destroys every schedule in the merge and frees it.
+ */
+void schedule_merge_destroy( schedule_merge_t *m );
+
+/**
+ *  Puts in, replaces or takes out one schedule.  Replacing the main schedule
+ *  has every source looked at again, as its time zone is the process's.
+ *
+ *  @param m    the merge
+ *  @param name the schedule's name, NULL for the main schedule
+ *  @param s    the finalized schedule to take ownership of, NULL to take the
+ *              named one out
+ *  @param old  [out] the schedule it replaces, for the caller to destroy
+ *
+ *  @return 0 on success, -2 if out of memory (s is not taken)
+ */
+int schedule_merge_swap( schedule_merge_t *m, const char *name,
+                         schedule_t *s, schedule_t **old );
+
+/**
+ *  Returns a schedule in the merge, NULL if there is none by that name.
+ *
+ *  @param m    the merge
+ *  @param name the schedule's name, NULL for the main schedule
+ */
+schedule_t* schedule_merge_get( const schedule_merge_t *m, const char *name );
+
+/**
+ *  Gets the union of the blocked sets of all the schedules at this time.
+ *  Only the schedules with a transition since the last call, or that were
+ *  swapped in, are looked at; all of them if time went backwards.
+ *
+ *  @param m   the merge
+ *  @param now the time to look at
+ *
+ *  @return the space separated MAC addresses, each once, in the order of
+ *          the schedules and their MAC tables, NULL if none (caller frees)
+ */
+char* schedule_merge_blocked( schedule_merge_t *m, time_t now );
+
+/**
+ *  Returns the earliest next transition of any schedule as of the last
+ *  schedule_merge_blocked(), 0 if that has to be called again first, or
+ *  INT_MAX if there is none.
+ */
+time_t schedule_merge_next( const schedule_merge_t *m );
+
+/**
+ *  Gets one device's state across all the schedules: blocked if any
+ *  schedule blocks it, changing at the first transition of any of them
+ *  where that answer flips.
+ *
+ *  @param m           the merge
+ *  @param mac         the device's MAC address
+ *  @param unixtime    the time to look at
+ *  @param blocked     where to put whether the device is blocked
+ *  @param next_change where to put when that next changes, INT_MAX if never
+ *
+ *  @return 0 on success, -1 if there is no indexed schedule, -2 if the
+ *          device is in none of them
+ */
+int schedule_merge_device_status( const schedule_merge_t *m, const char *mac,
+                                  time_t unixtime, bool *blocked,
+                                  time_t *next_change );
+
+#endif
@@ -0,0 +1,559 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <msgpack.h>
+
+#include "schedule_patch.h"
+#include "aker_log.h"
+#include "aker_mem.h"
+#include "time.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define BASE_STR          "base"
+#define OPS_STR           "ops"
+#define OP_STR            "op"
+#define RELATIVE_TIME_STR "time"
+#define UNIX_TIME_STR     "unix_time"
+#define INDEXES_STR       "indexes"
+#define MAC_STR           "mac"
+#define TIME_ZONE         "time_zone"
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static const char *op_names[] = {
+    [PATCH_OP_ADD_EVENT]     = "add_event",
+    [PATCH_OP_REMOVE_EVENT]  = "remove_event",
+    [PATCH_OP_ADD_MAC]       = "add_mac",
+    [PATCH_OP_REMOVE_MAC]    = "remove_mac",
+    [PATCH_OP_SET_TIME_ZONE] = "set_time_zone",
+};
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static int __apply_ops( schedule_t *s, event_array_t *lists,
+                        const schedule_patch_t *patch );
+static bool __is( const msgpack_object *o, const char *name );
+static char* __strdup( const msgpack_object *o );
+static int __decode_op( const msgpack_object *o, patch_op_t *op );
+static int __add_event( schedule_t *s, event_array_t *a, const patch_op_t *op );
+static bool __remove_event( event_array_t *a, time_t t );
+static int __add_mac( schedule_t *s, const char *mac );
+static int __remove_mac( schedule_t *s, const char *mac );
+static void __renumber( schedule_event_t *head, uint32_t removed );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See schedule_patch.h for details. */
+int decode_schedule_patch( size_t len, const uint8_t *data,
+                           schedule_patch_t **patch )
+{
+    msgpack_unpacked result;
+    msgpack_object_kv *kv;
+    schedule_patch_t *p;
+    size_t off = 0;
+    uint32_t i;
+    int rv = 0;
+
+    if( (NULL == data) || (0 == len) || (NULL == patch) ) {
+        return -1;
+    }
+
+    p = (schedule_patch_t*) aker_malloc( sizeof(schedule_patch_t) );
+    if( NULL == p ) {
+        return -3;
+    }
+    memset( p, 0, sizeof(schedule_patch_t) );
+
+    msgpack_unpacked_init( &result );
+    if( (MSGPACK_UNPACK_SUCCESS != msgpack_unpack_next(&result, (const char*) data, len, &off)) ||
+        (MSGPACK_OBJECT_MAP != result.data.type) )
+    {
+        debug_error( "decode_schedule_patch() not a msgpack map\n" );
+        rv = -2;
+        goto done;
+    }
+
+    kv = result.data.via.map.ptr;
+    for( i = 0; (0 == rv) && (i < result.data.via.map.size); i++, kv++ ) {
+        if( __is(&kv->key, BASE_STR) && (MSGPACK_OBJECT_STR == kv->val.type) ) {
+            if( NULL != p->base ) {
+                aker_free( p->base );
+            }
+            p->base = __strdup( &kv->val );
+            if( NULL == p->base ) {
+                rv = -3;
+            }
+        } else if( __is(&kv->key, OPS_STR) && (MSGPACK_OBJECT_ARRAY == kv->val.type) &&
+                   (NULL == p->ops) && (0 < kv->val.via.array.size) )
+        {
+            uint32_t j, count = kv->val.via.array.size;
+
+            p->ops = (patch_op_t*) aker_malloc( count * sizeof(patch_op_t) );
+            if( NULL == p->ops ) {
+                rv = -3;
+                break;
+            }
+            memset( p->ops, 0, count * sizeof(patch_op_t) );
+
+            for( j = 0; (0 == rv) && (j < count); j++ ) {
+                rv = __decode_op( &kv->val.via.array.ptr[j], &p->ops[j] );
+                p->op_count++;
+            }
+        } else {
+            debug_error( "decode_schedule_patch() unexpected item\n" );
+            rv = -2;
+        }
+    }
+
+    if( (0 == rv) && ((NULL == p->base) || (0 == p->op_count)) ) {
+        debug_error( "decode_schedule_patch() base or ops missing\n" );
+        rv = -2;
+    }
+
+done:
+    msgpack_unpacked_destroy( &result );
+
+    if( 0 == rv ) {
+        *patch = p;
+    } else {
+        destroy_schedule_patch( p );
+    }
+
+    return rv;
+}
+
+
+/* See schedule_patch.h for details. */
+int apply_schedule_patch( schedule_t *s, const schedule_patch_t *patch )
+{
+    return apply_schedule_patches( s, &patch, 1 );
+}
+
+
+/* See schedule_patch.h for details. */
+int apply_schedule_patches( schedule_t *s, const schedule_patch_t **patches,
+                            size_t count )
+{
+    event_array_t lists[2];
+    size_t n;
+    int rv = 0;
+
+    if( (NULL == s) || (NULL == patches) || (NULL != s->index) ) {
+        return -1;
+    }
+    for( n = 0; n < count; n++ ) {
+        if( NULL == patches[n] ) {
+            return -1;
+        }
+    }
+
+    /* Events are found by binary search, so a patch costs about the same
+     * against a large schedule as against a small one. */
+    if( 0 != event_array_init(&lists[0], &s->weekly, 0) ) {
+        return -3;
+    }
+    if( 0 != event_array_init(&lists[1], &s->absolute, 0) ) {
+        event_array_destroy( &lists[0] );
+        return -3;
+    }
+
+    for( n = 0; (0 == rv) && (n < count); n++ ) {
+        rv = __apply_ops( s, lists, patches[n] );
+    }
+
+    event_array_destroy( &lists[0] );
+    event_array_destroy( &lists[1] );
+
+    /* The same things decode_schedule() insists on. */
+    if( (0 == rv) &&
+        ((0 == s->mac_count) || ((NULL == s->weekly) && (NULL == s->absolute))) )
+    {
+        debug_error( "apply_schedule_patch() leaves no MACs or no events\n" );
+        rv = -2;
+    }
+
+    if( (0 == rv) && (0 != finalize_schedule(s)) ) {
+        rv = -3;
+    }
+
+    return rv;
+}
+
+
+/* See schedule_patch.h for details. */
+void destroy_schedule_patch( schedule_patch_t *patch )
+{
+    if( NULL != patch ) {
+        size_t i;
+
+        for( i = 0; i < patch->op_count; i++ ) {
+            if( NULL != patch->ops[i].block ) {
+                aker_free( patch->ops[i].block );
+            }
+            if( NULL != patch->ops[i].time_zone ) {
+                aker_free( patch->ops[i].time_zone );
+            }
+        }
+        if( NULL != patch->ops ) {
+            aker_free( patch->ops );
+        }
+        if( NULL != patch->base ) {
+            aker_free( patch->base );
+        }
+        aker_free( patch );
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Applies the operations of one patch in order, stopping at the first one
+ *  that fails.  lists are the event arrays over the weekly and absolute
+ *  lists, in that order.
+ *
+ *  @return 0 on success, error as apply_schedule_patches() otherwise
+ */
+static int __apply_ops( schedule_t *s, event_array_t *lists,
+                        const schedule_patch_t *patch )
+{
+    size_t i;
+    int rv = 0;
+
+    for( i = 0; (0 == rv) && (i < patch->op_count); i++ ) {
+        const patch_op_t *op = &patch->ops[i];
+        event_array_t *a = &lists[op->absolute ? 1 : 0];
+
+        switch( op->type ) {
+            case PATCH_OP_ADD_EVENT:
+                rv = __add_event( s, a, op );
+                break;
+            case PATCH_OP_REMOVE_EVENT:
+                rv = __remove_event( a, op->time ) ? 0 : -2;
+                break;
+            case PATCH_OP_ADD_MAC:
+                rv = __add_mac( s, op->mac );
+                break;
+            case PATCH_OP_REMOVE_MAC:
+                rv = __remove_mac( s, op->mac );
+                break;
+            case PATCH_OP_SET_TIME_ZONE:
+                if( NULL != s->time_zone ) {
+                    aker_free( s->time_zone );
+                }
+                s->time_zone = strdup( op->time_zone );
+                if( NULL == s->time_zone ) {
+                    rv = -3;
+                }
+                break;
+            default:
+                rv = -1;
+                break;
+        }
+
+        if( 0 != rv ) {
+            debug_error( "apply_schedule_patch() operation %zu (%s) failed: %d\n",
+                         i, op_names[op->type], rv );
+        }
+    }
+
+    return rv;
+}
+
+
+/**
+ *  Returns true if the object is the string name.
+ */
+static bool __is( const msgpack_object *o, const char *name )
+{
+    return (MSGPACK_OBJECT_STR == o->type) &&
+           (strlen(name) == o->via.str.size) &&
+           (0 == strncmp(o->via.str.ptr, name, o->via.str.size));
+}
+
+
+/**
+ *  Returns a null terminated copy of a msgpack string.
+ */
+static char* __strdup( const msgpack_object *o )
+{
+    char *s;
+
+    s = (char*) aker_malloc( o->via.str.size + 1 );
+    if( NULL != s ) {
+        memcpy( s, o->via.str.ptr, o->via.str.size );
+        s[o->via.str.size] = '\0';
+    }
+
+    return s;
+}
+
+
+/**
+ *  Decodes one operation map and checks it has what its type needs.
+ *
+ *  @return 0 on success, -2 on a format error, -3 on memory errors
+ */
+static int __decode_op( const msgpack_object *o, patch_op_t *op )
+{
+    msgpack_object_kv *kv;
+    bool have_time = false, have_indexes = false;
+    int type = -1;
+    uint32_t i;
+
+    if( MSGPACK_OBJECT_MAP != o->type ) {
+        return -2;
+    }
+
+    kv = o->via.map.ptr;
+    for( i = 0; i < o->via.map.size; i++, kv++ ) {
+        if( __is(&kv->key, OP_STR) ) {
+            int t;
+
+            for( t = 0; t < (int) (sizeof(op_names) / sizeof(op_names[0])); t++ ) {
+                if( __is(&kv->val, op_names[t]) ) {
+                    type = t;
+                }
+            }
+        } else if( (__is(&kv->key, RELATIVE_TIME_STR) || __is(&kv->key, UNIX_TIME_STR)) &&
+                   (MSGPACK_OBJECT_POSITIVE_INTEGER == kv->val.type) &&
+                   (kv->val.via.u64 <= INT32_MAX) && !have_time )
+        {
+            op->absolute = __is( &kv->key, UNIX_TIME_STR );
+            op->time = (time_t) kv->val.via.u64;
+            have_time = true;
+        } else if( __is(&kv->key, INDEXES_STR) && (MSGPACK_OBJECT_ARRAY == kv->val.type) &&
+                   !have_indexes )
+        {
+            uint32_t j;
+
+            op->block_count = kv->val.via.array.size;
+            if( 0 < op->block_count ) {
+                op->block = (uint32_t*) aker_malloc( op->block_count * sizeof(uint32_t) );
+                if( NULL == op->block ) {
+                    return -3;
+                }
+            }
+            for( j = 0; j < kv->val.via.array.size; j++ ) {
+                const msgpack_object *index = &kv->val.via.array.ptr[j];
+
+                if( (MSGPACK_OBJECT_POSITIVE_INTEGER != index->type) ||
+                    (UINT32_MAX < index->via.u64) )
+                {
+                    return -2;
+                }
+                op->block[j] = (uint32_t) index->via.u64;
+            }
+            have_indexes = true;
+        } else if( __is(&kv->key, MAC_STR) && (MSGPACK_OBJECT_STR == kv->val.type) &&
+                   (kv->val.via.str.size < MAC_ADDRESS_SIZE) )
+        {
+            memcpy( op->mac, kv->val.via.str.ptr, kv->val.via.str.size );
+            op->mac[kv->val.via.str.size] = '\0';
+        } else if( __is(&kv->key, TIME_ZONE) && (MSGPACK_OBJECT_STR == kv->val.type) &&
+                   (0 < kv->val.via.str.size) && (NULL == op->time_zone) )
+        {
+            op->time_zone = __strdup( &kv->val );
+            if( NULL == op->time_zone ) {
+                return -3;
+            }
+        } else {
+            debug_error( "decode_schedule_patch() unexpected operation item\n" );
+            return -2;
+        }
+    }
+
+    op->type = type;
+    switch( type ) {
+        case PATCH_OP_ADD_EVENT:
+        case PATCH_OP_REMOVE_EVENT:
+            if( ((PATCH_OP_ADD_EVENT == type) && !have_indexes) ||
+                !have_time || (!op->absolute && (SECONDS_IN_A_WEEK <= op->time)) )
+            {
+                return -2;
+            }
+            break;
+        case PATCH_OP_ADD_MAC:
+        case PATCH_OP_REMOVE_MAC:
+            if( '\0' == op->mac[0] ) {
+                return -2;
+            }
+            break;
+        case PATCH_OP_SET_TIME_ZONE:
+            if( NULL == op->time_zone ) {
+                return -2;
+            }
+            break;
+        default:
+            debug_error( "decode_schedule_patch() unknown operation\n" );
+            return -2;
+    }
+
+    return 0;
+}
+
+
+/**
+ *  Adds an event, replacing one at the same time in the same list.
+ *
+ *  @return 0 on success, -2 on an unknown MAC index, -3 on memory errors
+ */
+static int __add_event( schedule_t *s, event_array_t *a, const patch_op_t *op )
+{
+    schedule_event_t *e;
+    size_t i;
+
+    for( i = 0; i < op->block_count; i++ ) {
+        if( s->mac_count <= op->block[i] ) {
+            return -2;
+        }
+    }
+
+    e = create_schedule_event( op->block_count );
+    if( NULL == e ) {
+        return -3;
+    }
+    e->time = op->time;
+    for( i = 0; i < op->block_count; i++ ) {
+        e->block[i] = op->block[i];
+    }
+
+    (void) __remove_event( a, op->time );
+    if( 0 != event_array_insert(a, e) ) {
+        aker_free( e );
+        return -3;
+    }
+
+    return 0;
+}
+
+
+/**
+ *  Unlinks and frees the event at time t.
+ *
+ *  @return true if there was one, false otherwise
+ */
+static bool __remove_event( event_array_t *a, time_t t )
+{
+    size_t i = event_array_lower_bound( a, t );
+    schedule_event_t *e = event_array_get( a, i );
+
+    if( (NULL != e) && (e->time == t) ) {
+        aker_free( event_array_remove(a, i) );
+        return true;
+    }
+
+    return false;
+}
+
+
+/**
+ *  Adds a MAC address at the end of the table unless it is already there.
+ *
+ *  @return 0 on success, -2 on an invalid address, -3 on memory errors
+ */
+static int __add_mac( schedule_t *s, const char *mac )
+{
+    mac_address *old = s->macs;
+    size_t i, count = s->mac_count;
+
+    for( i = 0; i < count; i++ ) {
+        if( 0 == strcasecmp(mac, old[i].mac) ) {
+            return 0;
+        }
+    }
+
+    if( 0 != create_mac_table(s, count + 1) ) {
+        s->macs = old;
+        return -3;
+    }
+    if( 0 < count ) {
+        memcpy( s->macs, old, count * sizeof(mac_address) );
+    }
+    if( NULL != old ) {
+        aker_free( old );
+    }
+
+    if( 0 != set_mac_index(s, mac, strlen(mac), count) ) {
+        s->mac_count = count;
+        return -2;
+    }
+
+    return 0;
+}
+
+
+/**
+ *  Takes a MAC address out of the table and out of every event.
+ *
+ *  @return 0 on success, -2 if the address is not in the table
+ */
+static int __remove_mac( schedule_t *s, const char *mac )
+{
+    size_t i;
+
+    for( i = 0; i < s->mac_count; i++ ) {
+        if( 0 == strcasecmp(mac, s->macs[i].mac) ) {
+            break;
+        }
+    }
+
+    if( i == s->mac_count ) {
+        return -2;
+    }
+
+    memmove( &s->macs[i], &s->macs[i + 1],
+             (s->mac_count - i - 1) * sizeof(mac_address) );
+    s->mac_count--;
+
+    __renumber( s->weekly, (uint32_t) i );
+    __renumber( s->absolute, (uint32_t) i );
+
+    return 0;
+}
+
+
+/**
+ *  Drops a removed MAC table index from every event in a list and moves the
+ *  indexes after it down by one.  The events keep their allocation.
+ */
+static void __renumber( schedule_event_t *head, uint32_t removed )
+{
+    schedule_event_t *p;
+
+    for( p = head; NULL != p; p = p->next ) {
+        size_t i, n = 0;
+
+        for( i = 0; i < p->block_count; i++ ) {
+            if( removed != p->block[i] ) {
+                p->block[n++] = (removed < p->block[i]) ? (p->block[i] - 1) : p->block[i];
+            }
+        }
+        p->block_count = n;
+    }
+}
@@ -0,0 +1,134 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __SCHEDULE_PATCH_H__
+#define __SCHEDULE_PATCH_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "schedule.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define PATCH_OP_ADD_EVENT      0
+#define PATCH_OP_REMOVE_EVENT   1
+#define PATCH_OP_ADD_MAC        2
+#define PATCH_OP_REMOVE_MAC     3
+#define PATCH_OP_SET_TIME_ZONE  4
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+
+/*
+ *  A patch is a msgpack map:
+ *
+ *  {
+ *      "base": "<ETag of the schedule the patch was made against>",
+ *      "ops": [
+ *          { "op": "add_event", "time": <weekly seconds>, "indexes": [ 0, 2 ] },
+ *          { "op": "add_event", "unix_time": <unix time>, "indexes": [] },
+ *          { "op": "remove_event", "time": <weekly seconds> },
+ *          { "op": "add_mac", "mac": "11:22:33:44:55:66" },
+ *          { "op": "remove_mac", "mac": "11:22:33:44:55:66" },
+ *          { "op": "set_time_zone", "time_zone": "PST8PDT" }
+ *      ]
+ *  }
+ *
+ *  "base" may be given with the quotes the ETag header has.  "time" is a
+ *  weekly event and "unix_time" an absolute one, as in the schedule itself.
+ *  The operations are applied in order, and either all of them are applied
+ *  or none are.
+ */
+typedef struct patch_op {
+    int type;                       /* PATCH_OP_* */
+    bool absolute;                  /* Events: which list. */
+    time_t time;                    /* Events: the event time. */
+    size_t block_count;             /* add_event: the number of indexes. */
+    uint32_t *block;                /* add_event: the MAC table indexes. */
+    char mac[MAC_ADDRESS_SIZE];     /* MACs: the address. */
+    char *time_zone;                /* set_time_zone: the new zone. */
+} patch_op_t;
+
+
+typedef struct schedule_patch {
+    char *base;                     /* The ETag the patch applies to. */
+    size_t op_count;
+    patch_op_t *ops;
+} schedule_patch_t;
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Decodes and checks the format of a msgpack patch.
+ *
+ *  @param len   the number of bytes in data
+ *  @param data  the msgpack patch
+ *  @param patch [out] the decoded patch
+ *
+ *  @return 0 on success, error otherwise
+ */
+int decode_schedule_patch( size_t len, const uint8_t *data,
+                           schedule_patch_t **patch );
+
+/**
+ *  Applies a patch to a schedule copy made by copy_schedule() and finalizes
+ *  it.  Events are found by binary search, so apart from renumbering the
+ *  events when a MAC is removed and rebuilding the index the work grows with
+ *  the patch rather than the schedule.
+ *
+ *  An added event replaces any event at the same time in the same list.
+ *  Adding a MAC that is already in the table does nothing; a new one gets
+ *  the next index.  Removing a MAC takes it out of every event and moves the
+ *  MACs after it down one index.
+ *
+ *  @param s     the schedule copy to alter
+ *  @param patch the patch to apply
+ *
+ *  @return 0 on success, -1 on invalid arguments, -2 if an operation does
+ *          not fit the schedule (unknown event or MAC, bad index or time,
+ *          or the result has no MACs or no events), -3 on memory errors; on
+ *          error the copy is only fit for destroy_schedule()
+ */
+int apply_schedule_patch( schedule_t *s, const schedule_patch_t *patch );
+
+/**
+ *  Applies several patches, in order, as one: the schedule is only checked
+ *  and finalized once at the end.  Used to replay a journal.
+ *
+ *  @param s       the schedule copy to alter
+ *  @param patches the patches to apply
+ *  @param count   the number of patches
+ *
+ *  @return as apply_schedule_patch()
+ */
+int apply_schedule_patches( schedule_t *s, const schedule_patch_t **patches,
+                            size_t count );
+
+/**
+ *  Destroys a patch made by decode_schedule_patch().
+ *
+ *  @param patch the patch to destroy
+ */
+void destroy_schedule_patch( schedule_patch_t *patch );
+
+#endif
@@ -0,0 +1,412 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "schedule_rules.h"
+#include "aker_log.h"
+#include "aker_mem.h"
+#include "time.h"
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+
+/* One rule range starting or ending at a point in the week. */
+typedef struct rule_edge {
+    time_t time;
+    uint32_t rule;
+    bool start;
+} rule_edge_t;
+
+/* The state of the sweep over the week. */
+typedef struct rule_sweep {
+    schedule_t *s;
+    const schedule_rule_t *rules;
+    size_t count;
+    uint32_t *on;                   /* Ranges of each rule in effect. */
+    uint32_t *seen;                 /* Per MAC, the emit() that last added
+                                     * it, so each is added once. */
+    uint32_t stamp;
+    uint32_t *set;                  /* The set being built, mac_count long. */
+    schedule_event_t *head;         /* The new weekly list ... */
+    schedule_event_t *tail;         /* ... and its last event. */
+} rule_sweep_t;
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static bool __valid_rules( const schedule_t *s, const schedule_rule_t *rules,
+                           size_t count );
+static size_t __make_edges( const schedule_rule_t *rules, size_t count,
+                            rule_edge_t *edges, uint32_t *on );
+static int __compare_edge( const void *a, const void *b );
+static int __compare_index( const void *a, const void *b );
+static void __add( rule_sweep_t *w, const uint32_t *block, uint32_t count,
+                   uint32_t *n );
+static bool __blocks_any( const rule_sweep_t *w, const schedule_event_t *e );
+static bool __same_set( const schedule_event_t *e, const uint32_t *set,
+                        uint32_t n );
+static int __emit( rule_sweep_t *w, time_t t, const schedule_event_t *base );
+static void __free_list( schedule_event_t *head );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See schedule_rules.h for details. */
+int expand_schedule_rules( schedule_t *s, const schedule_rule_t *rules,
+                           size_t count )
+{
+    rule_sweep_t w;
+    rule_edge_t *edges;
+    const schedule_event_t *base, *next;
+    size_t n, i = 0;
+    time_t t = 0;
+    int rv = 0;
+
+    if( 0 == count ) {
+        return 0;
+    }
+    if( !__valid_rules(s, rules, count) ) {
+        return -1;
+    }
+
+    memset( &w, 0, sizeof(rule_sweep_t) );
+    w.s = s;
+    w.rules = rules;
+    w.count = count;
+
+    /* Each rule starts and ends at most once a day. */
+    edges = (rule_edge_t*) aker_malloc( 14 * count * sizeof(rule_edge_t) );
+    w.on = (uint32_t*) aker_malloc( count * sizeof(uint32_t) );
+    w.seen = (uint32_t*) aker_malloc( s->mac_count * sizeof(uint32_t) );
+    w.set = (uint32_t*) aker_malloc( s->mac_count * sizeof(uint32_t) );
+    if( (NULL == edges) || (NULL == w.on) || (NULL == w.seen) || (NULL == w.set) ) {
+        rv = -2;
+        goto done;
+    }
+    memset( w.on, 0, count * sizeof(uint32_t) );
+    memset( w.seen, 0, s->mac_count * sizeof(uint32_t) );
+
+    n = __make_edges( rules, count, edges, w.on );
+    qsort( edges, n, sizeof(rule_edge_t), __compare_edge );
+
+    /* Before the first weekly event the last one is in effect. */
+    base = NULL;
+    for( next = s->weekly; NULL != next; next = next->next ) {
+        base = next;
+    }
+    next = s->weekly;
+
+    while( 0 == rv ) {
+        while( (NULL != next) && (next->time <= t) ) {
+            base = next;
+            next = next->next;
+        }
+        for( ; (i < n) && (edges[i].time <= t); i++ ) {
+            if( edges[i].start ) {
+                w.on[edges[i].rule]++;
+            } else {
+                w.on[edges[i].rule]--;
+            }
+        }
+
+        rv = __emit( &w, t, base );
+
+        t = SECONDS_IN_A_WEEK;
+        if( (NULL != next) && (next->time < t) ) {
+            t = next->time;
+        }
+        if( (i < n) && (edges[i].time < t) ) {
+            t = edges[i].time;
+        }
+        if( SECONDS_IN_A_WEEK <= t ) {
+            break;
+        }
+    }
+
+    /* The last event carries over into Sunday anyway. */
+    if( (0 == rv) && (w.head != w.tail) &&
+        __same_set(w.head, w.tail->block, (uint32_t) w.tail->block_count) )
+    {
+        schedule_event_t *e = w.head;
+
+        w.head = e->next;
+        aker_free( e );
+    }
+
+    if( 0 == rv ) {
+        __free_list( s->weekly );
+        s->weekly = w.head;
+        w.head = NULL;
+    }
+
+done:
+    __free_list( w.head );
+    if( NULL != edges ) aker_free( edges );
+    if( NULL != w.on ) aker_free( w.on );
+    if( NULL != w.seen ) aker_free( w.seen );
+    if( NULL != w.set ) aker_free( w.set );
+
+    return rv;
+}
+
+
+/* See schedule_rules.h for details. */
+void destroy_schedule_rules( schedule_rule_t *rules, size_t count )
+{
+    if( NULL != rules ) {
+        size_t i;
+
+        for( i = 0; i < count; i++ ) {
+            if( NULL != rules[i].block ) {
+                aker_free( rules[i].block );
+            }
+        }
+        aker_free( rules );
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Checks the rules against the schedule they are for.
+ *
+ *  @return true if they can be expanded, false otherwise
+ */
+static bool __valid_rules( const schedule_t *s, const schedule_rule_t *rules,
+                           size_t count )
+{
+    size_t i, j;
+
+    if( (NULL == s) || (NULL == rules) || (NULL != s->index) ||
+        (0 == s->mac_count) )
+    {
+        return false;
+    }
+
+    for( i = 0; i < count; i++ ) {
+        const schedule_rule_t *r = &rules[i];
+
+        if( (0 == r->days) || (0 != (r->days & ~RULE_ALL_DAYS)) ||
+            (r->start < 0) || (SECONDS_IN_A_DAY <= r->start) ||
+            (r->end < 0) || (SECONDS_IN_A_DAY < r->end) ||
+            ((0 < r->block_count) && (NULL == r->block)) )
+        {
+            debug_error( "expand_schedule_rules() rule %zu is invalid\n", i );
+            return false;
+        }
+        for( j = 0; j < r->block_count; j++ ) {
+            if( s->mac_count <= r->block[j] ) {
+                debug_error( "expand_schedule_rules() rule %zu has an unknown index\n", i );
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+/**
+ *  Makes the start and end edges of every day's range of every rule.  Ranges
+ *  that run over the end of the week are counted as on at the start of the
+ *  week and end on Sunday instead.
+ *
+ *  @return the number of edges made
+ */
+static size_t __make_edges( const schedule_rule_t *rules, size_t count,
+                            rule_edge_t *edges, uint32_t *on )
+{
+    size_t i, n = 0;
+    int day;
+
+    for( i = 0; i < count; i++ ) {
+        const schedule_rule_t *r = &rules[i];
+        time_t length = r->end - r->start;
+
+        if( length <= 0 ) {
+            length += SECONDS_IN_A_DAY;
+        }
+
+        for( day = 0; day < 7; day++ ) {
+            time_t start, end;
+
+            if( 0 == (r->days & (1u << day)) ) {
+                continue;
+            }
+
+            start = day * SECONDS_IN_A_DAY + r->start;
+            end = start + length;
+
+            edges[n].time = start;
+            edges[n].rule = (uint32_t) i;
+            edges[n].start = true;
+            n++;
+
+            if( SECONDS_IN_A_WEEK < end ) {
+                on[i]++;
+                end -= SECONDS_IN_A_WEEK;
+            }
+            if( end < SECONDS_IN_A_WEEK ) {
+                edges[n].time = end;
+                edges[n].rule = (uint32_t) i;
+                edges[n].start = false;
+                n++;
+            }
+        }
+    }
+
+    return n;
+}
+
+
+/**
+ *  Orders edges by time, then the ends before the starts.
+ */
+static int __compare_edge( const void *a, const void *b )
+{
+    const rule_edge_t *x = (const rule_edge_t*) a;
+    const rule_edge_t *y = (const rule_edge_t*) b;
+
+    if( x->time != y->time ) {
+        return (x->time < y->time) ? -1 : 1;
+    }
+
+    return (int) x->start - (int) y->start;
+}
+
+
+static int __compare_index( const void *a, const void *b )
+{
+    uint32_t x = *(const uint32_t*) a;
+    uint32_t y = *(const uint32_t*) b;
+
+    return (x > y) - (x < y);
+}
+
+
+/**
+ *  Adds the indexes not already in the set being built.
+ */
+static void __add( rule_sweep_t *w, const uint32_t *block, uint32_t count,
+                   uint32_t *n )
+{
+    uint32_t i;
+
+    for( i = 0; i < count; i++ ) {
+        uint32_t m = block[i];
+
+        if( (m < w->s->mac_count) && (w->stamp != w->seen[m]) ) {
+            w->seen[m] = w->stamp;
+            w->set[(*n)++] = m;
+        }
+    }
+}
+
+
+/**
+ *  Returns false for a weekly event with an index outside the MAC table,
+ *  which blocks nothing at all (see get_blocked_at_time()), so the rules
+ *  in force at its time are all that is blocked then.
+ */
+static bool __blocks_any( const rule_sweep_t *w, const schedule_event_t *e )
+{
+    size_t i;
+
+    for( i = 0; i < e->block_count; i++ ) {
+        if( w->s->mac_count <= e->block[i] ) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/**
+ *  Returns true if an event blocks exactly the sorted set of indexes.
+ */
+static bool __same_set( const schedule_event_t *e, const uint32_t *set,
+                        uint32_t n )
+{
+    return (n == e->block_count) &&
+           ((0 == n) || (0 == memcmp(set, e->block, n * sizeof(uint32_t))));
+}
+
+
+/**
+ *  Appends the event for time t to the new list unless it blocks the same
+ *  set as the last one.
+ *
+ *  @return 0 on success, -2 if out of memory
+ */
+static int __emit( rule_sweep_t *w, time_t t, const schedule_event_t *base )
+{
+    schedule_event_t *e;
+    uint32_t n = 0;
+    size_t i;
+
+    w->stamp++;
+    if( (NULL != base) && __blocks_any(w, base) ) {
+        __add( w, base->block, (uint32_t) base->block_count, &n );
+    }
+    for( i = 0; i < w->count; i++ ) {
+        if( 0 < w->on[i] ) {
+            __add( w, w->rules[i].block, w->rules[i].block_count, &n );
+        }
+    }
+    qsort( w->set, n, sizeof(uint32_t), __compare_index );
+
+    if( (NULL != w->tail) && __same_set(w->tail, w->set, n) ) {
+        return 0;
+    }
+
+    e = create_schedule_event( n );
+    if( NULL == e ) {
+        return -2;
+    }
+    e->time = t;
+    if( 0 < n ) {
+        memcpy( e->block, w->set, n * sizeof(uint32_t) );
+    }
+
+    if( NULL == w->tail ) {
+        w->head = e;
+    } else {
+        w->tail->next = e;
+    }
+    w->tail = e;
+
+    return 0;
+}
+
+
+static void __free_list( schedule_event_t *head )
+{
+    while( NULL != head ) {
+        schedule_event_t *next = head->next;
+
+        aker_free( head );
+        head = next;
+    }
+}
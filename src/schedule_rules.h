@@ -0,0 +1,84 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __SCHEDULE_RULES_H__
+#define __SCHEDULE_RULES_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "schedule.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define SECONDS_IN_A_DAY    (24 * 60 * 60)
+#define RULE_ALL_DAYS       0x7f
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+
+/* A recurring time range, e.g. 21:00 - 07:00 Sunday to Thursday nights, that
+ * an uploaded schedule can give in its "rules" list instead of spelling out
+ * each transition in "weekly". */
+typedef struct schedule_rule {
+    uint32_t days;                  /* The days the range starts on, bit 0 is
+                                     * Sunday through bit 6 Saturday. */
+    time_t start;                   /* Seconds after midnight. */
+    time_t end;                     /* Seconds after midnight, up to a whole
+                                     * day; at or before start the range runs
+                                     * into the next day. */
+    uint32_t block_count;
+    uint32_t *block;                /* The MAC table indexes blocked during
+                                     * the range. */
+} schedule_rule_t;
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Folds recurrence rules into a schedule's weekly list.  The list is
+ *  replaced by one event per point in the week where a rule or a weekly
+ *  event starts or ends, blocking the MACs of the weekly event in effect
+ *  plus those of every rule in range; points that block the same set as the
+ *  one before them are left out.  A range that runs past Saturday midnight
+ *  carries on into Sunday.
+ *
+ *  Call it before finalize_schedule(), once the MAC table is known.
+ *
+ *  @param s     the schedule
+ *  @param rules the rules
+ *  @param count the number of rules, nothing is done if 0
+ *
+ *  @return 0 on success, -1 on invalid input (a day mask, time or MAC index
+ *          out of range, or s already finalized), -2 if out of memory; s is
+ *          untouched on error
+ */
+int expand_schedule_rules( schedule_t *s, const schedule_rule_t *rules,
+                           size_t count );
+
+/**
+ *  Frees the block arrays of the rules and the rules array itself.
+ *
+ *  @param rules the rules, may be NULL
+ *  @param count the number of rules
+ */
+void destroy_schedule_rules( schedule_rule_t *rules, size_t count );
+
+#endif
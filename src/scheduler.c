@@ -31,6 +31,10 @@
 #include "decode.h"
 #include "time.h"
 #include "aker_mem.h"
+#include "firewall_state.h"
+#include "aker_clock.h"
+#include "notify.h"
+#include "schedule_merge.h"
 
 
 /* Local Functions and file-scoped variables */
@@ -38,11 +42,19 @@ static void sig_handler(int sig);
 static void cleanup(void);
 static void *scheduler_thread(void *args);
 static void call_firewall( const char* firewall_cmd, char *blocked );
+static bool __restore_firewall_state( void );
+static int __swap( const char *name, schedule_t *s );
 
-static schedule_t *current_schedule = NULL;
+static schedule_merge_t schedules;  /* The main schedule and any named ones. */
 static char *current_blocked_macs = NULL;
 static pthread_mutex_t schedule_lock;
 static pthread_cond_t cond_var = PTHREAD_COND_INITIALIZER;
+static const char *state_file = NULL;
+static bool import_done = false;
+static uint64_t transition_seq = 0;
+static time_t started = 0;
+static size_t pruned_events = 0;    /* Dropped since the schedule was set or
+                                     * last copied to be stored. */
 
 
 
@@ -69,6 +81,8 @@ int scheduler_start( pthread_t *thread, const char *firewall_cmd )
         p = thread;
     }
 
+    started = get_unix_time();
+
     rv = pthread_create( p, NULL, scheduler_thread, (void*) firewall_cmd );
     if( 0 != rv ) {
         pthread_mutex_destroy(&schedule_lock);
@@ -78,6 +92,23 @@ int scheduler_start( pthread_t *thread, const char *firewall_cmd )
 }
 
 
+/* See scheduler.h for details. */
+void scheduler_set_state_file( const char *filename )
+{
+    state_file = filename;
+}
+
+
+/* See scheduler.h for details. */
+void scheduler_import_done( void )
+{
+    pthread_mutex_lock( &schedule_lock );
+    import_done = true;
+    pthread_mutex_unlock( &schedule_lock );
+    pthread_cond_signal(&cond_var);
+}
+
+
 /* See scheduler.h for details. */
 int process_schedule_data( size_t len, uint8_t *data )
 {
@@ -87,25 +118,14 @@ int process_schedule_data( size_t len, uint8_t *data )
     debug_info("process_schedule_data()\n");
 
     if (0 == len) {
-        pthread_mutex_lock( &schedule_lock );
-        s = current_schedule;
-        current_schedule = NULL;
-        pthread_mutex_unlock( &schedule_lock );
-        pthread_cond_signal(&cond_var);
-        destroy_schedule( s );
+        scheduler_set_schedule( NULL );
         debug_info( "process_schedule_data() empty schedule\n" );
     } else {
         rv = decode_schedule( len, data, &s );
 
         if (0 == rv ) {
-            schedule_t *tmp;
             print_schedule( s );
-            pthread_mutex_lock( &schedule_lock );
-            tmp = current_schedule;
-            current_schedule = s;
-            pthread_mutex_unlock( &schedule_lock );
-            pthread_cond_signal(&cond_var);
-            destroy_schedule(tmp);
+            scheduler_set_schedule( s );
             debug_info( "process_schedule_data() New schedule\n" );
         } else {
             destroy_schedule( s );
@@ -117,6 +137,56 @@ int process_schedule_data( size_t len, uint8_t *data )
 }
 
 
+/* See scheduler.h for details. */
+void scheduler_set_schedule( schedule_t *s )
+{
+    (void) __swap( NULL, s );
+}
+
+
+/* See scheduler.h for details. */
+int scheduler_set_named_schedule( const char *name, schedule_t *s )
+{
+    if( NULL == name ) {
+        destroy_schedule( s );
+        return -1;
+    }
+
+    return __swap( name, s );
+}
+
+
+/* See scheduler.h for details. */
+schedule_t* scheduler_copy_schedule( void )
+{
+    schedule_t *s;
+
+    pthread_mutex_lock( &schedule_lock );
+    s = copy_schedule( schedule_merge_get(&schedules, NULL) );
+    pthread_mutex_unlock( &schedule_lock );
+
+    return s;
+}
+
+
+/* See scheduler.h for details. */
+schedule_t* scheduler_copy_pruned_schedule( size_t min_pruned )
+{
+    schedule_t *s = NULL;
+
+    pthread_mutex_lock( &schedule_lock );
+    if( (0 < pruned_events) && (min_pruned <= pruned_events) ) {
+        s = copy_schedule( schedule_merge_get(&schedules, NULL) );
+        if( NULL != s ) {
+            pruned_events = 0;
+        }
+    }
+    pthread_mutex_unlock( &schedule_lock );
+
+    return s;
+}
+
+
 /* See scheduler.h for details. */
 char *get_current_blocked_macs( void )
 {
@@ -133,6 +203,38 @@ char *get_current_blocked_macs( void )
 }
 
 
+/* See scheduler.h for details. */
+uint64_t get_current_transition_seq( time_t *start_time )
+{
+    uint64_t seq;
+
+    pthread_mutex_lock( &schedule_lock );
+    seq = transition_seq;
+    if( NULL != start_time ) {
+        *start_time = started;
+    }
+    pthread_mutex_unlock( &schedule_lock );
+
+    return seq;
+}
+
+
+/* See scheduler.h for details. */
+int get_current_device_status( const char *mac, time_t unixtime,
+                               bool *blocked, time_t *next_change )
+{
+    int rv = -1;
+
+    if( 0 == pthread_mutex_lock(&schedule_lock) ) {
+        rv = schedule_merge_device_status( &schedules, mac, unixtime,
+                                           blocked, next_change );
+        pthread_mutex_unlock( &schedule_lock );
+    }
+
+    return rv;
+}
+
+
 /*----------------------------------------------------------------------------*/
 /*                             Internal functions                             */
 /*----------------------------------------------------------------------------*/
@@ -143,12 +245,13 @@ char *get_current_blocked_macs( void )
 void *scheduler_thread(void *args)
 {
     const char *firewall_cmd;
-    struct timespec tm = { INT_MAX, 0 };
     time_t current_unix_time = 0;
     int rv = ETIMEDOUT;
+    bool force_apply = false;
+    bool announced = false;
     
-    signal(SIGTERM, sig_handler);
-    signal(SIGINT, sig_handler);
+    /* SIGTERM/SIGINT are left to main(), which writes out what it has
+     * accepted before exiting. */
     signal(SIGUSR1, sig_handler);
     signal(SIGUSR2, sig_handler);
     signal(SIGSEGV, sig_handler);
@@ -162,7 +265,11 @@ void *scheduler_thread(void *args)
     
     firewall_cmd = (const char*) args;
 
-    call_firewall( firewall_cmd, NULL );
+    if( NULL == state_file ) {
+        call_firewall( firewall_cmd, NULL );
+    } else {
+        force_apply = __restore_firewall_state();
+    }
 
     while( __keep_going__ ) {
         int info_period = 3;
@@ -170,11 +277,26 @@ void *scheduler_thread(void *args)
    
         pthread_mutex_lock( &schedule_lock );
         
-        if( current_schedule ) {
+        if( 0 < schedules.count ) {
             char *blocked_macs;
+            size_t i;
 
             current_unix_time = get_unix_time();
-            blocked_macs = get_blocked_at_time(current_schedule, current_unix_time);
+
+            /* Expired absolute events only slow the lookups down. */
+            for( i = 0; i < schedules.count; i++ ) {
+                int pruned = prune_absolute_events(schedules.src[i].s, current_unix_time);
+
+                if( 0 < pruned ) {
+                    debug_info("scheduler_thread(): pruned %d absolute events\n", pruned);
+                    /* Only the main schedule is stored again for this. */
+                    if( NULL == schedules.src[i].name ) {
+                        pruned_events += pruned;
+                    }
+                }
+            }
+
+            blocked_macs = schedule_merge_blocked(&schedules, current_unix_time);
             debug_info("Time to process current schedule event is %ld seconds\n", (get_unix_time() - current_unix_time));
 
             if (NULL == current_blocked_macs) {
@@ -202,6 +324,7 @@ void *scheduler_thread(void *args)
                 }
             }
         } else {
+            current_unix_time = get_unix_time();
             if( current_blocked_macs ) {
                 aker_free(current_blocked_macs);
                 current_blocked_macs = NULL;
@@ -209,14 +332,28 @@ void *scheduler_thread(void *args)
             }
         }
 
-        if( 0 != schedule_changed ) {
+        if( (0 != schedule_changed) || force_apply ) {
             call_firewall( firewall_cmd, current_blocked_macs );
+            force_apply = false;
+
+            if( NULL != state_file ) {
+                if( 0 != firewall_state_save(state_file, current_blocked_macs, get_unix_time()) ) {
+                    debug_error("scheduler_thread(): failed to save %s\n", state_file);
+                }
+            }
+        }
+
+        /* Upstream gets the state aker starts with and every change after. */
+        if( (0 != schedule_changed) || !announced ) {
+            transition_seq++;
+            notify_transition( current_blocked_macs, transition_seq, current_unix_time );
+            announced = true;
         }
 
-        tm.tv_sec = get_next_unixtime(current_schedule, current_unix_time);
-        rv = pthread_cond_timedwait(&cond_var, &schedule_lock, &tm);
+        rv = aker_clock_wait_until(&cond_var, &schedule_lock,
+                                   schedule_merge_next(&schedules));
         if( (0 != rv) && (ETIMEDOUT != rv) ) {
-            debug_error("pthread_cond_timedwait error: %d(%s)\n", rv, strerror(rv));
+            debug_error("aker_clock_wait_until error: %d(%s)\n", rv, strerror(rv));
         }
 
         pthread_mutex_unlock( &schedule_lock );
@@ -226,6 +363,36 @@ void *scheduler_thread(void *args)
     return NULL;    
 }
 
+/**
+ *  Puts a schedule in place of the one by that name and wakes the scheduler.
+ *
+ *  @param name the schedule's name, NULL for the main schedule
+ *  @param s    the new schedule, or NULL to clear it; destroyed on error
+ *
+ *  @return 0 on success, -2 if out of memory
+ */
+static int __swap( const char *name, schedule_t *s )
+{
+    schedule_t *old = NULL;
+    int rv;
+
+    pthread_mutex_lock( &schedule_lock );
+    rv = schedule_merge_swap( &schedules, name, s, &old );
+    if( NULL == name ) {
+        pruned_events = 0;
+    }
+    pthread_mutex_unlock( &schedule_lock );
+    pthread_cond_signal(&cond_var);
+
+    if( 0 != rv ) {
+        debug_error("scheduler: no room for schedule '%s'\n", (NULL != name) ? name : "");
+        destroy_schedule(s);
+    }
+    destroy_schedule(old);
+
+    return rv;
+}
+
 /**
  *  Takes the firewall cmd and the blocked list and makes the call.
  *
@@ -261,6 +428,38 @@ static void call_firewall( const char* firewall_cmd, char *blocked )
     }
 }
 
+/**
+ *  Waits for the stored schedule to be imported, then adopts the blocked set
+ *  the firewall is already enforcing from the state file.  The first pass of
+ *  the scheduler then only calls the firewall if the effective set differs.
+ *
+ *  @return true if the firewall state is unknown and must be applied even if
+ *          the schedule's set looks unchanged, false otherwise
+ */
+static bool __restore_firewall_state( void )
+{
+    char *saved = NULL;
+    time_t applied = 0;
+    int rv;
+
+    pthread_mutex_lock( &schedule_lock );
+    while( (false == import_done) && __keep_going__ ) {
+        pthread_cond_wait( &cond_var, &schedule_lock );
+    }
+
+    rv = firewall_state_load( state_file, &saved, &applied );
+    if( 0 == rv ) {
+        current_blocked_macs = saved;
+        debug_info("Firewall state from %ld restored: '%s'\n", applied,
+                   (NULL != saved) ? saved : "");
+    } else {
+        debug_info("Firewall state unknown (%d), will apply the schedule\n", rv);
+    }
+    pthread_mutex_unlock( &schedule_lock );
+
+    return (0 != rv);
+}
+
 static void sig_handler(int sig)
 {
     if( sig == SIGINT ) {
@@ -294,5 +493,5 @@ void cleanup (void )
 {
     pthread_mutex_unlock( &schedule_lock );
     pthread_mutex_destroy(&schedule_lock);
-    destroy_schedule(current_schedule);
+    schedule_merge_destroy(&schedules);
 }
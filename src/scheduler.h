@@ -17,6 +17,8 @@
 #ifndef __SCHEDULER_H__
 #define __SCHEDULER_H__
 
+#include "schedule.h"
+
 /**
  *  Starts the scheduler thread
  *
@@ -27,6 +29,26 @@
  */
 int scheduler_start( pthread_t *thread, const char *firewall_cmd );
 
+/**
+ *  Enables warm restarts: the blocked set handed to the firewall is recorded
+ *  in this file, and on start the scheduler waits for
+ *  scheduler_import_done() and only calls the firewall if the schedule's
+ *  effective set differs from the recorded one.  Without a state file the
+ *  firewall is reset when the scheduler starts.
+ *
+ *  @note Must be called before scheduler_start().
+ *
+ *  @param filename the state file, or NULL to disable
+ */
+void scheduler_set_state_file( const char *filename );
+
+/**
+ *  Tells the scheduler the stored schedule (if any) has been loaded.
+ *
+ *  @note Must be called after scheduler_start().
+ */
+void scheduler_import_done( void );
+
 /**
  *  Sends in data to make a new schedule and replace any existing ones.
  *
@@ -37,6 +59,51 @@ int scheduler_start( pthread_t *thread, const char *firewall_cmd );
  */
 int process_schedule_data( size_t len, uint8_t *data );
 
+/**
+ *  Replaces the current schedule with one that is already compiled.
+ *
+ *  @note The scheduler takes ownership of the schedule.
+ *
+ *  @param s the new schedule, or NULL to clear it
+ */
+void scheduler_set_schedule( schedule_t *s );
+
+/**
+ *  Replaces, adds or removes a named schedule.  The blocked set is the union
+ *  of the main schedule's and every named schedule's; only the schedule that
+ *  changed is looked at again (see schedule_merge.h).
+ *
+ *  @note The scheduler takes ownership of the schedule.  Named schedules are
+ *        evaluated in the process time zone, i.e. the main schedule's.
+ *
+ *  @param name the schedule's name
+ *  @param s    the new schedule, or NULL to remove it
+ *
+ *  @return 0 on success, error otherwise (s is destroyed)
+ */
+int scheduler_set_named_schedule( const char *name, schedule_t *s );
+
+/**
+ *  Makes a copy of the current schedule to build a new one from, see
+ *  copy_schedule().
+ *
+ *  @return the copy, NULL if there is no schedule or on error
+ */
+schedule_t* scheduler_copy_schedule( void );
+
+/**
+ *  The scheduler drops the absolute events that have expired from the
+ *  running schedule (see prune_absolute_events()).  This makes a copy of the
+ *  running schedule, to be stored in place of the one with those events,
+ *  once enough of them have been dropped.
+ *
+ *  @param min_pruned the number of events that must have been dropped since
+ *                    the schedule was set or last copied by this
+ *
+ *  @return the copy, NULL if there is nothing worth storing or on error
+ */
+schedule_t* scheduler_copy_pruned_schedule( size_t min_pruned );
+
 /**
  *  Retreives data generated the last time the scheduler was run.
  *
@@ -46,6 +113,34 @@ int process_schedule_data( size_t len, uint8_t *data );
  */
 char *get_current_blocked_macs( void );
 
+/**
+ *  Returns the sequence number of the blocked set returned by
+ *  get_current_blocked_macs().  It goes up by one every time the set
+ *  changes, and it is the sequence number transition events carry.
+ *
+ *  @note The numbers start over when aker restarts, so they are only unique
+ *        together with the start time.
+ *
+ *  @param start_time if not NULL the time the scheduler started is put here
+ *
+ *  @return the sequence number, 0 before the scheduler's first pass
+ */
+uint64_t get_current_transition_seq( time_t *start_time );
+
+/**
+ *  Gets one device's blocked state from the current schedule.
+ *
+ *  @param mac         the device's MAC address
+ *  @param unixtime    the time to look at
+ *  @param blocked     where to put whether the device is blocked
+ *  @param next_change where to put when that next changes, INT_MAX if never
+ *
+ *  @return 0 on success, -1 if there is no (indexed) schedule, -2 if the
+ *          device is not in it
+ */
+int get_current_device_status( const char *mac, time_t unixtime,
+                               bool *blocked, time_t *next_change );
+
 /* For Unit Test Use, since SIGTERM kills the process and gcov info file is not
  created */
 void terminate_scheduler_thread(void);
@@ -0,0 +1,685 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tenant.h"
+#include "timer_wheel.h"
+#include "process_data.h"
+#include "aker_clock.h"
+#include "aker_log.h"
+#include "aker_mem.h"
+#include "time.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define TENANT_OF(n)    ((tenant_t*) ((char*) (n) - offsetof(tenant_t, timer)))
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+typedef struct tenant {
+    char *id;
+    char *target;
+    schedule_t *s;
+    schedule_t *in_use;         /* The schedule a worker is looking at ... */
+    schedule_t *retired;        /* ... and it, once replaced, for that
+                                 * worker to destroy. */
+    char *blocked;              /* The set last given to the firewall. */
+    timer_node_t timer;         /* The schedule's next transition. */
+    struct tenant *ready;       /* The next one in the ready queue. */
+    bool queued;                /* In the ready queue. */
+    bool busy;                  /* With a worker. */
+    bool again;                 /* Due again while with a worker. */
+    bool applied;               /* blocked is what the firewall has. */
+} tenant_t;
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wheel_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+
+static tenant_t **tenants = NULL;   /* Sorted by ID. */
+static size_t tenant_total = 0;
+static size_t tenant_capacity = 0;
+
+static timer_wheel_t wheel;
+static time_t wheel_waits_until = 0;
+static tenant_t *ready_head = NULL;
+static tenant_t *ready_tail = NULL;
+
+static const char *firewall = NULL;
+static pthread_t wheel_thread;
+static pthread_t *workers = NULL;
+static unsigned worker_total = 0;
+static bool running = false;
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static int __find( const char *id, bool *found );
+static bool __valid_target( const char *target );
+static void __queue( tenant_t *t );
+static void __rewind( time_t now );
+static void __evaluate( schedule_t *s, time_t now, char **blocked,
+                        time_t *next );
+static char* __apply( tenant_t *t, char *blocked, time_t next );
+static char* __firewall_cmd( const tenant_t *t );
+static void* __wheel_thread( void *args );
+static void* __worker( void *args );
+static void __stop_threads( void );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See tenant.h for details. */
+int tenant_add( const char *id, const char *target )
+{
+    tenant_t *t;
+    bool found;
+    int i, rv = 0;
+
+    if( NULL == target ) {
+        target = id;
+    }
+    if( !process_is_named_ok(id) || !__valid_target(target) ) {
+        return -1;
+    }
+
+    t = (tenant_t*) aker_malloc( sizeof(tenant_t) );
+    if( NULL == t ) {
+        return -2;
+    }
+    memset( t, 0, sizeof(tenant_t) );
+    t->id = strdup( id );
+    t->target = strdup( target );
+
+    pthread_mutex_lock( &lock );
+    i = __find( id, &found );
+    if( found ) {
+        rv = -3;
+    } else if( (NULL == t->id) || (NULL == t->target) ) {
+        rv = -2;
+    } else if( tenant_total == tenant_capacity ) {
+        size_t capacity = (0 < tenant_capacity) ? (2 * tenant_capacity) : 16;
+        tenant_t **p = (tenant_t**) aker_malloc( capacity * sizeof(tenant_t*) );
+
+        if( NULL == p ) {
+            rv = -2;
+        } else {
+            if( 0 < tenant_total ) {
+                memcpy( p, tenants, tenant_total * sizeof(tenant_t*) );
+            }
+            if( NULL != tenants ) {
+                aker_free( tenants );
+            }
+            tenants = p;
+            tenant_capacity = capacity;
+        }
+    }
+
+    if( 0 == rv ) {
+        memmove( &tenants[i + 1], &tenants[i], (tenant_total - i) * sizeof(tenant_t*) );
+        tenants[i] = t;
+        tenant_total++;
+        __queue( t );
+    }
+    pthread_mutex_unlock( &lock );
+
+    if( 0 != rv ) {
+        if( NULL != t->id )     aker_free( t->id );
+        if( NULL != t->target ) aker_free( t->target );
+        aker_free( t );
+    }
+
+    return rv;
+}
+
+
+/* See tenant.h for details. */
+int tenant_load( const char *filename )
+{
+    char line[256];
+    int count = 0, number = 0;
+    FILE *f;
+
+    f = fopen( filename, "r" );
+    if( NULL == f ) {
+        debug_error("tenant_load() can't read %s\n", filename);
+        return -1;
+    }
+
+    while( NULL != fgets(line, sizeof(line), f) ) {
+        char *save = NULL, *id, *target, *extra;
+
+        number++;
+        id = strtok_r( line, " \t\r\n", &save );
+        if( (NULL == id) || ('#' == id[0]) ) {
+            continue;
+        }
+        target = strtok_r( NULL, " \t\r\n", &save );
+        extra = strtok_r( NULL, " \t\r\n", &save );
+
+        if( (NULL != extra) || (0 != tenant_add(id, target)) ) {
+            debug_error("tenant_load() %s:%d is not a valid tenant\n", filename, number);
+            fclose( f );
+            return -2;
+        }
+        count++;
+    }
+    fclose( f );
+
+    debug_info("tenant_load() %d tenants from %s\n", count, filename);
+
+    return count;
+}
+
+
+/* See tenant.h for details. */
+int tenant_start( const char *firewall_cmd, unsigned workers_wanted )
+{
+    unsigned i;
+    int rv;
+
+    if( 0 == workers_wanted ) {
+        workers_wanted = TENANT_DEFAULT_WORKERS;
+    }
+    if( TENANT_MAX_WORKERS < workers_wanted ) {
+        workers_wanted = TENANT_MAX_WORKERS;
+    }
+
+    workers = (pthread_t*) aker_malloc( workers_wanted * sizeof(pthread_t) );
+    if( NULL == workers ) {
+        return ENOMEM;
+    }
+
+    pthread_mutex_lock( &lock );
+    firewall = firewall_cmd;
+    timer_wheel_init( &wheel, get_unix_time() );
+    running = true;
+    pthread_mutex_unlock( &lock );
+
+    rv = pthread_create( &wheel_thread, NULL, __wheel_thread, NULL );
+    if( 0 != rv ) {
+        debug_error("tenant_start() failed to start the wheel thread: %d\n", rv);
+        pthread_mutex_lock( &lock );
+        running = false;
+        pthread_mutex_unlock( &lock );
+        aker_free( workers );
+        workers = NULL;
+        return rv;
+    }
+
+    for( i = 0; (0 == rv) && (i < workers_wanted); i++ ) {
+        rv = pthread_create( &workers[i], NULL, __worker, NULL );
+        if( 0 == rv ) {
+            worker_total++;
+        }
+    }
+
+    if( 0 != rv ) {
+        debug_error("tenant_start() failed to start the workers: %d\n", rv);
+        __stop_threads();
+    }
+
+    return rv;
+}
+
+
+/* See tenant.h for details. */
+void tenant_stop( void )
+{
+    size_t i;
+
+    __stop_threads();
+
+    pthread_mutex_lock( &lock );
+    for( i = 0; i < tenant_total; i++ ) {
+        destroy_schedule( tenants[i]->s );
+        if( NULL != tenants[i]->blocked ) aker_free( tenants[i]->blocked );
+        aker_free( tenants[i]->id );
+        aker_free( tenants[i]->target );
+        aker_free( tenants[i] );
+    }
+    if( NULL != tenants ) {
+        aker_free( tenants );
+    }
+    tenants = NULL;
+    tenant_total = 0;
+    tenant_capacity = 0;
+    ready_head = NULL;
+    ready_tail = NULL;
+    pthread_mutex_unlock( &lock );
+}
+
+
+/* See tenant.h for details. */
+int tenant_set_schedule( const char *id, schedule_t *s )
+{
+    schedule_t *old = NULL;
+    bool found;
+    int i, rv = -1;
+
+    pthread_mutex_lock( &lock );
+    i = __find( id, &found );
+    if( found ) {
+        old = tenants[i]->s;
+        tenants[i]->s = s;
+        timer_wheel_cancel( &wheel, &tenants[i]->timer );
+        __queue( tenants[i] );
+        rv = 0;
+
+        /* A worker looks at the schedule without the lock, so it gets rid
+         * of it when done. */
+        if( (NULL != old) && (old == tenants[i]->in_use) ) {
+            tenants[i]->retired = old;
+            old = NULL;
+        }
+    } else {
+        old = s;
+    }
+    pthread_mutex_unlock( &lock );
+
+    destroy_schedule( old );
+
+    return rv;
+}
+
+
+/* See tenant.h for details. */
+bool tenant_exists( const char *id )
+{
+    bool found;
+
+    pthread_mutex_lock( &lock );
+    (void) __find( id, &found );
+    pthread_mutex_unlock( &lock );
+
+    return found;
+}
+
+
+/* See tenant.h for details. */
+size_t tenant_count( void )
+{
+    size_t count;
+
+    pthread_mutex_lock( &lock );
+    count = tenant_total;
+    pthread_mutex_unlock( &lock );
+
+    return count;
+}
+
+
+/* See tenant.h for details. */
+char* tenant_get_blocked( const char *id )
+{
+    char *blocked = NULL;
+    bool found;
+    int i;
+
+    pthread_mutex_lock( &lock );
+    i = __find( id, &found );
+    if( found && (NULL != tenants[i]->blocked) ) {
+        blocked = strdup( tenants[i]->blocked );
+    }
+    pthread_mutex_unlock( &lock );
+
+    return blocked;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Binary searches the tenants for an ID.  The lock must be held.
+ *
+ *  @return the position of the tenant, or where it would go if not found
+ */
+static int __find( const char *id, bool *found )
+{
+    int lo = 0, hi = (int) tenant_total;
+
+    *found = false;
+    if( NULL == id ) {
+        return 0;
+    }
+
+    while( lo < hi ) {
+        int mid = lo + (hi - lo) / 2;
+        int cmp = strcmp( tenants[mid]->id, id );
+
+        if( 0 == cmp ) {
+            *found = true;
+            return mid;
+        }
+        if( cmp < 0 ) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+
+/**
+ *  Checks a firewall target.  It ends up on a shell command line, so only
+ *  characters that mean nothing to the shell are allowed.
+ */
+static bool __valid_target( const char *target )
+{
+    size_t i;
+
+    if( NULL == target ) {
+        return false;
+    }
+
+    for( i = 0; '\0' != target[i]; i++ ) {
+        if( (TENANT_TARGET_MAX <= i) ||
+            (!isalnum((unsigned char) target[i]) && (NULL == strchr("-_.:/@", target[i]))) )
+        {
+            return false;
+        }
+    }
+
+    return (0 < i);
+}
+
+
+/**
+ *  Hands a tenant to the workers, or has the worker it is with look at it
+ *  again.  The lock must be held.
+ */
+static void __queue( tenant_t *t )
+{
+    if( t->busy ) {
+        t->again = true;
+        return;
+    }
+    if( t->queued ) {
+        return;
+    }
+
+    t->queued = true;
+    t->ready = NULL;
+    if( NULL == ready_tail ) {
+        ready_head = t;
+    } else {
+        ready_tail->ready = t;
+    }
+    ready_tail = t;
+
+    pthread_cond_signal( &work_cond );
+}
+
+
+/**
+ *  Starts the wheel over at an earlier time and has every tenant looked at
+ *  again.  The lock must be held.
+ */
+static void __rewind( time_t now )
+{
+    size_t i;
+
+    debug_info("tenant: the time went back %ld seconds\n", (long) (wheel.now - now));
+
+    for( i = 0; i < tenant_total; i++ ) {
+        tenants[i]->timer.next = NULL;
+        tenants[i]->timer.prev = NULL;
+    }
+    timer_wheel_init( &wheel, now );
+
+    for( i = 0; i < tenant_total; i++ ) {
+        __queue( tenants[i] );
+    }
+}
+
+
+/**
+ *  Looks a tenant's blocked set and next transition up.  Called without the
+ *  lock: only the worker the tenant is with uses its schedule.
+ */
+static void __evaluate( schedule_t *s, time_t now, char **blocked,
+                        time_t *next )
+{
+    *blocked = NULL;
+    *next = INT_MAX;
+
+    if( NULL != s ) {
+        (void) prune_absolute_events( s, now );
+        *blocked = get_blocked_at_time( s, now );
+        *next = get_next_transition( s, now );
+    }
+}
+
+
+/**
+ *  Arms a tenant's timer for its next transition and keeps its blocked set,
+ *  which it takes over.  The lock must be held.
+ *
+ *  @return the firewall command to run if the set changed, NULL otherwise
+ */
+static char* __apply( tenant_t *t, char *blocked, time_t next )
+{
+    if( INT_MAX != next ) {
+        timer_wheel_add( &wheel, &t->timer, next );
+        if( next < wheel_waits_until ) {
+            pthread_cond_signal( &wheel_cond );
+        }
+    } else {
+        timer_wheel_cancel( &wheel, &t->timer );
+    }
+
+    if( t->applied &&
+        (((NULL == blocked) && (NULL == t->blocked)) ||
+         ((NULL != blocked) && (NULL != t->blocked) && (0 == strcmp(blocked, t->blocked)))) )
+    {
+        if( NULL != blocked ) {
+            aker_free( blocked );
+        }
+        return NULL;
+    }
+
+    if( NULL != t->blocked ) {
+        aker_free( t->blocked );
+    }
+    t->blocked = blocked;
+    t->applied = true;
+
+    return __firewall_cmd( t );
+}
+
+
+/**
+ *  Makes the firewall command line for a tenant's blocked set.
+ *
+ *  @return the command line, NULL if there is no firewall or no memory
+ */
+static char* __firewall_cmd( const tenant_t *t )
+{
+    char *buf;
+    size_t len;
+
+    if( NULL == firewall ) {
+        return NULL;
+    }
+
+    len = strlen(firewall) + 1 + strlen(t->target) + 1;
+    if( NULL != t->blocked ) {
+        len += 1 + strlen(t->blocked);
+    }
+
+    buf = (char*) aker_malloc( len );
+    if( NULL == buf ) {
+        debug_error("tenant %s: no memory for the firewall command\n", t->id);
+        return NULL;
+    }
+
+    if( NULL != t->blocked ) {
+        snprintf( buf, len, "%s %s %s", firewall, t->target, t->blocked );
+    } else {
+        snprintf( buf, len, "%s %s", firewall, t->target );
+    }
+
+    return buf;
+}
+
+
+/**
+ *  Drives the timer wheel, handing the tenants that are due to the workers.
+ */
+static void* __wheel_thread( void *args )
+{
+    (void) args;
+
+    pthread_mutex_lock( &lock );
+    while( running ) {
+        time_t now = get_unix_time();
+        timer_node_t *n;
+        int rv;
+
+        if( now < wheel.now ) {
+            __rewind( now );
+        }
+
+        (void) timer_wheel_advance( &wheel, now );
+        while( NULL != (n = timer_wheel_expired(&wheel)) ) {
+            __queue( TENANT_OF(n) );
+        }
+
+        wheel_waits_until = timer_wheel_next( &wheel );
+        rv = aker_clock_wait_until( &wheel_cond, &lock, wheel_waits_until );
+        if( (0 != rv) && (ETIMEDOUT != rv) ) {
+            debug_error("tenant: aker_clock_wait_until error: %d(%s)\n", rv, strerror(rv));
+        }
+    }
+    pthread_mutex_unlock( &lock );
+
+    return NULL;
+}
+
+
+/**
+ *  Takes tenants off the ready queue, one at a time, and applies them.
+ *  The schedule is looked at and the firewall called without the lock held.
+ */
+static void* __worker( void *args )
+{
+    (void) args;
+
+    pthread_mutex_lock( &lock );
+    while( running ) {
+        tenant_t *t = ready_head;
+        schedule_t *s, *retired;
+        char *cmd = NULL;
+        char *blocked;
+        time_t next;
+
+        if( NULL == t ) {
+            pthread_cond_wait( &work_cond, &lock );
+            continue;
+        }
+
+        ready_head = t->ready;
+        if( NULL == ready_head ) {
+            ready_tail = NULL;
+        }
+        t->ready = NULL;
+        t->queued = false;
+        t->busy = true;
+        s = t->s;
+        t->in_use = s;
+        pthread_mutex_unlock( &lock );
+
+        __evaluate( s, get_unix_time(), &blocked, &next );
+
+        pthread_mutex_lock( &lock );
+        retired = t->retired;
+        t->retired = NULL;
+        t->in_use = NULL;
+        if( NULL == retired ) {
+            cmd = __apply( t, blocked, next );
+        } else if( NULL != blocked ) {
+            /* Replaced meanwhile, so it is looked at again right after. */
+            aker_free( blocked );
+        }
+        pthread_mutex_unlock( &lock );
+
+        destroy_schedule( retired );
+        if( NULL != cmd ) {
+            debug_info("Firewall command: '%s'\n", cmd);
+            if( 0 != system(cmd) ) {
+                debug_error("tenant %s: firewall command failed\n", t->id);
+            }
+            aker_free( cmd );
+        }
+
+        pthread_mutex_lock( &lock );
+        t->busy = false;
+        if( t->again ) {
+            t->again = false;
+            __queue( t );
+        }
+    }
+    pthread_mutex_unlock( &lock );
+
+    return NULL;
+}
+
+
+/**
+ *  Stops and joins the wheel thread and the workers.
+ */
+static void __stop_threads( void )
+{
+    bool started;
+    unsigned i;
+
+    pthread_mutex_lock( &lock );
+    started = running;
+    running = false;
+    pthread_cond_broadcast( &work_cond );
+    pthread_cond_broadcast( &wheel_cond );
+    pthread_mutex_unlock( &lock );
+
+    if( started ) {
+        pthread_join( wheel_thread, NULL );
+        for( i = 0; i < worker_total; i++ ) {
+            pthread_join( workers[i], NULL );
+        }
+    }
+
+    if( NULL != workers ) {
+        aker_free( workers );
+    }
+    workers = NULL;
+    worker_total = 0;
+}
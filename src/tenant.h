@@ -0,0 +1,127 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __TENANT_H__
+#define __TENANT_H__
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "schedule.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define TENANT_DEFAULT_WORKERS  4
+#define TENANT_MAX_WORKERS      64
+#define TENANT_TARGET_MAX       64  /* The longest firewall target. */
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+
+/*
+ *  Multi-tenant mode: besides its own schedule, aker keeps one schedule per
+ *  tenant (a downstream interface or subscriber), each applied to its own
+ *  firewall target with
+ *
+ *      <firewall_cmd> <target> [<mac> ...]
+ *
+ *  Every tenant's next transition is a timer in one hierarchical timer
+ *  wheel, driven by a single thread that hands the tenants that are due to
+ *  a small pool of workers.  A worker looks the tenant's blocked set up and
+ *  calls the firewall if it changed, so the cost of a tick depends on the
+ *  tenants that are due, not on how many there are.  A tenant is only ever
+ *  with one worker at a time, so its firewall calls stay in order.
+ *
+ *  Tenant schedules use the process time zone, i.e. the main schedule's.
+ */
+
+/**
+ *  Adds a tenant.  Once started, it is applied right away.
+ *
+ *  @param id     the tenant ID, see process_is_named_ok()
+ *  @param target the firewall target, up to TENANT_TARGET_MAX letters,
+ *                digits or "-_.:/@", NULL for the tenant ID
+ *
+ *  @return 0 on success, -1 if the ID or target is not valid, -2 if out of
+ *          memory, -3 if the tenant exists already
+ */
+int tenant_add( const char *id, const char *target );
+
+/**
+ *  Adds the tenants listed in a file, one "<id> [<target>]" per line.
+ *  Blank lines and lines starting with '#' are skipped.
+ *
+ *  @param filename the tenants file
+ *
+ *  @return the number of tenants added, -1 if the file can't be read, -2 if
+ *          a line is not valid (the ones before it are added)
+ */
+int tenant_load( const char *filename );
+
+/**
+ *  Starts the timer wheel thread and the workers.  Every tenant is applied
+ *  once at start, as the firewall's state is not known.
+ *
+ *  @param firewall_cmd the firewall command
+ *  @param workers      the number of worker threads, 0 for
+ *                      TENANT_DEFAULT_WORKERS
+ *
+ *  @return 0 on success, error otherwise
+ */
+int tenant_start( const char *firewall_cmd, unsigned workers );
+
+/**
+ *  Stops the threads and drops every tenant and its schedule.  Nothing is
+ *  stopped if tenant_start() wasn't called.
+ */
+void tenant_stop( void );
+
+/**
+ *  Replaces a tenant's schedule and has it applied.
+ *
+ *  @param id the tenant ID
+ *  @param s  the finalized schedule to take ownership of, NULL for none;
+ *            destroyed on error
+ *
+ *  @return 0 on success, -1 if there is no such tenant
+ */
+int tenant_set_schedule( const char *id, schedule_t *s );
+
+/**
+ *  Returns true if there is a tenant by that ID.
+ */
+bool tenant_exists( const char *id );
+
+/**
+ *  Returns the number of tenants.
+ */
+size_t tenant_count( void );
+
+/**
+ *  Returns the blocked set last given to a tenant's firewall target.
+ *
+ *  @note The returned string needs to be aker_free()-ed by the caller.
+ *
+ *  @param id the tenant ID
+ *
+ *  @return the space separated MAC addresses, NULL if none, the tenant
+ *          hasn't been applied yet or there is no such tenant
+ */
+char* tenant_get_blocked( const char *id );
+
+#endif
@@ -19,6 +19,7 @@
 #include <stdlib.h>
 
 #include "time.h"
+#include "aker_clock.h"
 #include "aker_log.h"
 
 /*----------------------------------------------------------------------------*/
@@ -52,7 +53,7 @@ time_t convert_unix_time_to_weekly(time_t unixtime)
     time_t t = unixtime;
     struct tm ts;
 
-    ts = *localtime(&t);
+    localtime_r(&t, &ts);
 
     seconds_since_sunday_midnght = (ts.tm_wday * 24 * 3600) +
             (ts.tm_hour * 3600) +
@@ -66,19 +67,7 @@ time_t convert_unix_time_to_weekly(time_t unixtime)
 /* See time.h for details. */
 time_t get_unix_time(void)
 {
-    #define SLEEP_TIME 5
-    struct timespec tm;
-    time_t unix_time = 0;
-
-    while( 1 ) {
-        if( 0 == clock_gettime(CLOCK_REALTIME, &tm) ) {
-            unix_time = tm.tv_sec; // ignore tm.tv_nsec
-            break;
-        }
-        sleep(SLEEP_TIME);
-    }
-
-    return unix_time;
+    return aker_clock_now();
 }
 
 int set_unix_time_zone (const char *time_zone)
@@ -34,7 +34,8 @@
 time_t convert_unix_time_to_weekly( time_t unixtime );
 
 /**
- * Utility wrapper for unixtime.
+ * Utility wrapper for unixtime.  Follows the virtual clock when one is set,
+ * see aker_clock.h.
  *
  * @note Will block until system call is successful
  *
@@ -0,0 +1,348 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "timer_wheel.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define SLOT_MASK       ((uint64_t) (TIMER_WHEEL_SLOTS - 1))
+#define TOP_SHIFT       (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static void __list_init( timer_node_t *head );
+static bool __list_empty( const timer_node_t *head );
+static void __link( timer_node_t *head, timer_node_t *n );
+static void __unlink( timer_wheel_t *w, timer_node_t *n );
+static void __place( timer_wheel_t *w, timer_node_t *n );
+static void __replace_all( timer_wheel_t *w, timer_node_t *head );
+static bool __next_tick( const timer_wheel_t *w, time_t *tick );
+static void __tick( timer_wheel_t *w );
+static unsigned __lowest_bit( uint64_t bits );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See timer_wheel.h for details. */
+void timer_wheel_init( timer_wheel_t *w, time_t now )
+{
+    size_t l, i;
+
+    memset( w, 0, sizeof(timer_wheel_t) );
+    w->now = now;
+
+    for( l = 0; l < TIMER_WHEEL_LEVELS; l++ ) {
+        for( i = 0; i < TIMER_WHEEL_SLOTS; i++ ) {
+            __list_init( &w->slot[l][i] );
+        }
+    }
+    __list_init( &w->overflow );
+    __list_init( &w->expired );
+}
+
+
+/* See timer_wheel.h for details. */
+void timer_wheel_add( timer_wheel_t *w, timer_node_t *n, time_t deadline )
+{
+    if( timer_wheel_armed(n) ) {
+        __unlink( w, n );
+    } else {
+        w->count++;
+    }
+
+    n->deadline = deadline;
+    __place( w, n );
+}
+
+
+/* See timer_wheel.h for details. */
+void timer_wheel_cancel( timer_wheel_t *w, timer_node_t *n )
+{
+    if( timer_wheel_armed(n) ) {
+        __unlink( w, n );
+        w->count--;
+    }
+}
+
+
+/* See timer_wheel.h for details. */
+bool timer_wheel_armed( const timer_node_t *n )
+{
+    return (NULL != n->next);
+}
+
+
+/* See timer_wheel.h for details. */
+size_t timer_wheel_advance( timer_wheel_t *w, time_t now )
+{
+    size_t count = 0;
+    timer_node_t *p;
+    time_t tick;
+
+    /* Nothing can be in a slot the time skips over. */
+    while( w->now < now ) {
+        if( !__next_tick(w, &tick) || (now < tick) ) {
+            w->now = now;
+            break;
+        }
+        w->now = tick;
+        __tick( w );
+    }
+
+    for( p = w->expired.next; p != &w->expired; p = p->next ) {
+        count++;
+    }
+
+    return count;
+}
+
+
+/* See timer_wheel.h for details. */
+timer_node_t* timer_wheel_expired( timer_wheel_t *w )
+{
+    timer_node_t *n;
+
+    if( __list_empty(&w->expired) ) {
+        return NULL;
+    }
+
+    n = w->expired.next;
+    timer_wheel_cancel( w, n );
+
+    return n;
+}
+
+
+/* See timer_wheel.h for details. */
+time_t timer_wheel_next( const timer_wheel_t *w )
+{
+    time_t tick;
+
+    if( !__list_empty(&w->expired) ) {
+        return w->now;
+    }
+    if( __next_tick(w, &tick) ) {
+        return tick;
+    }
+
+    return INT_MAX;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Makes a list head point at itself.
+ */
+static void __list_init( timer_node_t *head )
+{
+    head->next = head;
+    head->prev = head;
+}
+
+
+/**
+ *  Returns true if a list has nothing but its head.
+ */
+static bool __list_empty( const timer_node_t *head )
+{
+    return (head->next == head);
+}
+
+
+/**
+ *  Puts a timer at the end of a list.
+ */
+static void __link( timer_node_t *head, timer_node_t *n )
+{
+    n->prev = head->prev;
+    n->next = head;
+    head->prev->next = n;
+    head->prev = n;
+}
+
+
+/**
+ *  Takes a timer out of its list, clearing the slot's bit if it was the
+ *  last one in it.
+ */
+static void __unlink( timer_wheel_t *w, timer_node_t *n )
+{
+    timer_node_t *first = &w->slot[0][0];
+    timer_node_t *prev = n->prev;
+
+    prev->next = n->next;
+    n->next->prev = prev;
+    n->next = NULL;
+    n->prev = NULL;
+
+    if( __list_empty(prev) &&
+        (first <= prev) && (prev < first + TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS) )
+    {
+        size_t k = (size_t) (prev - first);
+
+        w->occupied[k / TIMER_WHEEL_SLOTS] &= ~((uint64_t) 1 << (k % TIMER_WHEEL_SLOTS));
+    }
+}
+
+
+/**
+ *  Puts an unlinked timer where its deadline belongs relative to the wheel's
+ *  time: the expired list, the lowest level whose span around now holds
+ *  the deadline, or the overflow list.
+ */
+static void __place( timer_wheel_t *w, timer_node_t *n )
+{
+    uint64_t now = (uint64_t) w->now;
+    uint64_t d = (uint64_t) n->deadline;
+    unsigned level;
+
+    if( n->deadline <= w->now ) {
+        __link( &w->expired, n );
+        return;
+    }
+
+    for( level = 0; level < TIMER_WHEEL_LEVELS; level++ ) {
+        unsigned shift = TIMER_WHEEL_BITS * (level + 1);
+
+        if( (d >> shift) == (now >> shift) ) {
+            size_t i = (size_t) ((d >> (shift - TIMER_WHEEL_BITS)) & SLOT_MASK);
+
+            __link( &w->slot[level][i], n );
+            w->occupied[level] |= (uint64_t) 1 << i;
+            return;
+        }
+    }
+
+    __link( &w->overflow, n );
+}
+
+
+/**
+ *  Places every timer of a list again.
+ */
+static void __replace_all( timer_wheel_t *w, timer_node_t *head )
+{
+    while( !__list_empty(head) ) {
+        timer_node_t *n = head->next;
+
+        __unlink( w, n );
+        __place( w, n );
+    }
+}
+
+
+/**
+ *  Finds the next time after the wheel's time at which a slot in use, or
+ *  the overflow list, has to be looked at.  A timer only ever sits in a slot
+ *  after the wheel's time in its level's turn, so this is the earliest set
+ *  bit past now on each level.
+ *
+ *  @return false if no timer is waiting
+ */
+static bool __next_tick( const timer_wheel_t *w, time_t *tick )
+{
+    uint64_t now = (uint64_t) w->now;
+    uint64_t best = 0;
+    bool found = false;
+    unsigned level;
+
+    for( level = 0; level < TIMER_WHEEL_LEVELS; level++ ) {
+        unsigned shift = TIMER_WHEEL_BITS * level;
+        unsigned i = (unsigned) ((now >> shift) & SLOT_MASK);
+        uint64_t later = (TIMER_WHEEL_SLOTS - 1 == i) ? 0 : ~(((uint64_t) 2 << i) - 1);
+        uint64_t bits = w->occupied[level] & later;
+
+        if( 0 != bits ) {
+            uint64_t t = ((now >> (shift + TIMER_WHEEL_BITS)) << (shift + TIMER_WHEEL_BITS)) +
+                         ((uint64_t) __lowest_bit(bits) << shift);
+
+            if( !found || (t < best) ) {
+                best = t;
+                found = true;
+            }
+        }
+    }
+
+    if( !__list_empty(&w->overflow) ) {
+        uint64_t t = ((now >> TOP_SHIFT) + 1) << TOP_SHIFT;
+
+        if( !found || (t < best) ) {
+            best = t;
+            found = true;
+        }
+    }
+
+    *tick = (time_t) best;
+
+    return found;
+}
+
+
+/**
+ *  Does the work due at the wheel's (new) time: the overflow list at the
+ *  start of a top level turn, then each level's slot starting now from the
+ *  top down so timers moved down are expired in the same tick.
+ */
+static void __tick( timer_wheel_t *w )
+{
+    uint64_t now = (uint64_t) w->now;
+    unsigned level;
+
+    if( 0 == (now & ((((uint64_t) 1) << TOP_SHIFT) - 1)) ) {
+        __replace_all( w, &w->overflow );
+    }
+
+    for( level = TIMER_WHEEL_LEVELS; 0 < level; level-- ) {
+        unsigned shift = TIMER_WHEEL_BITS * (level - 1);
+        size_t i = (size_t) ((now >> shift) & SLOT_MASK);
+
+        if( (0 == (now & ((((uint64_t) 1) << shift) - 1))) &&
+            (0 != (w->occupied[level - 1] & ((uint64_t) 1 << i))) )
+        {
+            __replace_all( w, &w->slot[level - 1][i] );
+        }
+    }
+}
+
+
+/**
+ *  Returns the position of the lowest set bit of a non zero value.
+ */
+static unsigned __lowest_bit( uint64_t bits )
+{
+    unsigned i = 0;
+
+    while( 0 == (bits & 0xff) ) {
+        bits >>= 8;
+        i += 8;
+    }
+    while( 0 == (bits & 1) ) {
+        bits >>= 1;
+        i++;
+    }
+
+    return i;
+}
@@ -0,0 +1,115 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __TIMER_WHEEL_H__
+#define __TIMER_WHEEL_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define TIMER_WHEEL_BITS    6
+#define TIMER_WHEEL_SLOTS   (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS  4       /* 64 s, 68 min, 3 days, 194 days. */
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+
+/* A timer, embedded in whatever it is the timer of.  It starts zeroed. */
+typedef struct timer_node {
+    struct timer_node *next;
+    struct timer_node *prev;
+    time_t deadline;
+} timer_node_t;
+
+/* Timers with a one second resolution.  A timer sits in the slot of the
+ * lowest level whose span still holds its deadline and moves down a level
+ * when the time reaches its slot, so adding, cancelling and expiring are
+ * O(1) whatever the number of timers, and advancing the time only stops at
+ * slots that are in use.  Deadlines past the top level wait in an overflow
+ * list that is looked at once per top level turn. */
+typedef struct timer_wheel {
+    time_t now;
+    size_t count;                   /* Armed timers, the expired included. */
+    uint64_t occupied[TIMER_WHEEL_LEVELS];
+    timer_node_t slot[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    timer_node_t overflow;
+    timer_node_t expired;           /* Due, not handed out yet. */
+} timer_wheel_t;
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Sets up an empty wheel.
+ *
+ *  @param w   the wheel
+ *  @param now the time the wheel starts at
+ */
+void timer_wheel_init( timer_wheel_t *w, time_t now );
+
+/**
+ *  Arms a timer, or moves it if it is armed already.  A deadline at or
+ *  before the wheel's time expires right away.
+ *
+ *  @param w        the wheel
+ *  @param n        the timer
+ *  @param deadline when it expires
+ */
+void timer_wheel_add( timer_wheel_t *w, timer_node_t *n, time_t deadline );
+
+/**
+ *  Disarms a timer.  Nothing happens if it isn't armed.
+ */
+void timer_wheel_cancel( timer_wheel_t *w, timer_node_t *n );
+
+/**
+ *  Returns true if the timer is armed (or expired and not yet handed out).
+ */
+bool timer_wheel_armed( const timer_node_t *n );
+
+/**
+ *  Moves the wheel's time forward, expiring the timers that are due.  An
+ *  earlier time is ignored.
+ *
+ *  @param w   the wheel
+ *  @param now the time now
+ *
+ *  @return the number of expired timers waiting in timer_wheel_expired()
+ */
+size_t timer_wheel_advance( timer_wheel_t *w, time_t now );
+
+/**
+ *  Hands out, and disarms, one expired timer.
+ *
+ *  @return the timer, NULL if none has expired
+ */
+timer_node_t* timer_wheel_expired( timer_wheel_t *w );
+
+/**
+ *  Returns when timer_wheel_advance() next has work to do: the wheel's time
+ *  if timers have expired, the start of the next slot in use otherwise
+ *  (never after the earliest deadline), or INT_MAX if nothing is armed.
+ */
+time_t timer_wheel_next( const timer_wheel_t *w );
+
+#endif
@@ -15,18 +15,22 @@
  *
  */
 #include <stdio.h>
+#include <strings.h>
+#include <ctype.h>
 
 #include "aker_log.h"
 #include "wrp_interface.h"
 #include "process_data.h"
 #include "scheduler.h"
+#include "tenant.h"
 #include "aker_mem.h"
 #include "aker_msgpack.h"
 
 /*----------------------------------------------------------------------------*/
 /*                                   Macros                                   */
 /*----------------------------------------------------------------------------*/
-/* None */
+#define HEADER_IF_NONE_MATCH "If-None-Match"
+#define HEADER_ETAG          "ETag"
 
 /*----------------------------------------------------------------------------*/
 /*                               Data Structures                              */
@@ -40,6 +44,10 @@ typedef struct wrp_req_msg  req_msg_t;
 void process_crud(const char *data_file, const char *md5_file,
                   const char *service, const char *endpoint,
                   wrp_msg_t *in, wrp_msg_t *response);
+static bool __not_modified( const crud_msg_t *msg, const char *etag );
+static void __add_etag( crud_msg_t *msg, const char *etag );
+static const char* __named( const char *endpoint );
+static const char* __tenant( const char *endpoint );
 
 /*----------------------------------------------------------------------------*/
 /*                             External Functions                             */
@@ -83,15 +91,102 @@ int cleanup_wrp(wrp_msg_t *message)
     int rv = -1;
 
     if( WRP_MSG_TYPE__RETREIVE == message->msg_type ) {
+        rv = 0;
+    }
+
+    /* Any CRUD response carries a payload (at least the status message)
+     * and may carry an ETag. */
+    if( (WRP_MSG_TYPE__CREATE <= message->msg_type) &&
+        (WRP_MSG_TYPE__DELETE >= message->msg_type) )
+    {
         crud_msg_t *msg = &(message->u.crud);
-        if( msg->payload )
+        if( msg->payload ) {
             aker_free(msg->payload);
-        rv = 0;
+            msg->payload = NULL;
+        }
+        if( msg->headers ) {
+            size_t i;
+            for( i = 0; i < msg->headers->count; i++ ) {
+                aker_free(msg->headers->headers[i]);
+            }
+            aker_free(msg->headers);
+            msg->headers = NULL;
+        }
+    }
+
+    return rv;
+}
+
+/* See wrp_interface.h for details. */
+char* process_wrp_replaces( const wrp_msg_t *msg )
+{
+    char *service, *endpoint;
+    char *rv = NULL;
+
+    if( WRP_MSG_TYPE__UPDATE != msg->msg_type ) {
+        return NULL;
+    }
+
+    service = wrp_get_msg_element(WRP_ID_ELEMENT__SERVICE, msg, DEST);
+    endpoint = wrp_get_msg_element(WRP_ID_ELEMENT__APPLICATION, msg, DEST);
+
+    if( (NULL != service) &&
+        (NULL != endpoint) &&
+        (0 == strcmp(SERVICE_AKER, service)) &&
+        ((0 == strcmp(APP_SCHEDULE, endpoint)) ||
+         ((0 != strcmp(APP_SCHEDULE_PATCH, endpoint)) && (NULL != __named(endpoint))) ||
+         (NULL != __tenant(endpoint))) )
+    {
+        size_t len = strlen(endpoint) + 1;
+
+        rv = (char*) aker_malloc(len);
+        if( NULL != rv ) {
+            memcpy(rv, endpoint, len);
+        }
+    }
+
+    if (endpoint) {
+        free(endpoint);
+    }
+    if (service) {
+        free(service);
     }
 
     return rv;
 }
 
+/* See wrp_interface.h for details. */
+int process_wrp_reject( wrp_msg_t *msg, int status, const char *text,
+                        wrp_msg_t *response )
+{
+    crud_msg_t *crud_in = &(msg->u.crud);
+    crud_msg_t *crud_out = &(response->u.crud);
+
+    if( (WRP_MSG_TYPE__CREATE > msg->msg_type) ||
+        (WRP_MSG_TYPE__DELETE < msg->msg_type) )
+    {
+        return -1;
+    }
+
+    /* Response struct has been initialized to 0. */
+    response->msg_type = msg->msg_type;
+
+    crud_out->content_type     = "application/msgpack";
+    crud_out->transaction_uuid = crud_in->transaction_uuid;
+    crud_out->source           = crud_in->dest;
+    crud_out->dest             = crud_in->source;
+    crud_out->path             = crud_in->path;
+    crud_out->status           = status;
+    crud_out->payload_size     = pack_status_msg(text, &crud_out->payload);
+
+    crud_in->transaction_uuid = NULL;
+    crud_in->source = NULL;
+    crud_in->dest   = NULL;
+    crud_in->path   = NULL;
+
+    return 0;
+}
+
 /*----------------------------------------------------------------------------*/
 /*                             Internal functions                             */
 /*----------------------------------------------------------------------------*/
@@ -101,6 +196,8 @@ void process_crud(const char *data_file, const char *md5_file,
 {
     int tmp;
     int payload_valid;
+    char *etag = NULL;
+    const char *name;
     crud_msg_t *crud_in = &(in->u.crud);
     crud_msg_t *crud_out = &(response->u.crud);
 
@@ -130,19 +227,66 @@ void process_crud(const char *data_file, const char *md5_file,
                     } else {
                         crud_out->status = 409;
                     }
-                } else if( 0 == strcmp(APP_SCHEDULE_END, endpoint) ) {
+                } else if( (0 == strcmp(APP_SCHEDULE_END, endpoint)) ||
+                           (0 == strcmp(APP_SCHEDULE_PATCH, endpoint)) ||
+                           (0 == strncmp(APP_DEVICE_PREFIX, endpoint, strlen(APP_DEVICE_PREFIX))) ) {
                     crud_out->status = 405;
+                } else if( NULL != (name = __named(endpoint)) ) {
+                    tmp = process_is_named_create_ok(data_file, name);
+                    if( 0 == tmp ) {
+                        tmp = process_named_update(data_file, md5_file, name,
+                                                   crud_in->payload, crud_in->payload_size );
+                        crud_out->status = ((0 == tmp) ? 201 : 533);
+                    } else {
+                        crud_out->status = ((-1 == tmp) ? 409 : 400);
+                    }
+                } else if( NULL != (name = __tenant(endpoint)) ) {
+                    if( !tenant_exists(name) ) {
+                        crud_out->status = 404;
+                    } else if( 0 == (tmp = process_is_tenant_create_ok(data_file, name)) ) {
+                        tmp = process_tenant_update(data_file, md5_file, name,
+                                                    crud_in->payload, crud_in->payload_size );
+                        crud_out->status = ((0 == tmp) ? 201 : 533);
+                    } else {
+                        crud_out->status = ((-1 == tmp) ? 409 : 400);
+                    }
                 }
                 break;
                 
             case WRP_MSG_TYPE__RETREIVE:
+                /* The tag is taken before the payload, so a change in
+                 * between can only make the next request return a 200. */
                 if( 0 == strcmp(APP_SCHEDULE, endpoint) ) {
+                    etag = process_get_schedule_etag();
+                    if( __not_modified(crud_in, etag) ) {
+                        crud_out->status = 304;
+                    } else {
+                        crud_out->status = 200;
+                        crud_out->payload_size = process_retrieve_schedule(data_file,
+                                                    (uint8_t**) &(crud_out->payload));
+                    }
+                } else if( 0 == strcmp(APP_SCHEDULE_END, endpoint) ) {
+                    etag = process_get_now_etag();
+                    if( __not_modified(crud_in, etag) ) {
+                        crud_out->status = 304;
+                    } else {
+                        crud_out->status = 200;
+                        crud_out->payload_size = process_retrieve_now((uint8_t**) &(crud_out->payload));
+                    }
+                } else if( 0 == strncmp(APP_DEVICE_PREFIX, endpoint, strlen(APP_DEVICE_PREFIX)) ) {
                     crud_out->status = 200;
-                    crud_out->payload_size = read_file_from_disk(data_file,
+                    crud_out->payload_size = process_retrieve_device(&endpoint[strlen(APP_DEVICE_PREFIX)],
                                                 (uint8_t**) &(crud_out->payload));
-                } else if( 0 == strcmp(APP_SCHEDULE_END, endpoint) ) {
+                } else if( 0 == strcmp(APP_SCHEDULE_PATCH, endpoint) ) {
+                    crud_out->status = 405;
+                } else if( NULL != (name = __named(endpoint)) ) {
+                    crud_out->status = 200;
+                    crud_out->payload_size = process_retrieve_named(data_file, name,
+                                                (uint8_t**) &(crud_out->payload));
+                } else if( NULL != (name = __tenant(endpoint)) ) {
                     crud_out->status = 200;
-                    crud_out->payload_size = process_retrieve_now((uint8_t**) &(crud_out->payload));
+                    crud_out->payload_size = process_retrieve_tenant(data_file, name,
+                                                (uint8_t**) &(crud_out->payload));
                 }
 
                 if( 200 == crud_out->status ) {
@@ -151,6 +295,15 @@ void process_crud(const char *data_file, const char *md5_file,
                         crud_out->status = 404;
                     }
                     payload_valid = 1;
+                } else if( 304 == crud_out->status ) {
+                    /* Not Modified has no payload at all. */
+                    crud_out->payload = NULL;
+                    crud_out->payload_size = 0;
+                    payload_valid = 1;
+                }
+
+                if( (200 == crud_out->status) || (304 == crud_out->status) ) {
+                    __add_etag(crud_out, etag);
                 }
                 break;
 
@@ -159,8 +312,39 @@ void process_crud(const char *data_file, const char *md5_file,
                     tmp = process_update(data_file, md5_file, crud_in->payload,
                                             crud_in->payload_size );
                     crud_out->status = ((0 == tmp) ? 201 : 534);
-                } else if( 0 == strcmp(APP_SCHEDULE_END, endpoint) ) {
+                } else if( 0 == strcmp(APP_SCHEDULE_PATCH, endpoint) ) {
+                    tmp = process_patch(data_file, md5_file, crud_in->payload,
+                                        crud_in->payload_size );
+                    switch( tmp ) {
+                        case  0: crud_out->status = 200; break;
+                        case -1: crud_out->status = 400; break;
+                        case -2: crud_out->status = 404; break;
+                        case -3: crud_out->status = 412; break;
+                        case -4: crud_out->status = 409; break;
+                        case -7: crud_out->status = 405; break;
+                        default: crud_out->status = 534; break;
+                    }
+                    /* The new tag is the base for the next patch. */
+                    if( 200 == crud_out->status ) {
+                        etag = process_get_schedule_etag();
+                        __add_etag(crud_out, etag);
+                    }
+                } else if( (0 == strcmp(APP_SCHEDULE_END, endpoint)) ||
+                           (0 == strcmp(APP_SCHEDULE_PATCH, endpoint)) ||
+                           (0 == strncmp(APP_DEVICE_PREFIX, endpoint, strlen(APP_DEVICE_PREFIX))) ) {
                     crud_out->status = 405;
+                } else if( NULL != (name = __named(endpoint)) ) {
+                    tmp = process_named_update(data_file, md5_file, name,
+                                               crud_in->payload, crud_in->payload_size );
+                    crud_out->status = ((0 == tmp) ? 201 : ((-1 == tmp) ? 400 : 534));
+                } else if( NULL != (name = __tenant(endpoint)) ) {
+                    if( !tenant_exists(name) ) {
+                        crud_out->status = 404;
+                    } else {
+                        tmp = process_tenant_update(data_file, md5_file, name,
+                                                    crud_in->payload, crud_in->payload_size );
+                        crud_out->status = ((0 == tmp) ? 201 : ((-1 == tmp) ? 400 : 534));
+                    }
                 }
                 break;
 
@@ -170,8 +354,24 @@ void process_crud(const char *data_file, const char *md5_file,
                     if( 0 != process_delete(data_file, md5_file) ) {
                         crud_out->status = 535;
                     }
-                } else if( 0 == strcmp(APP_SCHEDULE_END, endpoint) ) {
+                } else if( (0 == strcmp(APP_SCHEDULE_END, endpoint)) ||
+                           (0 == strcmp(APP_SCHEDULE_PATCH, endpoint)) ||
+                           (0 == strncmp(APP_DEVICE_PREFIX, endpoint, strlen(APP_DEVICE_PREFIX))) ) {
                     crud_out->status = 405;
+                } else if( NULL != (name = __named(endpoint)) ) {
+                    switch( process_named_delete(data_file, md5_file, name) ) {
+                        case  0: crud_out->status = 200; break;
+                        case -1: crud_out->status = 400; break;
+                        case -2: crud_out->status = 404; break;
+                        default: crud_out->status = 535; break;
+                    }
+                } else if( NULL != (name = __tenant(endpoint)) ) {
+                    switch( process_tenant_delete(data_file, md5_file, name) ) {
+                        case  0: crud_out->status = 200; break;
+                        case -1: crud_out->status = 400; break;
+                        case -2: crud_out->status = 404; break;
+                        default: crud_out->status = 535; break;
+                    }
                 }
                 break;
 
@@ -180,6 +380,10 @@ void process_crud(const char *data_file, const char *md5_file,
         }
     }
 
+    if( NULL != etag ) {
+        aker_free(etag);
+    }
+
     crud_in->transaction_uuid = NULL;
     crud_in->source = NULL;
     crud_in->dest   = NULL;
@@ -196,10 +400,140 @@ void process_crud(const char *data_file, const char *md5_file,
             case 404: text = "Not Found";                   break;
             case 405: text = "Method Not allowed";          break;
             case 409: text = "Schedule already present";    break;
+            case 412: text = "Precondition Failed";         break;
             case 533: text = "Unable to create schedule";   break;
             case 534: text = "Unable to update schedule";   break;
             case 535: text = "Unable to delete schedule";   break;
         }
+        if( (409 == crud_out->status) && (WRP_MSG_TYPE__UPDATE == in->msg_type) ) {
+            text = "Patch does not fit the schedule";
+        }
         crud_out->payload_size = pack_status_msg(text, &crud_out->payload);
     }
 }
+
+
+/**
+ *  Checks the request's If-None-Match header against the current tag.  The
+ *  header value may be quoted, and "*" matches any tag.
+ *
+ *  @param msg  the CRUD request
+ *  @param etag the current tag, NULL if not known
+ *
+ *  @return true if the requester already has what would be returned
+ */
+static bool __not_modified( const crud_msg_t *msg, const char *etag )
+{
+    size_t i, name_len;
+
+    if( (NULL == etag) || (NULL == msg->headers) ) {
+        return false;
+    }
+
+    name_len = strlen(HEADER_IF_NONE_MATCH);
+    for( i = 0; i < msg->headers->count; i++ ) {
+        const char *value = msg->headers->headers[i];
+        size_t len;
+
+        if( (NULL == value) ||
+            (0 != strncasecmp(HEADER_IF_NONE_MATCH, value, name_len)) ||
+            (':' != value[name_len]) )
+        {
+            continue;
+        }
+
+        value += name_len + 1;
+        while( isspace((unsigned char) *value) ) {
+            value++;
+        }
+        len = strlen(value);
+        while( (0 < len) && isspace((unsigned char) value[len - 1]) ) {
+            len--;
+        }
+        if( (2 <= len) && ('"' == value[0]) && ('"' == value[len - 1]) ) {
+            value++;
+            len -= 2;
+        }
+
+        if( ((1 == len) && ('*' == value[0])) ||
+            ((len == strlen(etag)) && (0 == strncmp(etag, value, len))) )
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/**
+ *  Adds the "ETag: "<tag>"" header to a response.  The headers are freed by
+ *  cleanup_wrp().
+ *
+ *  @param msg  the CRUD response
+ *  @param etag the tag, nothing is added if NULL
+ */
+static void __add_etag( crud_msg_t *msg, const char *etag )
+{
+    headers_t *headers;
+    size_t len;
+
+    if( NULL == etag ) {
+        return;
+    }
+
+    headers = (headers_t*) aker_malloc(sizeof(headers_t) + sizeof(char*));
+    if( NULL == headers ) {
+        return;
+    }
+
+    len = strlen(HEADER_ETAG) + strlen(": \"\"") + strlen(etag) + 1;
+    headers->headers[0] = (char*) aker_malloc(len);
+    if( NULL == headers->headers[0] ) {
+        aker_free(headers);
+        return;
+    }
+    snprintf(headers->headers[0], len, "%s: \"%s\"", HEADER_ETAG, etag);
+    headers->count = 1;
+    msg->headers = headers;
+}
+
+
+/**
+ *  Gets the schedule name out of a "schedule/<name>" endpoint.
+ *
+ *  @param endpoint the request endpoint
+ *
+ *  @return the name, NULL if the endpoint is not a valid named schedule
+ */
+static const char* __named( const char *endpoint )
+{
+    const char *name;
+
+    if( 0 != strncmp(APP_SCHEDULE_NAMED_PREFIX, endpoint, strlen(APP_SCHEDULE_NAMED_PREFIX)) ) {
+        return NULL;
+    }
+    name = &endpoint[strlen(APP_SCHEDULE_NAMED_PREFIX)];
+
+    return process_is_named_ok(name) ? name : NULL;
+}
+
+
+/**
+ *  Gets the tenant ID out of a "tenant/<id>" endpoint.
+ *
+ *  @param endpoint the request endpoint
+ *
+ *  @return the ID, NULL if the endpoint is not a valid tenant's
+ */
+static const char* __tenant( const char *endpoint )
+{
+    const char *id;
+
+    if( 0 != strncmp(APP_TENANT_PREFIX, endpoint, strlen(APP_TENANT_PREFIX)) ) {
+        return NULL;
+    }
+    id = &endpoint[strlen(APP_TENANT_PREFIX)];
+
+    return process_is_named_ok(id) ? id : NULL;
+}
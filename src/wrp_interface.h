@@ -36,6 +36,10 @@ extern "C" {
 #define SERVICE_AKER         "aker"
 #define APP_SCHEDULE         "schedule"
 #define APP_SCHEDULE_END     "now"
+#define APP_DEVICE_PREFIX    "device/"
+#define APP_SCHEDULE_PATCH   "schedule/patch"
+#define APP_SCHEDULE_NAMED_PREFIX "schedule/"
+#define APP_TENANT_PREFIX    "tenant/"
     
 
 /*----------------------------------------------------------------------------*/
@@ -65,6 +69,34 @@ int process_wrp(const char *data_file, const char *md5_file,
  */
 int cleanup_wrp(wrp_msg_t *response);
 
+/**
+ *  Tells whether a request replaces a whole schedule: an UPDATE of the main,
+ *  a named or a tenant schedule.  Of two such requests for the same
+ *  endpoint, only the newer one needs to be applied.
+ *
+ *  @note The returned string needs to be aker_free()-ed by the caller.
+ *
+ *  @param msg      [in]  incoming WRP data.
+ *
+ *  @return the endpoint it replaces, NULL if none
+ */
+char* process_wrp_replaces(const wrp_msg_t *msg);
+
+/**
+ *  Answers an incoming message without processing it.
+ *
+ *  @note The response WRP message needs to be cleaned up by the caller.
+ *
+ *  @param msg      [in]  incoming WRP data.
+ *  @param status   [in]  the response status.
+ *  @param text     [in]  the response message.
+ *  @param response [in]  response WRP message.
+ *
+ *  @return 0 if the response message is to be sent, < 0 otherwise.
+ */
+int process_wrp_reject(wrp_msg_t *msg, int status, const char *text,
+                       wrp_msg_t *response);
+
 #ifdef __cplusplus
 }
 #endif
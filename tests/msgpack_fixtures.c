@@ -0,0 +1,85 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "msgpack_fixtures.h"
+#include "../src/decode.h"
+
+/* See msgpack_fixtures.h for details. */
+void pack_str( msgpack_packer *pk, const char *s )
+{
+    msgpack_pack_str( pk, strlen(s) );
+    msgpack_pack_str_body( pk, s, strlen(s) );
+}
+
+
+/* See msgpack_fixtures.h for details. */
+size_t to_buffer( msgpack_sbuffer *sbuf, uint8_t **data )
+{
+    size_t len = sbuf->size;
+
+    *data = (uint8_t*) malloc( len );
+    memcpy( *data, sbuf->data, len );
+    msgpack_sbuffer_destroy( sbuf );
+
+    return len;
+}
+
+
+/* See msgpack_fixtures.h for details. */
+schedule_t* make_weekly_schedule( const char *mac0, const char *mac1,
+                                  int start, int end )
+{
+    msgpack_sbuffer sbuf;
+    msgpack_packer pk;
+    schedule_t *s = NULL;
+
+    msgpack_sbuffer_init( &sbuf );
+    msgpack_packer_init( &pk, &sbuf, msgpack_sbuffer_write );
+
+    msgpack_pack_map( &pk, 3 );
+    pack_str( &pk, "time_zone" );
+    pack_str( &pk, "UTC" );
+    pack_str( &pk, "macs" );
+    msgpack_pack_array( &pk, 2 );
+    pack_str( &pk, mac0 );
+    pack_str( &pk, mac1 );
+    pack_str( &pk, "weekly" );
+    msgpack_pack_array( &pk, 2 );
+
+    msgpack_pack_map( &pk, 2 );
+    pack_str( &pk, "time" );
+    msgpack_pack_int( &pk, start * 3600 );
+    pack_str( &pk, "indexes" );
+    msgpack_pack_array( &pk, 2 );
+    msgpack_pack_int( &pk, 0 );
+    msgpack_pack_int( &pk, 1 );
+
+    msgpack_pack_map( &pk, 2 );
+    pack_str( &pk, "time" );
+    msgpack_pack_int( &pk, end * 3600 );
+    pack_str( &pk, "indexes" );
+    msgpack_pack_array( &pk, 0 );
+
+    if( 0 != decode_schedule(sbuf.size, (uint8_t*) sbuf.data, &s) ) {
+        s = NULL;
+    }
+    msgpack_sbuffer_destroy( &sbuf );
+
+    return s;
+}
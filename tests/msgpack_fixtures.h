@@ -0,0 +1,49 @@
+/**
+ * Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __MSGPACK_FIXTURES_H__
+#define __MSGPACK_FIXTURES_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <msgpack.h>
+
+#include "../src/schedule.h"
+
+/* Builders for the msgpack the tests feed the decoders. */
+
+/**
+ *  Packs a string.
+ */
+void pack_str( msgpack_packer *pk, const char *s );
+
+/**
+ *  Moves what was packed into a malloc()-ed buffer and destroys the sbuffer.
+ *
+ *  @return the length of the buffer
+ */
+size_t to_buffer( msgpack_sbuffer *sbuf, uint8_t **data );
+
+/**
+ *  Makes a UTC weekly schedule of two MAC addresses blocking both of them
+ *  from start to end (hours into the week).
+ *
+ *  @return the decoded schedule, NULL on error
+ */
+schedule_t* make_weekly_schedule( const char *mac0, const char *mac1,
+                                  int start, int end );
+
+#endif
@@ -18,6 +18,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <limits.h>
 #include <wrp-c.h>
 
 #include <CUnit/Basic.h>
@@ -103,6 +104,84 @@ void test_pack_now_msg()
     buf = NULL;
 }
 
+void test_pack_device_msg()
+{
+    // unblocked, never changes, time: 1513822552
+    uint8_t expected0[] = { 0x83,
+                                 0xa3, 'm', 'a', 'c',
+                                 0xb1, '1', '1', ':', '2', '2', ':', '3', '3', ':', '4', '4', ':', '5', '5', ':', '6', '6',
+                                 0xa7, 'b', 'l', 'o', 'c', 'k', 'e', 'd',
+                                 0xc2,
+                                 0xa4, 't', 'i', 'm', 'e',
+                                 0xce, 0x5a, 0x3b, 0x19, 0x58 };
+
+    // blocked until 1513822653, time: 1513822553
+    uint8_t expected1[] = { 0x84,
+                                 0xa3, 'm', 'a', 'c',
+                                 0xb1, '1', '1', ':', '2', '2', ':', '3', '3', ':', '4', '4', ':', '5', '5', ':', '6', '6',
+                                 0xa7, 'b', 'l', 'o', 'c', 'k', 'e', 'd',
+                                 0xc3,
+                                 0xab, 'n', 'e', 'x', 't', '_', 'c', 'h', 'a', 'n', 'g', 'e',
+                                 0xce, 0x5a, 0x3b, 0x19, 0xbd,
+                                 0xa4, 't', 'i', 'm', 'e',
+                                 0xce, 0x5a, 0x3b, 0x19, 0x59 };
+
+    size_t len;
+    uint8_t *buf;
+
+    buf = NULL;
+    len = pack_device_msg( "11:22:33:44:55:66", false, INT_MAX, 1513822552, (void**) &buf );
+    CU_ASSERT( sizeof(expected0)/sizeof(uint8_t) == len );
+    CU_ASSERT( NULL != buf );
+    CU_ASSERT( 0 == memcmp(expected0, buf, len) );
+    aker_free(buf);
+    buf = NULL;
+
+    len = pack_device_msg( "11:22:33:44:55:66", true, 1513822653, 1513822553, (void**) &buf );
+    CU_ASSERT( sizeof(expected1)/sizeof(uint8_t) == len );
+    CU_ASSERT( NULL != buf );
+    CU_ASSERT( 0 == memcmp(expected1, buf, len) );
+    aker_free(buf);
+}
+
+void test_pack_event_msg()
+{
+    // active: 11:22:33:44:55:66, seq: 5, time: 1513822552
+    uint8_t expected0[] = { 0x83,
+                                 0xa6, 'a', 'c', 't', 'i', 'v', 'e',
+                                 0xb1, '1', '1', ':', '2', '2', ':', '3', '3', ':', '4', '4', ':', '5', '5', ':', '6', '6',
+                                 0xa3, 's', 'e', 'q',
+                                 0x05,
+                                 0xa4, 't', 'i', 'm', 'e',
+                                 0xce, 0x5a, 0x3b, 0x19, 0x58 };
+
+    // nothing blocked, seq: 4294967296, time: 1513822553
+    uint8_t expected1[] = { 0x83,
+                                 0xa6, 'a', 'c', 't', 'i', 'v', 'e',
+                                 0xa0,
+                                 0xa3, 's', 'e', 'q',
+                                 0xcf, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+                                 0xa4, 't', 'i', 'm', 'e',
+                                 0xce, 0x5a, 0x3b, 0x19, 0x59 };
+
+    size_t len;
+    uint8_t *buf;
+
+    buf = NULL;
+    len = pack_event_msg( "11:22:33:44:55:66", 5, 1513822552, (void**) &buf );
+    CU_ASSERT( sizeof(expected0)/sizeof(uint8_t) == len );
+    CU_ASSERT( NULL != buf );
+    CU_ASSERT( 0 == memcmp(expected0, buf, len) );
+    aker_free(buf);
+    buf = NULL;
+
+    len = pack_event_msg( NULL, 4294967296ULL, 1513822553, (void**) &buf );
+    CU_ASSERT( sizeof(expected1)/sizeof(uint8_t) == len );
+    CU_ASSERT( NULL != buf );
+    CU_ASSERT( 0 == memcmp(expected1, buf, len) );
+    aker_free(buf);
+}
+
 
 void add_suites( CU_pSuite *suite )
 {
@@ -110,6 +189,8 @@ void add_suites( CU_pSuite *suite )
     *suite = CU_add_suite( "tests", NULL, NULL );
     CU_add_test( *suite, "Test pack_status_msg", test_pack_status_msg );
     CU_add_test( *suite, "Test pack_now_msg", test_pack_now_msg );
+    CU_add_test( *suite, "Test pack_device_msg", test_pack_device_msg );
+    CU_add_test( *suite, "Test pack_event_msg", test_pack_event_msg );
 }
 
 /*----------------------------------------------------------------------------*/
@@ -0,0 +1,295 @@
+/**
+ *  Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <CUnit/Basic.h>
+
+#include "mem_wrapper.h"
+#include "../src/aker_clock.h"
+#include "../src/schedule.h"
+#include "../src/scheduler.h"
+#include "../src/time.h"
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static int turn = 0;
+
+/*----------------------------------------------------------------------------*/
+/*                                   Tests                                    */
+/*----------------------------------------------------------------------------*/
+int32_t get_max_mac_limit( void )
+{
+    return 10;
+}
+
+static void nap( long ms )
+{
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000 };
+
+    nanosleep( &ts, NULL );
+}
+
+static void *advance_later( void *arg )
+{
+    nap( 20 );
+    aker_clock_advance( *(time_t*) arg );
+    return NULL;
+}
+
+void test_real()
+{
+    time_t t = time( NULL );
+
+    aker_clock_set_real();
+    CU_ASSERT( false == aker_clock_is_virtual() );
+    CU_ASSERT( t <= get_unix_time() );
+    CU_ASSERT( get_unix_time() <= t + 1 );
+    CU_ASSERT( 0 != aker_clock_advance(10) );
+
+    /* A deadline in the past times out right away. */
+    pthread_mutex_lock( &lock );
+    CU_ASSERT( ETIMEDOUT == aker_clock_wait_until(&cond, &lock, t - 10) );
+    pthread_mutex_unlock( &lock );
+}
+
+void test_manual()
+{
+    pthread_t thread;
+    time_t step = 3600;
+
+    CU_ASSERT( 0 != aker_clock_set_virtual(1000, -1.0) );
+    CU_ASSERT( 0 == aker_clock_set_virtual(1000, 0.0) );
+    CU_ASSERT( aker_clock_is_virtual() );
+    CU_ASSERT( 1000 == get_unix_time() );
+    nap( 20 );
+    CU_ASSERT( 1000 == get_unix_time() );
+
+    CU_ASSERT( 0 != aker_clock_advance(-1) );
+    CU_ASSERT( 0 == aker_clock_advance(60) );
+    CU_ASSERT( 1060 == get_unix_time() );
+
+    /* The wait only ends when the clock is moved past the deadline. */
+    pthread_mutex_lock( &lock );
+    CU_ASSERT( ETIMEDOUT == aker_clock_wait_until(&cond, &lock, 1060) );
+    pthread_create( &thread, NULL, advance_later, &step );
+    CU_ASSERT( ETIMEDOUT == aker_clock_wait_until(&cond, &lock, 1060 + 3600) );
+    pthread_mutex_unlock( &lock );
+    pthread_join( thread, NULL );
+    CU_ASSERT( 1060 + 3600 == get_unix_time() );
+
+    aker_clock_set_real();
+}
+
+void test_woken_early()
+{
+    pthread_t thread;
+    time_t step = 60;
+
+    /* Moving the clock short of the deadline still wakes the wait, so the
+     * caller can look again instead of the wait polling for it. */
+    CU_ASSERT( 0 == aker_clock_set_virtual(1000, 0.0) );
+    pthread_mutex_lock( &lock );
+    pthread_create( &thread, NULL, advance_later, &step );
+    CU_ASSERT( 0 == aker_clock_wait_until(&cond, &lock, 1000 + 3600) );
+    pthread_mutex_unlock( &lock );
+    pthread_join( thread, NULL );
+    CU_ASSERT( 1060 == get_unix_time() );
+
+    aker_clock_set_real();
+}
+
+static void *ping_pong( void *arg )
+{
+    int me = *(int*) arg;
+    int i;
+
+    pthread_mutex_lock( &lock );
+    for( i = 0; i < 1000; i++ ) {
+        while( me != turn ) {
+            aker_clock_wait_until( &cond, &lock, 1000 + 3600 );
+        }
+        turn = 1 - me;
+        pthread_cond_broadcast( &cond );
+    }
+    pthread_mutex_unlock( &lock );
+
+    return NULL;
+}
+
+void test_no_lost_signal()
+{
+    pthread_t thread;
+    int players[] = { 0, 1 };
+
+    /* With the clock stopped a lost signal leaves both sides waiting. */
+    CU_ASSERT( 0 == aker_clock_set_virtual(1000, 0.0) );
+    turn = 0;
+    pthread_create( &thread, NULL, ping_pong, &players[1] );
+    ping_pong( &players[0] );
+    pthread_join( thread, NULL );
+    CU_ASSERT( 0 == turn );
+
+    aker_clock_set_real();
+}
+
+void test_accelerated()
+{
+    time_t t;
+
+    /* A day per real second. */
+    CU_ASSERT( 0 == aker_clock_set_virtual(1510689448, 86400.0) );
+    pthread_mutex_lock( &lock );
+    CU_ASSERT( ETIMEDOUT == aker_clock_wait_until(&cond, &lock, 1510689448 + 3600) );
+    pthread_mutex_unlock( &lock );
+
+    t = get_unix_time();
+    CU_ASSERT( 1510689448 + 3600 <= t );
+    CU_ASSERT( t < 1510689448 + 86400 );
+
+    CU_ASSERT( 0 == aker_clock_advance(86400) );
+    CU_ASSERT( t + 86400 <= get_unix_time() );
+
+    aker_clock_set_real();
+}
+
+static bool wait_for_blocked( const char *expected )
+{
+    int i;
+
+    for( i = 0; i < 100; i++ ) {
+        char *macs = get_current_blocked_macs();
+        bool match;
+
+        match = ((NULL == expected) && (NULL == macs)) ||
+                ((NULL != expected) && (NULL != macs) && (0 == strcmp(expected, macs)));
+        free( macs );
+        if( match ) {
+            return true;
+        }
+        nap( 10 );
+    }
+
+    return false;
+}
+
+static void add_event( schedule_t *s, time_t t, int a, int b )
+{
+    schedule_event_t *e = create_schedule_event( (0 <= b) ? 2 : 0 );
+
+    e->time = t;
+    if( 0 <= b ) {
+        e->block[0] = a;
+        e->block[1] = b;
+    }
+    insert_event( &s->weekly, e );
+}
+
+void test_scheduler_replay()
+{
+    schedule_t *s;
+    pthread_t thread;
+
+    /* Sunday March 11, 2018 00:00:01 EST, the night clocks spring forward. */
+    set_unix_time_zone( "America/New_York" );
+    CU_ASSERT( 0 == aker_clock_set_virtual(1520744401, 0.0) );
+
+    s = create_schedule();
+    add_event( s, 2700, 0, 1 );     /* 00:45 */
+    add_event( s, 5400, 0, 2 );     /* 01:30 */
+    add_event( s, 7200, 0, 3 );     /* 02:00, skipped */
+    add_event( s, 10800, 0, 4 );    /* 03:00 */
+    add_event( s, 11700, 0, -1 );   /* 03:15 */
+    create_mac_table( s, 5 );
+    set_mac_index( s, "00:00:00:00:00:00", 17, 0 );
+    set_mac_index( s, "11:11:11:11:11:11", 17, 1 );
+    set_mac_index( s, "22:22:22:22:22:22", 17, 2 );
+    set_mac_index( s, "33:33:33:33:33:33", 17, 3 );
+    set_mac_index( s, "44:44:44:44:44:44", 17, 4 );
+    finalize_schedule( s );
+
+    CU_ASSERT_FATAL( 0 == scheduler_start(&thread, NULL) );
+    scheduler_set_schedule( s );
+    CU_ASSERT( wait_for_blocked(NULL) );
+
+    /* 00:45 EST */
+    aker_clock_advance( 2700 );
+    CU_ASSERT( wait_for_blocked("00:00:00:00:00:00 11:11:11:11:11:11") );
+
+    /* 01:30 EST */
+    aker_clock_advance( 2700 );
+    CU_ASSERT( wait_for_blocked("00:00:00:00:00:00 22:22:22:22:22:22") );
+
+    /* 01:59:59 EST, then 03:00:00 EDT: 02:00 never happens. */
+    aker_clock_advance( 1799 );
+    CU_ASSERT( wait_for_blocked("00:00:00:00:00:00 22:22:22:22:22:22") );
+    aker_clock_advance( 1 );
+    CU_ASSERT( wait_for_blocked("00:00:00:00:00:00 44:44:44:44:44:44") );
+
+    /* 03:15 EDT */
+    aker_clock_advance( 900 );
+    CU_ASSERT( wait_for_blocked(NULL) );
+
+    terminate_scheduler_thread();
+    aker_clock_set_real();
+}
+
+void add_suites( CU_pSuite *suite )
+{
+    printf("--------Start of Test Cases Execution ---------\n");
+    *suite = CU_add_suite( "tests", NULL, NULL );
+    CU_add_test( *suite, "Test real", test_real );
+    CU_add_test( *suite, "Test manual", test_manual );
+    CU_add_test( *suite, "Test woken early", test_woken_early );
+    CU_add_test( *suite, "Test no lost signal", test_no_lost_signal );
+    CU_add_test( *suite, "Test accelerated", test_accelerated );
+    CU_add_test( *suite, "Test scheduler replay", test_scheduler_replay );
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main( void )
+{
+    unsigned rv = 1;
+    CU_pSuite suite = NULL;
+
+    if( CUE_SUCCESS == CU_initialize_registry() ) {
+        add_suites( &suite );
+
+        if( NULL != suite ) {
+            CU_basic_set_mode( CU_BRM_VERBOSE );
+            CU_basic_run_tests();
+            printf( "\n" );
+            CU_basic_show_failures( CU_get_failure_list() );
+            printf( "\n\n" );
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+
+    }
+
+    return rv;
+}
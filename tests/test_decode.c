@@ -18,6 +18,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include <CUnit/Basic.h>
 
@@ -255,11 +256,33 @@ void decode_test()
     CU_ASSERT(NULL == t);
 }
 
+void decode_data_test()
+{
+    schedule_t *t = NULL;
+
+    /* Only decode_schedule() applies the schedule's time zone. */
+    set_unix_time_zone( "UTC" );
+    CU_ASSERT( 0 == decode_schedule_data(tz1_bin_len, tz1_bin, &t) );
+    CU_ASSERT_STRING_EQUAL( t->time_zone, "America/New_York" );
+    CU_ASSERT_STRING_EQUAL( getenv("TZ"), "UTC" );
+    destroy_schedule( t );
+
+    t = NULL;
+    CU_ASSERT( 0 == decode_schedule(tz1_bin_len, tz1_bin, &t) );
+    CU_ASSERT_STRING_EQUAL( getenv("TZ"), "America/New_York" );
+    destroy_schedule( t );
+
+    t = NULL;
+    CU_ASSERT( 0 != decode_schedule_data(test4_bin_len, test4_bin, &t) );
+    CU_ASSERT( NULL == t );
+}
+
 void add_suites( CU_pSuite *suite )
 {
     printf("--------Start of Test Cases Execution ---------\n");
     *suite = CU_add_suite( "tests", NULL, NULL );
     CU_add_test( *suite, "Decode Test", decode_test);
+    CU_add_test( *suite, "Decode Data Test", decode_data_test);
 }
 
 /*----------------------------------------------------------------------------*/
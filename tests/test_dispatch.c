@@ -0,0 +1,473 @@
+/**
+ *  Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <CUnit/Basic.h>
+#include <wrp-c.h>
+
+#include "../src/dispatch.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define MAX_SENT    32
+#define SLOW_PATH   "slow"
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static pthread_mutex_t mock_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t mock_cond = PTHREAD_COND_INITIALIZER;
+static char sent[MAX_SENT][16];
+static int sent_count = 0;
+static int processed = 0;
+static int pruned = 0;
+static int writes_running = 0;
+static int writes_most = 0;
+static bool slow_running = false;
+static bool slow_released = false;
+static int send_ctx = 0;
+
+/*----------------------------------------------------------------------------*/
+/*                                   Mocks                                    */
+/*----------------------------------------------------------------------------*/
+int process_wrp( const char *data_file, const char *md5_file,
+                 wrp_msg_t *msg, wrp_msg_t *response )
+{
+    bool write = (WRP_MSG_TYPE__RETREIVE != msg->msg_type);
+    char tag[16];
+
+    (void) data_file;
+    (void) md5_file;
+
+    pthread_mutex_lock( &mock_lock );
+    processed++;
+    if( write ) {
+        writes_running++;
+        if( writes_most < writes_running ) {
+            writes_most = writes_running;
+        }
+    }
+    if( 0 == strcmp(SLOW_PATH, msg->u.crud.path) ) {
+        slow_running = true;
+        pthread_cond_broadcast( &mock_cond );
+        while( !slow_released ) {
+            pthread_cond_wait( &mock_cond, &mock_lock );
+        }
+        slow_running = false;
+    }
+    if( write ) {
+        writes_running--;
+    }
+    pthread_mutex_unlock( &mock_lock );
+
+    /* The response names the request: "<R|W>:<uuid>". */
+    snprintf( tag, sizeof(tag), "%c:%s", write ? 'W' : 'R',
+              msg->u.crud.transaction_uuid );
+    response->msg_type = msg->msg_type;
+    response->u.crud.transaction_uuid = strdup( tag );
+
+    return 0;
+}
+
+int cleanup_wrp( wrp_msg_t *response )
+{
+    if( (WRP_MSG_TYPE__CREATE <= response->msg_type) &&
+        (WRP_MSG_TYPE__DELETE >= response->msg_type) )
+    {
+        free( response->u.crud.transaction_uuid );
+    }
+    return 0;
+}
+
+/* Only UPDATEs of "schedule..." paths replace a schedule here. */
+char* process_wrp_replaces( const wrp_msg_t *msg )
+{
+    if( (WRP_MSG_TYPE__UPDATE == msg->msg_type) &&
+        (0 == strncmp("schedule", msg->u.crud.path, 8)) )
+    {
+        return strdup( msg->u.crud.path );
+    }
+    return NULL;
+}
+
+int process_wrp_reject( wrp_msg_t *msg, int status, const char *text,
+                        wrp_msg_t *response )
+{
+    char tag[16];
+
+    CU_ASSERT( NULL != text );
+    CU_ASSERT( NULL == msg->u.crud.payload );
+
+    /* The response names the request: "<status>:<uuid>". */
+    snprintf( tag, sizeof(tag), "%d:%s", status, msg->u.crud.transaction_uuid );
+    response->msg_type = msg->msg_type;
+    response->u.crud.transaction_uuid = strdup( tag );
+
+    return 0;
+}
+
+int process_persist_pruned( const char *filename, const char *md5_file,
+                            size_t min_pruned )
+{
+    (void) filename;
+    (void) md5_file;
+    (void) min_pruned;
+
+    pthread_mutex_lock( &mock_lock );
+    pruned++;
+    pthread_cond_broadcast( &mock_cond );
+    pthread_mutex_unlock( &mock_lock );
+
+    return 0;
+}
+
+static int send_mock( void *ctx, wrp_msg_t *msg )
+{
+    CU_ASSERT( &send_ctx == ctx );
+
+    pthread_mutex_lock( &mock_lock );
+    if( sent_count < MAX_SENT ) {
+        snprintf( sent[sent_count], sizeof(sent[0]), "%s",
+                  msg->u.crud.transaction_uuid );
+        sent_count++;
+    }
+    pthread_cond_broadcast( &mock_cond );
+    pthread_mutex_unlock( &mock_lock );
+
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                              Test Helpers                                  */
+/*----------------------------------------------------------------------------*/
+static wrp_msg_t* make_msg( enum wrp_msg_type type, const char *uuid,
+                            const char *path )
+{
+    wrp_msg_t *msg = (wrp_msg_t*) calloc( 1, sizeof(wrp_msg_t) );
+
+    msg->msg_type = type;
+    msg->u.crud.transaction_uuid = strdup( uuid );
+    msg->u.crud.source = strdup( "dns:test" );
+    msg->u.crud.dest = strdup( "mac:112233445566/parental control" );
+    msg->u.crud.path = strdup( path );
+
+    return msg;
+}
+
+/**
+ *  Waits up to 5 seconds for a counter to reach a value.  The mock lock
+ *  must be held.
+ */
+static bool wait_for( const int *counter, int value )
+{
+    struct timespec deadline;
+
+    clock_gettime( CLOCK_REALTIME, &deadline );
+    deadline.tv_sec += 5;
+
+    while( *counter < value ) {
+        if( ETIMEDOUT == pthread_cond_timedwait(&mock_cond, &mock_lock, &deadline) ) {
+            break;
+        }
+    }
+
+    return (value <= *counter);
+}
+
+static bool wait_for_slow( void )
+{
+    struct timespec deadline;
+
+    clock_gettime( CLOCK_REALTIME, &deadline );
+    deadline.tv_sec += 5;
+
+    while( !slow_running ) {
+        if( ETIMEDOUT == pthread_cond_timedwait(&mock_cond, &mock_lock, &deadline) ) {
+            break;
+        }
+    }
+
+    return slow_running;
+}
+
+static void release_slow( void )
+{
+    slow_released = true;
+    pthread_cond_broadcast( &mock_cond );
+}
+
+/* Returns where a response is in the sent list, -1 if not there. */
+static int sent_at( const char *tag )
+{
+    int i;
+
+    for( i = 0; i < sent_count; i++ ) {
+        if( 0 == strcmp(tag, sent[i]) ) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static void reset( void )
+{
+    pthread_mutex_lock( &mock_lock );
+    sent_count = 0;
+    processed = 0;
+    pruned = 0;
+    writes_most = 0;
+    slow_released = false;
+    pthread_mutex_unlock( &mock_lock );
+}
+
+/*----------------------------------------------------------------------------*/
+/*                                   Tests                                    */
+/*----------------------------------------------------------------------------*/
+void test_inline()
+{
+    reset();
+
+    /* Not started: handled right here, with nowhere to send the answer. */
+    dispatch_submit( make_msg(WRP_MSG_TYPE__RETREIVE, "a", "schedule") );
+    dispatch_submit( NULL );
+    dispatch_idle();
+
+    CU_ASSERT( 1 == processed );
+    CU_ASSERT( 0 == sent_count );
+    CU_ASSERT( 1 == pruned );
+
+    /* Stopping what wasn't started does nothing. */
+    dispatch_stop();
+}
+
+void test_reads_during_write()
+{
+    reset();
+    CU_ASSERT_FATAL( 0 == dispatch_start("data", "md5", send_mock, &send_ctx, 2, 0) );
+    CU_ASSERT( 0 != dispatch_start("data", "md5", send_mock, &send_ctx, 2, 0) );
+
+    dispatch_submit( make_msg(WRP_MSG_TYPE__UPDATE, "w1", SLOW_PATH) );
+
+    pthread_mutex_lock( &mock_lock );
+    CU_ASSERT_FATAL( wait_for_slow() );
+    pthread_mutex_unlock( &mock_lock );
+
+    /* The reads don't wait for the upload; the next write does. */
+    dispatch_submit( make_msg(WRP_MSG_TYPE__UPDATE, "w2", "schedule") );
+    dispatch_submit( make_msg(WRP_MSG_TYPE__RETREIVE, "r1", "schedule") );
+    dispatch_submit( make_msg(WRP_MSG_TYPE__RETREIVE, "r2", "now") );
+    dispatch_submit( make_msg(WRP_MSG_TYPE__RETREIVE, "r3", "schedule") );
+
+    /* Something is queued for the writer, so there is no idle work. */
+    dispatch_idle();
+
+    pthread_mutex_lock( &mock_lock );
+    CU_ASSERT( wait_for(&sent_count, 3) );
+    CU_ASSERT( 3 == sent_count );
+    CU_ASSERT( 0 <= sent_at("R:r1") );
+    CU_ASSERT( 0 <= sent_at("R:r2") );
+    CU_ASSERT( 0 <= sent_at("R:r3") );
+
+    release_slow();
+    CU_ASSERT( wait_for(&sent_count, 5) );
+    CU_ASSERT( 3 == sent_at("W:w1") );
+    CU_ASSERT( 4 == sent_at("W:w2") );
+    CU_ASSERT( 1 == writes_most );
+    CU_ASSERT( 0 == pruned );
+    pthread_mutex_unlock( &mock_lock );
+}
+
+void test_same_uuid()
+{
+    reset();
+
+    dispatch_submit( make_msg(WRP_MSG_TYPE__UPDATE, "t", SLOW_PATH) );
+
+    pthread_mutex_lock( &mock_lock );
+    CU_ASSERT_FATAL( wait_for_slow() );
+    pthread_mutex_unlock( &mock_lock );
+
+    /* The read of the same transaction waits for its update. */
+    dispatch_submit( make_msg(WRP_MSG_TYPE__RETREIVE, "t", "schedule") );
+    dispatch_submit( make_msg(WRP_MSG_TYPE__RETREIVE, "u", "schedule") );
+    dispatch_submit( make_msg(WRP_MSG_TYPE__DELETE, "t", "schedule") );
+
+    pthread_mutex_lock( &mock_lock );
+    CU_ASSERT( wait_for(&sent_count, 1) );
+    CU_ASSERT( 0 == sent_at("R:u") );
+    CU_ASSERT( 1 == sent_count );
+
+    release_slow();
+    CU_ASSERT( wait_for(&sent_count, 4) );
+    CU_ASSERT( 1 == sent_at("W:t") );
+    CU_ASSERT( 2 == sent_at("R:t") );
+    CU_ASSERT( 4 == sent_count );
+    CU_ASSERT( 0 == strcmp("W:t", sent[3]) );
+    pthread_mutex_unlock( &mock_lock );
+}
+
+void test_coalesce()
+{
+    reset();
+
+    dispatch_submit( make_msg(WRP_MSG_TYPE__UPDATE, "c0", SLOW_PATH) );
+
+    pthread_mutex_lock( &mock_lock );
+    CU_ASSERT_FATAL( wait_for_slow() );
+    pthread_mutex_unlock( &mock_lock );
+
+    /* Only the last update of each schedule is applied. */
+    dispatch_submit( make_msg(WRP_MSG_TYPE__UPDATE, "c1", "schedule") );
+    dispatch_submit( make_msg(WRP_MSG_TYPE__UPDATE, "c2", "schedule/a") );
+    dispatch_submit( make_msg(WRP_MSG_TYPE__UPDATE, "c3", "schedule") );
+    dispatch_submit( make_msg(WRP_MSG_TYPE__UPDATE, "c4", "schedule") );
+
+    pthread_mutex_lock( &mock_lock );
+    release_slow();
+    CU_ASSERT( wait_for(&sent_count, 5) );
+    CU_ASSERT( 5 == sent_count );
+    CU_ASSERT( 0 == sent_at("W:c0") );
+    CU_ASSERT( 1 == sent_at("410:c1") );
+    CU_ASSERT( 2 == sent_at("W:c2") );
+    CU_ASSERT( 3 == sent_at("410:c3") );
+    CU_ASSERT( 4 == sent_at("W:c4") );
+    CU_ASSERT( 3 == processed );
+    pthread_mutex_unlock( &mock_lock );
+}
+
+void test_overload()
+{
+    reset();
+    dispatch_stop();
+    CU_ASSERT_FATAL( 0 == dispatch_start("data", "md5", send_mock, &send_ctx, 1, 3) );
+
+    dispatch_submit( make_msg(WRP_MSG_TYPE__UPDATE, "o0", SLOW_PATH) );
+
+    pthread_mutex_lock( &mock_lock );
+    CU_ASSERT_FATAL( wait_for_slow() );
+    pthread_mutex_unlock( &mock_lock );
+
+    dispatch_submit( make_msg(WRP_MSG_TYPE__UPDATE, "o1", "schedule") );
+    dispatch_submit( make_msg(WRP_MSG_TYPE__DELETE, "o2", "now") );
+
+    /* Full: turned away right here... */
+    dispatch_submit( make_msg(WRP_MSG_TYPE__DELETE, "o3", "now") );
+    pthread_mutex_lock( &mock_lock );
+    CU_ASSERT( 1 == sent_count );
+    CU_ASSERT( 0 == sent_at("503:o3") );
+    pthread_mutex_unlock( &mock_lock );
+
+    /* ... unless it takes the place of a superseded one. */
+    dispatch_submit( make_msg(WRP_MSG_TYPE__UPDATE, "o4", "schedule") );
+    dispatch_submit( make_msg(WRP_MSG_TYPE__DELETE, "o5", "now") );
+
+    pthread_mutex_lock( &mock_lock );
+    CU_ASSERT( 2 == sent_count );
+    CU_ASSERT( 1 == sent_at("503:o5") );
+
+    release_slow();
+    CU_ASSERT( wait_for(&sent_count, 6) );
+    CU_ASSERT( 2 == sent_at("W:o0") );
+    CU_ASSERT( 3 == sent_at("410:o1") );
+    CU_ASSERT( 4 == sent_at("W:o2") );
+    CU_ASSERT( 5 == sent_at("W:o4") );
+    pthread_mutex_unlock( &mock_lock );
+
+    dispatch_stop();
+    CU_ASSERT_FATAL( 0 == dispatch_start("data", "md5", send_mock, &send_ctx, 0, 0) );
+}
+
+void test_idle_and_stop()
+{
+    int i;
+
+    reset();
+
+    /* Nothing queued: the idle work runs on the writer.  The last write may
+     * have been answered but not let go of yet, so it can take a few tries. */
+    for( i = 0; (i < 500) && (0 == pruned); i++ ) {
+        dispatch_idle();
+        usleep( 10000 );
+    }
+    pthread_mutex_lock( &mock_lock );
+    CU_ASSERT( 0 < pruned );
+    pthread_mutex_unlock( &mock_lock );
+
+    /* Everything handed over is answered before the threads stop. */
+    for( i = 0; i < 10; i++ ) {
+        char uuid[8];
+
+        snprintf( uuid, sizeof(uuid), "s%d", i );
+        dispatch_submit( make_msg((0 == i % 2) ? WRP_MSG_TYPE__RETREIVE : WRP_MSG_TYPE__DELETE,
+                                  uuid, "schedule") );
+    }
+    dispatch_stop();
+    CU_ASSERT( 10 == sent_count );
+    CU_ASSERT( 10 == processed );
+
+    /* Stopped: back to handling them in the caller, still answered. */
+    dispatch_submit( make_msg(WRP_MSG_TYPE__RETREIVE, "z", "schedule") );
+    CU_ASSERT( 11 == sent_count );
+    CU_ASSERT( 10 == sent_at("R:z") );
+}
+
+void add_suites( CU_pSuite *suite )
+{
+    printf("--------Start of Test Cases Execution ---------\n");
+    *suite = CU_add_suite( "tests", NULL, NULL );
+    CU_add_test( *suite, "Test inline", test_inline );
+    CU_add_test( *suite, "Test reads during a write", test_reads_during_write );
+    CU_add_test( *suite, "Test same UUID", test_same_uuid );
+    CU_add_test( *suite, "Test coalesce", test_coalesce );
+    CU_add_test( *suite, "Test overload", test_overload );
+    CU_add_test( *suite, "Test idle and stop", test_idle_and_stop );
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main( void )
+{
+    unsigned rv = 1;
+    CU_pSuite suite = NULL;
+
+    if( CUE_SUCCESS == CU_initialize_registry() ) {
+        add_suites( &suite );
+
+        if( NULL != suite ) {
+            CU_basic_set_mode( CU_BRM_VERBOSE );
+            CU_basic_run_tests();
+            printf( "\n" );
+            CU_basic_show_failures( CU_get_failure_list() );
+            printf( "\n\n" );
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+
+    }
+
+    return rv;
+}
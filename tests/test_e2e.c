@@ -0,0 +1,772 @@
+/**
+ *  Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <CUnit/Basic.h>
+#include <msgpack.h>
+#include <libparodus.h>
+#include <wrp-c/wrp-c.h>
+
+#include "msgpack_fixtures.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+/* The end to end harness drives the real daemon (main.c is built with
+ * main renamed to aker_main) through an in-process stand-in for libparodus.
+ * The firewall command is a shell script that logs when it was invoked.
+ *
+ * Usage: test_e2e [seconds [requests_per_second [transitions]]] [-b] */
+
+#define FILE_NAME_SIZE  64
+
+#define MAX_REQUESTS    65536
+#define MAX_FW_CALLS    (MAX_REQUESTS + 64)
+#define INBOX_SIZE      1024
+#define NS_PER_SEC      1000000000ULL
+#define DRAIN_NS        (10 * NS_PER_SEC)
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+typedef struct {
+    int type;
+    const char *endpoint;
+    uint64_t sent;
+    uint64_t answered;
+    int status;
+    int mac;            /* The MAC the schedule blocks, -1 for none. */
+} request_t;
+
+typedef struct {
+    uint64_t ts;
+    char *args;
+} fw_call_t;
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static double duration = 2.0;
+static double rate = 50.0;
+static int transitions = 3;
+static bool write_behind = false;
+
+/* Named after the pid, so runs side by side (ctest -j) don't share them. */
+static char data_file[FILE_NAME_SIZE];
+static char md5_file[FILE_NAME_SIZE];
+static char data_image[FILE_NAME_SIZE];
+static char data_journal[FILE_NAME_SIZE];
+static char firewall_script[FILE_NAME_SIZE];
+static char firewall_log[FILE_NAME_SIZE];
+static char firewall_cmd[FILE_NAME_SIZE + 4];
+
+static pthread_mutex_t mock_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t mock_cond = PTHREAD_COND_INITIALIZER;
+static wrp_msg_t *inbox[INBOX_SIZE];
+static size_t inbox_head = 0;
+static size_t inbox_tail = 0;
+static bool connected = false;
+static bool daemon_done = false;
+
+static request_t requests[MAX_REQUESTS];
+static size_t request_count = 0;
+
+static fw_call_t fw_calls[MAX_FW_CALLS];
+static size_t fw_count = 0;
+
+static size_t event_count = 0;
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+int aker_main( int argc, char **argv );
+
+/*----------------------------------------------------------------------------*/
+/*                               libparodus mock                              */
+/*----------------------------------------------------------------------------*/
+static uint64_t now_ns( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_REALTIME, &ts );
+    return (uint64_t) ts.tv_sec * NS_PER_SEC + (uint64_t) ts.tv_nsec;
+}
+
+int libparodus_init( libpd_instance_t *instance, libpd_cfg_t *cfg )
+{
+    (void) cfg;
+
+    *instance = (libpd_instance_t) &connected;
+    pthread_mutex_lock( &mock_lock );
+    connected = true;
+    pthread_cond_broadcast( &mock_cond );
+    pthread_mutex_unlock( &mock_lock );
+
+    return 0;
+}
+
+int libparodus_receive( libpd_instance_t instance, wrp_msg_t **msg, uint32_t ms )
+{
+    struct timespec until;
+    uint64_t deadline = now_ns() + (uint64_t) ms * 1000000ULL;
+    int rv = 1;
+
+    (void) instance;
+    *msg = NULL;
+    until.tv_sec = deadline / NS_PER_SEC;
+    until.tv_nsec = deadline % NS_PER_SEC;
+
+    pthread_mutex_lock( &mock_lock );
+    while( inbox_head == inbox_tail ) {
+        if( ETIMEDOUT == pthread_cond_timedwait(&mock_cond, &mock_lock, &until) ) {
+            break;
+        }
+    }
+    if( inbox_head != inbox_tail ) {
+        *msg = inbox[inbox_head % INBOX_SIZE];
+        inbox_head++;
+        pthread_cond_broadcast( &mock_cond );
+        rv = 0;
+    }
+    pthread_mutex_unlock( &mock_lock );
+
+    return rv;
+}
+
+int libparodus_send( libpd_instance_t instance, wrp_msg_t *msg )
+{
+    uint64_t t = now_ns();
+    unsigned long n;
+
+    (void) instance;
+    if( WRP_MSG_TYPE__EVENT == msg->msg_type ) {
+        pthread_mutex_lock( &mock_lock );
+        event_count++;
+        pthread_mutex_unlock( &mock_lock );
+        return 0;
+    }
+
+    if( (NULL != msg->u.crud.transaction_uuid) &&
+        (1 == sscanf(msg->u.crud.transaction_uuid, "e2e-%lu", &n)) &&
+        (n < MAX_REQUESTS) )
+    {
+        pthread_mutex_lock( &mock_lock );
+        requests[n].answered = t;
+        requests[n].status = msg->u.crud.status;
+        pthread_cond_broadcast( &mock_cond );
+        pthread_mutex_unlock( &mock_lock );
+    }
+
+    return 0;
+}
+
+int libparodus_close_receiver( libpd_instance_t instance )
+{
+    (void) instance;
+    return 0;
+}
+
+int libparodus_shutdown( libpd_instance_t *instance )
+{
+    (void) instance;
+    pthread_mutex_lock( &mock_lock );
+    connected = false;
+    pthread_mutex_unlock( &mock_lock );
+    return 0;
+}
+
+const char *libparodus_strerror( libpd_error_t err )
+{
+    (void) err;
+    return "mock";
+}
+
+/*----------------------------------------------------------------------------*/
+/*                                   Helpers                                  */
+/*----------------------------------------------------------------------------*/
+static void mac_name( char *buf, size_t size, int group, int n )
+{
+    snprintf( buf, size, "02:e2:%02x:00:%02x:%02x", group & 0xff,
+              (n >> 8) & 0xff, n & 0xff );
+}
+
+/**
+ *  Packs a schedule with one MAC per absolute time (mac i is blocked from
+ *  times[i] on) or, with no times, one MAC that is blocked all week.
+ */
+static size_t pack_schedule( int group, int first_mac, const time_t *times,
+                             int count, void **out )
+{
+    msgpack_sbuffer sbuf;
+    msgpack_packer pk;
+    size_t len = 0;
+    int i, macs = (0 < count) ? count : 1;
+
+    msgpack_sbuffer_init( &sbuf );
+    msgpack_packer_init( &pk, &sbuf, msgpack_sbuffer_write );
+
+    msgpack_pack_map( &pk, (0 < count) ? 4 : 3 );
+    pack_str( &pk, "time_zone" );
+    pack_str( &pk, "UTC" );
+
+    pack_str( &pk, "macs" );
+    msgpack_pack_array( &pk, macs );
+    for( i = 0; i < macs; i++ ) {
+        char mac[18];
+
+        mac_name( mac, sizeof(mac), group, first_mac + i );
+        pack_str( &pk, mac );
+    }
+
+    pack_str( &pk, "weekly" );
+    msgpack_pack_array( &pk, 1 );
+    msgpack_pack_map( &pk, 2 );
+    pack_str( &pk, "time" );
+    msgpack_pack_int( &pk, 0 );
+    pack_str( &pk, "indexes" );
+    msgpack_pack_array( &pk, (0 < count) ? 0 : 1 );
+    if( 0 == count ) {
+        msgpack_pack_int( &pk, 0 );
+    }
+
+    if( 0 < count ) {
+        pack_str( &pk, "absolute" );
+        msgpack_pack_array( &pk, count );
+        for( i = 0; i < count; i++ ) {
+            msgpack_pack_map( &pk, 2 );
+            pack_str( &pk, "unix_time" );
+            msgpack_pack_int64( &pk, times[i] );
+            pack_str( &pk, "indexes" );
+            msgpack_pack_array( &pk, 1 );
+            msgpack_pack_int( &pk, i );
+        }
+    }
+
+    *out = malloc( sbuf.size );
+    if( NULL != *out ) {
+        memcpy( *out, sbuf.data, sbuf.size );
+        len = sbuf.size;
+    }
+    msgpack_sbuffer_destroy( &sbuf );
+
+    return len;
+}
+
+/**
+ *  Queues a request for the daemon.  The message is freed by main_loop().
+ *
+ *  @return the request number
+ */
+static size_t send_request( int type, const char *endpoint, void *payload,
+                            size_t len, int mac )
+{
+    wrp_msg_t *msg;
+    char buf[64];
+    size_t n;
+
+    msg = (wrp_msg_t*) calloc( 1, sizeof(wrp_msg_t) );
+    CU_ASSERT_FATAL( NULL != msg );
+
+    pthread_mutex_lock( &mock_lock );
+    while( INBOX_SIZE <= inbox_tail - inbox_head ) {
+        pthread_cond_wait( &mock_cond, &mock_lock );
+    }
+    n = request_count++;
+    requests[n].type = type;
+    requests[n].endpoint = endpoint;
+    requests[n].mac = mac;
+    pthread_mutex_unlock( &mock_lock );
+
+    msg->msg_type = type;
+    snprintf( buf, sizeof(buf), "e2e-%zu", n );
+    msg->u.crud.transaction_uuid = strdup( buf );
+    msg->u.crud.source = strdup( "dns:e2e-harness" );
+    snprintf( buf, sizeof(buf), "mac:112233445566/aker/%s", endpoint );
+    msg->u.crud.dest = strdup( buf );
+    msg->u.crud.path = strdup( endpoint );
+    msg->u.crud.payload = payload;
+    msg->u.crud.payload_size = len;
+
+    pthread_mutex_lock( &mock_lock );
+    requests[n].sent = now_ns();
+    inbox[inbox_tail % INBOX_SIZE] = msg;
+    inbox_tail++;
+    pthread_cond_broadcast( &mock_cond );
+    pthread_mutex_unlock( &mock_lock );
+
+    return n;
+}
+
+/**
+ *  Waits until every request has an answer or the time runs out.
+ *
+ *  @return true if all the requests were answered
+ */
+static bool wait_for_answers( uint64_t timeout )
+{
+    uint64_t deadline = now_ns() + timeout;
+    bool done = false;
+    size_t i;
+
+    while( (false == done) && (now_ns() < deadline) ) {
+        struct timespec ts = { 0, 10000000 };
+
+        done = true;
+        pthread_mutex_lock( &mock_lock );
+        for( i = 0; i < request_count; i++ ) {
+            if( 0 == requests[i].answered ) {
+                done = false;
+            }
+        }
+        pthread_mutex_unlock( &mock_lock );
+        if( false == done ) {
+            nanosleep( &ts, NULL );
+        }
+    }
+
+    return done;
+}
+
+static void sleep_until( uint64_t t )
+{
+    struct timespec ts;
+
+    ts.tv_sec = t / NS_PER_SEC;
+    ts.tv_nsec = t % NS_PER_SEC;
+    while( EINTR == clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &ts, NULL) ) {
+        ;
+    }
+}
+
+/**
+ *  Reads in the firewall invocations logged so far.
+ */
+static void read_firewall_log( void )
+{
+    char line[4096];
+    FILE *fh;
+
+    while( 0 < fw_count ) {
+        free( fw_calls[--fw_count].args );
+    }
+
+    fh = fopen( firewall_log, "r" );
+    if( NULL == fh ) {
+        return;
+    }
+
+    while( (fw_count < MAX_FW_CALLS) && (NULL != fgets(line, sizeof(line), fh)) ) {
+        unsigned long long sec, nsec;
+        int used = 0;
+
+        if( 2 == sscanf(line, "%llu.%llu%n", &sec, &nsec, &used) ) {
+            fw_calls[fw_count].ts = sec * NS_PER_SEC + nsec;
+            fw_calls[fw_count].args = strdup( &line[used] );
+            fw_count++;
+        }
+    }
+    fclose( fh );
+}
+
+/**
+ *  Finds the first firewall call at or after a time that blocks a MAC.
+ *
+ *  @return the time of the call, 0 if there was none
+ */
+static uint64_t firewall_blocked( const char *mac, uint64_t after )
+{
+    size_t i;
+
+    for( i = 0; i < fw_count; i++ ) {
+        if( (after <= fw_calls[i].ts) && (NULL != strstr(fw_calls[i].args, mac)) ) {
+            return fw_calls[i].ts;
+        }
+    }
+
+    return 0;
+}
+
+static int compare_u64( const void *a, const void *b )
+{
+    uint64_t x = *(const uint64_t*) a;
+    uint64_t y = *(const uint64_t*) b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ *  Prints the percentiles of a set of samples, in microseconds, as a JSON
+ *  object on one line.  The samples are sorted in place.
+ */
+static void report( const char *name, const char *type, uint64_t *ns,
+                    size_t count, size_t missed )
+{
+    printf( "{\"e2e\":\"%s\"", name );
+    if( NULL != type ) {
+        printf( ",\"type\":\"%s\"", type );
+    }
+    printf( ",\"count\":%zu,\"missed\":%zu", count, missed );
+    if( 0 < count ) {
+        qsort( ns, count, sizeof(uint64_t), compare_u64 );
+        printf( ",\"p50_us\":%.1f,\"p90_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f",
+                ns[count / 2] / 1000.0, ns[(count * 9) / 10] / 1000.0,
+                ns[(count * 99) / 100] / 1000.0, ns[count - 1] / 1000.0 );
+    }
+    printf( "}\n" );
+}
+
+static void *daemon_thread( void *args )
+{
+    static char *argv[] = { "aker", "-p", "mock://parodus", "-c", "mock://e2e",
+                            "-w", firewall_cmd, "-d", data_file,
+                            "-f", md5_file, "-e", "event:aker/transition",
+                            "-b", NULL };
+    int argc = sizeof(argv) / sizeof(argv[0]) - 1;
+
+    (void) args;
+    if( false == write_behind ) {
+        argv[--argc] = NULL;
+    }
+
+    aker_main( argc, argv );
+
+    pthread_mutex_lock( &mock_lock );
+    daemon_done = true;
+    pthread_cond_broadcast( &mock_cond );
+    pthread_mutex_unlock( &mock_lock );
+
+    return NULL;
+}
+
+static void set_file_names( void )
+{
+    int pid = (int) getpid();
+
+    snprintf( data_file, sizeof(data_file), "e2e_%d_data.bin", pid );
+    snprintf( md5_file, sizeof(md5_file), "e2e_%d_data.md5", pid );
+    snprintf( data_image, sizeof(data_image), "e2e_%d_data.bin.img", pid );
+    snprintf( data_journal, sizeof(data_journal), "e2e_%d_data.bin.journal", pid );
+    snprintf( firewall_script, sizeof(firewall_script), "e2e_%d_firewall.sh", pid );
+    snprintf( firewall_log, sizeof(firewall_log), "e2e_%d_firewall.log", pid );
+    snprintf( firewall_cmd, sizeof(firewall_cmd), "sh %s", firewall_script );
+}
+
+static void remove_files( void )
+{
+    remove( data_file );
+    remove( md5_file );
+    remove( data_image );
+    remove( data_journal );
+    remove( firewall_log );
+}
+
+/*----------------------------------------------------------------------------*/
+/*                                   Tests                                    */
+/*----------------------------------------------------------------------------*/
+void test_start()
+{
+    pthread_t t;
+    FILE *fh;
+
+    remove_files();
+
+    fh = fopen( firewall_script, "w" );
+    CU_ASSERT_FATAL( NULL != fh );
+    fprintf( fh, "#!/bin/sh\necho \"$(date +%%s.%%N) $*\" >> %s\n", firewall_log );
+    fclose( fh );
+
+    CU_ASSERT_FATAL( 0 == pthread_create(&t, NULL, daemon_thread, NULL) );
+    pthread_detach( t );
+
+    pthread_mutex_lock( &mock_lock );
+    while( false == connected ) {
+        pthread_cond_wait( &mock_cond, &mock_lock );
+    }
+    pthread_mutex_unlock( &mock_lock );
+}
+
+void test_request_mix()
+{
+    static const int types[] = { WRP_MSG_TYPE__UPDATE, WRP_MSG_TYPE__RETREIVE,
+                                 WRP_MSG_TYPE__RETREIVE, WRP_MSG_TYPE__DELETE,
+                                 WRP_MSG_TYPE__CREATE };
+    static const char *names[] = { "UPDATE", "RETRIEVE", "RETRIEVE", "DELETE", "CREATE" };
+    static uint64_t samples[MAX_REQUESTS];
+    uint64_t start, end;
+    size_t total, i, count, missed;
+    int k;
+
+    total = (size_t) (duration * rate);
+    if( MAX_REQUESTS < total ) {
+        total = MAX_REQUESTS;
+    }
+
+    start = now_ns();
+    for( i = 0; i < total; i++ ) {
+        int type = types[i % 5];
+        const char *endpoint = (2 == i % 5) ? "now" : "schedule";
+        void *payload = NULL;
+        size_t len = 0;
+        int mac = -1;
+
+        sleep_until( start + (uint64_t) (i * NS_PER_SEC / rate) );
+
+        if( (WRP_MSG_TYPE__UPDATE == type) || (WRP_MSG_TYPE__CREATE == type) ) {
+            mac = (int) i;
+            len = pack_schedule( 0, mac, NULL, 0, &payload );
+        }
+        send_request( type, endpoint, payload, len, mac );
+    }
+
+    CU_ASSERT( wait_for_answers(DRAIN_NS) );
+    end = now_ns();
+
+    printf( "{\"e2e\":\"throughput\",\"requests\":%zu,\"seconds\":%.3f,\"per_s\":%.1f}\n",
+            total, (end - start) / 1e9, total / ((end - start) / 1e9) );
+
+    /* Request latency per type. */
+    for( k = 0; k < 5; k++ ) {
+        if( 2 == k ) {
+            continue;
+        }
+        count = 0;
+        missed = 0;
+        for( i = 0; i < total; i++ ) {
+            bool now = (0 == strcmp("now", requests[i].endpoint));
+
+            if( (types[k] != requests[i].type) || ((1 == k) && now) ) {
+                continue;
+            }
+            if( 0 == requests[i].answered ) {
+                missed++;
+                continue;
+            }
+            samples[count++] = requests[i].answered - requests[i].sent;
+
+            switch( types[k] ) {
+                case WRP_MSG_TYPE__UPDATE:
+                case WRP_MSG_TYPE__CREATE:
+                    CU_ASSERT( 201 == requests[i].status );
+                    break;
+                default:
+                    CU_ASSERT( 200 == requests[i].status );
+                    break;
+            }
+        }
+        report( "request", names[k], samples, count, missed );
+    }
+
+    count = 0;
+    missed = 0;
+    for( i = 0; i < total; i++ ) {
+        if( 0 == strcmp("now", requests[i].endpoint) ) {
+            CU_ASSERT( (200 == requests[i].status) || (404 == requests[i].status) );
+            samples[count++] = requests[i].answered - requests[i].sent;
+        }
+    }
+    report( "request", "RETRIEVE_NOW", samples, count, missed );
+
+    /* Schedule swap to firewall: from the request that installed a schedule
+     * to the firewall call blocking its MAC.  Schedules replaced before the
+     * scheduler got to them are missed, not errors. */
+    {
+        struct timespec ts = { 1, 0 };
+
+        nanosleep( &ts, NULL );
+    }
+    read_firewall_log();
+    CU_ASSERT( 0 < fw_count );
+
+    count = 0;
+    missed = 0;
+    for( i = 0; i < total; i++ ) {
+        if( (0 <= requests[i].mac) && (201 == requests[i].status) ) {
+            char mac[18];
+            uint64_t t;
+
+            mac_name( mac, sizeof(mac), 0, requests[i].mac );
+            t = firewall_blocked( mac, requests[i].sent );
+            if( 0 < t ) {
+                samples[count++] = t - requests[i].sent;
+            } else {
+                missed++;
+            }
+        }
+    }
+    CU_ASSERT( 0 < count );
+    report( "swap_to_firewall", NULL, samples, count, missed );
+}
+
+void test_transitions()
+{
+    static uint64_t samples[256];
+    time_t times[256];
+    void *payload = NULL;
+    size_t len, n, count = 0, missed = 0;
+    uint64_t first;
+    int i;
+
+    if( 256 < transitions ) {
+        transitions = 256;
+    }
+
+    /* Whole seconds, far enough out that the UPDATE lands first. */
+    first = now_ns() / NS_PER_SEC + 2;
+    for( i = 0; i < transitions; i++ ) {
+        times[i] = (time_t) (first + i);
+    }
+
+    len = pack_schedule( 1, 0, times, transitions, &payload );
+    n = send_request( WRP_MSG_TYPE__UPDATE, "schedule", payload, len, -1 );
+
+    sleep_until( (first + transitions + 1) * NS_PER_SEC );
+    CU_ASSERT( wait_for_answers(DRAIN_NS) );
+    CU_ASSERT( 201 == requests[n].status );
+
+    read_firewall_log();
+    for( i = 0; i < transitions; i++ ) {
+        uint64_t deadline = (uint64_t) times[i] * NS_PER_SEC;
+        char mac[18];
+        uint64_t t;
+
+        mac_name( mac, sizeof(mac), 1, i );
+        t = firewall_blocked( mac, requests[n].sent );
+        if( 0 < t ) {
+            /* Early calls would be a scheduler bug. */
+            CU_ASSERT( deadline <= t );
+            samples[count++] = (deadline <= t) ? (t - deadline) : 0;
+        } else {
+            missed++;
+        }
+    }
+    CU_ASSERT( 0 == missed );
+    report( "transition_lateness", NULL, samples, count, missed );
+
+    /* The transitions are pushed upstream too, at most one per second. */
+    pthread_mutex_lock( &mock_lock );
+    CU_ASSERT( 0 < event_count );
+    pthread_mutex_unlock( &mock_lock );
+}
+
+void test_shutdown()
+{
+    struct timespec until;
+    void *payload = NULL;
+    uint8_t *expected = NULL;
+    uint8_t buf[4096];
+    size_t len, n;
+    FILE *fh;
+
+    /* The last acknowledged schedule is on disk once SIGTERM is handled,
+     * write-behind or not. */
+    len = pack_schedule( 2, 0, NULL, 0, &payload );
+    CU_ASSERT_FATAL( len == pack_schedule(2, 0, NULL, 0, (void**) &expected) );
+    CU_ASSERT_FATAL( len <= sizeof(buf) );
+    n = send_request( WRP_MSG_TYPE__UPDATE, "schedule", payload, len, -1 );
+    CU_ASSERT( wait_for_answers(DRAIN_NS) );
+    CU_ASSERT( 201 == requests[n].status );
+
+    CU_ASSERT( 0 == kill(getpid(), SIGTERM) );
+
+    until.tv_sec = (time_t) (now_ns() / NS_PER_SEC) + 10;
+    until.tv_nsec = 0;
+    pthread_mutex_lock( &mock_lock );
+    while( false == daemon_done ) {
+        if( ETIMEDOUT == pthread_cond_timedwait(&mock_cond, &mock_lock, &until) ) {
+            break;
+        }
+    }
+    CU_ASSERT( daemon_done );
+    CU_ASSERT( false == connected );
+    pthread_mutex_unlock( &mock_lock );
+
+    fh = fopen( data_file, "rb" );
+    CU_ASSERT_FATAL( NULL != fh );
+    CU_ASSERT( len == fread(buf, 1, sizeof(buf), fh) );
+    CU_ASSERT( 0 == memcmp(expected, buf, len) );
+    fclose( fh );
+    free( expected );
+}
+
+void add_suites( CU_pSuite *suite )
+{
+    printf("--------Start of Test Cases Execution ---------\n");
+    *suite = CU_add_suite( "tests", NULL, NULL );
+    CU_add_test( *suite, "Test start", test_start );
+    CU_add_test( *suite, "Test request mix", test_request_mix );
+    CU_add_test( *suite, "Test transitions", test_transitions );
+    CU_add_test( *suite, "Test shutdown", test_shutdown );
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main( int argc, char **argv )
+{
+    unsigned rv = 1;
+    CU_pSuite suite = NULL;
+    int i, n = 0;
+
+    for( i = 1; i < argc; i++ ) {
+        if( 0 == strcmp("-b", argv[i]) ) {
+            write_behind = true;
+        } else if( 0 == n ) {
+            duration = atof( argv[i] );
+            n++;
+        } else if( 1 == n ) {
+            rate = atof( argv[i] );
+            n++;
+        } else {
+            transitions = atoi( argv[i] );
+        }
+    }
+
+    if( (duration <= 0.0) || (rate <= 0.0) || (transitions <= 0) ) {
+        fprintf( stderr, "Usage: %s [seconds [requests_per_second [transitions]]] [-b]\n", argv[0] );
+        return 1;
+    }
+
+    set_file_names();
+
+    if( CUE_SUCCESS == CU_initialize_registry() ) {
+        add_suites( &suite );
+
+        if( NULL != suite ) {
+            CU_basic_set_mode( CU_BRM_VERBOSE );
+            CU_basic_run_tests();
+            printf( "\n" );
+            CU_basic_show_failures( CU_get_failure_list() );
+            printf( "\n\n" );
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+
+    }
+    remove_files();
+    remove( firewall_script );
+
+    return rv;
+}
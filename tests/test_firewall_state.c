@@ -0,0 +1,214 @@
+/**
+ *  Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <CUnit/Basic.h>
+
+#include "mem_wrapper.h"
+#include "../src/firewall_state.h"
+#include "../src/schedule.h"
+#include "../src/scheduler.h"
+#include "../src/aker_mem.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define STATE_FILE      "firewall_state_test.state"
+#define FIREWALL_LOG    "firewall_state_test.log"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Tests                                    */
+/*----------------------------------------------------------------------------*/
+static void write_raw( const char *filename, const char *text )
+{
+    FILE *fh = fopen( filename, "w" );
+
+    if( NULL != fh ) {
+        fputs( text, fh );
+        fclose( fh );
+    }
+}
+
+static size_t read_text( const char *filename, char *buf, size_t size )
+{
+    size_t len = 0;
+    FILE *fh = fopen( filename, "r" );
+
+    if( NULL != fh ) {
+        len = fread( buf, 1, size - 1, fh );
+        fclose( fh );
+    }
+    buf[len] = '\0';
+
+    return len;
+}
+
+static schedule_t* always_block( const char *mac )
+{
+    schedule_t *s = create_schedule();
+    schedule_event_t *e = create_schedule_event( 1 );
+
+    create_mac_table( s, 1 );
+    set_mac_index( s, mac, 17, 0 );
+    e->time = 0;
+    e->block[0] = 0;
+    insert_event( &s->weekly, e );
+
+    return s;
+}
+
+void test_save_load()
+{
+    char *blocked = NULL;
+    time_t applied = 0;
+
+    CU_ASSERT( 0 == firewall_state_save(STATE_FILE, "11:22:33:44:55:66 aa:bb:cc:dd:ee:ff", 1234) );
+    CU_ASSERT( 0 == firewall_state_load(STATE_FILE, &blocked, &applied) );
+    CU_ASSERT( 1234 == applied );
+    CU_ASSERT_FATAL( NULL != blocked );
+    CU_ASSERT( 0 == strcmp("11:22:33:44:55:66 aa:bb:cc:dd:ee:ff", blocked) );
+    aker_free( blocked );
+
+    /* Nothing blocked round trips as NULL. */
+    CU_ASSERT( 0 == firewall_state_save(STATE_FILE, NULL, 99) );
+    CU_ASSERT( 0 == firewall_state_load(STATE_FILE, &blocked, NULL) );
+    CU_ASSERT( NULL == blocked );
+
+    CU_ASSERT( 0 != firewall_state_save(NULL, NULL, 99) );
+    malloc_fail = true;
+    malloc_failure_limit = 1;
+    CU_ASSERT( 0 != firewall_state_save(STATE_FILE, NULL, 99) );
+    malloc_fail = false;
+}
+
+void test_invalid()
+{
+    char *blocked = NULL;
+
+    CU_ASSERT( -1 == firewall_state_load("_no_exist_", &blocked, NULL) );
+    CU_ASSERT( -1 == firewall_state_load(NULL, &blocked, NULL) );
+
+    /* The rules don't survive a reboot, so neither does the state. */
+    write_raw( STATE_FILE, "aker-fw/1\nboot_id 00000000-0000-0000-0000-000000000000\n"
+                           "applied 5\nblocked 11:22:33:44:55:66\n" );
+    CU_ASSERT( -2 == firewall_state_load(STATE_FILE, &blocked, NULL) );
+    CU_ASSERT( NULL == blocked );
+
+    write_raw( STATE_FILE, "aker-fw/2\nboot_id -\napplied 5\nblocked \n" );
+    CU_ASSERT( -3 == firewall_state_load(STATE_FILE, &blocked, NULL) );
+    write_raw( STATE_FILE, "aker-fw/1\nboot_id -\napplied 5\n" );
+    CU_ASSERT( -3 == firewall_state_load(STATE_FILE, &blocked, NULL) );
+    write_raw( STATE_FILE, "aker-fw/1\nboot -\napplied 5\nblocked \n" );
+    CU_ASSERT( -3 == firewall_state_load(STATE_FILE, &blocked, NULL) );
+    CU_ASSERT( NULL == blocked );
+
+    remove( STATE_FILE );
+}
+
+void test_warm_restart()
+{
+    pthread_t thread;
+    char buf[256];
+    char *blocked = NULL;
+    int i;
+
+    remove( FIREWALL_LOG );
+
+    /* The firewall already enforces what the schedule wants. */
+    CU_ASSERT( 0 == firewall_state_save(STATE_FILE, "11:22:33:44:55:66", 1) );
+
+    scheduler_set_state_file( STATE_FILE );
+    CU_ASSERT( 0 == scheduler_start(&thread, "echo >> " FIREWALL_LOG) );
+    scheduler_set_schedule( always_block("11:22:33:44:55:66") );
+    scheduler_import_done();
+
+    for( i = 0; (i < 50) && (NULL == blocked); i++ ) {
+        usleep( 10000 );
+        blocked = get_current_blocked_macs();
+    }
+    CU_ASSERT_FATAL( NULL != blocked );
+    CU_ASSERT( 0 == strcmp("11:22:33:44:55:66", blocked) );
+    free( blocked );
+
+    /* No reset and no re-apply. */
+    usleep( 100000 );
+    CU_ASSERT( 0 == read_text(FIREWALL_LOG, buf, sizeof(buf)) );
+
+    /* A real change is applied once, with the full new set. */
+    scheduler_set_schedule( always_block("aa:bb:cc:dd:ee:ff") );
+    for( i = 0; (i < 50) && (0 == read_text(FIREWALL_LOG, buf, sizeof(buf))); i++ ) {
+        usleep( 10000 );
+    }
+    usleep( 100000 );
+    read_text( FIREWALL_LOG, buf, sizeof(buf) );
+    CU_ASSERT( 0 == strcmp("aa:bb:cc:dd:ee:ff\n", buf) );
+
+    CU_ASSERT( 0 == firewall_state_load(STATE_FILE, &blocked, NULL) );
+    CU_ASSERT_FATAL( NULL != blocked );
+    CU_ASSERT( 0 == strcmp("aa:bb:cc:dd:ee:ff", blocked) );
+    aker_free( blocked );
+
+    remove( FIREWALL_LOG );
+    remove( STATE_FILE );
+}
+
+void add_suites( CU_pSuite *suite )
+{
+    printf("--------Start of Test Cases Execution ---------\n");
+    *suite = CU_add_suite( "tests", NULL, NULL );
+    CU_add_test( *suite, "Test save and load", test_save_load );
+    CU_add_test( *suite, "Test invalid state", test_invalid );
+    CU_add_test( *suite, "Test warm restart", test_warm_restart );
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main( void )
+{
+    unsigned rv = 1;
+    CU_pSuite suite = NULL;
+
+    if( CUE_SUCCESS == CU_initialize_registry() ) {
+        add_suites( &suite );
+
+        if( NULL != suite ) {
+            CU_basic_set_mode( CU_BRM_VERBOSE );
+            CU_basic_run_tests();
+            printf( "\n" );
+            CU_basic_show_failures( CU_get_failure_list() );
+            printf( "\n\n" );
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+
+    }
+
+    terminate_scheduler_thread();
+    return rv;
+}
+
+int32_t get_max_mac_limit(void)
+{
+    return 2048;
+}
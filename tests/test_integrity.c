@@ -0,0 +1,250 @@
+/**
+ *  Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <CUnit/Basic.h>
+
+#include "mem_wrapper.h"
+#include "../src/crc32c.h"
+#include "../src/aker_integrity.h"
+#include "../src/aker_md5.h"
+#include "../src/aker_mem.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define DATA_FILE   "integrity_data.bin"
+#define SIG_FILE    "integrity_data.sig"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Mocks                                    */
+/*----------------------------------------------------------------------------*/
+size_t read_file_from_disk( const char *filename, uint8_t **data )
+{
+    FILE *fh;
+    long size;
+    size_t len = 0;
+
+    *data = NULL;
+    fh = fopen( filename, "rb" );
+    if( NULL != fh ) {
+        fseek( fh, 0, SEEK_END );
+        size = ftell( fh );
+        fseek( fh, 0, SEEK_SET );
+        if( 0 < size ) {
+            *data = (uint8_t*) aker_malloc( size );
+            if( NULL != *data ) {
+                len = fread( *data, 1, size, fh );
+            }
+        }
+        fclose( fh );
+    }
+
+    return len;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                                   Tests                                    */
+/*----------------------------------------------------------------------------*/
+static uint32_t crc32c_bitwise( const uint8_t *p, size_t len )
+{
+    uint32_t crc = 0xffffffff;
+    int i;
+
+    while( 0 < len-- ) {
+        crc ^= *p++;
+        for( i = 0; i < 8; i++ ) {
+            crc = (crc >> 1) ^ ((crc & 1) ? 0x82f63b78 : 0);
+        }
+    }
+
+    return ~crc;
+}
+
+static void write_file( const char *filename, const void *data, size_t len )
+{
+    FILE *fh = fopen( filename, "wb" );
+
+    if( NULL != fh ) {
+        fwrite( data, 1, len, fh );
+        fclose( fh );
+    }
+}
+
+void test_crc32c()
+{
+    uint8_t buf[1031];
+    uint8_t zeros[32];
+    size_t i;
+
+    /* RFC 3720 B.4 and the usual check value. */
+    memset( zeros, 0, sizeof(zeros) );
+    CU_ASSERT( 0xe3069283 == crc32c("123456789", 9) );
+    CU_ASSERT( 0x8a9136aa == crc32c(zeros, sizeof(zeros)) );
+    CU_ASSERT( 0 == crc32c(NULL, 0) );
+
+    for( i = 0; i < sizeof(buf); i++ ) {
+        buf[i] = (uint8_t) (i * 7 + 3);
+    }
+
+    /* Every length and alignment must match the bit at a time reference. */
+    for( i = 0; i < 24; i++ ) {
+        CU_ASSERT( crc32c_bitwise(&buf[i], sizeof(buf) - i * 3) ==
+                   crc32c(&buf[i], sizeof(buf) - i * 3) );
+    }
+
+    /* Incremental updates are the same as a single pass. */
+    CU_ASSERT( crc32c(buf, sizeof(buf)) ==
+               crc32c_update(crc32c_update(0, buf, 13), &buf[13], sizeof(buf) - 13) );
+}
+
+void test_modes()
+{
+    uint8_t payload[] = { 0x81, 0xa1, 'a', 0x01, 0x02, 0x03 };
+    char *sig;
+
+    CU_ASSERT( INTEGRITY_MD5 == integrity_get_mode() );
+    CU_ASSERT( 0 != integrity_set_mode(NULL) );
+    CU_ASSERT( 0 != integrity_set_mode("sha1") );
+    CU_ASSERT( INTEGRITY_MD5 == integrity_get_mode() );
+
+    /* The default stays the bare md5 older releases wrote. */
+    sig = integrity_compute_sig( payload, sizeof(payload) );
+    CU_ASSERT_FATAL( NULL != sig );
+    CU_ASSERT( MD5_SIZE * 2 == strlen(sig) );
+    CU_ASSERT( 0 == integrity_verify(payload, sizeof(payload), (uint8_t*) sig, strlen(sig)) );
+    aker_free( sig );
+
+    CU_ASSERT( 0 == integrity_set_mode("crc32c") );
+    CU_ASSERT( INTEGRITY_CRC32C == integrity_get_mode() );
+    sig = integrity_compute_sig( payload, sizeof(payload) );
+    CU_ASSERT_FATAL( NULL != sig );
+    CU_ASSERT( 0 == strncmp(sig, INTEGRITY_SIG_PREFIX "1 crc32c ", 18) );
+    CU_ASSERT( 0 == integrity_verify(payload, sizeof(payload), (uint8_t*) sig, strlen(sig)) );
+
+    /* Flipped payload bits and a truncated payload are both caught. */
+    payload[3] ^= 0x10;
+    CU_ASSERT( -2 == integrity_verify(payload, sizeof(payload), (uint8_t*) sig, strlen(sig)) );
+    payload[3] ^= 0x10;
+    CU_ASSERT( -2 == integrity_verify(payload, sizeof(payload) - 1, (uint8_t*) sig, strlen(sig)) );
+    aker_free( sig );
+
+    malloc_fail = true;
+    malloc_failure_limit = 1;
+    CU_ASSERT( NULL == integrity_compute_sig(payload, sizeof(payload)) );
+    malloc_fail = false;
+
+    CU_ASSERT( 0 == integrity_set_mode("md5") );
+}
+
+void test_verify_formats()
+{
+    uint8_t payload[] = { 0x81, 0xa1, 'b', 0x07 };
+    unsigned char md5_bin[MD5_SIZE];
+    unsigned char *md5;
+    char sig[128];
+
+    md5 = compute_byte_stream_md5( payload, sizeof(payload), md5_bin );
+    CU_ASSERT_FATAL( NULL != md5 );
+
+    /* Versioned md5 is accepted regardless of the configured mode. */
+    CU_ASSERT( 0 == integrity_set_mode("crc32c") );
+    snprintf( sig, sizeof(sig), "aker-sig/1 md5 %s %zu\n", md5, sizeof(payload) );
+    CU_ASSERT( 0 == integrity_verify(payload, sizeof(payload), (uint8_t*) sig, strlen(sig)) );
+
+    /* Legacy bare md5, with or without trailing bytes like md5sum adds. */
+    snprintf( sig, sizeof(sig), "%s  some.bin\n", md5 );
+    CU_ASSERT( 0 == integrity_verify(payload, sizeof(payload), (uint8_t*) sig, strlen(sig)) );
+    CU_ASSERT( -4 == integrity_verify(payload, sizeof(payload), (uint8_t*) sig, 10) );
+    aker_free( md5 );
+
+    /* Unknown versions and algorithms are refused rather than trusted. */
+    snprintf( sig, sizeof(sig), "aker-sig/2 crc32c %08x %zu\n",
+              crc32c(payload, sizeof(payload)), sizeof(payload) );
+    CU_ASSERT( -4 == integrity_verify(payload, sizeof(payload), (uint8_t*) sig, strlen(sig)) );
+    snprintf( sig, sizeof(sig), "aker-sig/1 xxh64 0011223344556677 %zu\n", sizeof(payload) );
+    CU_ASSERT( -4 == integrity_verify(payload, sizeof(payload), (uint8_t*) sig, strlen(sig)) );
+    CU_ASSERT( -4 == integrity_verify(payload, sizeof(payload), (uint8_t*) "aker-sig/1", 10) );
+    CU_ASSERT( -4 == integrity_verify(payload, sizeof(payload), NULL, 0) );
+
+    CU_ASSERT( 0 == integrity_set_mode("md5") );
+}
+
+void test_verify_files()
+{
+    uint8_t payload[] = { 0x81, 0xa1, 'c', 0x09 };
+    char *sig;
+
+    CU_ASSERT( 0 == integrity_set_mode("crc32c") );
+    sig = integrity_compute_sig( payload, sizeof(payload) );
+    CU_ASSERT_FATAL( NULL != sig );
+
+    write_file( DATA_FILE, payload, sizeof(payload) );
+    write_file( SIG_FILE, sig, strlen(sig) );
+    CU_ASSERT( 0 == verify_integrity_signatures(DATA_FILE, SIG_FILE) );
+    CU_ASSERT( -1 == verify_integrity_signatures("_no_exist_", SIG_FILE) );
+    CU_ASSERT( -3 == verify_integrity_signatures(DATA_FILE, "_no_exist_") );
+
+    payload[0] = 0x80;
+    write_file( DATA_FILE, payload, sizeof(payload) );
+    CU_ASSERT( -2 == verify_integrity_signatures(DATA_FILE, SIG_FILE) );
+    aker_free( sig );
+
+    remove( DATA_FILE );
+    remove( SIG_FILE );
+    CU_ASSERT( 0 == integrity_set_mode("md5") );
+}
+
+void add_suites( CU_pSuite *suite )
+{
+    printf("--------Start of Test Cases Execution ---------\n");
+    *suite = CU_add_suite( "tests", NULL, NULL );
+    CU_add_test( *suite, "Test crc32c", test_crc32c );
+    CU_add_test( *suite, "Test modes", test_modes );
+    CU_add_test( *suite, "Test verify formats", test_verify_formats );
+    CU_add_test( *suite, "Test verify files", test_verify_files );
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main( void )
+{
+    unsigned rv = 1;
+    CU_pSuite suite = NULL;
+
+    if( CUE_SUCCESS == CU_initialize_registry() ) {
+        add_suites( &suite );
+
+        if( NULL != suite ) {
+            CU_basic_set_mode( CU_BRM_VERBOSE );
+            CU_basic_run_tests();
+            printf( "\n" );
+            CU_basic_show_failures( CU_get_failure_list() );
+            printf( "\n\n" );
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+
+    }
+
+    return rv;
+}
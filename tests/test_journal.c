@@ -0,0 +1,371 @@
+/**
+ *  Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <msgpack.h>
+
+#include <CUnit/Basic.h>
+
+#include "mem_wrapper.h"
+#include "msgpack_fixtures.h"
+#include "../src/aker_mem.h"
+#include "../src/schedule.h"
+#include "../src/decode.h"
+#include "../src/journal.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define DATA_FILE       "journal_data.bin"
+#define MD5_FILE        "journal_data.md5"
+#define JOURNAL_FILE    DATA_FILE JOURNAL_SUFFIX
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static const char sig_a[] = "aker-sig/1 crc32c 1a2b3c4d 4\n";
+static const char sig_b[] = "aker-sig/1 crc32c 5e6f7a8b 4\n";
+static const char sig_c[] = "aker-sig/1 crc32c 9c0d1e2f 4\n";
+
+/* Stands in for the whole encoded schedule handed to journal_append(). */
+static uint8_t whole[200];
+
+/*----------------------------------------------------------------------------*/
+/*                                   Mocks                                    */
+/*----------------------------------------------------------------------------*/
+int32_t get_max_mac_limit(void)
+{
+    return 2048;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                              Test Helpers                                  */
+/*----------------------------------------------------------------------------*/
+/* One MAC blocked from 10 seconds into the week. */
+static schedule_t* make_schedule( void )
+{
+    msgpack_sbuffer sbuf;
+    msgpack_packer pk;
+    schedule_t *s = NULL;
+    uint8_t *data;
+    size_t len;
+
+    msgpack_sbuffer_init( &sbuf );
+    msgpack_packer_init( &pk, &sbuf, msgpack_sbuffer_write );
+
+    msgpack_pack_map( &pk, 2 );
+    pack_str( &pk, "macs" );
+    msgpack_pack_array( &pk, 1 );
+    pack_str( &pk, "11:22:33:44:55:aa" );
+
+    pack_str( &pk, "weekly" );
+    msgpack_pack_array( &pk, 1 );
+    msgpack_pack_map( &pk, 2 );
+    pack_str( &pk, "time" );        msgpack_pack_int( &pk, 10 );
+    pack_str( &pk, "indexes" );     msgpack_pack_array( &pk, 1 );
+    msgpack_pack_int( &pk, 0 );
+
+    len = to_buffer( &sbuf, &data );
+    CU_ASSERT( 0 == decode_schedule_data(len, data, &s) );
+    free( data );
+
+    return s;
+}
+
+/* A patch adding a weekly event that blocks MAC 0. */
+static size_t make_patch( int64_t t, uint8_t **data )
+{
+    msgpack_sbuffer sbuf;
+    msgpack_packer pk;
+
+    msgpack_sbuffer_init( &sbuf );
+    msgpack_packer_init( &pk, &sbuf, msgpack_sbuffer_write );
+
+    msgpack_pack_map( &pk, 2 );
+    pack_str( &pk, "base" );
+    pack_str( &pk, "any" );
+    pack_str( &pk, "ops" );
+    msgpack_pack_array( &pk, 1 );
+    msgpack_pack_map( &pk, 3 );
+    pack_str( &pk, "op" );          pack_str( &pk, "add_event" );
+    pack_str( &pk, "time" );        msgpack_pack_int64( &pk, t );
+    pack_str( &pk, "indexes" );     msgpack_pack_array( &pk, 1 );
+    msgpack_pack_int( &pk, 0 );
+
+    return to_buffer( &sbuf, data );
+}
+
+static int append( int64_t t, size_t whole_len, const char *sig )
+{
+    uint8_t *patch;
+    size_t len;
+    int rv;
+
+    len = make_patch( t, &patch );
+    rv = journal_append( DATA_FILE, MD5_FILE, patch, len, whole, whole_len, sig );
+    free( patch );
+
+    return rv;
+}
+
+static long file_size( const char *filename )
+{
+    long size = -1;
+    FILE *fh;
+
+    fh = fopen( filename, "rb" );
+    if( NULL != fh ) {
+        fseek( fh, 0, SEEK_END );
+        size = ftell( fh );
+        fclose( fh );
+    }
+
+    return size;
+}
+
+static int replay( const char *sig, schedule_t **s )
+{
+    *s = make_schedule();
+    CU_ASSERT_FATAL( NULL != *s );
+
+    return journal_replay( DATA_FILE, (const uint8_t*) sig,
+                           (NULL != sig) ? strlen(sig) : 0, s );
+}
+
+static bool has_event( schedule_t *s, time_t t )
+{
+    schedule_event_t *p;
+
+    for( p = s->weekly; NULL != p; p = p->next ) {
+        if( t == p->time ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                                   Tests                                    */
+/*----------------------------------------------------------------------------*/
+void test_append_replay()
+{
+    schedule_t *s;
+
+    CU_ASSERT( 0 == journal_remove_base(DATA_FILE, MD5_FILE) );
+
+    /* Nothing to journal against without a base. */
+    CU_ASSERT( -2 == append(20, sizeof(whole), sig_a) );
+    CU_ASSERT( -1 == journal_append(DATA_FILE, MD5_FILE, NULL, 1, whole, sizeof(whole), sig_a) );
+    CU_ASSERT( -1 == journal_append(NULL, MD5_FILE, whole, 1, whole, sizeof(whole), sig_a) );
+    CU_ASSERT( -1 == journal_replay(DATA_FILE, NULL, 0, NULL) );
+
+    CU_ASSERT( 0 == journal_write_base(DATA_FILE, MD5_FILE, whole, sizeof(whole), sig_a) );
+    CU_ASSERT( 0 == journal_get_record_count() );
+    CU_ASSERT( 0 != access(JOURNAL_FILE, F_OK) );
+
+    CU_ASSERT( 0 == append(20, sizeof(whole), sig_b) );
+    CU_ASSERT( 0 == append(30, sizeof(whole), sig_c) );
+    CU_ASSERT( 2 == journal_get_record_count() );
+
+    /* A restart on the same base gets both patches back. */
+    CU_ASSERT( 2 == replay(sig_a, &s) );
+    CU_ASSERT( 2 == journal_get_record_count() );
+    CU_ASSERT( NULL != s->index );
+    CU_ASSERT( has_event(s, 10) && has_event(s, 20) && has_event(s, 30) );
+    destroy_schedule( s );
+
+    /* And can keep appending where it left off. */
+    CU_ASSERT( 0 == append(40, sizeof(whole), sig_b) );
+    CU_ASSERT( 3 == replay(sig_a, &s) );
+    CU_ASSERT( has_event(s, 40) );
+    destroy_schedule( s );
+
+    /* A journal for another base is thrown away. */
+    CU_ASSERT( 0 == replay(sig_b, &s) );
+    CU_ASSERT( !has_event(s, 20) );
+    CU_ASSERT( 0 == journal_get_record_count() );
+    CU_ASSERT( 0 != access(JOURNAL_FILE, F_OK) );
+    destroy_schedule( s );
+
+    /* As is one for a base that did not verify. */
+    CU_ASSERT( 0 == journal_write_base(DATA_FILE, MD5_FILE, whole, sizeof(whole), sig_a) );
+    CU_ASSERT( 0 == append(20, sizeof(whole), sig_b) );
+    CU_ASSERT( 0 == replay(NULL, &s) );
+    CU_ASSERT( 0 != access(JOURNAL_FILE, F_OK) );
+    CU_ASSERT( -2 == append(20, sizeof(whole), sig_b) );
+    destroy_schedule( s );
+}
+
+void test_torn_tail()
+{
+    uint8_t junk[] = { 0x20, 0x00, 0x00, 0x00, 0xde, 0xad };
+    schedule_t *s;
+    long size;
+    FILE *fh;
+
+    CU_ASSERT( 0 == journal_write_base(DATA_FILE, MD5_FILE, whole, sizeof(whole), sig_a) );
+    CU_ASSERT( 0 == append(20, sizeof(whole), sig_b) );
+    CU_ASSERT( 0 == append(30, sizeof(whole), sig_c) );
+    size = file_size( JOURNAL_FILE );
+    CU_ASSERT( 0 < size );
+
+    /* A power cut part way through the next append. */
+    fh = fopen( JOURNAL_FILE, "ab" );
+    CU_ASSERT_FATAL( NULL != fh );
+    fwrite( junk, 1, sizeof(junk), fh );
+    fclose( fh );
+
+    CU_ASSERT( 2 == replay(sig_a, &s) );
+    CU_ASSERT( size == file_size(JOURNAL_FILE) );
+    CU_ASSERT( has_event(s, 30) );
+    destroy_schedule( s );
+
+    /* A damaged final record is cut off too. */
+    fh = fopen( JOURNAL_FILE, "r+b" );
+    CU_ASSERT_FATAL( NULL != fh );
+    fseek( fh, size - 1, SEEK_SET );
+    fputc( 0xff, fh );
+    fclose( fh );
+
+    CU_ASSERT( 1 == replay(sig_a, &s) );
+    CU_ASSERT( has_event(s, 20) && !has_event(s, 30) );
+    CU_ASSERT( 1 == journal_get_record_count() );
+    destroy_schedule( s );
+
+    /* Appends carry on from the cut. */
+    CU_ASSERT( 0 == append(50, sizeof(whole), sig_b) );
+    CU_ASSERT( 2 == replay(sig_a, &s) );
+    CU_ASSERT( has_event(s, 50) && !has_event(s, 30) );
+    destroy_schedule( s );
+}
+
+void test_compaction()
+{
+    uint8_t buf[sizeof(whole)];
+    schedule_t *s;
+    FILE *fh;
+    int i;
+
+    for( i = 0; i < (int) sizeof(whole); i++ ) {
+        whole[i] = (uint8_t) i;
+    }
+
+    /* In the caller: once the journal outgrows the schedule it is folded
+     * into a new base. */
+    CU_ASSERT( 0 == journal_write_base(DATA_FILE, MD5_FILE, whole, 1, sig_a) );
+    for( i = 0; i < 10; i++ ) {
+        CU_ASSERT( 0 == append(20 + i, sizeof(whole), sig_b) );
+        if( 0 == journal_get_record_count() ) {
+            break;
+        }
+    }
+    CU_ASSERT( (0 < i) && (i < 10) );
+    CU_ASSERT( 0 != access(JOURNAL_FILE, F_OK) );
+
+    fh = fopen( DATA_FILE, "rb" );
+    CU_ASSERT_FATAL( NULL != fh );
+    CU_ASSERT( sizeof(whole) == fread(buf, 1, sizeof(buf), fh) );
+    fclose( fh );
+    CU_ASSERT( 0 == memcmp(whole, buf, sizeof(whole)) );
+    CU_ASSERT( (long) strlen(sig_b) == file_size(MD5_FILE) );
+
+    /* The next patch starts a journal on the new base. */
+    CU_ASSERT( 0 == append(60, sizeof(whole), sig_c) );
+    CU_ASSERT( 1 == replay(sig_b, &s) );
+    CU_ASSERT( has_event(s, 60) );
+    destroy_schedule( s );
+
+    /* In the background: the thread writes the base on its own. */
+    CU_ASSERT( 0 == journal_start(1, NULL) );
+    CU_ASSERT( 0 == append(70, sizeof(whole), sig_c) );
+    journal_stop();
+    CU_ASSERT( 0 == journal_get_record_count() );
+    CU_ASSERT( 0 != access(JOURNAL_FILE, F_OK) );
+    CU_ASSERT( (long) strlen(sig_c) == file_size(MD5_FILE) );
+
+    /* A failed allocation skips the compaction, not the append. */
+    malloc_fail = true;
+    malloc_failure_limit = sizeof(whole);
+    CU_ASSERT( 0 == append(80, sizeof(whole), sig_a) );
+    malloc_fail = false;
+    CU_ASSERT( 1 == journal_get_record_count() );
+}
+
+void test_base_changes()
+{
+    CU_ASSERT( 0 == journal_write_base(DATA_FILE, MD5_FILE, whole, sizeof(whole), sig_a) );
+    CU_ASSERT( 0 == append(20, sizeof(whole), sig_b) );
+    CU_ASSERT( 0 == access(JOURNAL_FILE, F_OK) );
+
+    /* A whole new schedule replaces the journal. */
+    CU_ASSERT( 0 == journal_write_base(DATA_FILE, MD5_FILE, whole, sizeof(whole), sig_c) );
+    CU_ASSERT( 0 == journal_get_record_count() );
+    CU_ASSERT( 0 != access(JOURNAL_FILE, F_OK) );
+
+    /* A failed write leaves nothing to journal against. */
+    CU_ASSERT( 0 != journal_write_base(DATA_FILE, MD5_FILE, NULL, 0, sig_c) );
+    CU_ASSERT( -2 == append(20, sizeof(whole), sig_b) );
+
+    CU_ASSERT( 0 == journal_write_base(DATA_FILE, MD5_FILE, whole, sizeof(whole), sig_a) );
+    CU_ASSERT( 0 == append(20, sizeof(whole), sig_b) );
+    CU_ASSERT( 0 == journal_remove_base(DATA_FILE, MD5_FILE) );
+    CU_ASSERT( 0 != access(JOURNAL_FILE, F_OK) );
+    CU_ASSERT( 0 != access(DATA_FILE, F_OK) );
+    CU_ASSERT( 0 != access(MD5_FILE, F_OK) );
+    CU_ASSERT( -2 == append(20, sizeof(whole), sig_b) );
+}
+
+void add_suites( CU_pSuite *suite )
+{
+    printf("--------Start of Test Cases Execution ---------\n");
+    *suite = CU_add_suite( "tests", NULL, NULL );
+    CU_add_test( *suite, "Test append and replay", test_append_replay );
+    CU_add_test( *suite, "Test torn tail", test_torn_tail );
+    CU_add_test( *suite, "Test base changes", test_base_changes );
+    /* Last, as it leaves the compaction ratio at 1%. */
+    CU_add_test( *suite, "Test compaction", test_compaction );
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main( void )
+{
+    unsigned rv = 1;
+    CU_pSuite suite = NULL;
+
+    if( CUE_SUCCESS == CU_initialize_registry() ) {
+        add_suites( &suite );
+
+        if( NULL != suite ) {
+            CU_basic_set_mode( CU_BRM_VERBOSE );
+            CU_basic_run_tests();
+            printf( "\n" );
+            CU_basic_show_failures( CU_get_failure_list() );
+            printf( "\n\n" );
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+
+    }
+
+    return rv;
+}
@@ -0,0 +1,242 @@
+/**
+ *  Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <CUnit/Basic.h>
+
+#include "mem_wrapper.h"
+#include "../src/notify.h"
+#include "../src/aker_clock.h"
+#include "../src/aker_msgpack.h"
+#include "../src/aker_mem.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define SOURCE      "aker"
+#define DEST        "event:aker/transition"
+#define START       1520121600
+#define MAX_EVENTS  16
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+typedef struct {
+    int msg_type;
+    char source[32];
+    char dest[32];
+    uint8_t payload[128];
+    size_t len;
+} event_t;
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static pthread_mutex_t mock_lock = PTHREAD_MUTEX_INITIALIZER;
+static event_t events[MAX_EVENTS];
+static size_t event_count = 0;
+static int send_rv = 0;
+static int ctx_value = 42;
+
+/*----------------------------------------------------------------------------*/
+/*                                   Mocks                                    */
+/*----------------------------------------------------------------------------*/
+static int mock_send( void *ctx, wrp_msg_t *msg )
+{
+    CU_ASSERT( &ctx_value == ctx );
+
+    pthread_mutex_lock( &mock_lock );
+    if( event_count < MAX_EVENTS ) {
+        event_t *e = &events[event_count++];
+
+        e->msg_type = msg->msg_type;
+        snprintf( e->source, sizeof(e->source), "%s", msg->u.event.source );
+        snprintf( e->dest, sizeof(e->dest), "%s", msg->u.event.dest );
+        e->len = msg->u.event.payload_size;
+        if( e->len <= sizeof(e->payload) ) {
+            memcpy( e->payload, msg->u.event.payload, e->len );
+        }
+    }
+    pthread_mutex_unlock( &mock_lock );
+
+    return send_rv;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                                   Tests                                    */
+/*----------------------------------------------------------------------------*/
+static size_t get_event_count( void )
+{
+    size_t n;
+
+    pthread_mutex_lock( &mock_lock );
+    n = event_count;
+    pthread_mutex_unlock( &mock_lock );
+
+    return n;
+}
+
+/* Waits up to a second of real time for the sender to catch up. */
+static bool wait_for_sent( uint64_t seq )
+{
+    int i;
+
+    for( i = 0; i < 1000; i++ ) {
+        if( seq == notify_get_sent_sequence() ) {
+            return true;
+        }
+        usleep( 1000 );
+    }
+
+    return false;
+}
+
+static void check_event( size_t n, const char *active, uint64_t seq, time_t when )
+{
+    uint8_t *expected = NULL;
+    size_t len;
+
+    len = pack_event_msg( active, seq, when, (void**) &expected );
+    CU_ASSERT_FATAL( 0 < len );
+
+    pthread_mutex_lock( &mock_lock );
+    CU_ASSERT( n < event_count );
+    if( n < event_count ) {
+        CU_ASSERT( WRP_MSG_TYPE__EVENT == events[n].msg_type );
+        CU_ASSERT_STRING_EQUAL( SOURCE, events[n].source );
+        CU_ASSERT_STRING_EQUAL( DEST, events[n].dest );
+        CU_ASSERT( len == events[n].len );
+        CU_ASSERT( 0 == memcmp(expected, events[n].payload, len) );
+    }
+    pthread_mutex_unlock( &mock_lock );
+
+    aker_free( expected );
+}
+
+void test_disabled()
+{
+    CU_ASSERT( 0 != notify_init(NULL, DEST, 1) );
+    CU_ASSERT( 0 != notify_init(SOURCE, NULL, 1) );
+    CU_ASSERT( 0 != notify_init(SOURCE, DEST, -1) );
+
+    /* Nothing is recorded or sent until enabled. */
+    notify_transition( "11:22:33:44:55:66", 1, START );
+    CU_ASSERT( 0 == notify_get_sequence() );
+    CU_ASSERT( 0 != notify_start(mock_send, &ctx_value, NULL) );
+    notify_stop();
+    CU_ASSERT( 0 == get_event_count() );
+}
+
+void test_coalesce()
+{
+    pthread_t thread;
+
+    CU_ASSERT_FATAL( 0 == aker_clock_set_virtual(START, 0.0) );
+    CU_ASSERT_FATAL( 0 == notify_init(SOURCE, DEST, 10) );
+
+    /* Recorded before upstream is connected, sent once it is. */
+    notify_transition( "11:22:33:44:55:66", 1, START );
+    CU_ASSERT( 1 == notify_get_sequence() );
+    CU_ASSERT( 0 == notify_get_sent_sequence() );
+
+    CU_ASSERT_FATAL( 0 == notify_start(mock_send, &ctx_value, &thread) );
+    CU_ASSERT( 0 != notify_start(mock_send, &ctx_value, NULL) );
+    CU_ASSERT( 0 != notify_init(SOURCE, DEST, 10) );
+    CU_ASSERT( wait_for_sent(1) );
+    CU_ASSERT( 1 == get_event_count() );
+    check_event( 0, "11:22:33:44:55:66", 1, START );
+
+    /* Everything inside the interval collapses into the newest state. */
+    notify_transition( "11:22:33:44:55:77", 2, START + 1 );
+    notify_transition( "11:22:33:44:55:66 11:22:33:44:55:77", 3, START + 2 );
+    notify_transition( NULL, 4, START + 3 );
+    CU_ASSERT( 4 == notify_get_sequence() );
+    usleep( 50000 );
+    CU_ASSERT( 1 == get_event_count() );
+
+    CU_ASSERT( 0 == aker_clock_advance(10) );
+    CU_ASSERT( wait_for_sent(4) );
+    CU_ASSERT( 2 == get_event_count() );
+    check_event( 1, NULL, 4, START + 3 );
+
+    /* A failed send is not retried, the next event has the whole set. */
+    send_rv = -1;
+    CU_ASSERT( 0 == aker_clock_advance(10) );
+    notify_transition( "11:22:33:44:55:88", 5, START + 20 );
+    CU_ASSERT( wait_for_sent(5) );
+    CU_ASSERT( 3 == get_event_count() );
+    check_event( 2, "11:22:33:44:55:88", 5, START + 20 );
+    send_rv = 0;
+
+    /* An event that can't be packed is dropped the same way. */
+    CU_ASSERT( 0 == aker_clock_advance(10) );
+    malloc_fail = true;
+    malloc_failure_limit = 1;
+    notify_transition( "11:22:33:44:55:99", 6, START + 30 );
+    CU_ASSERT( wait_for_sent(6) );
+    malloc_fail = false;
+    CU_ASSERT( 3 == get_event_count() );
+
+    /* Whatever isn't sent when stopping is dropped. */
+    notify_transition( "11:22:33:44:55:aa", 7, START + 31 );
+    notify_stop();
+    CU_ASSERT( 3 == get_event_count() );
+    notify_transition( "11:22:33:44:55:bb", 8, START + 32 );
+    CU_ASSERT( 7 == notify_get_sequence() );
+
+    aker_clock_set_real();
+}
+
+void add_suites( CU_pSuite *suite )
+{
+    printf("--------Start of Test Cases Execution ---------\n");
+    *suite = CU_add_suite( "tests", NULL, NULL );
+    CU_add_test( *suite, "Test disabled", test_disabled );
+    CU_add_test( *suite, "Test coalesce", test_coalesce );
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main( void )
+{
+    unsigned rv = 1;
+    CU_pSuite suite = NULL;
+
+    if( CUE_SUCCESS == CU_initialize_registry() ) {
+        add_suites( &suite );
+
+        if( NULL != suite ) {
+            CU_basic_set_mode( CU_BRM_VERBOSE );
+            CU_basic_run_tests();
+            printf( "\n" );
+            CU_basic_show_failures( CU_get_failure_list() );
+            printf( "\n\n" );
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+
+    }
+
+    return rv;
+}
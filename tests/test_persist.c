@@ -0,0 +1,203 @@
+/**
+ *  Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <CUnit/Basic.h>
+
+#include "mem_wrapper.h"
+#include "../src/persist.h"
+#include "../src/aker_md5.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define DATA_FILE   "persist_data.bin"
+#define MD5_FILE    "persist_data.md5"
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static const char md5_a[] = "0123456789abcdef0123456789abcdef";
+static const char md5_b[] = "aker-sig/1 crc32c 1a2b3c4d 4\n";
+
+/*----------------------------------------------------------------------------*/
+/*                                   Tests                                    */
+/*----------------------------------------------------------------------------*/
+static size_t read_file( const char *filename, uint8_t *buf, size_t size )
+{
+    size_t len = 0;
+    FILE *fh;
+
+    fh = fopen( filename, "rb" );
+    if( NULL != fh ) {
+        len = fread( buf, 1, size, fh );
+        fclose( fh );
+    }
+
+    return len;
+}
+
+void test_synchronous()
+{
+    uint8_t payload[] = { 0x81, 0xa1, 'a', 0x01 };
+    uint8_t buf[64];
+    uint64_t v;
+
+    v = get_applied_version();
+
+    CU_ASSERT( 0 != persist_schedule(NULL, MD5_FILE, payload, sizeof(payload), md5_a) );
+    CU_ASSERT( 0 != persist_schedule(DATA_FILE, NULL, payload, sizeof(payload), md5_a) );
+    CU_ASSERT( 0 != persist_schedule(DATA_FILE, MD5_FILE, NULL, 0, md5_a) );
+    CU_ASSERT( v == get_applied_version() );
+
+    CU_ASSERT( 0 == persist_schedule(DATA_FILE, MD5_FILE, payload, sizeof(payload), md5_a) );
+    CU_ASSERT( v + 1 == get_applied_version() );
+    CU_ASSERT( get_applied_version() == get_persisted_version() );
+    CU_ASSERT( PERSIST_OP_NONE == persist_get_pending_op() );
+
+    CU_ASSERT( sizeof(payload) == read_file(DATA_FILE, buf, sizeof(buf)) );
+    CU_ASSERT( 0 == memcmp(payload, buf, sizeof(payload)) );
+    CU_ASSERT( MD5_SIZE * 2 == read_file(MD5_FILE, buf, sizeof(buf)) );
+    CU_ASSERT( 0 == memcmp(md5_a, buf, MD5_SIZE * 2) );
+
+    CU_ASSERT( 0 == persist_remove(DATA_FILE, MD5_FILE) );
+    CU_ASSERT( 0 != access(DATA_FILE, F_OK) );
+    CU_ASSERT( 0 != access(MD5_FILE, F_OK) );
+    CU_ASSERT( get_applied_version() == get_persisted_version() );
+
+    malloc_fail = true;
+    malloc_failure_limit = sizeof(payload);
+    CU_ASSERT( 0 != persist_schedule(DATA_FILE, MD5_FILE, payload, sizeof(payload), md5_a) );
+    malloc_fail = false;
+}
+
+void test_write_behind()
+{
+    uint8_t payloads[5][4] = {
+        { 0x81, 0xa1, 'a', 0x01 },
+        { 0x81, 0xa1, 'a', 0x02 },
+        { 0x81, 0xa1, 'a', 0x03 },
+        { 0x81, 0xa1, 'a', 0x04 },
+        { 0x81, 0xa1, 'a', 0x05 },
+    };
+    uint8_t buf[64];
+    uint64_t v;
+    int i;
+
+    CU_ASSERT( 0 == persist_start(NULL) );
+
+    v = get_applied_version();
+    for( i = 0; i < 5; i++ ) {
+        int op;
+
+        CU_ASSERT( 0 == persist_schedule(DATA_FILE, MD5_FILE, payloads[i], 4,
+                                         (i < 4) ? md5_a : md5_b) );
+
+        /* Whatever hasn't landed yet must be the newest accepted payload. */
+        op = persist_get_pending_op();
+        if( PERSIST_OP_WRITE == op ) {
+            uint8_t *data = NULL;
+            size_t len;
+
+            len = persist_get_pending_payload( &data );
+            if( 0 < len ) {
+                CU_ASSERT( 4 == len );
+                CU_ASSERT( 0 == memcmp(payloads[i], data, 4) );
+                free( data );
+            }
+        }
+    }
+    CU_ASSERT( v + 5 == get_applied_version() );
+
+    /* Stopping drains whatever is still queued. */
+    persist_stop();
+    CU_ASSERT( get_applied_version() == get_persisted_version() );
+    CU_ASSERT( PERSIST_OP_NONE == persist_get_pending_op() );
+
+    CU_ASSERT( 4 == read_file(DATA_FILE, buf, sizeof(buf)) );
+    CU_ASSERT( 0 == memcmp(payloads[4], buf, 4) );
+    CU_ASSERT( strlen(md5_b) == read_file(MD5_FILE, buf, sizeof(buf)) );
+    CU_ASSERT( 0 == memcmp(md5_b, buf, strlen(md5_b)) );
+
+    /* A removal queued after a write must win. */
+    CU_ASSERT( 0 == persist_start(NULL) );
+    CU_ASSERT( 0 == persist_schedule(DATA_FILE, MD5_FILE, payloads[0], 4, md5_a) );
+    CU_ASSERT( 0 == persist_remove(DATA_FILE, MD5_FILE) );
+    persist_stop();
+
+    CU_ASSERT( 0 != access(DATA_FILE, F_OK) );
+    CU_ASSERT( 0 != access(MD5_FILE, F_OK) );
+    CU_ASSERT( get_applied_version() == get_persisted_version() );
+}
+
+void test_write_file()
+{
+    const char data[] = "durable";
+    uint8_t buf[64];
+
+    /* With and without a directory in the name. */
+    CU_ASSERT( 0 == persist_write_file("persist_file.bin", data, sizeof(data)) );
+    CU_ASSERT( sizeof(data) == read_file("persist_file.bin", buf, sizeof(buf)) );
+    CU_ASSERT( 0 == persist_write_file("./persist_file.bin", data, 4) );
+    CU_ASSERT( 4 == read_file("persist_file.bin", buf, sizeof(buf)) );
+    CU_ASSERT( 0 != access("persist_file.bin.tmp", F_OK) );
+
+    CU_ASSERT( 0 != persist_write_file("no-such-dir/persist_file.bin", data, 4) );
+    CU_ASSERT( 0 != persist_write_file(NULL, data, 4) );
+
+    remove( "persist_file.bin" );
+}
+
+void add_suites( CU_pSuite *suite )
+{
+    printf("--------Start of Test Cases Execution ---------\n");
+    *suite = CU_add_suite( "tests", NULL, NULL );
+    CU_add_test( *suite, "Test synchronous", test_synchronous );
+    CU_add_test( *suite, "Test write-behind", test_write_behind );
+    CU_add_test( *suite, "Test write file", test_write_file );
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main( void )
+{
+    unsigned rv = 1;
+    CU_pSuite suite = NULL;
+
+    if( CUE_SUCCESS == CU_initialize_registry() ) {
+        add_suites( &suite );
+
+        if( NULL != suite ) {
+            CU_basic_set_mode( CU_BRM_VERBOSE );
+            CU_basic_run_tests();
+            printf( "\n" );
+            CU_basic_show_failures( CU_get_failure_list() );
+            printf( "\n\n" );
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+
+    }
+
+    return rv;
+}
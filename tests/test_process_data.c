@@ -18,6 +18,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
 #include <wrp-c.h>
 
 #include <CUnit/Basic.h>
@@ -25,6 +27,8 @@
 #include "test_macros.h"
 #include "../src/wrp_interface.h"
 #include "../src/process_data.h"
+#include "../src/schedule_compact.h"
+#include "../src/decode.h"
 
 /*----------------------------------------------------------------------------*/
 /*                                   Macros                                   */
@@ -107,7 +111,89 @@ void test_process_data()
 
     if( NULL != data ) {
         free(data);
+        data = NULL;
     }
+
+    /* The compacted schedule is what gets stored, and is already compact. */
+    process_set_compaction( PROCESS_COMPACT_STORE );
+    rv = process_update("pcs.bin", "pcs_md5.bin", test_vector, data_size);
+    CU_ASSERT( rv == 0 );
+    process_set_compaction( PROCESS_COMPACT_NONE );
+
+    len = read_file_from_disk("pcs.bin", &data);
+    CU_ASSERT_FATAL( 0 < len );
+    {
+        schedule_counts_t before, after;
+        schedule_t *s = NULL;
+
+        CU_ASSERT( 0 == decode_schedule_data(len, data, &s) );
+        CU_ASSERT( 0 == compact_schedule(s, 0, &before, &after) );
+        CU_ASSERT( 0 == memcmp(&before, &after, sizeof(after)) );
+        destroy_schedule( s );
+    }
+
+    if( NULL != data ) {
+        free(data);
+    }
+    if( NULL != test_vector ) {
+        free(test_vector);
+    }
+}
+
+void test_named()
+{
+    uint8_t *data = NULL;
+    uint8_t *test_vector = NULL;
+    size_t len, data_size = 0;
+    char *file;
+
+    data_size = get_data(&test_vector);
+    CU_ASSERT_FATAL( 0 < data_size );
+
+    (void) process_named_delete("pcs.bin", "pcs_md5.bin", "kids");
+
+    CU_ASSERT( process_is_named_ok("kids") );
+    CU_ASSERT( process_is_named_ok("Room_2-b") );
+    CU_ASSERT( !process_is_named_ok("") );
+    CU_ASSERT( !process_is_named_ok("patch") );
+    CU_ASSERT( !process_is_named_ok("../kids") );
+    CU_ASSERT( !process_is_named_ok("kids.tmp") );
+    CU_ASSERT( !process_is_named_ok("0123456789012345678901234567890123") );
+    CU_ASSERT( NULL == process_named_file("pcs.bin", "a/b") );
+
+    file = process_named_file("pcs.bin", "kids");
+    CU_ASSERT_FATAL( NULL != file );
+    CU_ASSERT_STRING_EQUAL( "pcs.bin.named.kids", file );
+
+    CU_ASSERT( -2 == process_is_named_create_ok("pcs.bin", "a b") );
+    CU_ASSERT( 0 == process_is_named_create_ok("pcs.bin", "kids") );
+    CU_ASSERT( -1 == process_named_update("pcs.bin", "pcs_md5.bin", "a b", test_vector, data_size) );
+    CU_ASSERT( -2 == process_named_update("pcs.bin", "pcs_md5.bin", "kids", NULL, 0) );
+    CU_ASSERT( 0 == process_retrieve_named("pcs.bin", "kids", &data) );
+
+    CU_ASSERT( 0 == process_named_update("pcs.bin", "pcs_md5.bin", "kids", test_vector, data_size) );
+    CU_ASSERT( -1 == process_is_named_create_ok("pcs.bin", "kids") );
+
+    len = process_retrieve_named("pcs.bin", "kids", &data);
+    CU_ASSERT( data_size == len );
+    CU_ASSERT( (NULL != data) && (0 == memcmp(test_vector, data, len)) );
+    if( NULL != data ) {
+        free(data);
+        data = NULL;
+    }
+
+    /* Stored schedules come back at startup; the main one is not named. */
+    CU_ASSERT( 1 == process_import_named("pcs.bin", "pcs_md5.bin") );
+    CU_ASSERT( 0 == process_import_named("pcs.bin.named.kids", "pcs_md5.bin") );
+
+    CU_ASSERT( -1 == process_named_delete("pcs.bin", "pcs_md5.bin", "a b") );
+    CU_ASSERT( 0 == process_named_delete("pcs.bin", "pcs_md5.bin", "kids") );
+    CU_ASSERT( -2 == process_named_delete("pcs.bin", "pcs_md5.bin", "kids") );
+    CU_ASSERT( 0 != access(file, F_OK) );
+    CU_ASSERT( 0 == process_import_named("pcs.bin", "pcs_md5.bin") );
+
+    free(file);
+    free(test_vector);
 }
 
 void add_suites( CU_pSuite *suite )
@@ -115,6 +201,7 @@ void add_suites( CU_pSuite *suite )
     printf("--------Start of Test Cases Execution ---------\n");
     *suite = CU_add_suite( "tests", NULL, NULL );
     CU_add_test( *suite, "Test 1", test_process_data );
+    CU_add_test( *suite, "Test named schedules", test_named );
 }
 
 /*----------------------------------------------------------------------------*/
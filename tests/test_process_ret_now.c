@@ -23,6 +23,9 @@
 #include <CUnit/Basic.h>
 
 #include "../src/process_data.h"
+#include "../src/schedule_patch.h"
+#include "../src/schedule_compact.h"
+#include "../src/schedule_image.h"
 
 /*----------------------------------------------------------------------------*/
 /*                                   Macros                                   */
@@ -130,8 +133,6 @@ static uint8_t i;
 /*----------------------------------------------------------------------------*/
 /*                                   Mocks                                    */
 /*----------------------------------------------------------------------------*/
-#define MD5_SIZE 1
-
 time_t get_unix_time(void)
 {
     return tests_now[i].ts;
@@ -142,10 +143,29 @@ char *get_current_blocked_macs( void )
     return strdup(tests_now[i].macs);
 }
 
-unsigned char *compute_byte_stream_md5(uint8_t *data, size_t length,
-                                   unsigned char result[MD5_SIZE])
+int get_current_device_status( const char *mac, time_t unixtime,
+                               bool *blocked, time_t *next_change )
+{
+    if( 0 != strcmp("11:22:33:44:55:66", mac) ) {
+        return -2;
+    }
+    *blocked = true;
+    *next_change = unixtime + 10;
+    return 0;
+}
+
+static uint64_t transition_seq = 0;
+uint64_t get_current_transition_seq( time_t *start_time )
 {
-    (void) data; (void) length; (void) result;
+    if( NULL != start_time ) {
+        *start_time = 1520121600;
+    }
+    return transition_seq;
+}
+
+char *integrity_compute_sig(const uint8_t *data, size_t length)
+{
+    (void) data; (void) length;
     return NULL;
 }
 
@@ -155,6 +175,145 @@ int process_schedule_data( size_t len, uint8_t *data )
     return 1;
 }
 
+/* Patches are covered by test_schedule_patch; none gets past decoding here. */
+int decode_schedule_patch( size_t len, const uint8_t *data,
+                           schedule_patch_t **patch )
+{
+    (void) len; (void) data; (void) patch;
+    return -2;
+}
+
+void destroy_schedule_patch( schedule_patch_t *patch )
+{
+    (void) patch;
+}
+
+int apply_schedule_patch( schedule_t *s, const schedule_patch_t *patch )
+{
+    (void) s; (void) patch;
+    return -1;
+}
+
+schedule_t* scheduler_copy_schedule( void )
+{
+    return NULL;
+}
+
+schedule_t* scheduler_copy_pruned_schedule( size_t min_pruned )
+{
+    (void) min_pruned;
+    return NULL;
+}
+
+void scheduler_set_schedule( schedule_t *s )
+{
+    (void) s;
+}
+
+void destroy_schedule( schedule_t *s )
+{
+    (void) s;
+}
+
+int finalize_schedule( schedule_t *s )
+{
+    (void) s;
+    return -1;
+}
+
+/* Named schedules are covered by test_process_data. */
+int scheduler_set_named_schedule( const char *name, schedule_t *s )
+{
+    (void) name; (void) s;
+    return -1;
+}
+
+int tenant_set_schedule( const char *id, schedule_t *s )
+{
+    (void) id; (void) s;
+    return -1;
+}
+
+int decode_schedule_data( size_t count, uint8_t *bytes, schedule_t **s )
+{
+    (void) count; (void) bytes; (void) s;
+    return -1;
+}
+
+int integrity_verify( const uint8_t *data, size_t len,
+                      const uint8_t *sig, size_t sig_len )
+{
+    (void) data; (void) len; (void) sig; (void) sig_len;
+    return -2;
+}
+
+size_t encode_schedule( schedule_t *s, uint8_t **data )
+{
+    (void) s; (void) data;
+    return 0;
+}
+
+/* Compaction is covered by test_schedule_compact and test_process_data. */
+int decode_schedule( size_t count, uint8_t *bytes, schedule_t **s )
+{
+    (void) count; (void) bytes; (void) s;
+    return -1;
+}
+
+int compact_schedule( schedule_t *s, time_t now,
+                      schedule_counts_t *before, schedule_counts_t *after )
+{
+    (void) s; (void) now; (void) before; (void) after;
+    return -1;
+}
+
+int set_unix_time_zone( const char *time_zone )
+{
+    (void) time_zone;
+    return 0;
+}
+
+int journal_append( const char *data_file, const char *md5_file,
+                    const uint8_t *patch, size_t patch_len,
+                    const uint8_t *schedule, size_t schedule_len,
+                    const char *sig )
+{
+    (void) data_file; (void) md5_file; (void) patch; (void) patch_len;
+    (void) schedule; (void) schedule_len; (void) sig;
+    return -1;
+}
+
+int journal_write_base( const char *data_file, const char *md5_file,
+                        const uint8_t *payload, size_t len, const char *sig )
+{
+    (void) data_file; (void) md5_file; (void) payload; (void) len; (void) sig;
+    return -1;
+}
+
+int journal_remove_base( const char *data_file, const char *md5_file )
+{
+    (void) data_file; (void) md5_file;
+    return 0;
+}
+
+size_t journal_get_record_count( void )
+{
+    return 0;
+}
+
+int schedule_image_write( const char *filename, const schedule_t *s,
+                          const uint8_t *source, size_t source_len )
+{
+    (void) filename; (void) s; (void) source; (void) source_len;
+    return -1;
+}
+
+char* schedule_image_name( const char *data_file )
+{
+    (void) data_file;
+    return NULL;
+}
+
 /*----------------------------------------------------------------------------*/
 /*                                   Tests                                    */
 /*----------------------------------------------------------------------------*/
@@ -173,11 +332,83 @@ void test_process_ret_now()
     }
 }
 
+void test_process_ret_device()
+{
+    uint8_t expected[] = {
+        0x84, /* 4 name value pairs */
+        0xa3, 'm', 'a', 'c',
+        0xb1, '1', '1', ':', '2', '2', ':', '3', '3', ':', '4', '4', ':', '5', '5', ':', '6', '6',
+        0xa7, 'b', 'l', 'o', 'c', 'k', 'e', 'd',
+        0xc3,
+        0xab, 'n', 'e', 'x', 't', '_', 'c', 'h', 'a', 'n', 'g', 'e',
+        0xce, 0x00, 0x12, 0xd4, 0x59, /* 1234009 */
+        0xa4, 't', 'i', 'm', 'e',
+        0xce, 0x00, 0x12, 0xd4, 0x4f, /* 1233999 */
+    };
+    uint8_t *data = NULL;
+    size_t ret_size;
+
+    i = 0;
+    ret_size = process_retrieve_device("11:22:33:44:55:66", &data);
+    CU_ASSERT(sizeof(expected) == ret_size);
+    CU_ASSERT(0 == memcmp(data, expected, sizeof(expected)));
+    free(data);
+    data = NULL;
+
+    CU_ASSERT(0 == process_retrieve_device("22:33:44:55:66:77", &data));
+    CU_ASSERT(NULL == data);
+}
+
+void test_etags()
+{
+    const uint8_t md5[] = "0123456789abcdef0123456789abcdef";
+    const uint8_t crc[] = "aker-sig/1 crc32c 1a2b3c4d 4\n";
+    char *etag;
+
+    CU_ASSERT(NULL == process_get_schedule_etag());
+
+    process_set_schedule_etag(md5, sizeof(md5) - 1);
+    etag = process_get_schedule_etag();
+    CU_ASSERT_STRING_EQUAL("0123456789abcdef0123456789abcdef", etag);
+    free(etag);
+
+    /* The versioned format's tag is the digest alone. */
+    process_set_schedule_etag(crc, sizeof(crc) - 1);
+    etag = process_get_schedule_etag();
+    CU_ASSERT_STRING_EQUAL("1a2b3c4d", etag);
+    free(etag);
+    process_set_schedule_etag((const uint8_t*) "aker-sig/1 crc32c", 17);
+    CU_ASSERT(NULL == process_get_schedule_etag());
+
+    process_set_schedule_etag((const uint8_t*) "\n", 1);
+    CU_ASSERT(NULL == process_get_schedule_etag());
+    process_set_schedule_etag(md5, sizeof(md5) - 1);
+    process_set_schedule_etag(NULL, 0);
+    CU_ASSERT(NULL == process_get_schedule_etag());
+
+    /* An update that fails before the schedule changes keeps the tag. */
+    process_set_schedule_etag(md5, sizeof(md5) - 1);
+    CU_ASSERT(0 != process_update("data", "md5", "x", 1));
+    etag = process_get_schedule_etag();
+    CU_ASSERT_STRING_EQUAL("0123456789abcdef0123456789abcdef", etag);
+    free(etag);
+    process_set_schedule_etag(NULL, 0);
+
+    transition_seq = 0;
+    CU_ASSERT(NULL == process_get_now_etag());
+    transition_seq = 42;
+    etag = process_get_now_etag();
+    CU_ASSERT_STRING_EQUAL("1520121600-42", etag);
+    free(etag);
+}
+
 void add_suites( CU_pSuite *suite )
 {
     printf("--------Start of Test Cases Execution ---------\n");
     *suite = CU_add_suite( "tests", NULL, NULL );
     CU_add_test( *suite, "Test 1", test_process_ret_now );
+    CU_add_test( *suite, "Test device", test_process_ret_device );
+    CU_add_test( *suite, "Test etags", test_etags );
 }
 
 /*----------------------------------------------------------------------------*/
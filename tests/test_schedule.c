@@ -214,6 +214,14 @@ void run_schedule_test( schedule_test_t *t )
         }
         next_unixtime = get_next_unixtime(s, t->block_test[i].unixtime);
         CU_ASSERT(t->block_test[i].next_unixtime == next_unixtime);
+        /* The blocked list is the string form of the event in effect. */
+        e = get_event_at_time( s, t->block_test[i].unixtime );
+        if( NULL != block ) {
+            CU_ASSERT( NULL != e );
+            if( NULL != e ) {
+                CU_ASSERT( e->block_count * MAC_ADDRESS_SIZE - 1 == strlen(block) );
+            }
+        }
         if( NULL != block ) free(block);
     }
 
@@ -352,6 +360,73 @@ void test_only_one_absolute( void )
     run_schedule_test(&test);
 }
 
+void test_prune( void )
+{
+    schedule_t *s;
+    schedule_event_t *e;
+    char *before[8], *after;
+    time_t next[8], transition[8];
+    time_t t[] = { 1000, 2000, 3000, 4000, 5000 };
+    time_t now = 3500;
+    size_t i;
+
+    s = create_schedule();
+    CU_ASSERT_FATAL( NULL != s );
+    CU_ASSERT_FATAL( 0 == create_mac_table(s, 2) );
+    CU_ASSERT( 0 == set_mac_index(s, "11:22:33:44:55:66", 17, 0) );
+    CU_ASSERT( 0 == set_mac_index(s, "22:33:44:55:66:aa", 17, 1) );
+
+    e = create_schedule_event( 1 );
+    CU_ASSERT_FATAL( NULL != e );
+    e->time = 100;
+    e->block[0] = 1;
+    insert_event( &s->weekly, e );
+    for( i = 0; i < sizeof(t) / sizeof(time_t); i++ ) {
+        e = create_schedule_event( 1 );
+        CU_ASSERT_FATAL( NULL != e );
+        e->time = t[i];
+        e->block[0] = i % 2;
+        insert_event( &s->absolute, e );
+    }
+    CU_ASSERT_FATAL( 0 == finalize_schedule(s) );
+
+    for( i = 0; i < 8; i++ ) {
+        before[i] = get_blocked_at_time( s, now + i * 500 );
+        next[i] = get_next_unixtime( s, now + i * 500 );
+        transition[i] = get_next_transition( s, now + i * 500 );
+    }
+
+    /* 3000 is in effect at 3500, so only 1000 and 2000 go. */
+    CU_ASSERT( 0 == prune_absolute_events(NULL, now) );
+    CU_ASSERT( 0 == prune_absolute_events(s, 999) );
+    CU_ASSERT( 2 == prune_absolute_events(s, now) );
+    CU_ASSERT( 0 == prune_absolute_events(s, now) );
+    CU_ASSERT_FATAL( NULL != s->absolute );
+    CU_ASSERT( 3000 == s->absolute->time );
+    CU_ASSERT_FATAL( NULL != s->index );
+    CU_ASSERT( 3 == s->index->absolute_count - s->index->absolute_first );
+
+    for( i = 0; i < 8; i++ ) {
+        after = get_blocked_at_time( s, now + i * 500 );
+        if( (NULL != before[i]) && (NULL != after) ) {
+            CU_ASSERT_STRING_EQUAL( before[i], after );
+        } else {
+            CU_ASSERT( before[i] == after );
+        }
+        CU_ASSERT( next[i] == get_next_unixtime(s, now + i * 500) );
+        CU_ASSERT( transition[i] == get_next_transition(s, now + i * 500) );
+        free( after );
+        free( before[i] );
+    }
+
+    /* The last one is always kept. */
+    CU_ASSERT( 2 == prune_absolute_events(s, 100000) );
+    CU_ASSERT( 5000 == s->absolute->time );
+    CU_ASSERT( NULL == s->absolute->next );
+
+    destroy_schedule( s );
+}
+
 void test_only_one_weekly( void )
 {
     #define WEEKLY_23_NEXT_WEEK 1234012 + SECONDS_IN_A_WEEK
@@ -392,6 +467,7 @@ void add_suites( CU_pSuite *suite )
     CU_add_test( *suite, "Test no schedule", test_no_schedule);
     CU_add_test( *suite, "Test only one absolute event", test_only_one_absolute);
     CU_add_test( *suite, "Test only one weekly event", test_only_one_weekly);
+    CU_add_test( *suite, "Test pruning absolute events", test_prune);
 }
 
 /*----------------------------------------------------------------------------*/
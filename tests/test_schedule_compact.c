@@ -0,0 +1,420 @@
+/**
+ *  Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <CUnit/Basic.h>
+
+#include "mem_wrapper.h"
+#include "../src/aker_mem.h"
+#include "../src/schedule.h"
+#include "../src/decode.h"
+#include "../src/encode.h"
+#include "../src/schedule_compact.h"
+#include "../src/time.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define MAC_A       "11:22:33:44:55:aa"
+#define MAC_A_UPPER "11:22:33:44:55:AA"
+#define MAC_B       "22:33:44:55:66:bb"
+#define MAC_C       "33:44:55:66:77:cc"
+#define MAC_D       "44:55:66:77:88:dd"
+#define SUNDAY      (3 * 24 * 3600)     /* 1970-01-04 00:00 UTC */
+
+/*----------------------------------------------------------------------------*/
+/*                                   Mocks                                    */
+/*----------------------------------------------------------------------------*/
+int32_t get_max_mac_limit(void)
+{
+    return 2048;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                              Test Helpers                                  */
+/*----------------------------------------------------------------------------*/
+static schedule_t* make_schedule( size_t count, ... )
+{
+    schedule_t *s;
+    va_list ap;
+    size_t i;
+
+    s = create_schedule();
+    CU_ASSERT_FATAL( NULL != s );
+    CU_ASSERT_FATAL( 0 == create_mac_table(s, count) );
+
+    va_start( ap, count );
+    for( i = 0; i < count; i++ ) {
+        const char *mac = va_arg( ap, const char* );
+        CU_ASSERT_FATAL( 0 == set_mac_index(s, mac, strlen(mac), i) );
+    }
+    va_end( ap );
+
+    return s;
+}
+
+static void add_event( schedule_t *s, bool absolute, time_t t, size_t count, ... )
+{
+    schedule_event_t *e;
+    va_list ap;
+    size_t i;
+
+    e = create_schedule_event( count );
+    CU_ASSERT_FATAL( NULL != e );
+    e->time = t;
+
+    va_start( ap, count );
+    for( i = 0; i < count; i++ ) {
+        e->block[i] = va_arg( ap, uint32_t );
+    }
+    va_end( ap );
+
+    insert_event( (absolute ? &s->absolute : &s->weekly), e );
+}
+
+static int compare_str( const void *a, const void *b )
+{
+    return strcmp( *((char* const*) a), *((char* const*) b) );
+}
+
+/* The set of lower case MACs blocked at t, sorted and space separated. */
+static void blocked( schedule_t *s, time_t t, char *buf, size_t size )
+{
+    schedule_event_t *e;
+    char macs[16][MAC_ADDRESS_SIZE];
+    char *sorted[16];
+    size_t i, j, n = 0;
+
+    buf[0] = '\0';
+    e = get_event_at_time( s, t );
+    if( NULL == e ) {
+        return;
+    }
+
+    CU_ASSERT_FATAL( e->block_count <= 16 );
+    for( i = 0; i < e->block_count; i++ ) {
+        for( j = 0; j < MAC_ADDRESS_SIZE; j++ ) {
+            macs[i][j] = tolower( (unsigned char) s->macs[e->block[i]].mac[j] );
+        }
+        sorted[i] = macs[i];
+    }
+    qsort( sorted, e->block_count, sizeof(char*), compare_str );
+
+    for( i = 0; i < e->block_count; i++ ) {
+        if( (0 < n) && (0 == strcmp(sorted[i], sorted[n - 1])) ) {
+            continue;
+        }
+        sorted[n++] = sorted[i];
+    }
+    for( i = 0; i < n; i++ ) {
+        strncat( buf, sorted[i], size - strlen(buf) - 1 );
+        strncat( buf, " ", size - strlen(buf) - 1 );
+    }
+}
+
+/* Both schedules block the same devices every step seconds in [from, to). */
+static bool same_blocking( schedule_t *a, schedule_t *b, time_t from, time_t to,
+                           time_t step )
+{
+    char x[256], y[256];
+    time_t t;
+
+    for( t = from; t < to; t += step ) {
+        blocked( a, t, x, sizeof(x) );
+        blocked( b, t, y, sizeof(y) );
+        if( 0 != strcmp(x, y) ) {
+            printf( "\nat %ld: '%s' vs '%s'\n", (long) t, x, y );
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static size_t list_length( schedule_event_t *e )
+{
+    size_t n = 0;
+
+    for( ; NULL != e; e = e->next ) {
+        if( 0 <= e->time ) {
+            n++;
+        }
+    }
+
+    return n;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                                   Tests                                    */
+/*----------------------------------------------------------------------------*/
+void test_weekly( void )
+{
+    schedule_counts_t before, after;
+    schedule_t *s, *orig;
+    schedule_event_t *e;
+
+    s = make_schedule( 5, MAC_A, MAC_B, MAC_C, MAC_A_UPPER, MAC_D );
+    add_event( s, false, 10, 2, 0, 3 );         /* A, twice */
+    add_event( s, false, 20, 2, 3, 0 );         /* the same: merged */
+    add_event( s, false, 30, 2, 2, 1 );
+    add_event( s, false, 30, 1, 1 );            /* goes in front: hidden */
+    add_event( s, false, 40, 0 );
+    add_event( s, false, 50, 1, 0 );            /* the same as the first one */
+    CU_ASSERT_FATAL( 0 == finalize_schedule(s) );
+    orig = copy_schedule( s );
+    CU_ASSERT_FATAL( 0 == finalize_schedule(orig) );
+
+    CU_ASSERT( 0 == compact_schedule(s, 0, &before, &after) );
+
+    CU_ASSERT( 6 == before.weekly );
+    CU_ASSERT( 0 == before.absolute );
+    CU_ASSERT( 5 == before.macs );
+    CU_ASSERT( 8 == before.blocks );
+
+    /* 30 {B, C}, 40 {} and 50 {A}; D is unused and A only listed once. */
+    CU_ASSERT( 3 == after.weekly );
+    CU_ASSERT( 0 == after.absolute );
+    CU_ASSERT( 3 == after.macs );
+    CU_ASSERT( 3 == after.blocks );
+    CU_ASSERT( 3 == list_length(s->weekly) );
+    CU_ASSERT( 0 == strcmp(MAC_A, s->macs[0].mac) );
+    CU_ASSERT( 0 == strcmp(MAC_B, s->macs[1].mac) );
+    CU_ASSERT( 0 == strcmp(MAC_C, s->macs[2].mac) );
+
+    /* The indexes are renumbered and sorted. */
+    e = get_event_at_time( s, SUNDAY + 35 );
+    CU_ASSERT_FATAL( NULL != e );
+    CU_ASSERT( 2 == e->block_count );
+    CU_ASSERT( 1 == e->block[0] );
+    CU_ASSERT( 2 == e->block[1] );
+
+    /* The copy of the last event is back in front and indexed. */
+    CU_ASSERT( 0 > s->weekly->time );
+    CU_ASSERT( NULL != s->index );
+    CU_ASSERT( same_blocking(orig, s, SUNDAY - 100, SUNDAY + 100, 1) );
+    CU_ASSERT( same_blocking(orig, s, 0, 2 * SECONDS_IN_A_WEEK, 600) );
+
+    /* A second pass has nothing left to do. */
+    CU_ASSERT( 0 == compact_schedule(s, 0, &before, &after) );
+    CU_ASSERT( 0 == memcmp(&before, &after, sizeof(after)) );
+    CU_ASSERT( same_blocking(orig, s, SUNDAY - 100, SUNDAY + 100, 1) );
+    CU_ASSERT( same_blocking(orig, s, 0, 2 * SECONDS_IN_A_WEEK, 600) );
+
+    destroy_schedule( orig );
+    destroy_schedule( s );
+}
+
+
+void test_absolute( void )
+{
+    schedule_counts_t before, after;
+    schedule_t *s, *orig;
+    time_t now = 100000;
+
+    s = make_schedule( 3, MAC_A, MAC_B, MAC_C );
+    add_event( s, false, 0, 0 );
+    add_event( s, false, 7200, 0 );             /* kept, see below */
+    add_event( s, false, 9000, 1, 2 );
+    add_event( s, true, now - 5000, 1, 0 );     /* expired */
+    add_event( s, true, now - 1000, 1, 1 );     /* expired */
+    add_event( s, true, now - 10, 1, 2 );       /* in effect */
+    add_event( s, true, now + 1000, 1, 1 );
+    add_event( s, true, now + 2000, 1, 1 );     /* the same: merged */
+    add_event( s, true, now + 3000, 1, 2 );
+    add_event( s, true, now + 4000, 1, 2 );     /* the end, so kept */
+    CU_ASSERT_FATAL( 0 == finalize_schedule(s) );
+    orig = copy_schedule( s );
+    CU_ASSERT_FATAL( 0 == finalize_schedule(orig) );
+
+    CU_ASSERT( 0 == compact_schedule(s, now, &before, &after) );
+
+    CU_ASSERT( 7 == before.absolute );
+    CU_ASSERT( 4 == after.absolute );
+    CU_ASSERT( 4 == list_length(s->absolute) );
+    CU_ASSERT( now - 10 == s->absolute->time );
+
+    /* With absolute events left the weekly ones stay as they are. */
+    CU_ASSERT( 3 == after.weekly );
+
+    /* A was only blocked by an expired event. */
+    CU_ASSERT( 2 == after.macs );
+    CU_ASSERT( 0 == strcmp(MAC_B, s->macs[0].mac) );
+
+    CU_ASSERT( same_blocking(orig, s, now, now + 5000, 10) );
+    CU_ASSERT( same_blocking(orig, s, now, now + 2 * SECONDS_IN_A_WEEK, 600) );
+
+    destroy_schedule( orig );
+    destroy_schedule( s );
+
+    /* With no absolute event before now nothing is pruned, and a first
+     * event hidden by another at the same time is still used before the
+     * absolute schedule starts. */
+    s = make_schedule( 3, MAC_A, MAC_B, MAC_C );
+    add_event( s, false, 0, 0 );
+    add_event( s, true, now + 10, 1, 0 );
+    add_event( s, true, now + 10, 1, 1 );
+    add_event( s, true, now + 20, 0 );
+    CU_ASSERT_FATAL( 0 == finalize_schedule(s) );
+    orig = copy_schedule( s );
+    CU_ASSERT_FATAL( 0 == finalize_schedule(orig) );
+
+    CU_ASSERT( 0 == compact_schedule(s, now, &before, &after) );
+    CU_ASSERT( 3 == after.absolute );
+    CU_ASSERT( same_blocking(orig, s, now - 100, now + 100, 1) );
+    CU_ASSERT( same_blocking(orig, s, now - SECONDS_IN_A_WEEK,
+                             now + 2 * SECONDS_IN_A_WEEK, 600) );
+
+    destroy_schedule( orig );
+    destroy_schedule( s );
+}
+
+
+void test_encode( void )
+{
+    schedule_counts_t after, decoded;
+    schedule_t *s, *d = NULL;
+    uint8_t *data = NULL;
+    size_t len;
+
+    /* Nothing is blocked, but one MAC is kept so it still decodes. */
+    s = make_schedule( 2, MAC_A, MAC_B );
+    add_event( s, false, 100, 0 );
+    add_event( s, false, 200, 0 );
+    add_event( s, true, 1000, 0 );
+    CU_ASSERT_FATAL( 0 == finalize_schedule(s) );
+
+    CU_ASSERT( 0 == compact_schedule(s, 5000, NULL, &after) );
+    CU_ASSERT( 1 == after.macs );
+    CU_ASSERT( 0 == after.blocks );
+
+    len = encode_schedule( s, &data );
+    CU_ASSERT_FATAL( 0 < len );
+    CU_ASSERT( 0 == decode_schedule_data(len, data, &d) );
+    CU_ASSERT_FATAL( NULL != d );
+    count_schedule( d, &decoded );
+    CU_ASSERT( 0 == memcmp(&after, &decoded, sizeof(after)) );
+
+    aker_free( data );
+    destroy_schedule( d );
+    destroy_schedule( s );
+}
+
+
+void test_errors( void )
+{
+    schedule_counts_t c;
+    schedule_event_t *e;
+    schedule_t *s, *orig;
+    time_t t;
+
+    CU_ASSERT( -1 == compact_schedule(NULL, 0, NULL, NULL) );
+
+    count_schedule( NULL, &c );
+    CU_ASSERT( 0 == c.weekly );
+    CU_ASSERT( 0 == c.macs );
+
+    /* An event with an index outside the MAC table blocks nothing at all,
+     * before compaction and after. */
+    s = make_schedule( 2, MAC_A, MAC_B );
+    add_event( s, false, 100, 2, 0, 2 );
+    add_event( s, false, 200, 1, 1 );
+    CU_ASSERT_FATAL( 0 == finalize_schedule(s) );
+    orig = copy_schedule( s );
+    CU_ASSERT_FATAL( 0 == finalize_schedule(orig) );
+    CU_ASSERT( 0 == compact_schedule(s, 0, NULL, &c) );
+    CU_ASSERT( 1 == c.blocks );
+    for( t = SUNDAY + 50; t < SUNDAY + 300; t += 50 ) {
+        char *x = get_blocked_at_time( orig, t );
+        char *y = get_blocked_at_time( s, t );
+
+        CU_ASSERT( (NULL == x) == (NULL == y) );
+        if( (NULL != x) && (NULL != y) ) {
+            CU_ASSERT_STRING_EQUAL( x, y );
+        }
+        aker_free( x );
+        aker_free( y );
+    }
+    e = s->weekly;
+    while( (NULL != e) && (e->time < 0) ) {
+        e = e->next;
+    }
+    CU_ASSERT_FATAL( NULL != e );
+    CU_ASSERT( 0 == e->block_count );
+    destroy_schedule( orig );
+    destroy_schedule( s );
+
+    /* Out of memory leaves the schedule as it was. */
+    s = make_schedule( 2, MAC_A, MAC_B );
+    add_event( s, false, 100, 1, 0 );
+    add_event( s, false, 200, 1, 0 );
+    CU_ASSERT_FATAL( 0 == finalize_schedule(s) );
+
+    malloc_fail = true;
+    malloc_failure_limit = 1;
+    CU_ASSERT( -2 == compact_schedule(s, 0, NULL, &c) );
+    malloc_fail = false;
+
+    count_schedule( s, &c );
+    CU_ASSERT( 2 == c.weekly );
+    CU_ASSERT( 2 == c.macs );
+
+    destroy_schedule( s );
+}
+
+
+void add_suites( CU_pSuite *suite )
+{
+    printf("--------Start of Test Cases Execution ---------\n");
+    *suite = CU_add_suite( "tests", NULL, NULL );
+    CU_add_test( *suite, "Test weekly", test_weekly );
+    CU_add_test( *suite, "Test absolute", test_absolute );
+    CU_add_test( *suite, "Test encode", test_encode );
+    CU_add_test( *suite, "Test errors", test_errors );
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main( void )
+{
+    unsigned rv = 1;
+    CU_pSuite suite = NULL;
+
+    set_unix_time_zone( "UTC" );
+
+    if( CUE_SUCCESS == CU_initialize_registry() ) {
+        add_suites( &suite );
+
+        if( NULL != suite ) {
+            CU_basic_set_mode( CU_BRM_VERBOSE );
+            CU_basic_run_tests();
+            printf( "\n" );
+            CU_basic_show_failures( CU_get_failure_list() );
+            printf( "\n\n" );
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+
+    }
+
+    return rv;
+}
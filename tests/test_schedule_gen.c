@@ -0,0 +1,277 @@
+/**
+ *  Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <CUnit/Basic.h>
+
+#include "mem_wrapper.h"
+#include "../src/schedule_gen.h"
+#include "../src/schedule.h"
+#include "../src/decode.h"
+#include "../src/time.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Tests                                    */
+/*----------------------------------------------------------------------------*/
+int32_t get_max_mac_limit( void )
+{
+    return 1000;
+}
+
+static size_t count_events( schedule_event_t *e, time_t *last, bool *sorted )
+{
+    size_t count = 0;
+
+    /* Skip the event finalize_schedule() carried over from last week. */
+    if( (NULL != e) && (e->time < 0) ) {
+        e = e->next;
+    }
+
+    *sorted = true;
+    while( NULL != e ) {
+        if( (0 < count) && (e->time <= *last) ) {
+            *sorted = false;
+        }
+        *last = e->time;
+        count++;
+        e = e->next;
+    }
+
+    return count;
+}
+
+void test_decodes()
+{
+    schedule_gen_cfg_t cfg;
+    schedule_t *s = NULL;
+    uint8_t *data = NULL;
+    time_t last = 0;
+    bool sorted;
+    size_t len;
+
+    schedule_gen_defaults( &cfg );
+    cfg.weekly = 500;
+    cfg.absolute = 100;
+    cfg.macs = 20;
+    cfg.block_max = 5;
+
+    len = schedule_gen( &cfg, &data );
+    CU_ASSERT( 0 < len );
+    CU_ASSERT( 0 == decode_schedule(len, data, &s) );
+    CU_ASSERT_FATAL( NULL != s );
+
+    CU_ASSERT( 20 == s->mac_count );
+    CU_ASSERT( 0 == strcmp("PST8PDT", s->time_zone) );
+    CU_ASSERT( 500 == count_events(s->weekly, &last, &sorted) );
+    CU_ASSERT( sorted );
+    CU_ASSERT( last < SECONDS_IN_A_WEEK );
+    CU_ASSERT( 100 == count_events(s->absolute, &last, &sorted) );
+    CU_ASSERT( sorted );
+    CU_ASSERT( last < cfg.absolute_start + cfg.absolute_span );
+
+    destroy_schedule( s );
+    free( data );
+
+    /* No time zone and no absolute events. */
+    cfg.time_zone = NULL;
+    cfg.absolute = 0;
+    len = schedule_gen( &cfg, &data );
+    CU_ASSERT( 0 == decode_schedule(len, data, &s) );
+    CU_ASSERT_FATAL( NULL != s );
+    CU_ASSERT( NULL == s->time_zone );
+    CU_ASSERT( NULL == s->absolute );
+    destroy_schedule( s );
+    free( data );
+}
+
+void test_deterministic()
+{
+    schedule_gen_cfg_t cfg;
+    uint8_t *a = NULL, *b = NULL;
+    size_t a_len, b_len;
+
+    schedule_gen_defaults( &cfg );
+    cfg.seed = 42;
+    a_len = schedule_gen( &cfg, &a );
+    b_len = schedule_gen( &cfg, &b );
+    CU_ASSERT( 0 < a_len );
+    CU_ASSERT( a_len == b_len );
+    CU_ASSERT( 0 == memcmp(a, b, a_len) );
+    free( b );
+
+    cfg.seed = 43;
+    b_len = schedule_gen( &cfg, &b );
+    CU_ASSERT( (a_len != b_len) || (0 != memcmp(a, b, a_len)) );
+    free( a );
+    free( b );
+}
+
+static bool has_time( schedule_event_t *e, time_t t )
+{
+    while( NULL != e ) {
+        if( t == e->time ) {
+            return true;
+        }
+        e = e->next;
+    }
+
+    return false;
+}
+
+void test_edges()
+{
+    schedule_gen_cfg_t cfg;
+    schedule_t *s = NULL;
+    uint8_t *data = NULL;
+    time_t last = 0;
+    bool sorted;
+    size_t len;
+
+    /* A year in PST8PDT starting 2017-11-14 has two changes. */
+    schedule_gen_defaults( &cfg );
+    cfg.absolute_span = 365 * 24 * 3600;
+    cfg.dst_edges = true;
+    cfg.time_zero = true;
+
+    len = schedule_gen( &cfg, &data );
+    CU_ASSERT( 0 == decode_schedule(len, data, &s) );
+    CU_ASSERT_FATAL( NULL != s );
+
+    /* 2018-03-11 02:00 PST and 2018-11-04 02:00 PDT */
+    CU_ASSERT( has_time(s->absolute, 1520762399) );
+    CU_ASSERT( has_time(s->absolute, 1520762400) );
+    CU_ASSERT( has_time(s->absolute, 1520762401) );
+    CU_ASSERT( has_time(s->absolute, 1541321999) );
+    CU_ASSERT( has_time(s->absolute, 1541322000) );
+    CU_ASSERT( has_time(s->absolute, 1541322001) );
+    CU_ASSERT( 2 + 6 == count_events(s->absolute, &last, &sorted) );
+    CU_ASSERT( sorted );
+
+    /* Sunday 00:00, 01:00, 01:59:59, 02:00 and 03:00 local time. */
+    CU_ASSERT( has_time(s->weekly, 0) );
+    CU_ASSERT( has_time(s->weekly, 3600) );
+    CU_ASSERT( has_time(s->weekly, 7199) );
+    CU_ASSERT( has_time(s->weekly, 7200) );
+    CU_ASSERT( has_time(s->weekly, 10800) );
+    CU_ASSERT( 10 + 5 == count_events(s->weekly, &last, &sorted) );
+    CU_ASSERT( sorted );
+
+    destroy_schedule( s );
+    free( data );
+}
+
+void test_overlap()
+{
+    schedule_gen_cfg_t cfg;
+    schedule_t *s = NULL;
+    schedule_event_t *e, *prev = NULL;
+    uint8_t *data = NULL;
+    size_t len, i, j;
+
+    schedule_gen_defaults( &cfg );
+    cfg.weekly = 200;
+    cfg.absolute = 0;
+    cfg.macs = 1000;
+    cfg.block_max = 4;
+    cfg.overlap = 100;
+
+    len = schedule_gen( &cfg, &data );
+    CU_ASSERT( 0 == decode_schedule(len, data, &s) );
+    CU_ASSERT_FATAL( NULL != s );
+
+    /* Every blocked MAC was blocked by the last event that blocked any. */
+    for( e = s->weekly; NULL != e; e = e->next ) {
+        if( e->time < 0 ) {
+            continue;
+        }
+        for( i = 0; (NULL != prev) && (i < e->block_count); i++ ) {
+            bool found = false;
+
+            for( j = 0; j < prev->block_count; j++ ) {
+                found |= (e->block[i] == prev->block[j]);
+            }
+            CU_ASSERT( found );
+        }
+        if( 0 < e->block_count ) {
+            prev = e;
+        }
+    }
+    CU_ASSERT( NULL != prev );
+
+    destroy_schedule( s );
+    free( data );
+}
+
+void test_errors()
+{
+    schedule_gen_cfg_t cfg;
+    uint8_t *data = NULL;
+
+    schedule_gen_defaults( &cfg );
+    CU_ASSERT( 0 == schedule_gen(NULL, &data) );
+    CU_ASSERT( 0 == schedule_gen(&cfg, NULL) );
+
+    cfg.macs = 0;
+    CU_ASSERT( 0 == schedule_gen(&cfg, &data) );
+
+    cfg.macs = 1;
+    cfg.weekly = 0;
+    cfg.absolute = 0;
+    CU_ASSERT( 0 == schedule_gen(&cfg, &data) );
+    CU_ASSERT( NULL == data );
+}
+
+void add_suites( CU_pSuite *suite )
+{
+    printf("--------Start of Test Cases Execution ---------\n");
+    *suite = CU_add_suite( "tests", NULL, NULL );
+    CU_add_test( *suite, "Test decodes", test_decodes );
+    CU_add_test( *suite, "Test deterministic", test_deterministic );
+    CU_add_test( *suite, "Test edges", test_edges );
+    CU_add_test( *suite, "Test overlap", test_overlap );
+    CU_add_test( *suite, "Test errors", test_errors );
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main( void )
+{
+    unsigned rv = 1;
+    CU_pSuite suite = NULL;
+
+    if( CUE_SUCCESS == CU_initialize_registry() ) {
+        add_suites( &suite );
+
+        if( NULL != suite ) {
+            CU_basic_set_mode( CU_BRM_VERBOSE );
+            CU_basic_run_tests();
+            printf( "\n" );
+            CU_basic_show_failures( CU_get_failure_list() );
+            printf( "\n\n" );
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+
+    }
+
+    return rv;
+}
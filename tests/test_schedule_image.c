@@ -0,0 +1,237 @@
+/**
+ *  Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <CUnit/Basic.h>
+
+#include "mem_wrapper.h"
+#include "../src/schedule.h"
+#include "../src/schedule_image.h"
+#include "../src/aker_mem.h"
+#include "../src/time.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define IMAGE_FILE  "schedule_image_test.img"
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static const uint8_t sig_a[] = "0123456789abcdef0123456789abcdef";
+static const uint8_t sig_b[] = "fedcba9876543210fedcba9876543210";
+
+/*----------------------------------------------------------------------------*/
+/*                                   Tests                                    */
+/*----------------------------------------------------------------------------*/
+static void add_event( schedule_event_t **head, time_t t, size_t count,
+                       uint32_t a, uint32_t b )
+{
+    schedule_event_t *e = create_schedule_event( count );
+
+    if( NULL != e ) {
+        e->time = t;
+        if( 0 < count ) e->block[0] = a;
+        if( 1 < count ) e->block[1] = b;
+        insert_event( head, e );
+    }
+}
+
+static schedule_t* make_schedule( void )
+{
+    schedule_t *s = create_schedule();
+
+    if( NULL != s ) {
+        s->time_zone = strdup( "PST8PDT" );
+        create_mac_table( s, 3 );
+        set_mac_index( s, "11:22:33:44:55:aa", 17, 0 );
+        set_mac_index( s, "22:33:44:55:66:bb", 17, 1 );
+        set_mac_index( s, "33:44:55:66:77:cc", 17, 2 );
+
+        add_event( &s->weekly, 10, 2, 0, 1 );
+        add_event( &s->weekly, 3600, 1, 2, 0 );
+        add_event( &s->weekly, 7200, 0, 0, 0 );
+        add_event( &s->absolute, 1500000000, 1, 1, 0 );
+        add_event( &s->absolute, 1500003600, 2, 2, 0 );
+        finalize_schedule( s );
+    }
+
+    return s;
+}
+
+static void write_raw( const char *filename, const uint8_t *buf, size_t len )
+{
+    FILE *fh = fopen( filename, "wb" );
+
+    if( NULL != fh ) {
+        fwrite( buf, 1, len, fh );
+        fclose( fh );
+    }
+}
+
+void test_round_trip()
+{
+    schedule_t *s, *l = NULL;
+    schedule_event_t *a, *b;
+    time_t t;
+
+    s = make_schedule();
+    CU_ASSERT_FATAL( NULL != s );
+
+    CU_ASSERT( 0 == schedule_image_write(IMAGE_FILE, s, sig_a, sizeof(sig_a)) );
+    CU_ASSERT( 0 == schedule_image_load(IMAGE_FILE, sig_a, sizeof(sig_a), &l) );
+    CU_ASSERT_FATAL( NULL != l );
+
+    CU_ASSERT( 0 == strcmp(s->time_zone, l->time_zone) );
+    CU_ASSERT( s->mac_count == l->mac_count );
+    CU_ASSERT( 0 == memcmp(s->macs, l->macs, s->mac_count * sizeof(mac_address)) );
+
+    /* The finalized lists come back exactly, including the wrap event. */
+    for( a = s->weekly, b = l->weekly; (NULL != a) && (NULL != b); a = a->next, b = b->next ) {
+        CU_ASSERT( a->time == b->time );
+        CU_ASSERT( a->block_count == b->block_count );
+        CU_ASSERT( 0 == memcmp(a->block, b->block, a->block_count * sizeof(uint32_t)) );
+    }
+    CU_ASSERT( (NULL == a) && (NULL == b) );
+    for( a = s->absolute, b = l->absolute; (NULL != a) && (NULL != b); a = a->next, b = b->next ) {
+        CU_ASSERT( a->time == b->time );
+        CU_ASSERT( a->block_count == b->block_count );
+    }
+    CU_ASSERT( (NULL == a) && (NULL == b) );
+
+    /* And they evaluate the same way. */
+    for( t = 1499990000; t < 1500010000; t += 599 ) {
+        char *x = get_blocked_at_time( s, t );
+        char *y = get_blocked_at_time( l, t );
+
+        CU_ASSERT( ((NULL == x) && (NULL == y)) ||
+                   ((NULL != x) && (NULL != y) && (0 == strcmp(x, y))) );
+        CU_ASSERT( get_next_unixtime(s, t) == get_next_unixtime(l, t) );
+        if( NULL != x ) aker_free( x );
+        if( NULL != y ) aker_free( y );
+    }
+
+    destroy_schedule( l );
+    destroy_schedule( s );
+}
+
+void test_rejected()
+{
+    schedule_t *s, *l = NULL;
+    uint8_t buf[4096];
+    size_t len;
+    FILE *fh;
+
+    s = make_schedule();
+    CU_ASSERT_FATAL( NULL != s );
+    CU_ASSERT( 0 == schedule_image_write(IMAGE_FILE, s, sig_a, sizeof(sig_a)) );
+    destroy_schedule( s );
+
+    /* Missing, or built from other data. */
+    CU_ASSERT( -1 == schedule_image_load("_no_exist_", sig_a, sizeof(sig_a), &l) );
+    CU_ASSERT( -3 == schedule_image_load(IMAGE_FILE, sig_b, sizeof(sig_b), &l) );
+    CU_ASSERT( NULL == l );
+
+    fh = fopen( IMAGE_FILE, "rb" );
+    CU_ASSERT_FATAL( NULL != fh );
+    len = fread( buf, 1, sizeof(buf), fh );
+    fclose( fh );
+
+    /* A flipped body bit and a truncated file are both corrupt. */
+    buf[len - 3] ^= 0x01;
+    write_raw( IMAGE_FILE, buf, len );
+    CU_ASSERT( -4 == schedule_image_load(IMAGE_FILE, sig_a, sizeof(sig_a), &l) );
+    buf[len - 3] ^= 0x01;
+    write_raw( IMAGE_FILE, buf, len - 1 );
+    CU_ASSERT( -4 == schedule_image_load(IMAGE_FILE, sig_a, sizeof(sig_a), &l) );
+
+    /* A different format version is not trusted. */
+    buf[4] ^= 0x80;
+    write_raw( IMAGE_FILE, buf, len );
+    CU_ASSERT( -2 == schedule_image_load(IMAGE_FILE, sig_a, sizeof(sig_a), &l) );
+    buf[4] ^= 0x80;
+
+    write_raw( IMAGE_FILE, buf, 8 );
+    CU_ASSERT( -1 == schedule_image_load(IMAGE_FILE, sig_a, sizeof(sig_a), &l) );
+    CU_ASSERT( NULL == l );
+
+    /* Allocation failures don't leak. */
+    write_raw( IMAGE_FILE, buf, len );
+    malloc_fail = true;
+    malloc_failure_limit = 1;
+    CU_ASSERT( -5 == schedule_image_load(IMAGE_FILE, sig_a, sizeof(sig_a), &l) );
+    malloc_fail = false;
+    CU_ASSERT( NULL == l );
+
+    CU_ASSERT( 0 != schedule_image_write(IMAGE_FILE, NULL, sig_a, sizeof(sig_a)) );
+
+    remove( IMAGE_FILE );
+}
+
+void test_image_name()
+{
+    char *name = schedule_image_name( "/tmp/pcs.bin" );
+
+    CU_ASSERT_FATAL( NULL != name );
+    CU_ASSERT( 0 == strcmp("/tmp/pcs.bin.img", name) );
+    aker_free( name );
+    CU_ASSERT( NULL == schedule_image_name(NULL) );
+}
+
+void add_suites( CU_pSuite *suite )
+{
+    printf("--------Start of Test Cases Execution ---------\n");
+    *suite = CU_add_suite( "tests", NULL, NULL );
+    CU_add_test( *suite, "Test round trip", test_round_trip );
+    CU_add_test( *suite, "Test rejected images", test_rejected );
+    CU_add_test( *suite, "Test image name", test_image_name );
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main( void )
+{
+    unsigned rv = 1;
+    CU_pSuite suite = NULL;
+
+    if( CUE_SUCCESS == CU_initialize_registry() ) {
+        add_suites( &suite );
+
+        if( NULL != suite ) {
+            CU_basic_set_mode( CU_BRM_VERBOSE );
+            CU_basic_run_tests();
+            printf( "\n" );
+            CU_basic_show_failures( CU_get_failure_list() );
+            printf( "\n\n" );
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+
+    }
+
+    return rv;
+}
+
+int32_t get_max_mac_limit(void)
+{
+    return 2048;
+}
@@ -0,0 +1,429 @@
+/**
+ *  Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+
+#include <CUnit/Basic.h>
+
+#include "mem_wrapper.h"
+#include "../src/schedule_gen.h"
+#include "../src/schedule.h"
+#include "../src/decode.h"
+#include "../src/time.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define SAMPLES     300
+#define SUNDAY      1520121600      /* 2018-03-04 00:00:00 UTC */
+
+/*----------------------------------------------------------------------------*/
+/*                                   Tests                                    */
+/*----------------------------------------------------------------------------*/
+int32_t get_max_mac_limit( void )
+{
+    return 1000;
+}
+
+static schedule_t* generate( uint64_t seed, size_t weekly, size_t absolute,
+                             bool edges )
+{
+    schedule_gen_cfg_t cfg;
+    schedule_t *s = NULL;
+    uint8_t *data = NULL;
+    size_t len;
+
+    schedule_gen_defaults( &cfg );
+    cfg.seed = seed;
+    cfg.weekly = weekly;
+    cfg.absolute = absolute;
+    cfg.macs = 8;
+    cfg.block_max = 4;
+    cfg.overlap = 50;
+    cfg.absolute_start = 1520000000;      /* DST starts in this span. */
+    cfg.absolute_span = 14 * 24 * 3600;
+    cfg.time_zone = "America/New_York";
+    cfg.dst_edges = edges;
+    cfg.time_zero = edges;
+
+    len = schedule_gen( &cfg, &data );
+    CU_ASSERT( 0 < len );
+    CU_ASSERT( 0 == decode_schedule(len, data, &s) );
+    free( data );
+
+    return s;
+}
+
+static time_t sample( uint64_t *state )
+{
+    /* From a week before the absolute span to three weeks after it. */
+    *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return 1520000000 - 7 * 24 * 3600 + (time_t) ((*state >> 33) % (35 * 24 * 3600));
+}
+
+/* The reference answers come from walking the lists. */
+static bool listed_blocked( schedule_t *s, const char *mac, time_t t )
+{
+    schedule_index_t *x = s->index;
+    char *macs;
+    bool rv;
+
+    s->index = NULL;
+    macs = get_blocked_at_time( s, t );
+    s->index = x;
+
+    rv = (NULL != macs) && (NULL != strstr(macs, mac));
+    free( macs );
+
+    return rv;
+}
+
+static time_t listed_next_change( schedule_t *s, const char *mac, time_t t,
+                                  time_t horizon )
+{
+    schedule_index_t *x = s->index;
+    bool now = listed_blocked( s, mac, t );
+
+    while( t < horizon ) {
+        s->index = NULL;
+        t = get_next_transition( s, t );
+        s->index = x;
+        if( (t < horizon) && (now != listed_blocked(s, mac, t)) ) {
+            return t;
+        }
+    }
+
+    return INT_MAX;
+}
+
+static void check_lookups( schedule_t *s, uint64_t seed )
+{
+    schedule_index_t *x = s->index;
+    int i;
+
+    CU_ASSERT_FATAL( NULL != x );
+    for( i = 0; i < SAMPLES; i++ ) {
+        schedule_event_t *e;
+        time_t t, next, next_unix;
+
+        t = sample( &seed );
+        e = get_event_at_time( s, t );
+        next = get_next_transition( s, t );
+        next_unix = get_next_unixtime( s, t );
+
+        s->index = NULL;
+        CU_ASSERT( e == get_event_at_time(s, t) );
+        CU_ASSERT( next == get_next_transition(s, t) );
+        CU_ASSERT( next_unix == get_next_unixtime(s, t) );
+        s->index = x;
+    }
+}
+
+static void check_devices( schedule_t *s, uint64_t seed )
+{
+    time_t horizon = 1520000000 + 14 * 24 * 3600 + 2 * SECONDS_IN_A_WEEK;
+    int i;
+
+    for( i = 0; i < SAMPLES / 3; i++ ) {
+        const char *mac = s->macs[i % s->mac_count].mac;
+        time_t t, next, expected;
+        bool blocked;
+
+        t = sample( &seed );
+        CU_ASSERT( 0 == get_device_status(s, mac, t, &blocked, &next) );
+        CU_ASSERT( listed_blocked(s, mac, t) == blocked );
+
+        expected = listed_next_change( s, mac, t, horizon );
+        if( expected < horizon ) {
+            CU_ASSERT( expected == next );
+        } else {
+            /* Beyond the reference walk both may only differ by never. */
+            CU_ASSERT( horizon <= next );
+        }
+    }
+}
+
+void test_lookups()
+{
+    struct {
+        uint64_t seed;
+        size_t weekly;
+        size_t absolute;
+        bool edges;
+    } cases[] = {
+        { 1,  60, 20, true  },
+        { 2,  60, 20, false },
+        { 3,  40,  1, true  },
+        { 4,   0, 20, false },
+        { 5,  40,  0, true  },
+        { 6,   5,  3, false },
+    };
+    size_t i;
+
+    for( i = 0; i < sizeof(cases) / sizeof(cases[0]); i++ ) {
+        schedule_t *s;
+
+        s = generate( cases[i].seed, cases[i].weekly, cases[i].absolute,
+                      cases[i].edges );
+        CU_ASSERT_FATAL( NULL != s );
+        check_lookups( s, cases[i].seed );
+        check_devices( s, cases[i].seed );
+        destroy_schedule( s );
+    }
+}
+
+void test_pruned_lookups()
+{
+    uint64_t seeds[] = { 1, 2, 6 };
+    size_t i;
+
+    /* The index keeps its arrays and just starts further in, so it has to
+     * agree with the pruned lists at any time. */
+    for( i = 0; i < sizeof(seeds) / sizeof(seeds[0]); i++ ) {
+        schedule_t *s;
+
+        s = generate( seeds[i], 40, 20, (0 != (seeds[i] % 2)) );
+        CU_ASSERT_FATAL( NULL != s );
+        CU_ASSERT( 0 < prune_absolute_events(s, 1520000000 + 7 * 24 * 3600) );
+        CU_ASSERT_FATAL( NULL != s->index );
+        CU_ASSERT( 0 < s->index->absolute_first );
+        check_lookups( s, seeds[i] );
+        check_devices( s, seeds[i] );
+        destroy_schedule( s );
+    }
+}
+
+void test_find_mac()
+{
+    schedule_t *s;
+    schedule_event_t *e;
+    uint32_t index = 99;
+    time_t next;
+    bool blocked;
+
+    s = create_schedule();
+    create_mac_table( s, 3 );
+    set_mac_index( s, "11:22:33:44:55:aa", 17, 0 );
+    set_mac_index( s, "22:33:44:55:66:BB", 17, 1 );
+    set_mac_index( s, "11:22:33:44:55:AA", 17, 2 );
+
+    /* Blocks 0 twice, then 1 but with an invalid index so nothing. */
+    e = create_schedule_event( 2 );
+    e->time = 100;
+    e->block[0] = 0;
+    e->block[1] = 0;
+    insert_event( &s->weekly, e );
+    e = create_schedule_event( 2 );
+    e->time = 200;
+    e->block[0] = 1;
+    e->block[1] = 7;
+    insert_event( &s->weekly, e );
+
+    /* No index yet. */
+    CU_ASSERT( 0 != find_mac_index(s, "22:33:44:55:66:bb", &index) );
+    CU_ASSERT( -1 == get_device_status(s, "22:33:44:55:66:bb", 0, &blocked, &next) );
+
+    CU_ASSERT( 0 == finalize_schedule(s) );
+    CU_ASSERT( 0 == find_mac_index(s, "22:33:44:55:66:bb", &index) );
+    CU_ASSERT( 1 == index );
+    CU_ASSERT( 0 == find_mac_index(s, "11:22:33:44:55:AA", &index) );
+    CU_ASSERT( 0 == index );
+    CU_ASSERT( 0 != find_mac_index(s, "33:44:55:66:77:cc", &index) );
+    CU_ASSERT( -2 == get_device_status(s, "33:44:55:66:77:cc", 0, &blocked, &next) );
+    CU_ASSERT( -1 == get_device_status(s, NULL, 0, &blocked, &next) );
+
+    set_unix_time_zone( "UTC" );
+    CU_ASSERT( 0 == get_device_status(s, "11:22:33:44:55:aa", SUNDAY + 150, &blocked, &next) );
+    CU_ASSERT( true == blocked );
+    CU_ASSERT( SUNDAY + 200 == next );
+    CU_ASSERT( 0 == get_device_status(s, "22:33:44:55:66:bb", SUNDAY + 150, &blocked, &next) );
+    CU_ASSERT( false == blocked );
+    CU_ASSERT( INT_MAX == next );
+    CU_ASSERT( 0 == get_device_status(s, "11:22:33:44:55:aa", SUNDAY + 250, &blocked, &next) );
+    CU_ASSERT( false == blocked );
+    CU_ASSERT( SUNDAY + SECONDS_IN_A_WEEK + 100 == next );
+
+    destroy_schedule( s );
+}
+
+void test_no_memory()
+{
+    schedule_t *s;
+    schedule_event_t *e;
+
+    s = create_schedule();
+    create_mac_table( s, 1 );
+    set_mac_index( s, "11:22:33:44:55:aa", 17, 0 );
+    e = create_schedule_event( 1 );
+    e->time = 100;
+    e->block[0] = 0;
+    insert_event( &s->weekly, e );
+
+    malloc_fail = true;
+    malloc_failure_limit = 0;
+    CU_ASSERT( 0 != build_schedule_index(s) );
+    malloc_fail = false;
+    CU_ASSERT( NULL == s->index );
+
+    /* Lookups fall back to the lists. */
+    set_unix_time_zone( "UTC" );
+    CU_ASSERT( e == get_event_at_time(s, SUNDAY + 150) );
+
+    destroy_schedule( s );
+}
+
+/* The list has to stay linked in the array's order. */
+static void check_array( event_array_t *a, schedule_event_t *head )
+{
+    size_t i, count = event_array_count( a );
+
+    for( i = 0; i < count; i++, head = head->next ) {
+        CU_ASSERT_FATAL( NULL != head );
+        CU_ASSERT( head == event_array_get(a, i) );
+        if( 0 < i ) {
+            CU_ASSERT( event_array_get(a, i - 1)->time <= head->time );
+        }
+    }
+    CU_ASSERT( NULL == head );
+    CU_ASSERT( NULL == event_array_get(a, count) );
+}
+
+void test_event_array()
+{
+    schedule_event_t *head = NULL, *e, *first;
+    event_array_t a;
+    uint64_t state = 7;
+    size_t i, n;
+
+    CU_ASSERT( 0 != event_array_init(NULL, &head, 0) );
+    CU_ASSERT( 0 != event_array_init(&a, NULL, 0) );
+    CU_ASSERT( 0 != event_array_insert(NULL, NULL) );
+    CU_ASSERT( NULL == event_array_remove(NULL, 0) );
+
+    /* Starts empty and has to grow. */
+    CU_ASSERT_FATAL( 0 == event_array_init(&a, &head, 0) );
+    CU_ASSERT( 0 == event_array_count(&a) );
+    CU_ASSERT( 0 == event_array_lower_bound(&a, 100) );
+    CU_ASSERT( NULL == event_array_remove(&a, 0) );
+
+    for( i = 0; i < 500; i++ ) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        e = create_schedule_event( 0 );
+        e->time = (time_t) ((state >> 33) % 200) * 10;
+        CU_ASSERT( 0 == event_array_insert(&a, e) );
+        /* In front of the events already at that time. */
+        CU_ASSERT( e == event_array_get(&a, event_array_lower_bound(&a, e->time)) );
+    }
+    CU_ASSERT( 500 == event_array_count(&a) );
+    check_array( &a, head );
+
+    for( i = 0; i < 2010; i += 5 ) {
+        size_t lo = event_array_lower_bound( &a, (time_t) i );
+        size_t hi = event_array_upper_bound( &a, (time_t) i );
+
+        CU_ASSERT( lo <= hi );
+        CU_ASSERT( (0 == lo) || (event_array_get(&a, lo - 1)->time < (time_t) i) );
+        CU_ASSERT( (500 == lo) || (event_array_get(&a, lo)->time >= (time_t) i) );
+        CU_ASSERT( (0 == hi) || (event_array_get(&a, hi - 1)->time <= (time_t) i) );
+        CU_ASSERT( (500 == hi) || (event_array_get(&a, hi)->time > (time_t) i) );
+    }
+
+    /* Take out the head, the tail and events from all over. */
+    first = event_array_get( &a, 0 );
+    CU_ASSERT( first == event_array_remove(&a, 0) );
+    CU_ASSERT( NULL == first->next );
+    free( first );
+    free( event_array_remove(&a, event_array_count(&a) - 1) );
+    for( i = 0; i < 200; i++ ) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        n = (size_t) (state >> 33) % event_array_count( &a );
+        free( event_array_remove(&a, n) );
+    }
+    CU_ASSERT( 298 == event_array_count(&a) );
+    check_array( &a, head );
+    event_array_destroy( &a );
+
+    /* A new array over the list that is left. */
+    CU_ASSERT_FATAL( 0 == event_array_init(&a, &head, 1) );
+    CU_ASSERT( 298 == event_array_count(&a) );
+    check_array( &a, head );
+
+    e = create_schedule_event( 0 );
+    e->time = 0;
+    CU_ASSERT( 0 == event_array_insert(&a, e) );
+    CU_ASSERT( e == head );
+
+    /* The array is full, so the next insert has to grow it. */
+    e = create_schedule_event( 0 );
+    e->time = 3000;
+    malloc_fail = true;
+    malloc_failure_limit = 0;
+    CU_ASSERT( 0 != event_array_insert(&a, e) );
+    malloc_fail = false;
+    CU_ASSERT( NULL == e->next );
+    CU_ASSERT( 299 == event_array_count(&a) );
+    CU_ASSERT( 0 == event_array_insert(&a, e) );
+    CU_ASSERT( e == event_array_get(&a, 299) );
+    check_array( &a, head );
+    event_array_destroy( &a );
+
+    while( NULL != head ) {
+        e = head;
+        head = head->next;
+        free( e );
+    }
+}
+
+void add_suites( CU_pSuite *suite )
+{
+    printf("--------Start of Test Cases Execution ---------\n");
+    *suite = CU_add_suite( "tests", NULL, NULL );
+    CU_add_test( *suite, "Test lookups", test_lookups );
+    CU_add_test( *suite, "Test pruned lookups", test_pruned_lookups );
+    CU_add_test( *suite, "Test find mac", test_find_mac );
+    CU_add_test( *suite, "Test no memory", test_no_memory );
+    CU_add_test( *suite, "Test event array", test_event_array );
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main( void )
+{
+    unsigned rv = 1;
+    CU_pSuite suite = NULL;
+
+    if( CUE_SUCCESS == CU_initialize_registry() ) {
+        add_suites( &suite );
+
+        if( NULL != suite ) {
+            CU_basic_set_mode( CU_BRM_VERBOSE );
+            CU_basic_run_tests();
+            printf( "\n" );
+            CU_basic_show_failures( CU_get_failure_list() );
+            printf( "\n\n" );
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+
+    }
+
+    return rv;
+}
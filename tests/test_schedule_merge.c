@@ -0,0 +1,260 @@
+/**
+ *  Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+
+#include <CUnit/Basic.h>
+#include <msgpack.h>
+
+#include "mem_wrapper.h"
+#include "msgpack_fixtures.h"
+#include "../src/aker_mem.h"
+#include "../src/schedule.h"
+#include "../src/schedule_merge.h"
+#include "../src/decode.h"
+#include "../src/time.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define MAC_A       "11:22:33:44:55:aa"
+#define MAC_B       "22:33:44:55:66:bb"
+#define MAC_B_UPPER "22:33:44:55:66:BB"
+#define MAC_C       "33:44:55:66:77:cc"
+#define SUNDAY      (3 * 24 * 3600)     /* 1970-01-04 00:00 UTC */
+#define DAY         (24 * 3600)
+#define HOUR        3600
+#define AT(d, h)    (SUNDAY + (d) * DAY + (h) * HOUR)
+
+/*----------------------------------------------------------------------------*/
+/*                                   Mocks                                    */
+/*----------------------------------------------------------------------------*/
+int32_t get_max_mac_limit(void)
+{
+    return 2048;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                              Test Helpers                                  */
+/*----------------------------------------------------------------------------*/
+static bool blocked_is( schedule_merge_t *m, time_t t, const char *expected )
+{
+    char *macs = schedule_merge_blocked( m, t );
+    bool rv;
+
+    if( NULL == expected ) {
+        rv = (NULL == macs);
+    } else {
+        rv = (NULL != macs) && (0 == strcmp(macs, expected));
+    }
+    if( !rv ) {
+        printf( "\nat %ld: '%s', expected '%s'\n", (long) t,
+                (NULL == macs) ? "" : macs, (NULL == expected) ? "" : expected );
+    }
+    if( NULL != macs ) {
+        free( macs );
+    }
+
+    return rv;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                                   Tests                                    */
+/*----------------------------------------------------------------------------*/
+void test_union()
+{
+    schedule_merge_t m;
+    schedule_t *old;
+    char *kids;
+
+    schedule_merge_init( &m );
+    CU_ASSERT( INT_MAX == schedule_merge_next(&m) );
+    CU_ASSERT( blocked_is(&m, AT(1, 0), NULL) );
+
+    /* Main: A and B Monday 00:00 - 10:00.  Kids: C and B 05:00 - 12:00. */
+    CU_ASSERT( 0 == schedule_merge_swap(&m, NULL, make_weekly_schedule(MAC_A, MAC_B, 24, 34), &old) );
+    CU_ASSERT( 0 == schedule_merge_swap(&m, "kids", make_weekly_schedule(MAC_C, MAC_B_UPPER, 29, 36), &old) );
+    CU_ASSERT( NULL == old );
+    CU_ASSERT( 0 == schedule_merge_next(&m) );
+
+    /* Each address once, in the order the schedules list them. */
+    CU_ASSERT( blocked_is(&m, AT(1, 6), MAC_A " " MAC_B " " MAC_C) );
+    CU_ASSERT( AT(1, 10) == schedule_merge_next(&m) );
+
+    /* Only the main schedule has a transition due. */
+    CU_ASSERT_FATAL( 2 == m.count );
+    kids = m.src[1].blocked;
+    CU_ASSERT( blocked_is(&m, AT(1, 11), MAC_C " " MAC_B_UPPER) );
+    CU_ASSERT( kids == m.src[1].blocked );
+    CU_ASSERT( NULL == m.src[0].blocked );
+    CU_ASSERT( AT(1, 12) == schedule_merge_next(&m) );
+
+    /* The week wrapping around is looked at too. */
+    CU_ASSERT( blocked_is(&m, AT(1, 13), NULL) );
+    CU_ASSERT( AT(7, 0) == schedule_merge_next(&m) );
+
+    /* Time going backwards has everything looked at again. */
+    CU_ASSERT( blocked_is(&m, AT(1, 1), MAC_A " " MAC_B) );
+    CU_ASSERT( AT(1, 5) == schedule_merge_next(&m) );
+    CU_ASSERT( blocked_is(&m, AT(1, 5), MAC_A " " MAC_B " " MAC_C) );
+
+    schedule_merge_destroy( &m );
+    CU_ASSERT( 0 == m.count );
+}
+
+void test_swap()
+{
+    schedule_merge_t m;
+    schedule_t *primary, *a, *b, *old;
+
+    schedule_merge_init( &m );
+    primary = make_weekly_schedule( MAC_A, MAC_B, 24, 34 );
+    a = make_weekly_schedule( MAC_C, MAC_B, 29, 36 );
+    b = make_weekly_schedule( MAC_C, MAC_A, 0, 1 );
+    CU_ASSERT_FATAL( (NULL != primary) && (NULL != a) && (NULL != b) );
+
+    /* Removing what isn't there is not an error. */
+    CU_ASSERT( 0 == schedule_merge_swap(&m, "none", NULL, &old) );
+    CU_ASSERT( NULL == old );
+
+    /* Out of memory leaves the schedule with the caller. */
+    malloc_fail = true;
+    malloc_failure_limit = 0;
+    CU_ASSERT( -2 == schedule_merge_swap(&m, "b", b, &old) );
+    CU_ASSERT( -2 == schedule_merge_swap(&m, NULL, b, &old) );
+    malloc_fail = false;
+    CU_ASSERT( 0 == m.count );
+
+    CU_ASSERT( 0 == schedule_merge_swap(&m, "b", b, &old) );
+    CU_ASSERT( 0 == schedule_merge_swap(&m, "a", a, &old) );
+    CU_ASSERT( 0 == schedule_merge_swap(&m, NULL, primary, &old) );
+    CU_ASSERT_FATAL( 3 == m.count );
+    CU_ASSERT( NULL == m.src[0].name );
+    CU_ASSERT_STRING_EQUAL( "a", m.src[1].name );
+    CU_ASSERT_STRING_EQUAL( "b", m.src[2].name );
+
+    CU_ASSERT( primary == schedule_merge_get(&m, NULL) );
+    CU_ASSERT( a == schedule_merge_get(&m, "a") );
+    CU_ASSERT( b == schedule_merge_get(&m, "b") );
+    CU_ASSERT( NULL == schedule_merge_get(&m, "c") );
+
+    CU_ASSERT( blocked_is(&m, AT(1, 6), MAC_A " " MAC_B " " MAC_C) );
+    CU_ASSERT( !m.src[0].stale && !m.src[1].stale && !m.src[2].stale );
+
+    /* A named schedule only has itself looked at again... */
+    a = make_weekly_schedule( MAC_C, MAC_B, 40, 41 );
+    CU_ASSERT( 0 == schedule_merge_swap(&m, "a", a, &old) );
+    CU_ASSERT( NULL != old );
+    destroy_schedule( old );
+    CU_ASSERT( !m.src[0].stale && m.src[1].stale && !m.src[2].stale );
+    CU_ASSERT( blocked_is(&m, AT(1, 6), MAC_A " " MAC_B) );
+
+    /* ... but the main one's time zone changes them all. */
+    primary = make_weekly_schedule( MAC_A, MAC_B, 0, 1 );
+    CU_ASSERT( 0 == schedule_merge_swap(&m, NULL, primary, &old) );
+    destroy_schedule( old );
+    CU_ASSERT( m.src[0].stale && m.src[1].stale && m.src[2].stale );
+    CU_ASSERT( blocked_is(&m, AT(1, 6), NULL) );
+    CU_ASSERT( blocked_is(&m, AT(1, 16), MAC_C " " MAC_B) );
+
+    CU_ASSERT( 0 == schedule_merge_swap(&m, "a", NULL, &old) );
+    CU_ASSERT( a == old );
+    destroy_schedule( old );
+    CU_ASSERT( 2 == m.count );
+    CU_ASSERT( NULL == schedule_merge_get(&m, "a") );
+    CU_ASSERT( b == schedule_merge_get(&m, "b") );
+    CU_ASSERT( blocked_is(&m, AT(1, 16), NULL) );
+    CU_ASSERT( blocked_is(&m, AT(7, 0), MAC_A " " MAC_B " " MAC_C) );
+
+    schedule_merge_destroy( &m );
+}
+
+void test_device_status()
+{
+    schedule_merge_t m;
+    schedule_t *old;
+    bool blocked;
+    time_t next;
+
+    schedule_merge_init( &m );
+    CU_ASSERT( -1 == schedule_merge_device_status(&m, MAC_A, AT(1, 1), &blocked, &next) );
+
+    CU_ASSERT( 0 == schedule_merge_swap(&m, NULL, make_weekly_schedule(MAC_A, MAC_B, 24, 34), &old) );
+    CU_ASSERT( 0 == schedule_merge_swap(&m, "kids", make_weekly_schedule(MAC_C, MAC_A, 29, 36), &old) );
+
+    /* Main lets A go at 10:00, but the kids schedule holds it to 12:00. */
+    CU_ASSERT( 0 == schedule_merge_device_status(&m, MAC_A, AT(1, 1), &blocked, &next) );
+    CU_ASSERT( blocked );
+    CU_ASSERT( AT(1, 12) == next );
+
+    CU_ASSERT( 0 == schedule_merge_device_status(&m, MAC_A, AT(1, 13), &blocked, &next) );
+    CU_ASSERT( !blocked );
+    CU_ASSERT( AT(8, 0) == next );
+
+    /* B is only in the main schedule. */
+    CU_ASSERT( 0 == schedule_merge_device_status(&m, MAC_B, AT(1, 1), &blocked, &next) );
+    CU_ASSERT( blocked );
+    CU_ASSERT( AT(1, 10) == next );
+
+    CU_ASSERT( 0 == schedule_merge_device_status(&m, MAC_C, AT(1, 1), &blocked, &next) );
+    CU_ASSERT( !blocked );
+    CU_ASSERT( AT(1, 5) == next );
+
+    CU_ASSERT( -2 == schedule_merge_device_status(&m, "44:55:66:77:88:99", AT(1, 1), &blocked, &next) );
+
+    schedule_merge_destroy( &m );
+}
+
+void add_suites( CU_pSuite *suite )
+{
+    printf("--------Start of Test Cases Execution ---------\n");
+    *suite = CU_add_suite( "tests", NULL, NULL );
+    CU_add_test( *suite, "Test union", test_union );
+    CU_add_test( *suite, "Test swap", test_swap );
+    CU_add_test( *suite, "Test device status", test_device_status );
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main( void )
+{
+    unsigned rv = 1;
+    CU_pSuite suite = NULL;
+
+    set_unix_time_zone( "UTC" );
+
+    if( CUE_SUCCESS == CU_initialize_registry() ) {
+        add_suites( &suite );
+
+        if( NULL != suite ) {
+            CU_basic_set_mode( CU_BRM_VERBOSE );
+            CU_basic_run_tests();
+            printf( "\n" );
+            CU_basic_show_failures( CU_get_failure_list() );
+            printf( "\n\n" );
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+
+    }
+
+    return rv;
+}
@@ -0,0 +1,550 @@
+/**
+ *  Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <msgpack.h>
+
+#include <CUnit/Basic.h>
+
+#include "mem_wrapper.h"
+#include "msgpack_fixtures.h"
+#include "../src/aker_mem.h"
+#include "../src/schedule.h"
+#include "../src/decode.h"
+#include "../src/encode.h"
+#include "../src/schedule_patch.h"
+#include "../src/time.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define NO_INDEXES  -1
+#define MAC_A       "11:22:33:44:55:aa"
+#define MAC_B       "22:33:44:55:66:bb"
+#define MAC_C       "33:44:55:66:77:cc"
+#define MAC_D       "44:55:66:77:88:dd"
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+typedef struct {
+    const char *op;
+    const char *time_key;       /* "time", "unix_time" or NULL */
+    int64_t time;
+    int index_count;            /* NO_INDEXES leaves the key out */
+    uint32_t indexes[4];
+    const char *mac;
+    const char *time_zone;
+} op_desc_t;
+
+/*----------------------------------------------------------------------------*/
+/*                                   Mocks                                    */
+/*----------------------------------------------------------------------------*/
+int32_t get_max_mac_limit(void)
+{
+    return 2048;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                              Test Helpers                                  */
+/*----------------------------------------------------------------------------*/
+/* Three MACs, three weekly events and one absolute event. */
+static schedule_t* make_schedule( void )
+{
+    msgpack_sbuffer sbuf;
+    msgpack_packer pk;
+    schedule_t *s = NULL;
+    uint8_t *data;
+    size_t len;
+
+    msgpack_sbuffer_init( &sbuf );
+    msgpack_packer_init( &pk, &sbuf, msgpack_sbuffer_write );
+
+    msgpack_pack_map( &pk, 4 );
+    pack_str( &pk, "time_zone" );
+    pack_str( &pk, "UTC" );
+
+    pack_str( &pk, "macs" );
+    msgpack_pack_array( &pk, 3 );
+    pack_str( &pk, MAC_A );
+    pack_str( &pk, MAC_B );
+    pack_str( &pk, MAC_C );
+
+    pack_str( &pk, "weekly" );
+    msgpack_pack_array( &pk, 3 );
+    msgpack_pack_map( &pk, 2 );
+    pack_str( &pk, "time" );        msgpack_pack_int( &pk, 10 );
+    pack_str( &pk, "indexes" );     msgpack_pack_array( &pk, 2 );
+    msgpack_pack_int( &pk, 0 );     msgpack_pack_int( &pk, 1 );
+    msgpack_pack_map( &pk, 2 );
+    pack_str( &pk, "time" );        msgpack_pack_int( &pk, 20 );
+    pack_str( &pk, "indexes" );     msgpack_pack_array( &pk, 1 );
+    msgpack_pack_int( &pk, 2 );
+    msgpack_pack_map( &pk, 2 );
+    pack_str( &pk, "time" );        msgpack_pack_int( &pk, 30 );
+    pack_str( &pk, "indexes" );     msgpack_pack_array( &pk, 0 );
+
+    pack_str( &pk, "absolute" );
+    msgpack_pack_array( &pk, 1 );
+    msgpack_pack_map( &pk, 2 );
+    pack_str( &pk, "unix_time" );   msgpack_pack_int( &pk, 1520121600 );
+    pack_str( &pk, "indexes" );     msgpack_pack_array( &pk, 1 );
+    msgpack_pack_int( &pk, 1 );
+
+    len = to_buffer( &sbuf, &data );
+    CU_ASSERT( 0 == decode_schedule_data(len, data, &s) );
+    free( data );
+
+    return s;
+}
+
+static size_t make_patch( const char *base, const op_desc_t *ops, size_t count,
+                          uint8_t **data )
+{
+    msgpack_sbuffer sbuf;
+    msgpack_packer pk;
+    size_t i;
+
+    msgpack_sbuffer_init( &sbuf );
+    msgpack_packer_init( &pk, &sbuf, msgpack_sbuffer_write );
+
+    msgpack_pack_map( &pk, (NULL != base) ? 2 : 1 );
+    if( NULL != base ) {
+        pack_str( &pk, "base" );
+        pack_str( &pk, base );
+    }
+
+    pack_str( &pk, "ops" );
+    msgpack_pack_array( &pk, count );
+    for( i = 0; i < count; i++ ) {
+        const op_desc_t *o = &ops[i];
+        int j;
+
+        msgpack_pack_map( &pk, 1 + ((NULL != o->time_key) ? 1 : 0) +
+                               ((NO_INDEXES != o->index_count) ? 1 : 0) +
+                               ((NULL != o->mac) ? 1 : 0) +
+                               ((NULL != o->time_zone) ? 1 : 0) );
+        pack_str( &pk, "op" );
+        pack_str( &pk, o->op );
+        if( NULL != o->time_key ) {
+            pack_str( &pk, o->time_key );
+            msgpack_pack_int64( &pk, o->time );
+        }
+        if( NO_INDEXES != o->index_count ) {
+            pack_str( &pk, "indexes" );
+            msgpack_pack_array( &pk, o->index_count );
+            for( j = 0; j < o->index_count; j++ ) {
+                msgpack_pack_uint32( &pk, o->indexes[j] );
+            }
+        }
+        if( NULL != o->mac ) {
+            pack_str( &pk, "mac" );
+            pack_str( &pk, o->mac );
+        }
+        if( NULL != o->time_zone ) {
+            pack_str( &pk, "time_zone" );
+            pack_str( &pk, o->time_zone );
+        }
+    }
+
+    return to_buffer( &sbuf, data );
+}
+
+/* Decodes a patch and applies it to a copy of s. */
+static int patch( schedule_t *s, const op_desc_t *ops, size_t count,
+                  schedule_t **out )
+{
+    schedule_patch_t *p = NULL;
+    uint8_t *data;
+    size_t len;
+    int rv;
+
+    *out = NULL;
+    len = make_patch( "abc", ops, count, &data );
+    rv = decode_schedule_patch( len, data, &p );
+    free( data );
+    if( 0 != rv ) {
+        return 100 + rv;
+    }
+
+    *out = copy_schedule( s );
+    CU_ASSERT_FATAL( NULL != *out );
+    rv = apply_schedule_patch( *out, p );
+    destroy_schedule_patch( p );
+
+    if( 0 != rv ) {
+        destroy_schedule( *out );
+        *out = NULL;
+    }
+
+    return rv;
+}
+
+static schedule_event_t* find( schedule_event_t *head, time_t t )
+{
+    for( ; NULL != head; head = head->next ) {
+        if( t == head->time ) {
+            return head;
+        }
+    }
+    return NULL;
+}
+
+static bool same_list( schedule_event_t *a, schedule_event_t *b )
+{
+    /* Skip the copy of last week's final event in front. */
+    while( (NULL != a) && (a->time < 0) ) a = a->next;
+    while( (NULL != b) && (b->time < 0) ) b = b->next;
+
+    for( ; (NULL != a) && (NULL != b); a = a->next, b = b->next ) {
+        if( (a->time != b->time) || (a->block_count != b->block_count) ||
+            (0 != memcmp(a->block, b->block, a->block_count * sizeof(uint32_t))) )
+        {
+            return false;
+        }
+    }
+
+    return (NULL == a) && (NULL == b);
+}
+
+static bool same_schedule( schedule_t *a, schedule_t *b )
+{
+    return (a->mac_count == b->mac_count) &&
+           (0 == memcmp(a->macs, b->macs, a->mac_count * sizeof(mac_address))) &&
+           (0 == strcmp(a->time_zone, b->time_zone)) &&
+           same_list(a->weekly, b->weekly) &&
+           same_list(a->absolute, b->absolute);
+}
+
+/*----------------------------------------------------------------------------*/
+/*                                   Tests                                    */
+/*----------------------------------------------------------------------------*/
+void test_copy_encode()
+{
+    schedule_t *s, *c, *d = NULL;
+    uint8_t *data = NULL;
+    size_t len;
+
+    CU_ASSERT( NULL == copy_schedule(NULL) );
+    CU_ASSERT( 0 == encode_schedule(NULL, &data) );
+
+    s = make_schedule();
+    CU_ASSERT_FATAL( NULL != s );
+    CU_ASSERT_FATAL( NULL != s->weekly );
+    CU_ASSERT( s->weekly->time < 0 );
+
+    /* The copy is unfinalized: no index, no copy of last week's event. */
+    c = copy_schedule( s );
+    CU_ASSERT_FATAL( NULL != c );
+    CU_ASSERT( NULL == c->index );
+    CU_ASSERT( 10 == c->weekly->time );
+    CU_ASSERT( same_schedule(s, c) );
+
+    /* What is encoded decodes back to the same schedule. */
+    len = encode_schedule( c, &data );
+    CU_ASSERT_FATAL( 0 < len );
+    CU_ASSERT( 0 == decode_schedule_data(len, data, &d) );
+    CU_ASSERT_FATAL( NULL != d );
+    CU_ASSERT( same_schedule(s, d) );
+    aker_free( data );
+    destroy_schedule( d );
+
+    /* Encoding the finalized schedule leaves the extra event out too. */
+    len = encode_schedule( s, &data );
+    CU_ASSERT_FATAL( 0 < len );
+    CU_ASSERT( 0 == decode_schedule_data(len, data, &d) );
+    CU_ASSERT_FATAL( NULL != d );
+    CU_ASSERT( same_schedule(s, d) );
+    aker_free( data );
+    destroy_schedule( d );
+
+    destroy_schedule( c );
+
+    malloc_fail = true;
+    malloc_failure_limit = 1;
+    CU_ASSERT( NULL == copy_schedule(s) );
+    malloc_fail = false;
+
+    destroy_schedule( s );
+}
+
+void test_decode_patch()
+{
+    struct {
+        const char *base;
+        op_desc_t ops[2];
+        size_t count;
+        int rv;
+    } tests[] = {
+        { "abc", { { "add_event", "time", 40, 1, { 0 }, NULL, NULL } }, 1, 0 },
+        { "abc", { { "add_event", "unix_time", 1520121700, 0, { 0 }, NULL, NULL } }, 1, 0 },
+        { "abc", { { "remove_event", "time", 10, NO_INDEXES, { 0 }, NULL, NULL },
+                   { "add_mac", NULL, 0, NO_INDEXES, { 0 }, MAC_D, NULL } }, 2, 0 },
+        { "abc", { { "remove_mac", NULL, 0, NO_INDEXES, { 0 }, MAC_A, NULL } }, 1, 0 },
+        { "abc", { { "set_time_zone", NULL, 0, NO_INDEXES, { 0 }, NULL, "PST8PDT" } }, 1, 0 },
+
+        /* No base or no operations. */
+        { NULL,  { { "add_mac", NULL, 0, NO_INDEXES, { 0 }, MAC_D, NULL } }, 1, -2 },
+        { "abc", { { NULL } }, 0, -2 },
+
+        /* Operations missing what they need, or with too much. */
+        { "abc", { { "add_event", "time", 40, NO_INDEXES, { 0 }, NULL, NULL } }, 1, -2 },
+        { "abc", { { "add_event", NULL, 0, 1, { 0 }, NULL, NULL } }, 1, -2 },
+        { "abc", { { "add_event", "time", 604800, 1, { 0 }, NULL, NULL } }, 1, -2 },
+        { "abc", { { "add_event", "time", -1, 1, { 0 }, NULL, NULL } }, 1, -2 },
+        { "abc", { { "add_event", "unix_time", 0x80000000LL, 1, { 0 }, NULL, NULL } }, 1, -2 },
+        { "abc", { { "add_mac", NULL, 0, NO_INDEXES, { 0 }, NULL, NULL } }, 1, -2 },
+        { "abc", { { "add_mac", NULL, 0, NO_INDEXES, { 0 }, MAC_D ":ee", NULL } }, 1, -2 },
+        { "abc", { { "set_time_zone", NULL, 0, NO_INDEXES, { 0 }, NULL, "" } }, 1, -2 },
+        { "abc", { { "rename_mac", NULL, 0, NO_INDEXES, { 0 }, MAC_D, NULL } }, 1, -2 },
+    };
+    schedule_patch_t *p = NULL;
+    uint8_t not_a_map[] = { 0x91, 0x01 };
+    size_t i;
+
+    CU_ASSERT( -1 == decode_schedule_patch(0, not_a_map, &p) );
+    CU_ASSERT( -1 == decode_schedule_patch(sizeof(not_a_map), NULL, &p) );
+    CU_ASSERT( -1 == decode_schedule_patch(sizeof(not_a_map), not_a_map, NULL) );
+    CU_ASSERT( -2 == decode_schedule_patch(sizeof(not_a_map), not_a_map, &p) );
+    CU_ASSERT( NULL == p );
+
+    for( i = 0; i < sizeof(tests)/sizeof(tests[0]); i++ ) {
+        uint8_t *data;
+        size_t len;
+        int rv;
+
+        p = NULL;
+        len = make_patch( tests[i].base, tests[i].ops, tests[i].count, &data );
+        rv = decode_schedule_patch( len, data, &p );
+        if( tests[i].rv != rv ) {
+            printf( "\nTest: %zu Expected: %d, Got: %d\n", i, tests[i].rv, rv );
+        }
+        CU_ASSERT( tests[i].rv == rv );
+        if( 0 == rv ) {
+            CU_ASSERT_FATAL( NULL != p );
+            CU_ASSERT_STRING_EQUAL( "abc", p->base );
+            CU_ASSERT( tests[i].count == p->op_count );
+        } else {
+            CU_ASSERT( NULL == p );
+        }
+        destroy_schedule_patch( p );
+        free( data );
+    }
+
+    destroy_schedule_patch( NULL );
+}
+
+void test_apply_events()
+{
+    op_desc_t ops[] = {
+        /* Replaces the event at 20, adds one at 40 and drops the one at 30. */
+        { "add_event", "time", 20, 2, { 1, 2 }, NULL, NULL },
+        { "add_event", "time", 40, 1, { 0 }, NULL, NULL },
+        { "remove_event", "time", 30, NO_INDEXES, { 0 }, NULL, NULL },
+        { "add_event", "unix_time", 1520121700, 0, { 0 }, NULL, NULL },
+        { "set_time_zone", NULL, 0, NO_INDEXES, { 0 }, NULL, "PST8PDT" },
+    };
+    schedule_event_t *e;
+    schedule_t *s, *n;
+
+    s = make_schedule();
+    CU_ASSERT_FATAL( NULL != s );
+
+    CU_ASSERT( 0 == patch(s, ops, sizeof(ops)/sizeof(ops[0]), &n) );
+    CU_ASSERT_FATAL( NULL != n );
+
+    /* Finalized again: indexed, with last week's final event in front. */
+    CU_ASSERT( NULL != n->index );
+    CU_ASSERT( 40 - SECONDS_IN_A_WEEK == n->weekly->time );
+
+    e = find( n->weekly, 20 );
+    CU_ASSERT_FATAL( NULL != e );
+    CU_ASSERT( (2 == e->block_count) && (1 == e->block[0]) && (2 == e->block[1]) );
+    CU_ASSERT( NULL != find(n->weekly, 10) );
+    CU_ASSERT( NULL != find(n->weekly, 40) );
+    CU_ASSERT( NULL == find(n->weekly, 30) );
+    CU_ASSERT( NULL != find(n->absolute, 1520121600) );
+    CU_ASSERT( NULL != find(n->absolute, 1520121700) );
+    CU_ASSERT_STRING_EQUAL( "PST8PDT", n->time_zone );
+
+    /* The original is untouched. */
+    CU_ASSERT( NULL != find(s->weekly, 30) );
+    CU_ASSERT( 1 == find(s->weekly, 20)->block_count );
+    CU_ASSERT_STRING_EQUAL( "UTC", s->time_zone );
+
+    /* A finalized schedule can't be patched again. */
+    {
+        schedule_patch_t p = { "abc", 0, NULL };
+        CU_ASSERT( -1 == apply_schedule_patch(n, &p) );
+        CU_ASSERT( -1 == apply_schedule_patch(NULL, &p) );
+        CU_ASSERT( -1 == apply_schedule_patch(n, NULL) );
+    }
+
+    destroy_schedule( n );
+    destroy_schedule( s );
+}
+
+void test_apply_macs()
+{
+    op_desc_t ops[] = {
+        { "add_mac", NULL, 0, NO_INDEXES, { 0 }, MAC_D, NULL },
+        { "add_mac", NULL, 0, NO_INDEXES, { 0 }, "11:22:33:44:55:AA", NULL },
+        { "add_event", "time", 40, 2, { 0, 3 }, NULL, NULL },
+        { "remove_mac", NULL, 0, NO_INDEXES, { 0 }, MAC_B, NULL },
+    };
+    schedule_event_t *e;
+    schedule_t *s, *n;
+
+    s = make_schedule();
+    CU_ASSERT_FATAL( NULL != s );
+
+    CU_ASSERT( 0 == patch(s, ops, sizeof(ops)/sizeof(ops[0]), &n) );
+    CU_ASSERT_FATAL( NULL != n );
+
+    /* MAC_A was already there; MAC_D got index 3 and moved down to 2. */
+    CU_ASSERT_FATAL( 3 == n->mac_count );
+    CU_ASSERT_STRING_EQUAL( MAC_A, n->macs[0].mac );
+    CU_ASSERT_STRING_EQUAL( MAC_C, n->macs[1].mac );
+    CU_ASSERT_STRING_EQUAL( MAC_D, n->macs[2].mac );
+
+    e = find( n->weekly, 10 );
+    CU_ASSERT_FATAL( NULL != e );
+    CU_ASSERT( (1 == e->block_count) && (0 == e->block[0]) );
+    e = find( n->weekly, 20 );
+    CU_ASSERT_FATAL( NULL != e );
+    CU_ASSERT( (1 == e->block_count) && (1 == e->block[0]) );
+    e = find( n->weekly, 40 );
+    CU_ASSERT_FATAL( NULL != e );
+    CU_ASSERT( (2 == e->block_count) && (0 == e->block[0]) && (2 == e->block[1]) );
+    e = find( n->absolute, 1520121600 );
+    CU_ASSERT_FATAL( NULL != e );
+    CU_ASSERT( 0 == e->block_count );
+
+    destroy_schedule( n );
+    destroy_schedule( s );
+}
+
+void test_apply_errors()
+{
+    struct {
+        op_desc_t op;
+        int rv;
+    } tests[] = {
+        { { "remove_event", "time", 11, NO_INDEXES, { 0 }, NULL, NULL }, -2 },
+        { { "remove_event", "unix_time", 10, NO_INDEXES, { 0 }, NULL, NULL }, -2 },
+        { { "remove_mac", NULL, 0, NO_INDEXES, { 0 }, MAC_D, NULL }, -2 },
+        { { "add_event", "time", 40, 1, { 3 }, NULL, NULL }, -2 },
+        { { "add_mac", NULL, 0, NO_INDEXES, { 0 }, "not-a-mac", NULL }, -2 },
+    };
+    op_desc_t empty[] = {
+        { "remove_event", "time", 10, NO_INDEXES, { 0 }, NULL, NULL },
+        { "remove_event", "time", 20, NO_INDEXES, { 0 }, NULL, NULL },
+        { "remove_event", "time", 30, NO_INDEXES, { 0 }, NULL, NULL },
+        { "remove_event", "unix_time", 1520121600, NO_INDEXES, { 0 }, NULL, NULL },
+    };
+    op_desc_t no_macs[] = {
+        { "remove_mac", NULL, 0, NO_INDEXES, { 0 }, MAC_A, NULL },
+        { "remove_mac", NULL, 0, NO_INDEXES, { 0 }, MAC_B, NULL },
+        { "remove_mac", NULL, 0, NO_INDEXES, { 0 }, MAC_C, NULL },
+    };
+    schedule_t *s, *n;
+    size_t i;
+
+    s = make_schedule();
+    CU_ASSERT_FATAL( NULL != s );
+
+    for( i = 0; i < sizeof(tests)/sizeof(tests[0]); i++ ) {
+        int rv = patch( s, &tests[i].op, 1, &n );
+
+        if( tests[i].rv != rv ) {
+            printf( "\nTest: %zu Expected: %d, Got: %d\n", i, tests[i].rv, rv );
+        }
+        CU_ASSERT( tests[i].rv == rv );
+        CU_ASSERT( NULL == n );
+    }
+
+    /* A schedule needs events and MACs, as when it is uploaded. */
+    CU_ASSERT( -2 == patch(s, empty, sizeof(empty)/sizeof(empty[0]), &n) );
+    CU_ASSERT( -2 == patch(s, no_macs, sizeof(no_macs)/sizeof(no_macs[0]), &n) );
+
+    /* Allocation failures while applying. */
+    {
+        op_desc_t grow[] = {
+            { "add_mac", NULL, 0, NO_INDEXES, { 0 }, MAC_D, NULL },
+        };
+        schedule_patch_t *p = NULL;
+        uint8_t *data;
+        size_t len;
+
+        len = make_patch( "abc", grow, 1, &data );
+        CU_ASSERT( 0 == decode_schedule_patch(len, data, &p) );
+        free( data );
+
+        n = copy_schedule( s );
+        CU_ASSERT_FATAL( NULL != n );
+        malloc_fail = true;
+        malloc_failure_limit = 1;
+        CU_ASSERT( -3 == apply_schedule_patch(n, p) );
+        malloc_fail = false;
+        CU_ASSERT( 3 == n->mac_count );
+        destroy_schedule( n );
+
+        destroy_schedule_patch( p );
+    }
+
+    destroy_schedule( s );
+}
+
+void add_suites( CU_pSuite *suite )
+{
+    printf("--------Start of Test Cases Execution ---------\n");
+    *suite = CU_add_suite( "tests", NULL, NULL );
+    CU_add_test( *suite, "Test copy and encode", test_copy_encode );
+    CU_add_test( *suite, "Test decode patch", test_decode_patch );
+    CU_add_test( *suite, "Test apply events", test_apply_events );
+    CU_add_test( *suite, "Test apply MACs", test_apply_macs );
+    CU_add_test( *suite, "Test apply errors", test_apply_errors );
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main( void )
+{
+    unsigned rv = 1;
+    CU_pSuite suite = NULL;
+
+    if( CUE_SUCCESS == CU_initialize_registry() ) {
+        add_suites( &suite );
+
+        if( NULL != suite ) {
+            CU_basic_set_mode( CU_BRM_VERBOSE );
+            CU_basic_run_tests();
+            printf( "\n" );
+            CU_basic_show_failures( CU_get_failure_list() );
+            printf( "\n\n" );
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+
+    }
+
+    return rv;
+}
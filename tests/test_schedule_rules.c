@@ -0,0 +1,405 @@
+/**
+ *  Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <CUnit/Basic.h>
+#include <msgpack.h>
+
+#include "mem_wrapper.h"
+#include "msgpack_fixtures.h"
+#include "../src/aker_mem.h"
+#include "../src/schedule.h"
+#include "../src/schedule_rules.h"
+#include "../src/decode.h"
+#include "../src/time.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define MAC_A       "11:22:33:44:55:aa"
+#define MAC_B       "22:33:44:55:66:bb"
+#define SUNDAY      (3 * 24 * 3600)     /* 1970-01-04 00:00 UTC */
+#define DAY         SECONDS_IN_A_DAY
+#define HOUR        3600
+#define AT(d, h)    (SUNDAY + (d) * DAY + (h) * HOUR)
+#define NO_DAYS     -1                  /* Leave the day mask out. */
+
+/*----------------------------------------------------------------------------*/
+/*                                   Mocks                                    */
+/*----------------------------------------------------------------------------*/
+int32_t get_max_mac_limit(void)
+{
+    return 2048;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                              Test Helpers                                  */
+/*----------------------------------------------------------------------------*/
+typedef struct {
+    int days;
+    int start;
+    int end;
+    int index;
+} test_rule_t;
+
+static void pack_event( msgpack_packer *pk, int time, int index )
+{
+    msgpack_pack_map( pk, 2 );
+    pack_str( pk, "time" );
+    msgpack_pack_int( pk, time );
+    pack_str( pk, "indexes" );
+    msgpack_pack_array( pk, (0 <= index) ? 1 : 0 );
+    if( 0 <= index ) {
+        msgpack_pack_int( pk, index );
+    }
+}
+
+/**
+ *  Decodes a schedule of MAC_A and MAC_B with the rules and, if weekly is
+ *  set, a weekly list blocking MAC_B from Saturday 20:00 to Sunday 08:00.
+ */
+static int decode_rules( const test_rule_t *rules, size_t count, bool weekly,
+                         schedule_t **s, size_t *len )
+{
+    msgpack_sbuffer sbuf;
+    msgpack_packer pk;
+    size_t i;
+    int rv;
+
+    msgpack_sbuffer_init( &sbuf );
+    msgpack_packer_init( &pk, &sbuf, msgpack_sbuffer_write );
+
+    msgpack_pack_map( &pk, 2 + (weekly ? 1 : 0) + ((0 < count) ? 1 : 0) );
+    pack_str( &pk, "time_zone" );
+    pack_str( &pk, "UTC" );
+    pack_str( &pk, "macs" );
+    msgpack_pack_array( &pk, 2 );
+    pack_str( &pk, MAC_A );
+    pack_str( &pk, MAC_B );
+
+    if( weekly ) {
+        pack_str( &pk, "weekly" );
+        msgpack_pack_array( &pk, 2 );
+        pack_event( &pk, 8 * HOUR, -1 );
+        pack_event( &pk, 6 * DAY + 20 * HOUR, 1 );
+    }
+
+    if( 0 < count ) {
+        pack_str( &pk, "rules" );
+        msgpack_pack_array( &pk, count );
+    }
+    for( i = 0; i < count; i++ ) {
+        msgpack_pack_map( &pk, (NO_DAYS == rules[i].days) ? 3 : 4 );
+        if( NO_DAYS != rules[i].days ) {
+            pack_str( &pk, "days" );
+            msgpack_pack_int( &pk, rules[i].days );
+        }
+        pack_str( &pk, "start" );
+        msgpack_pack_int( &pk, rules[i].start );
+        pack_str( &pk, "end" );
+        msgpack_pack_int( &pk, rules[i].end );
+        pack_str( &pk, "indexes" );
+        msgpack_pack_array( &pk, 1 );
+        msgpack_pack_int( &pk, rules[i].index );
+    }
+
+    if( NULL != len ) {
+        *len = sbuf.size;
+    }
+    *s = NULL;
+    rv = decode_schedule( sbuf.size, (uint8_t*) sbuf.data, s );
+    msgpack_sbuffer_destroy( &sbuf );
+
+    return rv;
+}
+
+static bool blocked_is( schedule_t *s, time_t t, const char *expected )
+{
+    char *macs = get_blocked_at_time( s, t );
+    bool rv;
+
+    if( NULL == expected ) {
+        rv = (NULL == macs);
+    } else {
+        rv = (NULL != macs) && (0 == strcmp(macs, expected));
+    }
+    if( !rv ) {
+        printf( "\nat %ld: '%s', expected '%s'\n", (long) t,
+                (NULL == macs) ? "" : macs, (NULL == expected) ? "" : expected );
+    }
+    if( NULL != macs ) {
+        free( macs );
+    }
+
+    return rv;
+}
+
+static size_t count_events( schedule_event_t *e )
+{
+    size_t n = 0;
+
+    for( ; NULL != e; e = e->next ) {
+        n++;
+    }
+
+    return n;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                                   Tests                                    */
+/*----------------------------------------------------------------------------*/
+void test_school_nights()
+{
+    /* 21:00 - 07:00, Sunday to Thursday nights. */
+    test_rule_t rules[] = { { 0x1f, 21 * HOUR, 7 * HOUR, 0 } };
+    schedule_t *s;
+    int d;
+
+    CU_ASSERT_FATAL( 0 == decode_rules(rules, 1, false, &s, NULL) );
+
+    /* Ten transitions, plus the copy finalize_schedule() puts in front. */
+    CU_ASSERT( 11 == count_events(s->weekly) );
+
+    for( d = 0; d < 7; d++ ) {
+        bool night = (d < 5);
+        bool morning = (0 < d) && (d < 6);
+
+        CU_ASSERT( blocked_is(s, AT(d, 12), NULL) );
+        CU_ASSERT( blocked_is(s, AT(d, 20) + 3599, NULL) );
+        CU_ASSERT( blocked_is(s, AT(d, 21), night ? MAC_A : NULL) );
+        CU_ASSERT( blocked_is(s, AT(d, 23), night ? MAC_A : NULL) );
+        CU_ASSERT( blocked_is(s, AT(d, 6) + 3599, morning ? MAC_A : NULL) );
+        CU_ASSERT( blocked_is(s, AT(d, 7), NULL) );
+    }
+
+    /* And the next week the same. */
+    CU_ASSERT( blocked_is(s, AT(7, 22), MAC_A) );
+    CU_ASSERT( AT(1, 7) == get_next_unixtime(s, AT(0, 22)) );
+
+    destroy_schedule( s );
+}
+
+void test_with_weekly()
+{
+    test_rule_t rules[] = {
+        { NO_DAYS, 22 * HOUR, 23 * HOUR, 0 },     /* Every day. */
+        { 0x40, 23 * HOUR, 2 * HOUR, 0 },         /* Saturday, into Sunday. */
+        { 0x02, 10 * HOUR, 10 * HOUR, 1 },        /* All of Monday. */
+    };
+    schedule_t *s;
+
+    CU_ASSERT_FATAL( 0 == decode_rules(rules, 3, true, &s, NULL) );
+
+    CU_ASSERT( blocked_is(s, AT(0, 1), MAC_A " " MAC_B) );
+    CU_ASSERT( blocked_is(s, AT(0, 3), MAC_B) );
+    CU_ASSERT( blocked_is(s, AT(0, 9), NULL) );
+    CU_ASSERT( blocked_is(s, AT(0, 22), MAC_A) );
+    CU_ASSERT( blocked_is(s, AT(0, 23), NULL) );
+    CU_ASSERT( blocked_is(s, AT(1, 9), NULL) );
+    CU_ASSERT( blocked_is(s, AT(1, 10), MAC_B) );
+    CU_ASSERT( blocked_is(s, AT(1, 22), MAC_A " " MAC_B) );
+    CU_ASSERT( blocked_is(s, AT(2, 9), MAC_B) );
+    CU_ASSERT( blocked_is(s, AT(2, 10), NULL) );
+    CU_ASSERT( blocked_is(s, AT(6, 19), NULL) );
+    CU_ASSERT( blocked_is(s, AT(6, 21), MAC_B) );
+    CU_ASSERT( blocked_is(s, AT(6, 22), MAC_A " " MAC_B) );
+    CU_ASSERT( blocked_is(s, AT(6, 23), MAC_A " " MAC_B) );
+    CU_ASSERT( blocked_is(s, AT(7, 1), MAC_A " " MAC_B) );
+    CU_ASSERT( blocked_is(s, AT(7, 2), MAC_B) );
+
+    destroy_schedule( s );
+}
+
+void test_payload_size()
+{
+    test_rule_t rule = { 0x1f, 21 * HOUR, 7 * HOUR, 0 };
+    schedule_t *s;
+    size_t rule_len;
+    char *a, *b;
+    time_t t;
+
+    CU_ASSERT_FATAL( 0 == decode_rules(&rule, 1, false, &s, &rule_len) );
+
+    /* The same week, spelled out: the encoding is several times larger. */
+    {
+        msgpack_sbuffer sbuf;
+        msgpack_packer pk;
+        schedule_t *w = NULL;
+        int d;
+
+        msgpack_sbuffer_init( &sbuf );
+        msgpack_packer_init( &pk, &sbuf, msgpack_sbuffer_write );
+        msgpack_pack_map( &pk, 3 );
+        pack_str( &pk, "time_zone" );
+        pack_str( &pk, "UTC" );
+        pack_str( &pk, "macs" );
+        msgpack_pack_array( &pk, 2 );
+        pack_str( &pk, MAC_A );
+        pack_str( &pk, MAC_B );
+        pack_str( &pk, "weekly" );
+        msgpack_pack_array( &pk, 10 );
+        for( d = 0; d < 5; d++ ) {
+            if( 0 < d ) {
+                pack_event( &pk, d * DAY + 7 * HOUR, -1 );
+            }
+            pack_event( &pk, d * DAY + 21 * HOUR, 0 );
+        }
+        pack_event( &pk, 5 * DAY + 7 * HOUR, -1 );
+
+        CU_ASSERT( 2 * rule_len < sbuf.size );
+        CU_ASSERT_FATAL( 0 == decode_schedule(sbuf.size, (uint8_t*) sbuf.data, &w) );
+        msgpack_sbuffer_destroy( &sbuf );
+
+        for( t = AT(0, 0); t < AT(7, 0); t += 1800 ) {
+            a = get_blocked_at_time( s, t );
+            b = get_blocked_at_time( w, t );
+            CU_ASSERT( (NULL == a) == (NULL == b) );
+            if( (NULL != a) && (NULL != b) ) {
+                CU_ASSERT_STRING_EQUAL( a, b );
+            }
+            if( NULL != a ) free( a );
+            if( NULL != b ) free( b );
+        }
+        destroy_schedule( w );
+    }
+
+    destroy_schedule( s );
+}
+
+void test_errors()
+{
+    test_rule_t bad_days[] = { { 0x80, 0, HOUR, 0 } };
+    test_rule_t no_days[] = { { 0, 0, HOUR, 0 } };
+    test_rule_t bad_start[] = { { 0x01, DAY + 1, HOUR, 0 } };
+    test_rule_t bad_index[] = { { 0x01, 0, HOUR, 2 } };
+    uint32_t block[] = { 0 };
+    schedule_rule_t r = { 0x01, 0, HOUR, 1, block };
+    schedule_event_t *weekly;
+    schedule_t *s, *c;
+
+    CU_ASSERT( 0 != decode_rules(bad_days, 1, false, &s, NULL) );
+    CU_ASSERT( NULL == s );
+    CU_ASSERT( 0 != decode_rules(no_days, 1, false, &s, NULL) );
+    CU_ASSERT( 0 != decode_rules(bad_start, 1, false, &s, NULL) );
+    CU_ASSERT( 0 != decode_rules(bad_index, 1, true, &s, NULL) );
+    CU_ASSERT( NULL == s );
+
+    CU_ASSERT( 0 == expand_schedule_rules(NULL, NULL, 0) );
+    CU_ASSERT( -1 == expand_schedule_rules(NULL, &r, 1) );
+
+    /* Finalized schedules are rejected; out of memory leaves c alone. */
+    CU_ASSERT_FATAL( 0 == decode_rules(NULL, 0, true, &s, NULL) );
+    CU_ASSERT( -1 == expand_schedule_rules(s, &r, 1) );
+    c = copy_schedule( s );
+    CU_ASSERT_FATAL( NULL != c );
+    weekly = c->weekly;
+
+    malloc_fail = true;
+    malloc_failure_limit = 0;
+    CU_ASSERT( -2 == expand_schedule_rules(c, &r, 1) );
+    malloc_fail = false;
+    CU_ASSERT( weekly == c->weekly );
+
+    CU_ASSERT( 0 == expand_schedule_rules(c, &r, 1) );
+    CU_ASSERT( 0 == finalize_schedule(c) );
+    CU_ASSERT( blocked_is(c, AT(0, 0), MAC_A " " MAC_B) );
+    CU_ASSERT( blocked_is(c, AT(0, 1), MAC_B) );
+
+    destroy_schedule( c );
+    destroy_schedule( s );
+
+    destroy_schedule_rules( NULL, 0 );
+}
+
+void test_invalid_index()
+{
+    uint32_t block[] = { 1 };
+    schedule_rule_t r = { 0x01, 14 * HOUR, 15 * HOUR, 1, block };
+    schedule_event_t *e;
+    schedule_t *s, *c, *plain;
+
+    /* A weekly event with an index outside the MAC table blocks nothing,
+     * with rules as without them. */
+    CU_ASSERT_FATAL( 0 == decode_rules(NULL, 0, true, &s, NULL) );
+    c = copy_schedule( s );
+    CU_ASSERT_FATAL( NULL != c );
+    e = create_schedule_event( 2 );
+    CU_ASSERT_FATAL( NULL != e );
+    e->time = 12 * HOUR;
+    e->block[0] = 0;
+    e->block[1] = 5;
+    insert_event( &c->weekly, e );
+
+    plain = copy_schedule( c );
+    CU_ASSERT_FATAL( NULL != plain );
+    CU_ASSERT( 0 == finalize_schedule(plain) );
+    CU_ASSERT( blocked_is(plain, AT(0, 13), NULL) );
+    CU_ASSERT( blocked_is(plain, AT(0, 14), NULL) );
+
+    CU_ASSERT( 0 == expand_schedule_rules(c, &r, 1) );
+    CU_ASSERT( 0 == finalize_schedule(c) );
+    CU_ASSERT( blocked_is(c, AT(0, 13), NULL) );
+    CU_ASSERT( blocked_is(c, AT(0, 14), MAC_B) );
+    CU_ASSERT( blocked_is(c, AT(0, 15), NULL) );
+    CU_ASSERT( blocked_is(c, AT(1, 14), NULL) );
+
+    destroy_schedule( plain );
+    destroy_schedule( c );
+    destroy_schedule( s );
+}
+
+void add_suites( CU_pSuite *suite )
+{
+    printf("--------Start of Test Cases Execution ---------\n");
+    *suite = CU_add_suite( "tests", NULL, NULL );
+    CU_add_test( *suite, "Test school nights", test_school_nights );
+    CU_add_test( *suite, "Test with weekly", test_with_weekly );
+    CU_add_test( *suite, "Test payload size", test_payload_size );
+    CU_add_test( *suite, "Test errors", test_errors );
+    CU_add_test( *suite, "Test invalid index", test_invalid_index );
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main( void )
+{
+    unsigned rv = 1;
+    CU_pSuite suite = NULL;
+
+    set_unix_time_zone( "UTC" );
+
+    if( CUE_SUCCESS == CU_initialize_registry() ) {
+        add_suites( &suite );
+
+        if( NULL != suite ) {
+            CU_basic_set_mode( CU_BRM_VERBOSE );
+            CU_basic_run_tests();
+            printf( "\n" );
+            CU_basic_show_failures( CU_get_failure_list() );
+            printf( "\n\n" );
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+
+    }
+
+    return rv;
+}
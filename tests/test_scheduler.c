@@ -20,8 +20,10 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 #include <ctype.h>
 #include <signal.h>
+#include <unistd.h>
 
 #include <CUnit/Basic.h>
 
@@ -30,6 +32,9 @@
 #include "../src/aker_mem.h"
 #include "../src/scheduler.h"
 #include "../src/process_data.h"
+#include "../src/decode.h"
+#include "../src/encode.h"
+#include "../src/schedule_image.h"
 #include "test_scheduler.h"
 
 #include "scheduler_data0.h"
@@ -133,6 +138,82 @@ void test3()
     }
 }
 
+void test4()
+{
+    schedule_t *s, *loaded = NULL;
+    schedule_event_t *e;
+    uint8_t *data = NULL, *after = NULL, *sig = NULL, *sig_after = NULL;
+    char *etag, *etag_after, *image_file;
+    size_t len, sig_len;
+    time_t t[] = { -3000, -2000, -1000, 1000 };
+    int i, result = 0;
+
+    add_time = 0;
+
+    s = create_schedule();
+    CU_ASSERT_FATAL( NULL != s );
+    CU_ASSERT_FATAL( 0 == create_mac_table(s, 1) );
+    CU_ASSERT_FATAL( 0 == set_mac_index(s, "11:22:33:44:55:66", 17, 0) );
+    e = create_schedule_event( 0 );
+    CU_ASSERT_FATAL( NULL != e );
+    e->time = 0;
+    insert_event( &s->weekly, e );
+    for( i = 0; i < 4; i++ ) {
+        e = create_schedule_event( 1 );
+        CU_ASSERT_FATAL( NULL != e );
+        e->time = kUnixCurrentTime + t[i];
+        e->block[0] = 0;
+        insert_event( &s->absolute, e );
+    }
+    len = encode_schedule( s, &data );
+    destroy_schedule( s );
+    CU_ASSERT_FATAL( 0 < len );
+    CU_ASSERT_FATAL( 0 == process_update(file_name, md5_file, data, len) );
+    sig_len = read_file_from_disk( md5_file, &sig );
+    CU_ASSERT_FATAL( 0 < sig_len );
+    etag = process_get_schedule_etag();
+    CU_ASSERT_FATAL( NULL != etag );
+    image_file = schedule_image_name( file_name );
+    CU_ASSERT_FATAL( NULL != image_file );
+    remove( image_file );
+
+    /* Nothing is pruned until the scheduler has looked at it. */
+    for( i = 0; (i < 100) && (0 == result); i++ ) {
+        result = process_persist_pruned( file_name, md5_file, 2 );
+        if( 0 == result ) {
+            usleep( 10000 );
+        }
+    }
+    CU_ASSERT( 1 == result );
+    CU_ASSERT( 0 == process_persist_pruned(file_name, md5_file, 1) );
+
+    /* What the cloud uploaded and its tag are left alone ... */
+    CU_ASSERT( len == read_file_from_disk(file_name, &after) );
+    CU_ASSERT( (NULL != after) && (0 == memcmp(data, after, len)) );
+    CU_ASSERT( sig_len == read_file_from_disk(md5_file, &sig_after) );
+    CU_ASSERT( (NULL != sig_after) && (0 == memcmp(sig, sig_after, sig_len)) );
+    etag_after = process_get_schedule_etag();
+    CU_ASSERT( (NULL != etag_after) && (0 == strcmp(etag, etag_after)) );
+
+    /* ... and a restart loads the one in effect and the one to come. */
+    CU_ASSERT_FATAL( 0 == schedule_image_load(image_file, sig, sig_len, &loaded) );
+    CU_ASSERT_FATAL( NULL != loaded->absolute );
+    CU_ASSERT( kUnixCurrentTime - 1000 == loaded->absolute->time );
+    CU_ASSERT_FATAL( NULL != loaded->absolute->next );
+    CU_ASSERT( kUnixCurrentTime + 1000 == loaded->absolute->next->time );
+    CU_ASSERT( NULL == loaded->absolute->next->next );
+
+    remove( image_file );
+    destroy_schedule( loaded );
+    free( etag );
+    free( etag_after );
+    aker_free( image_file );
+    aker_free( data );
+    if( NULL != after ) aker_free( after );
+    aker_free( sig );
+    if( NULL != sig_after ) aker_free( sig_after );
+}
+
 void add_suites( CU_pSuite *suite )
 {
     printf("--------Start of Test Cases Execution For Scheduler---------\n");
@@ -140,6 +221,7 @@ void add_suites( CU_pSuite *suite )
     CU_add_test( *suite, "Scheduler Test 1", test1);
     CU_add_test( *suite, "Scheduler Test 2", test2);
     CU_add_test( *suite, "Scheduler Test 3", test3);
+    CU_add_test( *suite, "Scheduler Test 4", test4);
 }
 
 /*----------------------------------------------------------------------------*/
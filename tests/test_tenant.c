@@ -0,0 +1,309 @@
+/**
+ *  Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <CUnit/Basic.h>
+#include <msgpack.h>
+
+#include "msgpack_fixtures.h"
+#include "../src/aker_clock.h"
+#include "../src/schedule.h"
+#include "../src/tenant.h"
+#include "../src/decode.h"
+#include "../src/time.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define MAC_A           "11:22:33:44:55:aa"
+#define MAC_B           "22:33:44:55:66:bb"
+#define SUNDAY          (3 * 24 * 3600)     /* 1970-01-04 00:00 UTC */
+#define DAY             (24 * 3600)
+#define HOUR            3600
+#define AT(d, h)        (SUNDAY + (d) * DAY + (h) * HOUR)
+
+#define TENANTS_FILE    "test_tenants.txt"
+#define FIREWALL_SCRIPT "tenant_firewall.sh"
+#define FIREWALL_LOG    "tenant_firewall.log"
+#define MANY_TENANTS    500
+
+/*----------------------------------------------------------------------------*/
+/*                                   Mocks                                    */
+/*----------------------------------------------------------------------------*/
+int32_t get_max_mac_limit(void)
+{
+    return 2048;
+}
+
+/* The real one is tested with process_data. */
+bool process_is_named_ok( const char *name )
+{
+    return (NULL != name) && ('\0' != name[0]) && (NULL == strchr(name, '.'));
+}
+
+/*----------------------------------------------------------------------------*/
+/*                              Test Helpers                                  */
+/*----------------------------------------------------------------------------*/
+/**
+ *  Waits up to 5 seconds for a tenant's blocked set to become the expected
+ *  one.
+ */
+static bool blocked_becomes( const char *id, const char *expected )
+{
+    char *macs = NULL;
+    bool rv = false;
+    int i;
+
+    for( i = 0; !rv && (i < 500); i++ ) {
+        if( NULL != macs ) {
+            free( macs );
+        }
+        macs = tenant_get_blocked( id );
+        if( NULL == expected ) {
+            rv = (NULL == macs);
+        } else {
+            rv = (NULL != macs) && (0 == strcmp(macs, expected));
+        }
+        if( !rv ) {
+            usleep( 10000 );
+        }
+    }
+    if( !rv ) {
+        printf( "\n%s: '%s', expected '%s'\n", id,
+                (NULL == macs) ? "" : macs, (NULL == expected) ? "" : expected );
+    }
+    if( NULL != macs ) {
+        free( macs );
+    }
+
+    return rv;
+}
+
+/**
+ *  Waits up to 5 seconds for the firewall log to have a line.
+ */
+static bool firewall_called( const char *line )
+{
+    char buf[256];
+    bool rv = false;
+    int i;
+
+    for( i = 0; !rv && (i < 500); i++ ) {
+        FILE *fh = fopen( FIREWALL_LOG, "r" );
+
+        if( NULL != fh ) {
+            while( !rv && (NULL != fgets(buf, sizeof(buf), fh)) ) {
+                buf[strcspn(buf, "\n")] = '\0';
+                rv = (0 == strcmp(buf, line));
+            }
+            fclose( fh );
+        }
+        if( !rv ) {
+            usleep( 10000 );
+        }
+    }
+
+    return rv;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                                   Tests                                    */
+/*----------------------------------------------------------------------------*/
+void test_add()
+{
+    FILE *fh;
+
+    CU_ASSERT( 0 == tenant_add("sub1", "eth1") );
+    CU_ASSERT( 0 == tenant_add("sub0", NULL) );
+    CU_ASSERT( -3 == tenant_add("sub1", "eth2") );
+    CU_ASSERT( -1 == tenant_add("a.b", NULL) );
+    CU_ASSERT( -1 == tenant_add(NULL, "eth1") );
+    CU_ASSERT( -1 == tenant_add("sub2", "eth1;reboot") );
+    CU_ASSERT( -1 == tenant_add("sub2", "") );
+    CU_ASSERT( -1 == tenant_add("sub2", "01234567890123456789012345678901"
+                                        "012345678901234567890123456789012") );
+    CU_ASSERT( 2 == tenant_count() );
+    CU_ASSERT( tenant_exists("sub0") );
+    CU_ASSERT( tenant_exists("sub1") );
+    CU_ASSERT( !tenant_exists("sub2") );
+    CU_ASSERT( NULL == tenant_get_blocked("sub1") );
+    CU_ASSERT( -1 == tenant_set_schedule("sub2", make_weekly_schedule(MAC_A, MAC_B, 0, 1)) );
+
+    CU_ASSERT( -1 == tenant_load("no_such_tenants_file") );
+
+    fh = fopen( TENANTS_FILE, "w" );
+    CU_ASSERT_FATAL( NULL != fh );
+    fprintf( fh, "# Downstream ports\n\nport-1 vlan.100\n  port-2\nport-3 eth3 extra\nport-4\n" );
+    fclose( fh );
+    CU_ASSERT( -2 == tenant_load(TENANTS_FILE) );
+    CU_ASSERT( 4 == tenant_count() );
+
+    fh = fopen( TENANTS_FILE, "w" );
+    CU_ASSERT_FATAL( NULL != fh );
+    fprintf( fh, "port-3 eth3\nport-4\n" );
+    fclose( fh );
+    CU_ASSERT( 2 == tenant_load(TENANTS_FILE) );
+    CU_ASSERT( 6 == tenant_count() );
+    remove( TENANTS_FILE );
+
+    tenant_stop();
+    CU_ASSERT( 0 == tenant_count() );
+    CU_ASSERT( !tenant_exists("sub1") );
+}
+
+void test_firewall()
+{
+    FILE *fh;
+
+    remove( FIREWALL_LOG );
+    fh = fopen( FIREWALL_SCRIPT, "w" );
+    CU_ASSERT_FATAL( NULL != fh );
+    fprintf( fh, "#!/bin/sh\necho \"$*\" >> %s\n", FIREWALL_LOG );
+    fclose( fh );
+
+    CU_ASSERT_FATAL( 0 == aker_clock_set_virtual(AT(1, 1), 0) );
+
+    CU_ASSERT( 0 == tenant_add("sub1", "eth1") );
+    CU_ASSERT( 0 == tenant_add("sub2", NULL) );
+    CU_ASSERT( 0 == tenant_set_schedule("sub1", make_weekly_schedule(MAC_A, MAC_B, 24, 34)) );
+    CU_ASSERT_FATAL( 0 == tenant_start("sh " FIREWALL_SCRIPT, 2) );
+
+    /* Everyone is applied once at start. */
+    CU_ASSERT( firewall_called("eth1 " MAC_A " " MAC_B) );
+    CU_ASSERT( firewall_called("sub2") );
+    CU_ASSERT( blocked_becomes("sub1", MAC_A " " MAC_B) );
+    CU_ASSERT( blocked_becomes("sub2", NULL) );
+
+    /* A new schedule, then the transition at its end. */
+    CU_ASSERT( 0 == tenant_set_schedule("sub2", make_weekly_schedule(MAC_B, MAC_A, 25, 26)) );
+    CU_ASSERT( firewall_called("sub2 " MAC_B " " MAC_A) );
+    CU_ASSERT( 0 == aker_clock_advance(HOUR) );
+    CU_ASSERT( blocked_becomes("sub2", NULL) );
+    CU_ASSERT( blocked_becomes("sub1", MAC_A " " MAC_B) );
+
+    CU_ASSERT( 0 == aker_clock_advance(8 * HOUR) );
+    CU_ASSERT( blocked_becomes("sub1", NULL) );
+    CU_ASSERT( firewall_called("eth1") );
+
+    /* Dropping the schedule. */
+    CU_ASSERT( 0 == aker_clock_advance(6 * DAY + 15 * HOUR) );
+    CU_ASSERT( blocked_becomes("sub1", MAC_A " " MAC_B) );
+    CU_ASSERT( 0 == tenant_set_schedule("sub1", NULL) );
+    CU_ASSERT( blocked_becomes("sub1", NULL) );
+
+    tenant_stop();
+    aker_clock_set_real();
+    remove( FIREWALL_SCRIPT );
+    remove( FIREWALL_LOG );
+}
+
+void test_many()
+{
+    char id[16];
+    int i;
+
+    CU_ASSERT_FATAL( 0 == aker_clock_set_virtual(AT(0, 0), 0) );
+
+    /* Tenant i blocks from hour i % 100 to the hour after. */
+    for( i = 0; i < MANY_TENANTS; i++ ) {
+        snprintf( id, sizeof(id), "t%d", i );
+        CU_ASSERT( 0 == tenant_add(id, NULL) );
+        CU_ASSERT( 0 == tenant_set_schedule(id, make_weekly_schedule(MAC_A, MAC_B, 1 + i % 100, 2 + i % 100)) );
+    }
+    CU_ASSERT_FATAL( 0 == tenant_start(NULL, 0) );
+    CU_ASSERT( blocked_becomes("t0", NULL) );
+    CU_ASSERT( blocked_becomes("t499", NULL) );
+
+    CU_ASSERT( 0 == aker_clock_advance(HOUR) );
+    for( i = 0; i < MANY_TENANTS; i += 100 ) {
+        snprintf( id, sizeof(id), "t%d", i );
+        CU_ASSERT( blocked_becomes(id, MAC_A " " MAC_B) );
+    }
+    CU_ASSERT( blocked_becomes("t1", NULL) );
+
+    CU_ASSERT( 0 == aker_clock_advance(37 * HOUR) );
+    for( i = 0; i < MANY_TENANTS; i++ ) {
+        snprintf( id, sizeof(id), "t%d", i );
+        CU_ASSERT( blocked_becomes(id, (37 == i % 100) ? (MAC_A " " MAC_B) : NULL) );
+    }
+
+    tenant_stop();
+    aker_clock_set_real();
+}
+
+void test_replace()
+{
+    int i;
+
+    CU_ASSERT_FATAL( 0 == aker_clock_set_virtual(AT(0, 2), 0) );
+
+    /* The workers look at a schedule without the lock, so replacing it
+     * while they do must leave the old one to them. */
+    CU_ASSERT( 0 == tenant_add("r", NULL) );
+    CU_ASSERT_FATAL( 0 == tenant_start(NULL, 4) );
+    for( i = 0; i < 200; i++ ) {
+        CU_ASSERT( 0 == tenant_set_schedule("r", (0 == i % 2) ?
+                                            make_weekly_schedule(MAC_A, MAC_B, 5, 6) :
+                                            make_weekly_schedule(MAC_A, MAC_B, 1, 3)) );
+    }
+    CU_ASSERT( blocked_becomes("r", MAC_A " " MAC_B) );
+    CU_ASSERT( 0 == tenant_set_schedule("r", make_weekly_schedule(MAC_A, MAC_B, 5, 6)) );
+    CU_ASSERT( blocked_becomes("r", NULL) );
+
+    tenant_stop();
+    aker_clock_set_real();
+}
+
+void add_suites( CU_pSuite *suite )
+{
+    printf("--------Start of Test Cases Execution ---------\n");
+    *suite = CU_add_suite( "tests", NULL, NULL );
+    CU_add_test( *suite, "Test adding tenants", test_add );
+    CU_add_test( *suite, "Test the firewall", test_firewall );
+    CU_add_test( *suite, "Test many tenants", test_many );
+    CU_add_test( *suite, "Test replacing a schedule", test_replace );
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main( void )
+{
+    unsigned rv = 1;
+    CU_pSuite suite = NULL;
+
+    if( CUE_SUCCESS == CU_initialize_registry() ) {
+        add_suites( &suite );
+
+        if( NULL != suite ) {
+            CU_basic_set_mode( CU_BRM_VERBOSE );
+            CU_basic_run_tests();
+            printf( "\n" );
+            CU_basic_show_failures( CU_get_failure_list() );
+            printf( "\n\n" );
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+
+    }
+
+    return rv;
+}
@@ -22,6 +22,8 @@
 #include <stdint.h>
 #include <ctype.h>
 #include <signal.h>
+#include <limits.h>
+#include <string.h>
 
 #include <CUnit/Basic.h>
 #include <wrp-c/wrp-c.h>
@@ -329,12 +331,106 @@ void test_fall()
     }
 }
 
+static bool changed( const char *a, const char *b )
+{
+    return ((NULL == a) != (NULL == b)) ||
+           ((NULL != a) && (NULL != b) && (0 != strcmp(a, b)));
+}
+
+/* Walks [start, end) either second by second or transition by transition
+ * and records where the blocked list changes. */
+static size_t find_changes( schedule_t *s, time_t start, time_t end,
+                            bool by_transition, time_t *out, size_t max )
+{
+    char *last = NULL;
+    size_t count = 0;
+    time_t t;
+
+    for( t = start; t < end;
+         t = (by_transition) ? get_next_transition(s, t) : (t + 1) )
+    {
+        char *macs = get_blocked_at_time( s, t );
+
+        if( (t == start) || changed(last, macs) ) {
+            if( count < max ) {
+                out[count] = t;
+            }
+            count++;
+        }
+        if( NULL != last ) {
+            aker_free( last );
+        }
+        last = macs;
+    }
+    if( NULL != last ) {
+        aker_free( last );
+    }
+
+    return count;
+}
+
+static void check_transitions( schedule_t *s, time_t start, time_t end )
+{
+    time_t by_second[64], by_transition[64];
+    size_t a, b;
+
+    a = find_changes( s, start, end, false, by_second, 64 );
+    b = find_changes( s, start, end, true, by_transition, 64 );
+    CU_ASSERT( 1 < a );
+    CU_ASSERT_FATAL( a == b );
+    CU_ASSERT( 0 == memcmp(by_second, by_transition, a * sizeof(time_t)) );
+}
+
+void test_transitions()
+{
+    schedule_t *s;
+    schedule_event_t *e;
+    char *macs;
+
+    set_unix_time_zone( "America/New_York" );
+    s = build_schedule();
+
+    CU_ASSERT( INT_MAX == get_next_transition(NULL, 0) );
+
+    /* Both DST nights, and the Saturday to Sunday wrap around. */
+    check_transitions( s, 1520740800, 1520784000 );
+    check_transitions( s, 1541300400, 1541343600 );
+    check_transitions( s, 1521330000, 1521356400 );
+
+    /* An absolute schedule that starts after some weekly events. */
+    e = create_schedule_event( 1 );
+    e->time = 1520748000;
+    e->block[0] = 3;
+    insert_event( &s->absolute, e );
+    e = create_schedule_event( 1 );
+    e->time = 1520757000;
+    e->block[0] = 1;
+    insert_event( &s->absolute, e );
+    CU_ASSERT_FATAL( 0 == build_schedule_index(s) );
+    CU_ASSERT( 1520747100 == get_next_transition(s, 1520744401) );
+
+    /* Only the absolute schedule changes anything at 3:00 AM, and its first
+     * event holds until 5:30 AM whatever the weekly events say. */
+    CU_ASSERT( 1520748000 == get_next_transition(s, 1520747100) );
+    macs = get_blocked_at_time( s, 1520748000 );
+    CU_ASSERT_STRING_EQUAL( "33:33:33:33:33:33", macs );
+    aker_free( macs );
+    macs = get_blocked_at_time( s, 1520756999 );
+    CU_ASSERT_STRING_EQUAL( "33:33:33:33:33:33", macs );
+    aker_free( macs );
+    check_transitions( s, 1520740800, 1520784000 );
+    check_transitions( s, 1521330000, 1521356400 );
+
+    destroy_schedule( s );
+}
+
 void add_suites( CU_pSuite *suite )
 {
     printf("--------Start of Test Cases Execution For Scheduler---------\n");
     *suite = CU_add_suite( "tests", NULL, NULL );
     CU_add_test( *suite, "Scheduler Test Spring Forward", test_spring);
     CU_add_test( *suite, "Scheduler Test Fall Back", test_fall);
+    CU_add_test( *suite, "Scheduler Test Transitions", test_transitions);
 }
 
 /*----------------------------------------------------------------------------*/
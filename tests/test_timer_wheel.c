@@ -0,0 +1,215 @@
+/**
+ *  Copyright 2017 Comcast Cable Communications Management, LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+
+#include <CUnit/Basic.h>
+
+#include "../src/timer_wheel.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define START       1520121600      /* A multiple of 64, as it happens. */
+#define RANDOM_TIMERS   2000
+
+/*----------------------------------------------------------------------------*/
+/*                                   Tests                                    */
+/*----------------------------------------------------------------------------*/
+void test_basic()
+{
+    timer_wheel_t w;
+    timer_node_t n[8];
+    time_t deadlines[8] = {
+        START,                  /* Due right away. */
+        START + 1,
+        START + 63,
+        START + 64,             /* The next level. */
+        START + 5000,
+        START + 300000,         /* Level 3. */
+        START + 20000000,       /* Past the top level. */
+        START + 64,             /* The same slot as n[3]. */
+    };
+    time_t t;
+    size_t i;
+
+    memset( n, 0, sizeof(n) );
+    timer_wheel_init( &w, START );
+    CU_ASSERT( INT_MAX == timer_wheel_next(&w) );
+    CU_ASSERT( NULL == timer_wheel_expired(&w) );
+
+    for( i = 0; i < 8; i++ ) {
+        CU_ASSERT( !timer_wheel_armed(&n[i]) );
+        timer_wheel_add( &w, &n[i], deadlines[i] );
+        CU_ASSERT( timer_wheel_armed(&n[i]) );
+    }
+    CU_ASSERT( 8 == w.count );
+
+    /* Already due. */
+    CU_ASSERT( START == timer_wheel_next(&w) );
+    CU_ASSERT( 1 == timer_wheel_advance(&w, START) );
+    CU_ASSERT( &n[0] == timer_wheel_expired(&w) );
+    CU_ASSERT( !timer_wheel_armed(&n[0]) );
+    CU_ASSERT( NULL == timer_wheel_expired(&w) );
+
+    /* Each deadline in turn; the wake up is never late. */
+    for( i = 1; i < 7; i++ ) {
+        timer_node_t *e;
+        size_t expect = (3 == i) ? 2 : 1;
+
+        t = timer_wheel_next( &w );
+        while( t < deadlines[i] ) {
+            CU_ASSERT( 0 == timer_wheel_advance(&w, t) );
+            t = timer_wheel_next( &w );
+        }
+        CU_ASSERT( deadlines[i] == t );
+        CU_ASSERT( expect == timer_wheel_advance(&w, t) );
+        while( NULL != (e = timer_wheel_expired(&w)) ) {
+            CU_ASSERT( deadlines[i] == e->deadline );
+            expect--;
+        }
+        CU_ASSERT( 0 == expect );
+    }
+
+    CU_ASSERT( 0 == w.count );
+    CU_ASSERT( INT_MAX == timer_wheel_next(&w) );
+
+    /* Moving and cancelling. */
+    timer_wheel_add( &w, &n[0], w.now + 100 );
+    timer_wheel_add( &w, &n[1], w.now + 200 );
+    timer_wheel_add( &w, &n[0], w.now + 300 );
+    CU_ASSERT( 2 == w.count );
+    timer_wheel_cancel( &w, &n[1] );
+    timer_wheel_cancel( &w, &n[1] );
+    CU_ASSERT( 1 == w.count );
+    CU_ASSERT( 0 == timer_wheel_advance(&w, w.now + 299) );
+    CU_ASSERT( 1 == timer_wheel_advance(&w, w.now + 1) );
+    CU_ASSERT( &n[0] == timer_wheel_expired(&w) );
+
+    /* A deadline in the past expires right away. */
+    timer_wheel_add( &w, &n[2], w.now - 10 );
+    CU_ASSERT( w.now == timer_wheel_next(&w) );
+    timer_wheel_cancel( &w, &n[2] );
+    CU_ASSERT( NULL == timer_wheel_expired(&w) );
+    CU_ASSERT( 0 == w.count );
+
+    /* An earlier time is ignored. */
+    t = w.now;
+    CU_ASSERT( 0 == timer_wheel_advance(&w, t - 1000) );
+    CU_ASSERT( t == w.now );
+}
+
+void test_random()
+{
+    static timer_node_t n[RANDOM_TIMERS];
+    static bool armed[RANDOM_TIMERS];
+    timer_wheel_t w;
+    time_t now = START + 17;
+    int round;
+    size_t i;
+
+    srand( 42 );
+    memset( n, 0, sizeof(n) );
+    memset( armed, 0, sizeof(armed) );
+    timer_wheel_init( &w, now );
+
+    for( round = 0; round < 400; round++ ) {
+        timer_node_t *e;
+        size_t armed_count = 0;
+
+        /* Arm, move or cancel some. */
+        for( i = 0; i < 50; i++ ) {
+            size_t k = (size_t) rand() % RANDOM_TIMERS;
+
+            if( 0 == rand() % 4 ) {
+                timer_wheel_cancel( &w, &n[k] );
+                armed[k] = false;
+            } else {
+                time_t span = (0 == rand() % 2) ? 200 : (1 << 25);
+
+                timer_wheel_add( &w, &n[k], now + (rand() % span) );
+                armed[k] = true;
+            }
+        }
+
+        /* Step to the next wake up, or further. */
+        if( 0 == rand() % 3 ) {
+            now += rand() % 100000;
+        } else {
+            time_t next = timer_wheel_next( &w );
+
+            CU_ASSERT_FATAL( now <= next );
+            if( INT_MAX != next ) {
+                now = next;
+            }
+        }
+        timer_wheel_advance( &w, now );
+
+        while( NULL != (e = timer_wheel_expired(&w)) ) {
+            CU_ASSERT( e->deadline <= now );
+            armed[e - n] = false;
+        }
+
+        /* Nothing left armed is due, and the wake up is never late. */
+        for( i = 0; i < RANDOM_TIMERS; i++ ) {
+            CU_ASSERT( armed[i] == timer_wheel_armed(&n[i]) );
+            if( armed[i] ) {
+                CU_ASSERT( now < n[i].deadline );
+                CU_ASSERT( timer_wheel_next(&w) <= n[i].deadline );
+                armed_count++;
+            }
+        }
+        CU_ASSERT( armed_count == w.count );
+    }
+}
+
+void add_suites( CU_pSuite *suite )
+{
+    printf("--------Start of Test Cases Execution ---------\n");
+    *suite = CU_add_suite( "tests", NULL, NULL );
+    CU_add_test( *suite, "Test basic", test_basic );
+    CU_add_test( *suite, "Test random", test_random );
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main( void )
+{
+    unsigned rv = 1;
+    CU_pSuite suite = NULL;
+
+    if( CUE_SUCCESS == CU_initialize_registry() ) {
+        add_suites( &suite );
+
+        if( NULL != suite ) {
+            CU_basic_set_mode( CU_BRM_VERBOSE );
+            CU_basic_run_tests();
+            printf( "\n" );
+            CU_basic_show_failures( CU_get_failure_list() );
+            printf( "\n\n" );
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+
+    }
+
+    return rv;
+}
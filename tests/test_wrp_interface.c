@@ -24,6 +24,7 @@
 
 #include "test_macros.h"
 #include "../src/wrp_interface.h"
+#include "../src/aker_mem.h"
 
 /*----------------------------------------------------------------------------*/
 /*                                   Macros                                   */
@@ -36,6 +37,7 @@ typedef struct {
     size_t pack_status_msg_rv;
     int process_update_rv;
     size_t process_retrieve_now_rv;
+    size_t process_retrieve_device_rv;
     int process_schedule_data_rv;
     size_t read_file_from_disk_rv;
     int process_is_create_ok_rv;
@@ -88,6 +90,18 @@ int process_update( const char *filename, const char *md5_file,
     return process_update_rv;
 }
 
+static int process_patch_rv = 0;
+int process_patch( const char *filename, const char *md5_file,
+                   void *payload, size_t payload_size )
+{
+    (void) filename;
+    (void) md5_file;
+    (void) payload;
+    (void) payload_size;
+
+    return process_patch_rv;
+}
+
 static size_t process_retrieve_now_rv = 0;
 size_t process_retrieve_now( uint8_t **data )
 {
@@ -96,6 +110,16 @@ size_t process_retrieve_now( uint8_t **data )
     return process_retrieve_now_rv;
 }
 
+static size_t process_retrieve_device_rv = 0;
+size_t process_retrieve_device( const char *mac, uint8_t **data )
+{
+    (void) data;
+
+    CU_ASSERT_STRING_EQUAL( "11:22:33:44:55:66", mac );
+
+    return process_retrieve_device_rv;
+}
+
 static int process_schedule_data_rv = 0;
 int process_schedule_data( size_t len, uint8_t *data )
 {
@@ -114,6 +138,14 @@ size_t read_file_from_disk( const char *filename, void **data )
     return read_file_from_disk_rv;
 }
 
+size_t process_retrieve_schedule( const char *filename, uint8_t **data )
+{
+    (void) filename;
+    (void) data;
+
+    return read_file_from_disk_rv;
+}
+
 static int process_is_create_ok_rv = 0;
 int process_is_create_ok( const char *filename )
 {
@@ -122,6 +154,18 @@ int process_is_create_ok( const char *filename )
     return process_is_create_ok_rv;
 }
 
+static const char *schedule_etag = NULL;
+char* process_get_schedule_etag( void )
+{
+    return (NULL != schedule_etag) ? strdup(schedule_etag) : NULL;
+}
+
+static const char *now_etag = NULL;
+char* process_get_now_etag( void )
+{
+    return (NULL != now_etag) ? strdup(now_etag) : NULL;
+}
+
 static int process_delete_rv = 0;
 int process_delete( const char *filename, const char *md5_file )
 {
@@ -131,6 +175,110 @@ int process_delete( const char *filename, const char *md5_file )
     return process_delete_rv;
 }
 
+bool process_is_named_ok( const char *name )
+{
+    return (0 == strcmp("kids", name)) || (0 == strcmp("sub1", name)) ||
+           (0 == strcmp("sub2", name));
+}
+
+static int process_is_named_create_ok_rv = 0;
+int process_is_named_create_ok( const char *filename, const char *name )
+{
+    (void) filename;
+
+    CU_ASSERT_STRING_EQUAL( "kids", name );
+
+    return process_is_named_create_ok_rv;
+}
+
+static int process_named_update_rv = 0;
+int process_named_update( const char *filename, const char *md5_file,
+                          const char *name, void *payload, size_t payload_size )
+{
+    (void) filename;
+    (void) md5_file;
+    (void) payload;
+    (void) payload_size;
+
+    CU_ASSERT_STRING_EQUAL( "kids", name );
+
+    return process_named_update_rv;
+}
+
+static size_t process_retrieve_named_rv = 0;
+size_t process_retrieve_named( const char *filename, const char *name,
+                               uint8_t **data )
+{
+    (void) filename;
+    (void) data;
+
+    CU_ASSERT_STRING_EQUAL( "kids", name );
+
+    return process_retrieve_named_rv;
+}
+
+static int process_named_delete_rv = 0;
+int process_named_delete( const char *filename, const char *md5_file,
+                          const char *name )
+{
+    (void) filename;
+    (void) md5_file;
+
+    CU_ASSERT_STRING_EQUAL( "kids", name );
+
+    return process_named_delete_rv;
+}
+
+bool tenant_exists( const char *id )
+{
+    return (0 == strcmp("sub1", id));
+}
+
+static int process_tenant_rv = 0;
+int process_is_tenant_create_ok( const char *filename, const char *id )
+{
+    (void) filename;
+
+    CU_ASSERT_STRING_EQUAL( "sub1", id );
+
+    return process_tenant_rv;
+}
+
+int process_tenant_update( const char *filename, const char *md5_file,
+                           const char *id, void *payload, size_t payload_size )
+{
+    (void) filename;
+    (void) md5_file;
+    (void) payload;
+    (void) payload_size;
+
+    CU_ASSERT_STRING_EQUAL( "sub1", id );
+
+    return process_tenant_rv;
+}
+
+size_t process_retrieve_tenant( const char *filename, const char *id,
+                                uint8_t **data )
+{
+    (void) filename;
+    (void) data;
+
+    CU_ASSERT_STRING_EQUAL( "sub1", id );
+
+    return 0;
+}
+
+int process_tenant_delete( const char *filename, const char *md5_file,
+                           const char *id )
+{
+    (void) filename;
+    (void) md5_file;
+
+    CU_ASSERT_STRING_EQUAL( "sub1", id );
+
+    return process_tenant_rv;
+}
+
 /*----------------------------------------------------------------------------*/
 /*                                   Tests                                    */
 /*----------------------------------------------------------------------------*/
@@ -756,6 +904,91 @@ void test_process_wrp()
             .r.u.crud.payload = NULL,
             .r.u.crud.payload_size = 0,
         },
+
+        {   // 16
+            .process_retrieve_device_rv = 24,
+
+            .s.msg_type = WRP_MSG_TYPE__RETREIVE,
+            .s.u.crud.transaction_uuid = "c2bb1f16-09c8-11e7-93ae-92361f002671",
+            .s.u.crud.source = "fake-server",
+            .s.u.crud.dest = "mac:112233445566/aker/device/11:22:33:44:55:66",
+            .s.u.crud.path = "Some path",
+
+            .r.msg_type = WRP_MSG_TYPE__RETREIVE,
+            .r.u.crud.transaction_uuid = "c2bb1f16-09c8-11e7-93ae-92361f002671",
+            .r.u.crud.source = "mac:112233445566/aker/device/11:22:33:44:55:66",
+            .r.u.crud.dest = "fake-server",
+            .r.u.crud.status = 200,
+            .r.u.crud.path = "Some path",
+        },
+
+        {   // 17
+            .process_retrieve_device_rv = 0,
+
+            .s.msg_type = WRP_MSG_TYPE__RETREIVE,
+            .s.u.crud.transaction_uuid = "c2bb1f16-09c8-11e7-93ae-92361f002671",
+            .s.u.crud.source = "fake-server",
+            .s.u.crud.dest = "mac:112233445566/aker/device/11:22:33:44:55:66",
+            .s.u.crud.path = "Some path",
+
+            .r.msg_type = WRP_MSG_TYPE__RETREIVE,
+            .r.u.crud.transaction_uuid = "c2bb1f16-09c8-11e7-93ae-92361f002671",
+            .r.u.crud.source = "mac:112233445566/aker/device/11:22:33:44:55:66",
+            .r.u.crud.dest = "fake-server",
+            .r.u.crud.status = 404,
+            .r.u.crud.path = "Some path",
+        },
+
+        {   // 18
+            .process_retrieve_device_rv = 0,
+
+            .s.msg_type = WRP_MSG_TYPE__UPDATE,
+            .s.u.crud.transaction_uuid = "c2bb1f16-09c8-11e7-93ae-92361f002671",
+            .s.u.crud.source = "fake-server",
+            .s.u.crud.dest = "mac:112233445566/aker/device/11:22:33:44:55:66",
+            .s.u.crud.path = "Some path",
+
+            .r.msg_type = WRP_MSG_TYPE__UPDATE,
+            .r.u.crud.transaction_uuid = "c2bb1f16-09c8-11e7-93ae-92361f002671",
+            .r.u.crud.source = "mac:112233445566/aker/device/11:22:33:44:55:66",
+            .r.u.crud.dest = "fake-server",
+            .r.u.crud.status = 405,
+            .r.u.crud.path = "Some path",
+        },
+
+        {   // 19
+            .process_retrieve_device_rv = 0,
+
+            .s.msg_type = WRP_MSG_TYPE__CREATE,
+            .s.u.crud.transaction_uuid = "c2bb1f16-09c8-11e7-93ae-92361f002671",
+            .s.u.crud.source = "fake-server",
+            .s.u.crud.dest = "mac:112233445566/aker/device/11:22:33:44:55:66",
+            .s.u.crud.path = "Some path",
+
+            .r.msg_type = WRP_MSG_TYPE__CREATE,
+            .r.u.crud.transaction_uuid = "c2bb1f16-09c8-11e7-93ae-92361f002671",
+            .r.u.crud.source = "mac:112233445566/aker/device/11:22:33:44:55:66",
+            .r.u.crud.dest = "fake-server",
+            .r.u.crud.status = 405,
+            .r.u.crud.path = "Some path",
+        },
+
+        {   // 20
+            .process_retrieve_device_rv = 0,
+
+            .s.msg_type = WRP_MSG_TYPE__DELETE,
+            .s.u.crud.transaction_uuid = "c2bb1f16-09c8-11e7-93ae-92361f002671",
+            .s.u.crud.source = "fake-server",
+            .s.u.crud.dest = "mac:112233445566/aker/device/11:22:33:44:55:66",
+            .s.u.crud.path = "Some path",
+
+            .r.msg_type = WRP_MSG_TYPE__DELETE,
+            .r.u.crud.transaction_uuid = "c2bb1f16-09c8-11e7-93ae-92361f002671",
+            .r.u.crud.source = "mac:112233445566/aker/device/11:22:33:44:55:66",
+            .r.u.crud.dest = "fake-server",
+            .r.u.crud.status = 405,
+            .r.u.crud.path = "Some path",
+        },
     };
     size_t t_size = sizeof(tests)/sizeof(test_t);
     uint8_t i;
@@ -767,6 +1000,7 @@ void test_process_wrp()
         pack_status_msg_rv = tests[i].pack_status_msg_rv;
         process_update_rv = tests[i].process_update_rv;
         process_retrieve_now_rv = tests[i].process_retrieve_now_rv;
+        process_retrieve_device_rv = tests[i].process_retrieve_device_rv;
         process_schedule_data_rv = tests[i].process_schedule_data_rv;
         read_file_from_disk_rv = tests[i].read_file_from_disk_rv;
         process_is_create_ok_rv = tests[i].process_is_create_ok_rv;
@@ -793,11 +1027,338 @@ void test_process_wrp()
     }
 }
 
+void test_conditional_retrieve()
+{
+    struct {
+        const char *dest;
+        const char *if_none_match;
+        const char *schedule_etag;
+        const char *now_etag;
+        size_t payload_size;
+        int status;
+        const char *etag;
+    } tests[] = {
+        /* No tag known, no header: plain retrieves. */
+        { "mac:112233445566/aker/schedule", NULL, NULL, NULL, 8, 200, NULL },
+        { "mac:112233445566/aker/now", NULL, NULL, NULL, 8, 200, NULL },
+        { "mac:112233445566/aker/schedule", "If-None-Match: abc", NULL, NULL, 8, 200, NULL },
+
+        /* The tag is handed out with the payload. */
+        { "mac:112233445566/aker/schedule", NULL, "abc", NULL, 8, 200, "ETag: \"abc\"" },
+        { "mac:112233445566/aker/now", NULL, NULL, "1520121600-3", 8, 200, "ETag: \"1520121600-3\"" },
+
+        /* Matching tags (quoted, spaced, any case, wildcard) get a 304. */
+        { "mac:112233445566/aker/schedule", "If-None-Match: abc", "abc", NULL, 8, 304, "ETag: \"abc\"" },
+        { "mac:112233445566/aker/schedule", "if-none-match:  \"abc\" ", "abc", NULL, 8, 304, "ETag: \"abc\"" },
+        { "mac:112233445566/aker/schedule", "If-None-Match: *", "abc", NULL, 8, 304, "ETag: \"abc\"" },
+        { "mac:112233445566/aker/now", "If-None-Match: 1520121600-3", NULL, "1520121600-3", 8, 304, "ETag: \"1520121600-3\"" },
+
+        /* Anything else is a full retrieve. */
+        { "mac:112233445566/aker/schedule", "If-None-Match: abcd", "abc", NULL, 8, 200, "ETag: \"abc\"" },
+        { "mac:112233445566/aker/schedule", "If-None-Match: ab", "abc", NULL, 8, 200, "ETag: \"abc\"" },
+        { "mac:112233445566/aker/schedule", "If-None-Matches: abc", "abc", NULL, 8, 200, "ETag: \"abc\"" },
+        { "mac:112233445566/aker/now", "If-None-Match: 1520121600-2", NULL, "1520121600-3", 8, 200, "ETag: \"1520121600-3\"" },
+        { "mac:112233445566/aker/schedule", NULL, NULL, NULL, 0, 404, NULL },
+    };
+    size_t i;
+
+    for( i = 0; i < sizeof(tests)/sizeof(tests[0]); i++ ) {
+        headers_t *headers = NULL;
+        wrp_msg_t in, out;
+
+        memset(&in, 0, sizeof(wrp_msg_t));
+        memset(&out, 0, sizeof(wrp_msg_t));
+        in.msg_type = WRP_MSG_TYPE__RETREIVE;
+        in.u.crud.transaction_uuid = "c2bb1f16-09c8-11e7-93ae-92361f002671";
+        in.u.crud.source = "fake-server";
+        in.u.crud.dest = (char*) tests[i].dest;
+        in.u.crud.path = "Some path";
+        if( NULL != tests[i].if_none_match ) {
+            headers = (headers_t*) malloc(sizeof(headers_t) + 2 * sizeof(char*));
+            headers->count = 2;
+            headers->headers[0] = "X-Other: abc";
+            headers->headers[1] = (char*) tests[i].if_none_match;
+            in.u.crud.headers = headers;
+        }
+
+        schedule_etag = tests[i].schedule_etag;
+        now_etag = tests[i].now_etag;
+        read_file_from_disk_rv = tests[i].payload_size;
+        process_retrieve_now_rv = tests[i].payload_size;
+
+        CU_ASSERT(0 == process_wrp("data", "md5", &in, &out));
+        if( tests[i].status != out.u.crud.status ) {
+            printf( "\nTest: %zu Expected: %d, Got: %d\n", i, tests[i].status, out.u.crud.status );
+        }
+        CU_ASSERT_EQUAL(tests[i].status, out.u.crud.status);
+        if( 304 == tests[i].status ) {
+            CU_ASSERT(NULL == out.u.crud.payload);
+            CU_ASSERT(0 == out.u.crud.payload_size);
+        }
+        if( NULL == tests[i].etag ) {
+            CU_ASSERT(NULL == out.u.crud.headers);
+        } else {
+            CU_ASSERT_FATAL(NULL != out.u.crud.headers);
+            CU_ASSERT(1 == out.u.crud.headers->count);
+            CU_ASSERT_STRING_EQUAL(tests[i].etag, out.u.crud.headers->headers[0]);
+        }
+
+        cleanup_wrp(&out);
+        CU_ASSERT(NULL == out.u.crud.headers);
+        if( NULL != headers ) {
+            free(headers);
+        }
+    }
+
+    schedule_etag = NULL;
+    now_etag = NULL;
+    read_file_from_disk_rv = 0;
+    process_retrieve_now_rv = 0;
+}
+
+void test_patch()
+{
+    struct {
+        int msg_type;
+        int process_patch_rv;
+        const char *schedule_etag;
+        int status;
+        const char *etag;
+    } tests[] = {
+        /* A patch answers with the tag to base the next patch on. */
+        { WRP_MSG_TYPE__UPDATE,    0, "def", 200, "ETag: \"def\"" },
+        { WRP_MSG_TYPE__UPDATE,    0, NULL,  200, NULL },
+        { WRP_MSG_TYPE__UPDATE,   -1, "abc", 400, NULL },
+        { WRP_MSG_TYPE__UPDATE,   -2, NULL,  404, NULL },
+        { WRP_MSG_TYPE__UPDATE,   -3, "abc", 412, NULL },
+        { WRP_MSG_TYPE__UPDATE,   -4, "abc", 409, NULL },
+        { WRP_MSG_TYPE__UPDATE,   -5, "abc", 534, NULL },
+        { WRP_MSG_TYPE__UPDATE,   -6, NULL,  534, NULL },
+        { WRP_MSG_TYPE__UPDATE,   -7, "abc", 405, NULL },
+
+        /* Only UPDATE makes sense for a patch. */
+        { WRP_MSG_TYPE__CREATE,    0, "abc", 405, NULL },
+        { WRP_MSG_TYPE__RETREIVE,  0, "abc", 405, NULL },
+        { WRP_MSG_TYPE__DELETE,    0, "abc", 405, NULL },
+    };
+    size_t i;
+
+    for( i = 0; i < sizeof(tests)/sizeof(tests[0]); i++ ) {
+        wrp_msg_t in, out;
+
+        memset(&in, 0, sizeof(wrp_msg_t));
+        memset(&out, 0, sizeof(wrp_msg_t));
+        in.msg_type = tests[i].msg_type;
+        in.u.crud.transaction_uuid = "c2bb1f16-09c8-11e7-93ae-92361f002671";
+        in.u.crud.source = "fake-server";
+        in.u.crud.dest = "mac:112233445566/aker/schedule/patch";
+        in.u.crud.path = "Some path";
+
+        process_patch_rv = tests[i].process_patch_rv;
+        schedule_etag = tests[i].schedule_etag;
+
+        CU_ASSERT(0 == process_wrp("data", "md5", &in, &out));
+        if( tests[i].status != out.u.crud.status ) {
+            printf( "\nTest: %zu Expected: %d, Got: %d\n", i, tests[i].status, out.u.crud.status );
+        }
+        CU_ASSERT_EQUAL(tests[i].status, out.u.crud.status);
+        if( NULL == tests[i].etag ) {
+            CU_ASSERT(NULL == out.u.crud.headers);
+        } else {
+            CU_ASSERT_FATAL(NULL != out.u.crud.headers);
+            CU_ASSERT(1 == out.u.crud.headers->count);
+            CU_ASSERT_STRING_EQUAL(tests[i].etag, out.u.crud.headers->headers[0]);
+        }
+
+        cleanup_wrp(&out);
+        CU_ASSERT(NULL == out.u.crud.headers);
+    }
+
+    process_patch_rv = 0;
+    schedule_etag = NULL;
+}
+
+void test_named()
+{
+    struct {
+        int msg_type;
+        int create_ok_rv;
+        int update_rv;
+        size_t retrieve_rv;
+        int delete_rv;
+        int status;
+    } tests[] = {
+        { WRP_MSG_TYPE__CREATE,    0,  0, 0,  0, 201 },
+        { WRP_MSG_TYPE__CREATE,    0, -2, 0,  0, 533 },
+        { WRP_MSG_TYPE__CREATE,   -1,  0, 0,  0, 409 },
+        { WRP_MSG_TYPE__CREATE,   -2,  0, 0,  0, 400 },
+
+        { WRP_MSG_TYPE__UPDATE,    0,  0, 0,  0, 201 },
+        { WRP_MSG_TYPE__UPDATE,    0, -1, 0,  0, 400 },
+        { WRP_MSG_TYPE__UPDATE,    0, -2, 0,  0, 534 },
+        { WRP_MSG_TYPE__UPDATE,    0, -4, 0,  0, 534 },
+
+        { WRP_MSG_TYPE__DELETE,    0,  0, 0,  0, 200 },
+        { WRP_MSG_TYPE__DELETE,    0,  0, 0, -1, 400 },
+        { WRP_MSG_TYPE__DELETE,    0,  0, 0, -2, 404 },
+        { WRP_MSG_TYPE__DELETE,    0,  0, 0, -3, 535 },
+
+        /* The payload is the stored msgpack, which the stub doesn't set. */
+        { WRP_MSG_TYPE__RETREIVE,  0,  0, 0,  0, 404 },
+    };
+    size_t i;
+
+    for( i = 0; i < sizeof(tests)/sizeof(tests[0]); i++ ) {
+        wrp_msg_t in, out;
+
+        memset(&in, 0, sizeof(wrp_msg_t));
+        memset(&out, 0, sizeof(wrp_msg_t));
+        in.msg_type = tests[i].msg_type;
+        in.u.crud.transaction_uuid = "c2bb1f16-09c8-11e7-93ae-92361f002671";
+        in.u.crud.source = "fake-server";
+        in.u.crud.dest = "mac:112233445566/aker/schedule/kids";
+        in.u.crud.path = "Some path";
+
+        process_is_named_create_ok_rv = tests[i].create_ok_rv;
+        process_named_update_rv = tests[i].update_rv;
+        process_retrieve_named_rv = tests[i].retrieve_rv;
+        process_named_delete_rv = tests[i].delete_rv;
+
+        CU_ASSERT(0 == process_wrp("data", "md5", &in, &out));
+        if( tests[i].status != out.u.crud.status ) {
+            printf( "\nTest: %zu Expected: %d, Got: %d\n", i, tests[i].status, out.u.crud.status );
+        }
+        CU_ASSERT_EQUAL(tests[i].status, out.u.crud.status);
+        CU_ASSERT(NULL == out.u.crud.headers);
+
+        cleanup_wrp(&out);
+    }
+
+    process_is_named_create_ok_rv = 0;
+    process_named_update_rv = 0;
+    process_retrieve_named_rv = 0;
+    process_named_delete_rv = 0;
+}
+
+void test_tenant()
+{
+    struct {
+        int msg_type;
+        const char *dest;
+        int process_tenant_rv;
+        int status;
+    } tests[] = {
+        { WRP_MSG_TYPE__CREATE,   "mac:112233445566/aker/tenant/sub1",  0, 201 },
+        { WRP_MSG_TYPE__CREATE,   "mac:112233445566/aker/tenant/sub1", -1, 409 },
+        { WRP_MSG_TYPE__UPDATE,   "mac:112233445566/aker/tenant/sub1",  0, 201 },
+        { WRP_MSG_TYPE__UPDATE,   "mac:112233445566/aker/tenant/sub1", -3, 534 },
+        { WRP_MSG_TYPE__RETREIVE, "mac:112233445566/aker/tenant/sub1",  0, 404 },
+        { WRP_MSG_TYPE__DELETE,   "mac:112233445566/aker/tenant/sub1",  0, 200 },
+        { WRP_MSG_TYPE__DELETE,   "mac:112233445566/aker/tenant/sub1", -2, 404 },
+
+        /* Only the tenants in the tenants file. */
+        { WRP_MSG_TYPE__CREATE,   "mac:112233445566/aker/tenant/sub2",  0, 404 },
+        { WRP_MSG_TYPE__UPDATE,   "mac:112233445566/aker/tenant/sub2",  0, 404 },
+        { WRP_MSG_TYPE__UPDATE,   "mac:112233445566/aker/tenant/a.b",   0, 400 },
+    };
+    size_t i;
+
+    for( i = 0; i < sizeof(tests)/sizeof(tests[0]); i++ ) {
+        wrp_msg_t in, out;
+
+        memset(&in, 0, sizeof(wrp_msg_t));
+        memset(&out, 0, sizeof(wrp_msg_t));
+        in.msg_type = tests[i].msg_type;
+        in.u.crud.transaction_uuid = "c2bb1f16-09c8-11e7-93ae-92361f002671";
+        in.u.crud.source = "fake-server";
+        in.u.crud.dest = (char*) tests[i].dest;
+        in.u.crud.path = "Some path";
+
+        process_tenant_rv = tests[i].process_tenant_rv;
+
+        CU_ASSERT(0 == process_wrp("data", "md5", &in, &out));
+        if( tests[i].status != out.u.crud.status ) {
+            printf( "\nTest: %zu Expected: %d, Got: %d\n", i, tests[i].status, out.u.crud.status );
+        }
+        CU_ASSERT_EQUAL(tests[i].status, out.u.crud.status);
+
+        cleanup_wrp(&out);
+    }
+
+    process_tenant_rv = 0;
+}
+
+void test_replaces_and_reject()
+{
+    struct {
+        int msg_type;
+        const char *dest;
+        const char *replaces;
+    } tests[] = {
+        { WRP_MSG_TYPE__UPDATE,   "mac:112233445566/aker/schedule",       "schedule"      },
+        { WRP_MSG_TYPE__UPDATE,   "mac:112233445566/aker/schedule/kids",  "schedule/kids" },
+        { WRP_MSG_TYPE__UPDATE,   "mac:112233445566/aker/tenant/sub1",    "tenant/sub1"   },
+        { WRP_MSG_TYPE__UPDATE,   "mac:112233445566/aker/schedule/patch", NULL            },
+        { WRP_MSG_TYPE__UPDATE,   "mac:112233445566/aker/schedule/a.b",   NULL            },
+        { WRP_MSG_TYPE__UPDATE,   "mac:112233445566/aker/now",            NULL            },
+        { WRP_MSG_TYPE__UPDATE,   "mac:112233445566/other/schedule",      NULL            },
+        { WRP_MSG_TYPE__CREATE,   "mac:112233445566/aker/schedule",       NULL            },
+        { WRP_MSG_TYPE__RETREIVE, "mac:112233445566/aker/schedule",       NULL            },
+    };
+    wrp_msg_t in, out;
+    size_t i;
+
+    for( i = 0; i < sizeof(tests)/sizeof(tests[0]); i++ ) {
+        char *replaces;
+
+        memset(&in, 0, sizeof(wrp_msg_t));
+        in.msg_type = tests[i].msg_type;
+        in.u.crud.dest = (char*) tests[i].dest;
+
+        replaces = process_wrp_replaces(&in);
+        if( NULL == tests[i].replaces ) {
+            CU_ASSERT(NULL == replaces);
+        } else {
+            CU_ASSERT_FATAL(NULL != replaces);
+            CU_ASSERT_STRING_EQUAL(tests[i].replaces, replaces);
+            aker_free(replaces);
+        }
+    }
+
+    memset(&in, 0, sizeof(wrp_msg_t));
+    memset(&out, 0, sizeof(wrp_msg_t));
+    in.msg_type = WRP_MSG_TYPE__UPDATE;
+    in.u.crud.transaction_uuid = "c2bb1f16-09c8-11e7-93ae-92361f002671";
+    in.u.crud.source = "fake-server";
+    in.u.crud.dest = "mac:112233445566/aker/schedule";
+    in.u.crud.path = "Some path";
+
+    CU_ASSERT(0 == process_wrp_reject(&in, 503, "Too many requests", &out));
+    CU_ASSERT(WRP_MSG_TYPE__UPDATE == out.msg_type);
+    CU_ASSERT(503 == out.u.crud.status);
+    CU_ASSERT_STRING_EQUAL("c2bb1f16-09c8-11e7-93ae-92361f002671", out.u.crud.transaction_uuid);
+    CU_ASSERT_STRING_EQUAL("fake-server", out.u.crud.dest);
+    CU_ASSERT_STRING_EQUAL("mac:112233445566/aker/schedule", out.u.crud.source);
+    CU_ASSERT(NULL == in.u.crud.transaction_uuid);
+    cleanup_wrp(&out);
+
+    /* Only CRUD requests have a status to answer with. */
+    memset(&in, 0, sizeof(wrp_msg_t));
+    memset(&out, 0, sizeof(wrp_msg_t));
+    in.msg_type = WRP_MSG_TYPE__REQ;
+    CU_ASSERT(0 != process_wrp_reject(&in, 503, "Too many requests", &out));
+}
+
 void add_suites( CU_pSuite *suite )
 {
     printf("--------Start of Test Cases Execution ---------\n");
     *suite = CU_add_suite( "tests", NULL, NULL );
     CU_add_test( *suite, "Test 1", test_process_wrp );
+    CU_add_test( *suite, "Test conditional retrieve", test_conditional_retrieve );
+    CU_add_test( *suite, "Test patch", test_patch );
+    CU_add_test( *suite, "Test named schedules", test_named );
+    CU_add_test( *suite, "Test tenants", test_tenant );
+    CU_add_test( *suite, "Test replaces and reject", test_replaces_and_reject );
 }
 
 /*----------------------------------------------------------------------------*/